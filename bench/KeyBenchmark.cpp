@@ -0,0 +1,206 @@
+// Microbenchmark for name and path keys: case folding, hashed grouping and path matching,
+// each timed with the per-character C library calls the core used before and with
+// CaseFold, on the same reproducible names.
+//
+//   NewFolderFromFilesKeyBench --names 1000000 --runs 5 --format csv
+//
+// Names are camera-, document- and download-style, mostly ASCII with a share of accented
+// ones, in random case. Each record is the best of --runs.
+
+#include "CaseFold.h"
+#include "NaturalSort.h"
+#include <algorithm>
+#include <chrono>
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cwctype>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct KeyBenchOptions
+{
+    size_t names = 1000000;
+    int runs = 3;
+    uint64_t seed = 1;
+    std::string format = "json";
+};
+
+static uint64_t NextRandom(uint64_t& state)
+{
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static std::vector<std::wstring> MakeNames(const KeyBenchOptions& options)
+{
+    static const wchar_t* const kStems[] = { L"IMG_", L"DSC", L"Invoice ", L"report-final-", L"Caf\u00E9 menu ", L"\u00C9t\u00E9 ", L"scan" };
+    static const wchar_t* const kExts[] = { L".jpg", L".JPG", L".Jpg", L".pdf", L".docx", L".mp4", L".PNG" };
+    uint64_t state = options.seed;
+    std::vector<std::wstring> names;
+    names.reserve(options.names);
+    for (size_t i = 0; i < options.names; i++)
+    {
+        uint64_t r = NextRandom(state);
+        std::wstring name = kStems[r % 7] + std::to_wstring((r >> 8) % 100000) + kExts[(r >> 32) % 7];
+        for (auto& c : name)
+        {
+            if (NextRandom(state) & 1)
+                c = static_cast<wchar_t>(c < 0x80 ? towupper(c) : FoldCase(c));
+        }
+        names.push_back(std::move(name));
+    }
+    return names;
+}
+
+// Best of runs, in nanoseconds per name
+template <typename Body>
+static double TimeBest(const KeyBenchOptions& options, Body body)
+{
+    double best = 0;
+    for (int run = 0; run < options.runs; run++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / options.names;
+        if (run == 0 || ns < best)
+            best = ns;
+    }
+    return best;
+}
+
+static void PrintRecord(const KeyBenchOptions& options, const char* bench, const char* impl, double ns, size_t check)
+{
+    if (options.format == "csv")
+        printf("%s,%s,%zu,%.2f,%zu\n", bench, impl, options.names, ns, check);
+    else
+        printf("{\"bench\":\"%s\",\"impl\":\"%s\",\"names\":%zu,\"ns_per_name\":%.2f,\"check\":%zu}\n", bench, impl, options.names, ns, check);
+}
+
+#ifdef _WIN32
+static int CompareNoCase(const wchar_t* a, const wchar_t* b) { return _wcsicmp(a, b); }
+#else
+static int CompareNoCase(const wchar_t* a, const wchar_t* b) { return wcscasecmp(a, b); }
+#endif
+
+// The key the core built before: an uppercased copy
+static std::wstring TowupperKey(const std::wstring& name)
+{
+    std::wstring key = name;
+    for (auto& c : key) c = static_cast<wchar_t>(towupper(c));
+    return key;
+}
+
+static void RunBenchmarks(const KeyBenchOptions& options)
+{
+    std::vector<std::wstring> names = MakeNames(options);
+    size_t check = 0;
+
+    // Folding a name into a key
+    double ns = TimeBest(options, [&]() {
+        check = 0;
+        for (const auto& name : names)
+            check += TowupperKey(name)[0];
+    });
+    PrintRecord(options, "fold", "towupper", ns, check);
+    ns = TimeBest(options, [&]() {
+        check = 0;
+        for (const auto& name : names)
+            check += FoldCase(name)[0];
+    });
+    PrintRecord(options, "fold", "casefold", ns, check);
+
+    // Grouping names that differ only in case (conflict checks, folder grouping)
+    ns = TimeBest(options, [&]() {
+        std::unordered_map<std::wstring, size_t> groups;
+        groups.reserve(names.size());
+        for (const auto& name : names)
+            groups.emplace(TowupperKey(name), groups.size());
+        check = groups.size();
+    });
+    PrintRecord(options, "group", "towupper", ns, check);
+    ns = TimeBest(options, [&]() {
+        std::unordered_map<std::wstring, size_t, FoldedHash, FoldedEqual> groups;
+        groups.reserve(names.size());
+        for (const auto& name : names)
+            groups.emplace(name, groups.size());
+        check = groups.size();
+    });
+    PrintRecord(options, "group", "casefold", ns, check);
+
+    // Matching a full path against the same path in other case (shell view lookup)
+    std::vector<std::wstring> paths, others;
+    paths.reserve(names.size());
+    others.reserve(names.size());
+    for (const auto& name : names)
+    {
+        paths.push_back(L"/home/user/Pictures/Camera Uploads/2024/" + name);
+        others.push_back(FoldCase(paths.back()));
+    }
+    ns = TimeBest(options, [&]() {
+        check = 0;
+        for (size_t i = 0; i < paths.size(); i++)
+            check += CompareNoCase(paths[i].c_str(), others[i].c_str()) == 0;
+    });
+    PrintRecord(options, "match", "wcsicmp", ns, check);
+    ns = TimeBest(options, [&]() {
+        check = 0;
+        for (size_t i = 0; i < paths.size(); i++)
+            check += EqualsFolded(paths[i], others[i]);
+    });
+    PrintRecord(options, "match", "casefold", ns, check);
+
+    // Natural sort keys for the whole list, then the sort
+    ns = TimeBest(options, [&]() { check = NaturalOrder(names).front(); });
+    PrintRecord(options, "natural-sort", "keys", ns, check);
+}
+
+static void PrintUsage()
+{
+    fprintf(stderr,
+        "Usage: NewFolderFromFilesKeyBench [options]\n"
+        "  --names N               names per benchmark (default 1000000)\n"
+        "  --runs N                repetitions; the best is reported (default 3)\n"
+        "  --seed N                generator seed (default 1)\n"
+        "  --format json|csv       one record per line (default json)\n");
+}
+
+static bool ParseOptions(int argc, char** argv, KeyBenchOptions& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+            return false;
+        const char* value = argv[++i];
+
+        if (arg == "--names") options.names = static_cast<size_t>(strtoull(value, nullptr, 10));
+        else if (arg == "--runs") options.runs = atoi(value);
+        else if (arg == "--seed") options.seed = strtoull(value, nullptr, 10);
+        else if (arg == "--format") options.format = value;
+        else return false;
+    }
+    return options.names > 0 && options.runs > 0;
+}
+
+int main(int argc, char** argv)
+{
+    KeyBenchOptions options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    // The process locale the baselines run in, as in a desktop session
+    setlocale(LC_ALL, "");
+    if (options.format == "csv")
+        printf("bench,impl,names,ns_per_name,check\n");
+    RunBenchmarks(options);
+    return 0;
+}
@@ -0,0 +1,889 @@
+// Synthetic-tree benchmark for every OrganizeMode.
+//
+// Generates a reproducible directory of N files, runs one organize against it
+// through the portable core and reports per-phase wall times:
+//   enumerate -> metadata -> plan -> naming -> execute
+//
+//   NewFolderFromFilesBench --root /dev/shm/nff --files 1000,100000 --modes all --format json
+//
+// Each (files, mode, run) gets a fresh tree so moves never see a pre-organized folder.
+
+#include "FakeFileSystem.h"
+#include "FolderIndex.h"
+#include "OrganizeConflicts.h"
+#include "OrganizeExecutor.h"
+#include "OrganizePlanner.h"
+#include "OrganizeRules.h"
+#include "OrganizeStreaming.h"
+#include "OrganizeViews.h"
+#include "ZipArchive.h"
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/vfs.h>
+#endif
+
+namespace fs = std::filesystem;
+
+struct BenchOptions
+{
+    std::string root;
+    std::vector<size_t> fileCounts = { 10000 };
+    std::vector<OrganizeMode> modes;
+    std::string names = "mixed";
+    std::string exts = "mixed";
+    std::string sizes = "mixed";
+    int mtimeDays = 365;
+    int runs = 1;
+    uint64_t seed = 1;
+    std::string format = "json";
+    std::string label;
+    std::string output;
+    std::string rulesFile;
+    bool headers = false;
+    OrganizeOptions organize;
+    ExecuteOptions execute;
+    ConflictPolicy conflict = ConflictPolicy::None;
+    bool view = false;
+    bool archive = false;
+    bool index = false;
+    bool fake = false;  // Run against FakeFileSystem; times are virtual
+    IoBackend io = IoBackend::Default;  // How LocalFileSystem runs batched stats, mkdirs and moves
+    size_t streamMB = 0;  // Plan through sorted runs with this memory limit (per-entry modes)
+    FakeFileSystemOptions fakeOptions;
+};
+
+struct PhaseTimes
+{
+    double enumerate = 0;
+    double metadata = 0;
+    double plan = 0;
+    double naming = 0;
+    double execute = 0;
+};
+
+// splitmix64: same sequence on every platform and compiler
+class BenchRandom
+{
+public:
+    explicit BenchRandom(uint64_t seed) : m_state(seed) {}
+
+    uint64_t Next()
+    {
+        uint64_t z = (m_state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t Below(uint64_t bound) { return bound ? Next() % bound : 0; }
+    double Unit() { return (Next() >> 11) * (1.0 / 9007199254740992.0); }
+
+private:
+    uint64_t m_state;
+};
+
+static const char* const kWords[] =
+{
+    "invoice", "report", "photo", "scan", "holiday", "draft", "final", "meeting",
+    "budget", "summary", "render", "shot", "track", "clip", "notes", "backup",
+    "Export", "IMG", "DSC", "Screenshot", "Project", "Client", "archive", "zeta",
+};
+
+struct WeightedExt
+{
+    const char* ext;
+    int weight;
+};
+
+static const WeightedExt kMediaExts[] = { { "jpg", 40 }, { "png", 15 }, { "mp4", 15 }, { "mov", 5 }, { "mp3", 15 }, { "flac", 5 }, { "heic", 5 } };
+static const WeightedExt kDocumentExts[] = { { "pdf", 35 }, { "docx", 25 }, { "xlsx", 15 }, { "txt", 15 }, { "md", 5 }, { "csv", 5 } };
+static const WeightedExt kMixedExts[] = { { "jpg", 20 }, { "pdf", 15 }, { "mp4", 8 }, { "mp3", 8 }, { "docx", 10 }, { "zip", 8 }, { "txt", 8 }, { "png", 8 }, { "exe", 5 }, { "", 5 }, { "JPG", 5 } };
+static const WeightedExt kSingleExts[] = { { "dat", 1 } };
+
+template <size_t N>
+static const char* PickExt(BenchRandom& rng, const WeightedExt (&table)[N])
+{
+    int total = 0;
+    for (const auto& e : table) total += e.weight;
+    int pick = static_cast<int>(rng.Below(total));
+    for (const auto& e : table)
+    {
+        if (pick < e.weight) return e.ext;
+        pick -= e.weight;
+    }
+    return table[0].ext;
+}
+
+static const char* PickExtension(BenchRandom& rng, const std::string& mix)
+{
+    if (mix == "media") return PickExt(rng, kMediaExts);
+    if (mix == "documents") return PickExt(rng, kDocumentExts);
+    if (mix == "single") return PickExt(rng, kSingleExts);
+    return PickExt(rng, kMixedExts);
+}
+
+static std::string RandomWord(BenchRandom& rng)
+{
+    std::string word;
+    size_t length = 4 + rng.Below(9);
+    for (size_t i = 0; i < length; i++)
+        word.push_back(static_cast<char>('a' + rng.Below(26)));
+    return word;
+}
+
+static std::string MakeStem(BenchRandom& rng, const std::string& dist, size_t index, size_t count)
+{
+    char buffer[64];
+    std::string kind = dist;
+    if (kind == "mixed")
+    {
+        static const char* const kKinds[] = { "random", "prefixed", "numbered" };
+        kind = kKinds[rng.Below(3)];
+    }
+
+    if (kind == "frames")
+    {
+        // Render output: 1000-frame shots
+        snprintf(buffer, sizeof(buffer), "shot%03zu_v001.%04zu", index / 1000, index % 1000 + 1);
+        return buffer;
+    }
+    if (kind == "numbered")
+    {
+        snprintf(buffer, sizeof(buffer), "IMG_%07zu", index);
+        return buffer;
+    }
+    if (kind == "prefixed")
+    {
+        // ~1% distinct series, each with many members
+        size_t series = rng.Below(count / 100 + 1);
+        snprintf(buffer, sizeof(buffer), "%s_%zu_%zu", kWords[series % (sizeof(kWords) / sizeof(kWords[0]))], series, index);
+        return buffer;
+    }
+    snprintf(buffer, sizeof(buffer), "_%zx", index);
+    return RandomWord(rng) + buffer;
+}
+
+// Minimal real header for formats the media readers understand, so header-reading
+// modes see parseable files; empty for everything else
+static std::string MakeHeader(BenchRandom& rng, std::string ext)
+{
+    for (auto& c : ext) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    uint32_t width = 320 + static_cast<uint32_t>(rng.Below(7680));
+    uint32_t height = 240 + static_cast<uint32_t>(rng.Below(4320));
+    auto be16 = [](std::string& out, uint32_t v) { out.push_back(static_cast<char>(v >> 8)); out.push_back(static_cast<char>(v)); };
+    auto be32 = [&](std::string& out, uint32_t v) { be16(out, v >> 16); be16(out, v & 0xFFFF); };
+
+    std::string header;
+    if (ext == "png")
+    {
+        header.assign("\x89PNG\r\n\x1A\n", 8);
+        be32(header, 13);
+        header += "IHDR";
+        be32(header, width);
+        be32(header, height);
+        header.append("\x08\x02\0\0\0", 5);
+    }
+    else if (ext == "jpg" || ext == "jpeg")
+    {
+        // SOI, JFIF APP0, baseline SOF0
+        header.assign("\xFF\xD8\xFF\xE0", 4);
+        be16(header, 16);
+        header.append("JFIF\0\x01\x01\0\0\x01\0\x01\0\0", 14);
+        header.append("\xFF\xC0", 2);
+        be16(header, 17);
+        header.push_back(8);
+        be16(header, height);
+        be16(header, width);
+        header.append("\x03\x01\x22\0\x02\x11\x01\x03\x11\x01", 10);
+        header.append("\xFF\xDA", 2);
+    }
+    else if (ext == "mp3")
+    {
+        // ID3v2.3 with album artist and album, as tag-based modes read them
+        std::string frames;
+        auto frame = [&](const char* id, const std::string& text)
+        {
+            frames += id;
+            be32(frames, static_cast<uint32_t>(text.size() + 1));
+            frames.append("\0\0\0", 3);  // Flags, Latin-1
+            frames += text;
+        };
+        frame("TPE2", "Artist " + std::to_string(rng.Below(200)));
+        frame("TALB", "Album " + std::to_string(rng.Below(20)));
+        header.assign("ID3\x03\0\0", 6);
+        for (int shift = 21; shift >= 0; shift -= 7)
+            header.push_back(static_cast<char>((frames.size() >> shift) & 0x7F));
+        header += frames;
+    }
+    else if (ext == "mp4" || ext == "mov")
+    {
+        // ftyp, then a faststart moov holding just mvhd (version 0, seconds since 1904)
+        uint32_t created = 3600000000u + static_cast<uint32_t>(rng.Below(300000000));
+        header.assign("\0\0\0\x10" "ftypisom\0\0\0\0", 16);
+        be32(header, 8 + 8 + 100);
+        header += "moov";
+        be32(header, 8 + 100);
+        header += "mvhd";
+        be32(header, 0);
+        be32(header, created);
+        be32(header, created);
+        header.append(88, '\0');
+    }
+    return header;
+}
+
+static uint64_t PickSize(BenchRandom& rng, const std::string& dist)
+{
+    const uint64_t MB = 1024 * 1024;
+    if (dist == "empty") return 0;
+    if (dist == "small") return rng.Below(64 * 1024);
+    if (dist == "large") return 100 * MB + rng.Below(1900 * MB);
+
+    // mixed: mostly small, some medium, a few large (all sparse)
+    double u = rng.Unit();
+    if (u < 0.80) return rng.Below(MB);
+    if (u < 0.95) return MB + rng.Below(99 * MB);
+    return 100 * MB + rng.Below(900 * MB);
+}
+
+// Creates count files under dir (or spread across 16 subfolders for Flatten), on disk or
+// in the fake filesystem. Returns the folders that hold the generated files.
+static std::vector<fs::path> GenerateTree(const fs::path& dir, const BenchOptions& options, size_t count, bool nested, uint64_t seed,
+    FakeFileSystem* fake)
+{
+    BenchRandom rng(seed);
+    std::vector<fs::path> folders;
+    if (fake)
+        fake->AddFolder(dir.wstring());
+    else
+        fs::create_directories(dir);
+
+    if (nested)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            folders.push_back(dir / ("sub" + std::to_string(i)));
+            if (fake)
+                fake->AddFolder(folders.back().wstring());
+            else
+                fs::create_directory(folders.back());
+        }
+    }
+    else
+    {
+        folders.push_back(dir);
+    }
+
+    auto now = fs::file_time_type::clock::now();
+    const int64_t kUnixEpochSeconds = 11644473600LL;
+    int64_t nowSeconds = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    for (size_t i = 0; i < count; i++)
+    {
+        std::string name = MakeStem(rng, options.names, i, count);
+        const char* ext = PickExtension(rng, options.exts);
+        if (*ext)
+            name = name + "." + ext;
+
+        fs::path path = folders[i % folders.size()] / name;
+        std::string header = options.headers ? MakeHeader(rng, ext) : std::string();
+        uint64_t size = PickSize(rng, options.sizes);
+        int64_t age = static_cast<int64_t>(rng.Below(static_cast<uint64_t>(options.mtimeDays) * 86400 + 1));
+        if (fake)
+        {
+            uint64_t ticks = static_cast<uint64_t>(nowSeconds - age + kUnixEpochSeconds) * 10000000ULL;
+            fake->AddFile(path.wstring(), size, ticks, header);
+            continue;
+        }
+
+        {
+            std::ofstream file(path, std::ios::binary);
+            file.write(header.data(), header.size());
+        }
+        if (size > header.size())
+            fs::resize_file(path, size);
+        fs::last_write_time(path, now - std::chrono::seconds(age));
+    }
+
+    return folders;
+}
+
+static std::string FilesystemType(const std::string& root)
+{
+#ifdef __linux__
+    struct statfs sfs;
+    if (statfs(root.c_str(), &sfs) == 0)
+    {
+        switch (static_cast<unsigned long>(sfs.f_type))
+        {
+        case 0x01021994: return "tmpfs";
+        case 0xEF53: return "ext4";
+        case 0x9123683E: return "btrfs";
+        case 0x58465342: return "xfs";
+        case 0x6969: return "nfs";
+        case 0xFF534D42: return "cifs";
+        case 0x794C7630: return "overlayfs";
+        default:
+        {
+            char buffer[32];
+            snprintf(buffer, sizeof(buffer), "0x%lx", static_cast<unsigned long>(sfs.f_type));
+            return buffer;
+        }
+        }
+    }
+#endif
+    (void)root;
+    return "unknown";
+}
+
+// Resets the process's peak resident size to what it holds now (Linux 4.0+)
+static void ResetPeakRss()
+{
+#ifdef __linux__
+    if (FILE* file = fopen("/proc/self/clear_refs", "w"))
+    {
+        fputs("5", file);
+        fclose(file);
+    }
+#endif
+}
+
+// Peak resident size in MB since the last reset; 0 where it cannot be read
+static double PeakRssMb()
+{
+#ifdef __linux__
+    if (FILE* file = fopen("/proc/self/status", "r"))
+    {
+        char line[256];
+        double kb = 0;
+        while (fgets(line, sizeof(line), file))
+        {
+            if (strncmp(line, "VmHWM:", 6) == 0)
+                kb = atof(line + 6);
+        }
+        fclose(file);
+        return kb / 1024;
+    }
+#endif
+    return 0;
+}
+
+using BenchClock = std::chrono::steady_clock;
+
+static double ElapsedMs(BenchClock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+// The label as a JSON string body: quotes, backslashes and control characters escaped
+static std::string JsonEscape(const std::string& text)
+{
+    std::string escaped;
+    for (unsigned char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            escaped += '\\';
+            escaped += static_cast<char>(c);
+        }
+        else if (c < 0x20)
+        {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", c);
+            escaped += code;
+        }
+        else
+        {
+            escaped += static_cast<char>(c);
+        }
+    }
+    return escaped;
+}
+
+// The label as one CSV field: quoted (quotes doubled) when it holds a comma, quote or line break
+static std::string CsvField(const std::string& text)
+{
+    if (text.find_first_of(",\"\r\n") == std::string::npos)
+        return text;
+    std::string quoted = "\"";
+    for (char c : text)
+    {
+        if (c == '"')
+            quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+static void PrintRecord(FILE* out, const BenchOptions& options, OrganizeMode mode, size_t count, int run,
+    const PhaseTimes& times, size_t groups, size_t moved, size_t failed, const char* action)
+{
+    double total = times.enumerate + times.metadata + times.plan + times.naming + times.execute;
+    std::string fsType = options.fake ? "fake" : FilesystemType(options.root);
+
+    if (options.format == "csv")
+    {
+        fprintf(out, "%s,%s,%s,%zu,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%zu,%zu,%zu,%s,%s,%.1f\n",
+            CsvField(options.label).c_str(), fsType.c_str(), GetOrganizeModeName(mode), count, run,
+            times.enumerate, times.metadata, times.plan, times.naming, times.execute, total,
+            groups, moved, failed, action, GetIoBackendName(options.io), PeakRssMb());
+    }
+    else
+    {
+        fprintf(out, "{\"label\":\"%s\",\"fs\":\"%s\",\"mode\":\"%s\",\"files\":%zu,\"run\":%d,"
+            "\"enumerate_ms\":%.3f,\"metadata_ms\":%.3f,\"plan_ms\":%.3f,\"naming_ms\":%.3f,\"execute_ms\":%.3f,"
+            "\"total_ms\":%.3f,\"groups\":%zu,\"moved\":%zu,\"failed\":%zu,\"action\":\"%s\",\"io\":\"%s\","
+            "\"peak_rss_mb\":%.1f}\n",
+            JsonEscape(options.label).c_str(), fsType.c_str(), GetOrganizeModeName(mode), count, run,
+            times.enumerate, times.metadata, times.plan, times.naming, times.execute, total,
+            groups, moved, failed, action, GetIoBackendName(options.io), PeakRssMb());
+    }
+    fflush(out);
+}
+
+static void RunOnce(const BenchOptions& options, OrganizeMode mode, size_t count, int run, FILE* out)
+{
+    bool nested = mode == OrganizeMode::Flatten;
+    fs::path dir = fs::path(options.root) / ("nffbench-" + std::string(GetOrganizeModeName(mode)) + "-" + std::to_string(count));
+    fs::remove_all(dir);
+
+    LocalFileSystem local(options.io);
+    std::unique_ptr<FakeFileSystem> fake;
+    if (options.fake)
+        fake = std::make_unique<FakeFileSystem>(options.fakeOptions);
+    IFileSystem& fsys = fake ? static_cast<IFileSystem&>(*fake) : local;
+
+    // Same seed for every mode so all modes see the same names, sizes and dates
+    std::vector<fs::path> folders = GenerateTree(dir, options, count, nested, options.seed + count, fake.get());
+    std::wstring parent = dir.wstring();
+    ResetPeakRss();
+
+    // Phase times: wall clock, or virtual time when the run goes through the fake filesystem
+    BenchClock::time_point runStart = BenchClock::now();
+    auto now = [&]() { return fake ? fake->ElapsedMs() : ElapsedMs(runStart); };
+    PhaseTimes times;
+    std::vector<FileEntry> entries;
+
+    // Indexed listing: the first pass builds the folder index, the second reuses it
+    if (options.index && !nested)
+    {
+        FolderIndexOptions indexOptions;
+        indexOptions.mediaFields = OrganizeModeMediaFields(mode, options.organize);
+        for (const char* action : { "index-cold", "index-warm" })
+        {
+            double start = now();
+            FolderIndexStats stats;
+            ListDirectoryIndexed(local, parent, entries, indexOptions, &stats);
+            times.enumerate = now() - start;
+
+            start = now();
+            OrganizePlan plan;
+            BuildOrganizePlan(entries, mode, plan, options.organize);
+            times.plan = now() - start;
+            PrintRecord(out, options, mode, count, run, times, plan.groups.size(), stats.reused, 0, action);
+        }
+
+        fs::remove_all(dir);
+        std::wstring indexPath = GetFolderIndexPath(parent);
+        if (!indexPath.empty())
+            local.DeleteEntry(indexPath);
+        return;
+    }
+
+    // Streaming: listing, metadata and the sort into runs are all timed as plan
+    if (options.streamMB > 0 && !nested && OrganizeModeIsPerEntry(mode))
+    {
+        StreamingPlanOptions streamOptions;
+        streamOptions.memoryLimit = options.streamMB << 20;
+        StreamingPlan stream(streamOptions);
+        double start = now();
+        size_t metadataFailures = 0;
+        BuildStreamingPlan(fsys, parent, mode, options.organize, stream, &metadataFailures);
+        times.plan = now() - start;
+
+        start = now();
+        OrganizeResult result;
+        ExecuteStreamingPlan(fsys, parent, stream, result, options.execute);
+        times.execute = now() - start;
+        PrintRecord(out, options, mode, count, run, times, result.folders.size(), result.moved, result.failed + metadataFailures, "stream");
+
+        fs::remove_all(dir);
+        return;
+    }
+
+    double start = now();
+    if (nested)
+    {
+        std::vector<FileEntry> selection;
+        for (const auto& folder : folders)
+        {
+            FileEntry entry;
+            entry.path = folder.wstring();
+            entry.isDirectory = true;
+            entry.hasMetadata = true;
+            selection.push_back(entry);
+        }
+        entries = ExpandFolderContents(fsys, selection);
+    }
+    else
+    {
+        fsys.ListDirectory(parent, entries);
+    }
+    times.enumerate = now() - start;
+
+    start = now();
+    size_t metadataFailures = 0;
+    if (OrganizeModeNeedsMetadata(mode, options.organize))
+        metadataFailures = QueryEntriesMetadata(fsys, entries);
+    if (unsigned fields = OrganizeModeMediaFields(mode, options.organize))
+        QueryEntriesMediaInfo(fsys, entries, fields);
+    times.metadata = now() - start;
+
+    start = now();
+    OrganizePlan plan;
+    BuildOrganizePlan(entries, mode, plan, options.organize);
+    times.plan = now() - start;
+
+    // Views: the plan as hard links in a sibling folder, then an unchanged rebuild
+    if (options.view)
+    {
+        fs::path viewDir = dir;
+        viewDir += "-view";
+        fs::remove_all(viewDir);
+
+        start = now();
+        ViewResult view;
+        BuildLinkView(fsys, viewDir.wstring(), entries, plan, view);
+        times.execute = now() - start;
+        PrintRecord(out, options, mode, count, run, times, plan.groups.size(), view.linked, view.failed + metadataFailures, "view");
+
+        start = now();
+        ViewResult rebuild;
+        BuildLinkView(fsys, viewDir.wstring(), entries, plan, rebuild);
+        times.execute = now() - start;
+        PrintRecord(out, options, mode, count, run, times, plan.groups.size(), rebuild.linked, rebuild.failed + metadataFailures, "view-rebuild");
+
+        fs::remove_all(dir);
+        fs::remove_all(viewDir);
+        return;
+    }
+
+    // Archives: the whole selection into a sibling .zip; the plan is not used
+    if (options.archive)
+    {
+        fs::path archivePath = dir;
+        archivePath += ".zip";
+        fs::remove(archivePath);
+
+        start = now();
+        ArchiveResult archive;
+        CreateZipArchive(fsys, archivePath.wstring(), entries, archive);
+        times.execute = now() - start;
+        PrintRecord(out, options, mode, count, run, times, plan.groups.size(), archive.files, archive.failed + metadataFailures, "archive");
+
+        fs::remove_all(dir);
+        fs::remove(archivePath);
+        return;
+    }
+
+    // Copies land in a sibling staging folder, as they would on another drive
+    fs::path staging = dir;
+    staging += "-staging";
+    std::wstring target = parent;
+    if (options.execute.copy)
+    {
+        fs::remove_all(staging);
+        if (fake)
+            fake->AddFolder(staging.wstring());
+        else
+            fs::create_directories(staging);
+        target = staging.wstring();
+    }
+
+    start = now();
+    std::vector<std::wstring> destinations = ResolveDestinations(fsys, target, plan);
+    ResolveConflicts(fsys, entries, plan, destinations, options.conflict);
+    times.naming = now() - start;
+
+    start = now();
+    OrganizeResult result;
+    ExecuteOrganizePlan(fsys, target, entries, plan, destinations, result, options.execute);
+    times.execute = now() - start;
+
+    const char* action = !options.execute.copy ? "move" : options.execute.verify ? "copy-verify" : "copy";
+    PrintRecord(out, options, mode, count, run, times, plan.groups.size(), result.moved, result.failed + metadataFailures, action);
+
+    fs::remove_all(dir);
+    if (options.execute.copy)
+        fs::remove_all(staging);
+}
+
+static std::vector<std::string> SplitList(const char* value)
+{
+    std::vector<std::string> items;
+    std::string current;
+    for (const char* p = value; ; p++)
+    {
+        if (*p == ',' || *p == 0)
+        {
+            if (!current.empty()) items.push_back(current);
+            current.clear();
+            if (*p == 0) break;
+        }
+        else
+        {
+            current.push_back(*p);
+        }
+    }
+    return items;
+}
+
+static void PrintUsage()
+{
+    fprintf(stderr,
+        "Usage: NewFolderFromFilesBench --root DIR [options]\n"
+        "  --files N[,N...]        file counts (default 10000)\n"
+        "  --modes all|m1,m2       organize modes by name (default all)\n"
+        "  --names random|prefixed|numbered|frames|mixed\n"
+        "  --exts media|documents|mixed|single\n"
+        "  --sizes empty|small|mixed|large   (files are sparse)\n"
+        "  --mtime-days N          spread of modification times (default 365)\n"
+        "  --runs N                repetitions per mode (default 1)\n"
+        "  --seed N                generator seed (default 1)\n"
+        "  --format json|csv       one record per line (default json)\n"
+        "  --label TEXT            free-form tag copied into every record\n"
+        "  --output FILE           append results to FILE instead of stdout\n"
+        "  --rules FILE            rules file for the \"rules\" mode (included in all when given)\n"
+        "  --headers               write real headers into .jpg/.png/.mp3/.mp4 files (header-reading modes)\n"
+        "  --template T            destination template for the \"template\" mode, e.g. {yyyy}/{MM}/{category}\n"
+        "  --copy                  copy into a staging folder instead of moving\n"
+        "  --verify                with --copy, compare every copy with its source\n"
+        "  --conflict P            resolve name conflicts up front: rename, skip, newer, keep-both (timed as naming)\n"
+        "  --view                  build a hard-link view instead, then rebuild it unchanged (action view-rebuild)\n"
+        "  --archive               zip the whole selection into a sibling archive instead (action archive)\n"
+        "  --index                 list through the folder index twice, cold then warm (actions index-cold,\n"
+        "                          index-warm; enumerate includes metadata and headers; moved = entries reused)\n"
+        "  --threads N             with --copy, files copied at once (default: the executor's); with --fake,\n"
+        "                          also the calls the share serves at once (default 8)\n"
+        "  --io B                  batched stats, folder creation and moves: sync, threads, uring or default\n"
+        "                          (default: sync; uring needs a kernel with io_uring); the record's io field\n"
+        "  --stream MB             per-entry modes plan through sorted runs on disk, holding at most MB in\n"
+        "                          memory (action stream; plan includes enumerate and metadata)\n"
+        "  --fake MS[,P99]         run in memory against a share with this median (and 99th percentile,\n"
+        "                          default 4x) latency per call; times are virtual (fs \"fake\")\n"
+        "  --fake-mbps N           with --fake, bandwidth shared by all data moved (default unlimited)\n"
+        "  --fake-fail RATE        with --fake, fraction of calls that fail (e.g. 0.001)\n"
+        "  --fake-sharing RATE     with --fake, fraction of opens, copies and moves refused as in use\n");
+}
+
+static bool ParseOptions(int argc, char** argv, BenchOptions& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--headers" || arg == "--copy" || arg == "--verify" || arg == "--view" || arg == "--archive" ||
+            arg == "--index")
+        {
+            if (arg == "--headers") options.headers = true;
+            else if (arg == "--copy") options.execute.copy = true;
+            else if (arg == "--verify") options.execute.verify = true;
+            else if (arg == "--view") options.view = true;
+            else if (arg == "--archive") options.archive = true;
+            else options.index = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+            return false;
+        const char* value = argv[++i];
+
+        if (arg == "--root") options.root = value;
+        else if (arg == "--names") options.names = value;
+        else if (arg == "--exts") options.exts = value;
+        else if (arg == "--sizes") options.sizes = value;
+        else if (arg == "--mtime-days") options.mtimeDays = atoi(value);
+        else if (arg == "--runs") options.runs = atoi(value);
+        else if (arg == "--seed") options.seed = strtoull(value, nullptr, 10);
+        else if (arg == "--format") options.format = value;
+        else if (arg == "--label") options.label = value;
+        else if (arg == "--output") options.output = value;
+        else if (arg == "--rules") options.rulesFile = value;
+        else if (arg == "--conflict")
+        {
+            if (!ParseConflictPolicy(value, options.conflict))
+                return false;
+        }
+        else if (arg == "--threads") options.execute.threads = static_cast<unsigned>(atoi(value));
+        else if (arg == "--io")
+        {
+            if (!ParseIoBackend(value, options.io))
+                return false;
+        }
+        else if (arg == "--stream") options.streamMB = static_cast<size_t>(strtoull(value, nullptr, 10));
+        else if (arg == "--fake")
+        {
+            char* end = nullptr;
+            double median = strtod(value, &end);
+            double p99 = (*end == ',') ? strtod(end + 1, nullptr) : median * 4;
+            if (median < 0 || p99 < 0)
+                return false;
+            options.fake = true;
+            FakeLatency latency{ median, p99 };
+            options.fakeOptions.metadata = latency;
+            options.fakeOptions.change = latency;
+            options.fakeOptions.open = latency;
+            options.fakeOptions.io = latency;
+        }
+        else if (arg == "--fake-mbps") options.fakeOptions.bandwidthMBps = atof(value);
+        else if (arg == "--fake-fail") options.fakeOptions.failureRate = atof(value);
+        else if (arg == "--fake-sharing") options.fakeOptions.sharingRate = atof(value);
+        else if (arg == "--template") options.organize.destinationTemplate = Utf8ToWide(value, strlen(value));
+        else if (arg == "--files")
+        {
+            options.fileCounts.clear();
+            for (const auto& item : SplitList(value))
+                options.fileCounts.push_back(static_cast<size_t>(strtoull(item.c_str(), nullptr, 10)));
+        }
+        else if (arg == "--modes")
+        {
+            options.modes.clear();
+            if (strcmp(value, "all") == 0)
+                continue;
+            for (const auto& item : SplitList(value))
+            {
+                OrganizeMode mode;
+                if (!ParseOrganizeMode(item.c_str(), mode))
+                {
+                    fprintf(stderr, "Unknown mode: %s\n", item.c_str());
+                    return false;
+                }
+                options.modes.push_back(mode);
+            }
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (options.modes.empty())
+    {
+        // The ByType* variants all run the same full type sort; bench it once
+        for (int m = 0; m < static_cast<int>(OrganizeMode::COUNT); m++)
+        {
+            OrganizeMode mode = static_cast<OrganizeMode>(m);
+            if (mode == OrganizeMode::ByTypePhoto || mode == OrganizeMode::ByTypeAudio ||
+                mode == OrganizeMode::ByTypeDocument || mode == OrganizeMode::ByTypeOther)
+                continue;
+            if (mode == OrganizeMode::ByRules && options.rulesFile.empty())
+                continue;
+            if (mode == OrganizeMode::ByTemplate && options.organize.destinationTemplate.empty())
+                continue;
+            options.modes.push_back(mode);
+        }
+    }
+
+    // The index lists through the OS (USN journal, inodes), which the fake does not have
+    if (options.fake && options.index)
+    {
+        fprintf(stderr, "--index cannot be combined with --fake\n");
+        return false;
+    }
+    if (options.fake && options.io != IoBackend::Default)
+    {
+        fprintf(stderr, "--io cannot be combined with --fake\n");
+        return false;
+    }
+    if (options.streamMB > 0 && (options.execute.copy || options.view || options.archive || options.index))
+    {
+        fprintf(stderr, "--stream only moves\n");
+        return false;
+    }
+    options.fakeOptions.seed = options.seed;
+    // The fake serves as many calls at once as the copies run with, whatever this machine has
+    if (options.fake)
+    {
+        if (options.execute.threads == 0)
+            options.execute.threads = 8;
+        options.fakeOptions.slots = options.execute.threads;
+    }
+
+    return !options.root.empty() && options.runs > 0;
+}
+
+int main(int argc, char** argv)
+{
+    BenchOptions options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    RuleSet rules;
+    if (!options.rulesFile.empty())
+    {
+        std::wstring error;
+        if (!LoadRulesFile(Utf8ToWide(options.rulesFile.data(), options.rulesFile.size()), rules, &error))
+        {
+            fprintf(stderr, "%s: %s\n", options.rulesFile.c_str(), WideToUtf8(error).c_str());
+            return 1;
+        }
+        options.organize.rules = &rules;
+    }
+    for (OrganizeMode mode : options.modes)
+    {
+        if (mode == OrganizeMode::ByRules && !options.organize.rules)
+        {
+            fprintf(stderr, "Mode rules needs --rules FILE\n");
+            return 2;
+        }
+        if (mode == OrganizeMode::ByTemplate && !IsValidDestinationTemplate(options.organize.destinationTemplate))
+        {
+            fprintf(stderr, "Mode template needs a valid --template\n");
+            return 2;
+        }
+    }
+
+    FILE* out = stdout;
+    if (!options.output.empty())
+    {
+        out = fopen(options.output.c_str(), "a");
+        if (!out)
+        {
+            fprintf(stderr, "Cannot open %s\n", options.output.c_str());
+            return 1;
+        }
+    }
+
+    // Records pile up across invocations in one file: the header only starts a new one
+    fseek(out, 0, SEEK_END);
+    if (options.format == "csv" && ftell(out) <= 0)
+        fprintf(out, "label,fs,mode,files,run,enumerate_ms,metadata_ms,plan_ms,naming_ms,execute_ms,total_ms,groups,moved,failed,action,io,peak_rss_mb\n");
+
+    try
+    {
+        for (size_t count : options.fileCounts)
+            for (OrganizeMode mode : options.modes)
+                for (int run = 1; run <= options.runs; run++)
+                    RunOnce(options, mode, count, run, out);
+    }
+    catch (const fs::filesystem_error& e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
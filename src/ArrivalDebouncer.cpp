@@ -0,0 +1,54 @@
+#include "ArrivalDebouncer.h"
+
+void ArrivalDebouncer::Touch(const std::wstring& path, uint64_t nowMs)
+{
+    m_lastChange[path] = nowMs;
+    m_queue.push_back({ path, nowMs });
+}
+
+void ArrivalDebouncer::Forget(const std::wstring& path)
+{
+    m_lastChange.erase(path);
+}
+
+// Front entries whose path was touched again later (or forgotten) are stale
+void ArrivalDebouncer::DropStale()
+{
+    while (!m_queue.empty())
+    {
+        auto it = m_lastChange.find(m_queue.front().path);
+        if (it != m_lastChange.end() && it->second == m_queue.front().timeMs)
+            break;
+        m_queue.pop_front();
+    }
+}
+
+std::vector<std::wstring> ArrivalDebouncer::TakeSettled(uint64_t nowMs, size_t maxBatch)
+{
+    std::vector<std::wstring> settled;
+
+    DropStale();
+    while (!m_queue.empty() && settled.size() < maxBatch)
+    {
+        QueueItem& front = m_queue.front();
+        if (nowMs - front.timeMs < m_quietMs)
+            break;
+
+        m_lastChange.erase(front.path);
+        settled.push_back(std::move(front.path));
+        m_queue.pop_front();
+        DropStale();
+    }
+
+    return settled;
+}
+
+int64_t ArrivalDebouncer::NextDeadline(uint64_t nowMs) const
+{
+    // Stale entries only make the estimate early, never late
+    if (m_queue.empty())
+        return -1;
+
+    uint64_t due = m_queue.front().timeMs + m_quietMs;
+    return due > nowMs ? static_cast<int64_t>(due - nowMs) : 0;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Tracks files that are still being written. A path is "settled" once no
+// change has been reported for it for quietMs. Touch and TakeSettled are
+// amortized O(1) per event: re-touched paths leave stale queue entries that
+// are skipped when they reach the front.
+class ArrivalDebouncer
+{
+public:
+    explicit ArrivalDebouncer(uint64_t quietMs) : m_quietMs(quietMs) {}
+
+    void Touch(const std::wstring& path, uint64_t nowMs);
+    void Forget(const std::wstring& path);
+
+    // Settled paths in arrival order, at most maxBatch of them
+    std::vector<std::wstring> TakeSettled(uint64_t nowMs, size_t maxBatch);
+
+    // Milliseconds until the oldest pending path settles (0 if one already has, -1 if none pending)
+    int64_t NextDeadline(uint64_t nowMs) const;
+
+    size_t PendingCount() const { return m_lastChange.size(); }
+
+private:
+    struct QueueItem
+    {
+        std::wstring path;
+        uint64_t timeMs;
+    };
+
+    void DropStale();
+
+    uint64_t m_quietMs;
+    std::unordered_map<std::wstring, uint64_t> m_lastChange;
+    std::deque<QueueItem> m_queue;
+};
@@ -0,0 +1,217 @@
+#include "CaseFold.h"
+#include <algorithm>
+#include <cstring>
+#include <cwchar>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <cwctype>
+#include <locale.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CASEFOLD_SSE2 1
+#endif
+
+static bool IsSurrogate(uint32_t c)
+{
+    return c >= 0xD800 && c <= 0xDFFF;
+}
+
+static std::vector<uint16_t> BuildUpcaseTable()
+{
+    std::vector<uint16_t> table(0x10000);
+    for (uint32_t c = 0; c < 0x10000; c++)
+        table[c] = static_cast<uint16_t>(c);
+
+#ifdef _WIN32
+    // CharUpperBuff maps through the system uppercase table, the one behind
+    // CompareStringOrdinal(..., TRUE) and the names NTFS treats as equal
+    std::vector<wchar_t> upper(table.begin(), table.end());
+    CharUpperBuffW(upper.data() + 1, 0xD800 - 1);
+    CharUpperBuffW(upper.data() + 0xE000, 0x10000 - 0xE000);
+    for (uint32_t c = 1; c < 0x10000; c++)
+    {
+        if (!IsSurrogate(c))
+            table[c] = static_cast<uint16_t>(upper[c]);
+    }
+#else
+    // Any UTF-8 locale has the simple Unicode mappings; the process locale may not
+    locale_t utf8 = newlocale(LC_CTYPE_MASK, "C.UTF-8", static_cast<locale_t>(0));
+    if (!utf8)
+        utf8 = newlocale(LC_CTYPE_MASK, "en_US.UTF-8", static_cast<locale_t>(0));
+    for (uint32_t c = 0x80; c < 0x10000; c++)
+    {
+        if (IsSurrogate(c))
+            continue;
+        wint_t upper = utf8 ? towupper_l(static_cast<wint_t>(c), utf8) : towupper(static_cast<wint_t>(c));
+        if (upper < 0x10000 && !IsSurrogate(upper))
+            table[c] = static_cast<uint16_t>(upper);
+    }
+    if (utf8)
+        freelocale(utf8);
+#endif
+
+    // The ASCII fast path relies on exactly these
+    for (uint32_t c = 'a'; c <= 'z'; c++)
+        table[c] = static_cast<uint16_t>(c - 0x20);
+    return table;
+}
+
+static const uint16_t* UpcaseTable()
+{
+    static const std::vector<uint16_t> table = BuildUpcaseTable();
+    return table.data();
+}
+
+wchar_t FoldCase(wchar_t c)
+{
+    uint32_t unit = static_cast<uint32_t>(c);
+    return unit <= 0xFFFF ? static_cast<wchar_t>(UpcaseTable()[unit]) : c;
+}
+
+#ifdef CASEFOLD_SSE2
+const size_t kBlockUnits = 16 / sizeof(wchar_t);
+
+// All-ASCII blocks fold with one mask: 'a'-'z' lose their 0x20 bit
+static bool FoldAsciiBlock(const wchar_t* text, __m128i& folded)
+{
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text));
+#if WCHAR_MAX > 0xFFFF
+    __m128i ascii = _mm_cmpeq_epi32(_mm_and_si128(v, _mm_set1_epi32(~0x7F)), _mm_setzero_si128());
+    __m128i lower = _mm_and_si128(_mm_cmpgt_epi32(v, _mm_set1_epi32('a' - 1)), _mm_cmplt_epi32(v, _mm_set1_epi32('z' + 1)));
+    __m128i caseBit = _mm_set1_epi32(0x20);
+#else
+    __m128i ascii = _mm_cmpeq_epi16(_mm_and_si128(v, _mm_set1_epi16(static_cast<short>(0xFF80))), _mm_setzero_si128());
+    __m128i lower = _mm_and_si128(_mm_cmpgt_epi16(v, _mm_set1_epi16('a' - 1)), _mm_cmplt_epi16(v, _mm_set1_epi16('z' + 1)));
+    __m128i caseBit = _mm_set1_epi16(0x20);
+#endif
+    if (_mm_movemask_epi8(ascii) != 0xFFFF)
+        return false;
+    folded = _mm_xor_si128(v, _mm_and_si128(lower, caseBit));
+    return true;
+}
+#endif
+
+static void FoldUnits(const wchar_t* text, wchar_t* out, size_t count)
+{
+    const uint16_t* table = UpcaseTable();
+    size_t i = 0;
+#ifdef CASEFOLD_SSE2
+    for (; i + kBlockUnits <= count; i += kBlockUnits)
+    {
+        __m128i folded;
+        if (FoldAsciiBlock(text + i, folded))
+        {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), folded);
+            continue;
+        }
+        for (size_t k = i; k < i + kBlockUnits; k++)
+        {
+            uint32_t unit = static_cast<uint32_t>(text[k]);
+            out[k] = unit <= 0xFFFF ? static_cast<wchar_t>(table[unit]) : text[k];
+        }
+    }
+#endif
+    for (; i < count; i++)
+    {
+        uint32_t unit = static_cast<uint32_t>(text[i]);
+        out[i] = unit <= 0xFFFF ? static_cast<wchar_t>(table[unit]) : text[i];
+    }
+}
+
+std::wstring FoldCase(const std::wstring& text)
+{
+    std::wstring folded(text.size(), L'\0');
+    FoldUnits(text.data(), &folded[0], text.size());
+    return folded;
+}
+
+// Units at the start that are equal once folded, counted in whole all-ASCII blocks;
+// the caller compares the rest unit by unit
+static size_t SkipEqualAscii(const wchar_t* a, const wchar_t* b, size_t count)
+{
+    size_t i = 0;
+#ifdef CASEFOLD_SSE2
+    for (; i + kBlockUnits <= count; i += kBlockUnits)
+    {
+        __m128i foldedA, foldedB;
+        if (!FoldAsciiBlock(a + i, foldedA) || !FoldAsciiBlock(b + i, foldedB) ||
+            _mm_movemask_epi8(_mm_cmpeq_epi8(foldedA, foldedB)) != 0xFFFF)
+            break;
+    }
+#else
+    (void)a;
+    (void)b;
+    (void)count;
+#endif
+    return i;
+}
+
+bool EqualsFolded(const wchar_t* a, size_t aLength, const wchar_t* b, size_t bLength)
+{
+    if (aLength != bLength)
+        return false;
+    for (size_t i = SkipEqualAscii(a, b, aLength); i < aLength; i++)
+    {
+        if (a[i] != b[i] && FoldCase(a[i]) != FoldCase(b[i]))
+            return false;
+    }
+    return true;
+}
+
+int CompareFolded(const std::wstring& a, const std::wstring& b)
+{
+    size_t common = std::min(a.size(), b.size());
+    for (size_t i = SkipEqualAscii(a.data(), b.data(), common); i < common; i++)
+    {
+        uint32_t x = static_cast<uint32_t>(FoldCase(a[i]));
+        uint32_t y = static_cast<uint32_t>(FoldCase(b[i]));
+        if (x != y)
+            return x < y ? -1 : 1;
+    }
+    return a.size() < b.size() ? -1 : (a.size() > b.size() ? 1 : 0);
+}
+
+static uint64_t HashStep(uint64_t hash, uint64_t word)
+{
+    hash ^= word;
+    hash = (hash << 27) | (hash >> 37);
+    return hash * 0x9FB21C651E98DF25ULL;
+}
+
+uint64_t HashFolded(const wchar_t* text, size_t length)
+{
+    // Folded a chunk at a time; chunks are whole words, so the words do not depend on
+    // which path folded them
+    const size_t kChunkUnits = 64;
+    wchar_t folded[kChunkUnits];
+    uint64_t hash = 0x9E3779B97F4A7C15ULL ^ length;
+    for (size_t start = 0; start < length; start += kChunkUnits)
+    {
+        size_t count = std::min(kChunkUnits, length - start);
+        FoldUnits(text + start, folded, count);
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(folded);
+        size_t size = count * sizeof(wchar_t);
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8)
+        {
+            uint64_t word;
+            memcpy(&word, bytes + i, 8);
+            hash = HashStep(hash, word);
+        }
+        if (i < size)
+        {
+            uint64_t word = 0;
+            memcpy(&word, bytes + i, size - i);
+            hash = HashStep(hash, word);
+        }
+    }
+
+    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBULL;
+    return hash ^ (hash >> 31);
+}
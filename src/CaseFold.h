@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Ordinal case-insensitive names, as NTFS compares them: every UTF-16 unit goes through
+// one uppercase table, one unit to one unit, with no locale, no normalization and no
+// expansions (the German sharp s does not match "SS"). The table is the operating system's on Windows
+// and the C library's simple Unicode uppercase on Linux, so results do not depend on the
+// process locale (towupper only folds ASCII in the "C" locale). Units outside the BMP
+// (and surrogates) fold to themselves.
+//
+// Blocks of ASCII go through SSE2 sixteen bytes at a time where the target has it; other
+// units take one table lookup each.
+
+wchar_t FoldCase(wchar_t c);
+std::wstring FoldCase(const std::wstring& text);
+
+bool EqualsFolded(const wchar_t* a, size_t aLength, const wchar_t* b, size_t bLength);
+inline bool EqualsFolded(const std::wstring& a, const std::wstring& b)
+{
+    return EqualsFolded(a.data(), a.size(), b.data(), b.size());
+}
+
+// Ordinal order of the folded units (<0, 0, >0), like CompareStringOrdinal(..., TRUE)
+int CompareFolded(const std::wstring& a, const std::wstring& b);
+
+// Same for any two strings EqualsFolded calls equal
+uint64_t HashFolded(const wchar_t* text, size_t length);
+
+// For unordered containers and maps keyed by names that differ only in case
+struct FoldedHash
+{
+    size_t operator()(const std::wstring& text) const { return static_cast<size_t>(HashFolded(text.data(), text.size())); }
+};
+
+struct FoldedEqual
+{
+    bool operator()(const std::wstring& a, const std::wstring& b) const { return EqualsFolded(a, b); }
+};
+
+struct FoldedLess
+{
+    bool operator()(const std::wstring& a, const std::wstring& b) const { return CompareFolded(a, b) < 0; }
+};
+
+// Names and paths as the local filesystem tells them apart: folded on Windows, exact elsewhere
+#ifdef _WIN32
+using PathKeyHash = FoldedHash;
+using PathKeyEqual = FoldedEqual;
+#else
+using PathKeyHash = std::hash<std::wstring>;
+using PathKeyEqual = std::equal_to<std::wstring>;
+#endif
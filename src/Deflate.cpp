@@ -0,0 +1,669 @@
+#include "Deflate.h"
+#include <algorithm>
+#include <cstring>
+
+// --- CRC-32 ---
+
+// Slicing by 8: eight bytes per step through eight derived tables
+struct CrcTables
+{
+    uint32_t table[8][256];
+
+    CrcTables()
+    {
+        for (uint32_t n = 0; n < 256; n++)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[0][n] = c;
+        }
+        for (uint32_t n = 0; n < 256; n++)
+        {
+            for (int k = 1; k < 8; k++)
+                table[k][n] = (table[k - 1][n] >> 8) ^ table[0][table[k - 1][n] & 0xFF];
+        }
+    }
+};
+
+static const CrcTables& GetCrcTables()
+{
+    static const CrcTables tables;
+    return tables;
+}
+
+uint32_t Crc32(uint32_t crc, const void* data, size_t length)
+{
+    const auto& t = GetCrcTables().table;
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for (; length >= 8; length -= 8, p += 8)
+    {
+        uint32_t lo = crc ^ (p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24));
+        uint32_t hi = p[4] | (p[5] << 8) | (p[6] << 16) | (static_cast<uint32_t>(p[7]) << 24);
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+            t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+    }
+    for (; length > 0; length--)
+        crc = t[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+// GF(2) matrix helpers for Crc32Combine (the zlib method: appending n zero bytes is a
+// linear operator on the CRC, applied by repeated squaring)
+static uint32_t Gf2Times(const uint32_t* matrix, uint32_t vector)
+{
+    uint32_t sum = 0;
+    for (; vector; vector >>= 1, matrix++)
+    {
+        if (vector & 1)
+            sum ^= *matrix;
+    }
+    return sum;
+}
+
+static void Gf2Square(uint32_t* square, const uint32_t* matrix)
+{
+    for (int n = 0; n < 32; n++)
+        square[n] = Gf2Times(matrix, matrix[n]);
+}
+
+uint32_t Crc32Combine(uint32_t crcA, uint32_t crcB, uint64_t lengthB)
+{
+    if (lengthB == 0)
+        return crcA;
+
+    uint32_t even[32], odd[32];
+    odd[0] = 0xEDB88320u;  // One zero bit
+    for (int n = 1; n < 32; n++)
+        odd[n] = 1u << (n - 1);
+    Gf2Square(even, odd);  // Two zero bits
+    Gf2Square(odd, even);  // Four
+
+    // First square gives one zero byte
+    for (;;)
+    {
+        Gf2Square(even, odd);
+        if (lengthB & 1)
+            crcA = Gf2Times(even, crcA);
+        lengthB >>= 1;
+        if (lengthB == 0)
+            break;
+
+        Gf2Square(odd, even);
+        if (lengthB & 1)
+            crcA = Gf2Times(odd, crcA);
+        lengthB >>= 1;
+        if (lengthB == 0)
+            break;
+    }
+    return crcA ^ crcB;
+}
+
+// --- Deflate ---
+
+static const size_t kWindowSize = 32768;
+static const size_t kMinMatch = 3;
+static const size_t kMaxMatch = 258;
+// Roughly zlib level 6: chain walks are capped, a good enough match stops the search,
+// and short matches are checked against the next position (lazy matching) with a shorter
+// walk once the match in hand is already decent
+static const unsigned kMaxChain = 128;
+static const size_t kGoodMatch = 8;
+static const size_t kNiceMatch = 128;
+static const size_t kLazyLimit = 16;
+static const size_t kBlockSymbols = 16384;
+static const size_t kMaxStored = 65535;
+
+static const uint16_t kLengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t kLengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t kDistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t kDistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+static const uint8_t kCodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+// Length -> code 257..285 (minus 257), distance - 1 -> code, zlib's split table for distances
+struct SymbolTables
+{
+    uint8_t lengthCode[kMaxMatch + 1];
+    uint8_t distanceCode[512];
+
+    SymbolTables()
+    {
+        for (int code = 0; code < 29; code++)
+        {
+            int end = code + 1 < 29 ? kLengthBase[code + 1] : kMaxMatch + 1;
+            if (code == 27)
+                end = kMaxMatch;  // 258 has its own code
+            for (int length = kLengthBase[code]; length < end; length++)
+                lengthCode[length] = static_cast<uint8_t>(code);
+        }
+        for (int code = 0; code < 30; code++)
+        {
+            for (int d = kDistanceBase[code] - 1; d < kDistanceBase[code] - 1 + (1 << kDistanceExtra[code]); d++)
+            {
+                if (d < 256)
+                    distanceCode[d] = static_cast<uint8_t>(code);
+                else
+                    distanceCode[256 + (d >> 7)] = static_cast<uint8_t>(code);
+            }
+        }
+    }
+
+    unsigned DistanceCode(size_t distance) const
+    {
+        size_t d = distance - 1;
+        return d < 256 ? distanceCode[d] : distanceCode[256 + (d >> 7)];
+    }
+};
+
+static const SymbolTables& GetSymbolTables()
+{
+    static const SymbolTables tables;
+    return tables;
+}
+
+// LSB-first bit packing, as deflate wants
+class BitWriter
+{
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : m_out(out) {}
+
+    void Put(uint32_t value, unsigned count)
+    {
+        m_bits |= static_cast<uint64_t>(value) << m_count;
+        m_count += count;
+        while (m_count >= 8)
+        {
+            m_out.push_back(static_cast<uint8_t>(m_bits));
+            m_bits >>= 8;
+            m_count -= 8;
+        }
+    }
+
+    void Align()
+    {
+        if (m_count)
+            Put(0, 8 - m_count);
+    }
+
+    // Only when aligned
+    void PutBytes(const uint8_t* data, size_t length) { m_out.insert(m_out.end(), data, data + length); }
+
+private:
+    std::vector<uint8_t>& m_out;
+    uint64_t m_bits = 0;
+    unsigned m_count = 0;
+};
+
+// Huffman code lengths no longer than limit. Every code is complete: a tree with fewer
+// than two used symbols gets a second, unused one so strict decoders accept it.
+static void BuildCodeLengths(const uint32_t* freq, size_t count, unsigned limit, uint8_t* lengths)
+{
+    std::fill(lengths, lengths + count, 0);
+    std::vector<std::pair<uint32_t, uint16_t>> leaves;
+    for (size_t s = 0; s < count; s++)
+    {
+        if (freq[s])
+            leaves.emplace_back(freq[s], static_cast<uint16_t>(s));
+    }
+    if (leaves.size() < 2)
+    {
+        size_t used = leaves.empty() ? 0 : leaves[0].second;
+        lengths[used] = 1;
+        lengths[used == 0 ? 1 : 0] = 1;
+        return;
+    }
+    std::sort(leaves.begin(), leaves.end());
+
+    // Two-queue Huffman over the sorted leaves; internal nodes come out in weight order
+    size_t n = leaves.size();
+    std::vector<uint64_t> weight(2 * n - 1);
+    std::vector<size_t> parent(2 * n - 1, 0);
+    for (size_t i = 0; i < n; i++)
+        weight[i] = leaves[i].first;
+    size_t leaf = 0, inner = n;
+    for (size_t next = n; next < 2 * n - 1; next++)
+    {
+        size_t pick[2];
+        for (auto& p : pick)
+            p = (leaf < n && (inner >= next || weight[leaf] <= weight[inner])) ? leaf++ : inner++;
+        weight[next] = weight[pick[0]] + weight[pick[1]];
+        parent[pick[0]] = parent[pick[1]] = next;
+    }
+
+    std::vector<unsigned> depth(2 * n - 1, 0);
+    unsigned lengthCount[33] = {};
+    for (size_t i = 2 * n - 1; i-- > 0;)
+    {
+        if (i != 2 * n - 2)
+            depth[i] = depth[parent[i]] + 1;
+        if (i < n)
+            lengthCount[std::min(depth[i], limit)]++;
+    }
+
+    // Too-deep leaves were clamped to limit; lengthen shorter codes until the Kraft sum fits
+    uint32_t total = 0;
+    for (unsigned i = limit; i > 0; i--)
+        total += lengthCount[i] << (limit - i);
+    while (total != (1u << limit))
+    {
+        lengthCount[limit]--;
+        for (unsigned i = limit - 1; i > 0; i--)
+        {
+            if (lengthCount[i])
+            {
+                lengthCount[i]--;
+                lengthCount[i + 1] += 2;
+                break;
+            }
+        }
+        total--;
+    }
+
+    // Longest codes to the rarest symbols
+    size_t next = 0;
+    for (unsigned length = limit; length > 0; length--)
+    {
+        for (unsigned k = 0; k < lengthCount[length]; k++)
+            lengths[leaves[next++].second] = static_cast<uint8_t>(length);
+    }
+}
+
+// Canonical codes, bit-reversed for LSB-first output
+static void BuildCodes(const uint8_t* lengths, size_t count, uint16_t* codes)
+{
+    unsigned lengthCount[16] = {};
+    for (size_t s = 0; s < count; s++)
+        lengthCount[lengths[s]]++;
+    lengthCount[0] = 0;
+
+    unsigned nextCode[16] = {};
+    unsigned code = 0;
+    for (int bits = 1; bits < 16; bits++)
+    {
+        code = (code + lengthCount[bits - 1]) << 1;
+        nextCode[bits] = code;
+    }
+
+    for (size_t s = 0; s < count; s++)
+    {
+        unsigned length = lengths[s];
+        if (length == 0)
+            continue;
+        unsigned value = nextCode[length]++;
+        unsigned reversed = 0;
+        for (unsigned b = 0; b < length; b++)
+            reversed |= ((value >> b) & 1) << (length - 1 - b);
+        codes[s] = static_cast<uint16_t>(reversed);
+    }
+}
+
+// Literal (distance 0) or match
+struct Symbol
+{
+    uint16_t value;     // Byte, or match length
+    uint16_t distance;
+};
+
+struct CodeLengthSymbol
+{
+    uint8_t symbol;  // 0..18
+    uint8_t extra;
+};
+
+// Run-length coding of the literal/length and distance code lengths (RFC 1951 3.2.7)
+static void EncodeCodeLengths(const uint8_t* lengths, size_t count, std::vector<CodeLengthSymbol>& out)
+{
+    for (size_t i = 0; i < count;)
+    {
+        uint8_t value = lengths[i];
+        size_t run = 1;
+        while (i + run < count && lengths[i + run] == value)
+            run++;
+        i += run;
+
+        if (value == 0)
+        {
+            while (run >= 3)
+            {
+                size_t r = std::min<size_t>(run, 138);
+                if (r >= 11)
+                    out.push_back({ 18, static_cast<uint8_t>(r - 11) });
+                else
+                    out.push_back({ 17, static_cast<uint8_t>(r - 3) });
+                run -= r;
+            }
+        }
+        else
+        {
+            out.push_back({ value, 0 });
+            run--;
+            while (run >= 3)
+            {
+                size_t r = std::min<size_t>(run, 6);
+                out.push_back({ 16, static_cast<uint8_t>(r - 3) });
+                run -= r;
+            }
+        }
+        for (; run > 0; run--)
+            out.push_back({ value, 0 });
+    }
+}
+
+static const uint8_t kCodeLengthExtra[19] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 3, 7 };
+
+// Writes one block over input[start, end) with the cheapest of dynamic, fixed and stored
+static void FlushBlock(BitWriter& bits, const uint8_t* input, size_t start, size_t end,
+    const std::vector<Symbol>& symbols, bool final)
+{
+    const SymbolTables& tables = GetSymbolTables();
+
+    uint32_t litFreq[286] = {};
+    uint32_t distFreq[30] = {};
+    uint64_t extraBits = 0;
+    for (const Symbol& s : symbols)
+    {
+        if (s.distance == 0)
+        {
+            litFreq[s.value]++;
+            continue;
+        }
+        unsigned lc = tables.lengthCode[s.value];
+        unsigned dc = tables.DistanceCode(s.distance);
+        litFreq[257 + lc]++;
+        distFreq[dc]++;
+        extraBits += kLengthExtra[lc] + kDistanceExtra[dc];
+    }
+    litFreq[256] = 1;
+
+    uint8_t litLengths[286], distLengths[30];
+    BuildCodeLengths(litFreq, 286, 15, litLengths);
+    BuildCodeLengths(distFreq, 30, 15, distLengths);
+
+    size_t hlit = 286;
+    while (hlit > 257 && litLengths[hlit - 1] == 0)
+        hlit--;
+    size_t hdist = 30;
+    while (hdist > 1 && distLengths[hdist - 1] == 0)
+        hdist--;
+
+    uint8_t combined[286 + 30];
+    memcpy(combined, litLengths, hlit);
+    memcpy(combined + hlit, distLengths, hdist);
+    std::vector<CodeLengthSymbol> header;
+    EncodeCodeLengths(combined, hlit + hdist, header);
+
+    uint32_t clFreq[19] = {};
+    for (const auto& h : header)
+        clFreq[h.symbol]++;
+    uint8_t clLengths[19];
+    BuildCodeLengths(clFreq, 19, 7, clLengths);
+    size_t hclen = 19;
+    while (hclen > 4 && clLengths[kCodeLengthOrder[hclen - 1]] == 0)
+        hclen--;
+
+    // Costs in bits
+    uint64_t dynamicBits = 3 + 5 + 5 + 4 + 3 * hclen + extraBits;
+    for (const auto& h : header)
+        dynamicBits += clLengths[h.symbol] + kCodeLengthExtra[h.symbol];
+    uint64_t fixedBits = 3 + extraBits;
+    for (size_t s = 0; s < 286; s++)
+    {
+        dynamicBits += static_cast<uint64_t>(litFreq[s]) * litLengths[s];
+        fixedBits += static_cast<uint64_t>(litFreq[s]) * (s < 144 ? 8 : s < 256 ? 9 : s < 280 ? 7 : 8);
+    }
+    for (size_t s = 0; s < 30; s++)
+    {
+        dynamicBits += static_cast<uint64_t>(distFreq[s]) * distLengths[s];
+        fixedBits += static_cast<uint64_t>(distFreq[s]) * 5;
+    }
+    size_t length = end - start;
+    uint64_t storedBits = (length + 5 * ((length + kMaxStored - 1) / kMaxStored)) * 8 + 7;
+
+    if (length > 0 && storedBits <= dynamicBits && storedBits <= fixedBits)
+    {
+        for (size_t pos = start; pos < end;)
+        {
+            size_t piece = std::min(kMaxStored, end - pos);
+            bits.Put(final && pos + piece == end ? 1 : 0, 1);
+            bits.Put(0, 2);
+            bits.Align();
+            uint8_t lengths[4] = { static_cast<uint8_t>(piece), static_cast<uint8_t>(piece >> 8),
+                static_cast<uint8_t>(~piece), static_cast<uint8_t>(~piece >> 8) };
+            bits.PutBytes(lengths, 4);
+            bits.PutBytes(input + pos, piece);
+            pos += piece;
+        }
+        return;
+    }
+
+    uint16_t litCodes[288] = {}, distCodes[30] = {};
+    if (fixedBits <= dynamicBits)
+    {
+        uint8_t fixedLit[288];
+        for (size_t s = 0; s < 288; s++)
+            fixedLit[s] = static_cast<uint8_t>(s < 144 ? 8 : s < 256 ? 9 : s < 280 ? 7 : 8);
+        memset(litLengths, 0, sizeof(litLengths));
+        memcpy(litLengths, fixedLit, 286);
+        memset(distLengths, 5, sizeof(distLengths));
+        BuildCodes(fixedLit, 288, litCodes);
+        BuildCodes(distLengths, 30, distCodes);
+        bits.Put(final ? 1 : 0, 1);
+        bits.Put(1, 2);
+    }
+    else
+    {
+        BuildCodes(litLengths, 286, litCodes);
+        BuildCodes(distLengths, 30, distCodes);
+        uint16_t clCodes[19] = {};
+        BuildCodes(clLengths, 19, clCodes);
+
+        bits.Put(final ? 1 : 0, 1);
+        bits.Put(2, 2);
+        bits.Put(static_cast<uint32_t>(hlit - 257), 5);
+        bits.Put(static_cast<uint32_t>(hdist - 1), 5);
+        bits.Put(static_cast<uint32_t>(hclen - 4), 4);
+        for (size_t i = 0; i < hclen; i++)
+            bits.Put(clLengths[kCodeLengthOrder[i]], 3);
+        for (const auto& h : header)
+        {
+            bits.Put(clCodes[h.symbol], clLengths[h.symbol]);
+            if (kCodeLengthExtra[h.symbol])
+                bits.Put(h.extra, kCodeLengthExtra[h.symbol]);
+        }
+    }
+
+    for (const Symbol& s : symbols)
+    {
+        if (s.distance == 0)
+        {
+            bits.Put(litCodes[s.value], litLengths[s.value]);
+            continue;
+        }
+        unsigned lc = tables.lengthCode[s.value];
+        bits.Put(litCodes[257 + lc], litLengths[257 + lc]);
+        if (kLengthExtra[lc])
+            bits.Put(s.value - kLengthBase[lc], kLengthExtra[lc]);
+        unsigned dc = tables.DistanceCode(s.distance);
+        bits.Put(distCodes[dc], distLengths[dc]);
+        if (kDistanceExtra[dc])
+            bits.Put(s.distance - kDistanceBase[dc], kDistanceExtra[dc]);
+    }
+    bits.Put(litCodes[256], litLengths[256]);
+}
+
+static size_t MatchLength(const uint8_t* a, const uint8_t* b, size_t limit)
+{
+    size_t n = 0;
+    while (n + 8 <= limit)
+    {
+        uint64_t x, y;
+        memcpy(&x, a + n, 8);
+        memcpy(&y, b + n, 8);
+        if (x != y)
+            break;
+        n += 8;
+    }
+    while (n < limit && a[n] == b[n])
+        n++;
+    return n;
+}
+
+// Hash chains over the chunk and its dictionary. Tables are sized to the input, so a
+// small file does not pay for clearing 32 KB windows.
+class MatchFinder
+{
+public:
+    MatchFinder(const uint8_t* data, size_t end) : m_data(data), m_end(end)
+    {
+        unsigned bits = 8;
+        while (bits < 15 && (size_t(1) << bits) < end)
+            bits++;
+        m_hashShift = 32 - bits;
+        m_head.assign(size_t(1) << bits, -1);
+        m_prev.assign(std::min(kWindowSize, size_t(1) << bits), -1);
+        m_mask = m_prev.size() - 1;
+    }
+
+    void Insert(size_t pos)
+    {
+        if (pos + kMinMatch > m_end)
+            return;
+        uint32_t h = Hash(pos);
+        m_prev[pos & m_mask] = m_head[h];
+        m_head[h] = static_cast<int32_t>(pos);
+    }
+
+    // Longest match for pos among earlier positions (pos itself not inserted yet)
+    size_t Find(size_t pos, size_t& distance, unsigned maxChain) const
+    {
+        size_t limit = std::min(kMaxMatch, m_end - pos);
+        if (limit < kMinMatch)
+            return 0;
+
+        size_t best = kMinMatch - 1;
+        int32_t candidate = m_head[Hash(pos)];
+        for (unsigned chain = maxChain; candidate >= 0 && chain > 0; chain--)
+        {
+            size_t d = pos - static_cast<size_t>(candidate);
+            if (d > kWindowSize || d > m_prev.size())
+                break;
+            const uint8_t* c = m_data + candidate;
+            if (c[best] == m_data[pos + best] && c[0] == m_data[pos])
+            {
+                size_t length = MatchLength(c, m_data + pos, limit);
+                if (length > best)
+                {
+                    best = length;
+                    distance = d;
+                    if (length >= kNiceMatch || length >= limit)
+                        break;
+                }
+            }
+            int32_t next = m_prev[candidate & m_mask];
+            if (next >= candidate)
+                break;  // Slot reused by a newer position
+            candidate = next;
+        }
+        return best >= kMinMatch ? best : 0;
+    }
+
+private:
+    uint32_t Hash(size_t pos) const
+    {
+        const uint8_t* p = m_data + pos;
+        uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+        return (v * 2654435761u) >> m_hashShift;
+    }
+
+    const uint8_t* m_data;
+    size_t m_end;
+    unsigned m_hashShift;
+    size_t m_mask;
+    std::vector<int32_t> m_head;
+    std::vector<int32_t> m_prev;
+};
+
+void DeflateChunk(const uint8_t* data, size_t dictionary, size_t length, bool final, std::vector<uint8_t>& out)
+{
+    if (dictionary > kWindowSize)
+    {
+        data += dictionary - kWindowSize;
+        dictionary = kWindowSize;
+    }
+    size_t end = dictionary + length;
+
+    BitWriter bits(out);
+    MatchFinder finder(data, end);
+    for (size_t pos = 0; pos < dictionary; pos++)
+        finder.Insert(pos);
+
+    std::vector<Symbol> symbols;
+    symbols.reserve(kBlockSymbols + 1);
+    size_t blockStart = dictionary;
+    size_t pos = dictionary;
+    while (pos < end)
+    {
+        size_t distance = 0;
+        size_t match = finder.Find(pos, distance, kMaxChain);
+        finder.Insert(pos);
+
+        // Lazy: a longer match one byte later wins over this one
+        while (match > 0 && match < kLazyLimit && pos + 1 < end)
+        {
+            size_t nextDistance = 0;
+            size_t next = finder.Find(pos + 1, nextDistance, match >= kGoodMatch ? kMaxChain / 4 : kMaxChain);
+            if (next <= match)
+                break;
+            symbols.push_back({ data[pos], 0 });
+            pos++;
+            finder.Insert(pos);
+            match = next;
+            distance = nextDistance;
+        }
+
+        if (match > 0)
+        {
+            symbols.push_back({ static_cast<uint16_t>(match), static_cast<uint16_t>(distance) });
+            for (size_t k = 1; k < match; k++)
+                finder.Insert(pos + k);
+            pos += match;
+        }
+        else
+        {
+            symbols.push_back({ data[pos], 0 });
+            pos++;
+        }
+
+        if (symbols.size() >= kBlockSymbols)
+        {
+            FlushBlock(bits, data, blockStart, pos, symbols, final && pos == end);
+            symbols.clear();
+            blockStart = pos;
+        }
+    }
+
+    // An empty final chunk still needs its end-of-stream block
+    if (!symbols.empty() || (final && length == 0))
+        FlushBlock(bits, data, blockStart, end, symbols, final);
+
+    if (!final)
+    {
+        // Empty stored block: byte-aligns the stream so the next chunk can follow
+        bits.Put(0, 3);
+        bits.Align();
+        const uint8_t marker[4] = { 0x00, 0x00, 0xFF, 0xFF };
+        bits.PutBytes(marker, 4);
+    }
+    bits.Align();
+}
+
+size_t DeflateBound(size_t length)
+{
+    // Stored is the fallback for every block: 5 bytes per block of up to kBlockSymbols bytes
+    return length + 5 * (length / kBlockSymbols + 2) + 8;
+}
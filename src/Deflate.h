@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// CRC-32 (ZIP / gzip polynomial). Start with crc = 0 and feed the result back in.
+uint32_t Crc32(uint32_t crc, const void* data, size_t length);
+// CRC of A followed by B from the CRCs of both and B's length, so chunks can be summed
+// on different threads and combined in order
+uint32_t Crc32Combine(uint32_t crcA, uint32_t crcB, uint64_t lengthB);
+
+// Raw deflate (RFC 1951) of data[dictionary, dictionary + length). The first dictionary
+// bytes (up to 32 KB, the input just before this chunk) are only match history.
+// A final chunk ends the stream; any other ends byte-aligned on an empty stored block,
+// so independently compressed chunks concatenate into one valid stream. Appends to out.
+void DeflateChunk(const uint8_t* data, size_t dictionary, size_t length, bool final, std::vector<uint8_t>& out);
+
+// Largest output DeflateChunk can produce for length input bytes
+size_t DeflateBound(size_t length);
@@ -0,0 +1,556 @@
+#include "FakeFileSystem.h"
+#include "OrganizePlanner.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static uint64_t Mix(uint64_t z)
+{
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// (0, 1), never 0 so it can go through a log
+static double Unit(uint64_t hash)
+{
+    return ((hash >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+// Log-normal around the median, spread so that 99% of draws stay under p99
+static double DrawLatency(const FakeLatency& latency, uint64_t hash)
+{
+    if (latency.medianMs <= 0)
+        return 0;
+    if (latency.p99Ms <= latency.medianMs)
+        return latency.medianMs;
+    const double kZ99 = 2.3263478740;
+    const double kTwoPi = 6.283185307179586;
+    double sigma = std::log(latency.p99Ms / latency.medianMs) / kZ99;
+    double z = std::sqrt(-2.0 * std::log(Unit(Mix(hash)))) * std::cos(kTwoPi * Unit(Mix(hash ^ 0x5DEECE66DULL)));
+    return latency.medianMs * std::exp(sigma * z);
+}
+
+// Children of folder start with this
+static std::wstring ChildPrefix(const std::wstring& folder)
+{
+    return !folder.empty() && (folder.back() == L'/' || folder.back() == L'\\') ? folder : folder + kPathSeparator;
+}
+
+class FakeFileReader : public IFileReader
+{
+public:
+    FakeFileReader(FakeFileSystem& fs, const std::wstring& path, std::shared_ptr<const std::string> content, uint64_t size)
+        : m_fs(fs), m_path(path), m_content(std::move(content)), m_size(size) {}
+
+    FsResult Read(uint64_t offset, void* buffer, size_t length, size_t& read) override
+    {
+        return m_fs.Read(m_path, m_content, m_size, offset, buffer, length, read);
+    }
+    uint64_t Size() const override { return m_size; }
+
+private:
+    FakeFileSystem& m_fs;
+    std::wstring m_path;
+    std::shared_ptr<const std::string> m_content;
+    uint64_t m_size;
+};
+
+class FakeFileWriter : public IFileWriter
+{
+public:
+    FakeFileWriter(FakeFileSystem& fs, const std::wstring& path) : m_fs(fs), m_path(path) {}
+
+    FsResult Write(uint64_t offset, const void* data, size_t length) override
+    {
+        (void)data;
+        return m_fs.Write(m_path, offset, length);
+    }
+
+private:
+    FakeFileSystem& m_fs;
+    std::wstring m_path;
+};
+
+FakeFileSystem::FakeFileSystem(const FakeFileSystemOptions& options)
+    : m_options(options), m_owner(std::this_thread::get_id())
+{
+}
+
+void FakeFileSystem::AddFolder(const std::wstring& path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (std::wstring folder = path; !folder.empty(); )
+    {
+        Node& node = m_nodes[folder];
+        node.isDirectory = true;
+        std::wstring parent = PathParent(folder);
+        if (parent == folder)
+            break;
+        folder = parent;
+    }
+}
+
+void FakeFileSystem::AddFile(const std::wstring& path, uint64_t size, uint64_t lastWriteTime, const std::string& content)
+{
+    AddFolder(PathParent(path));
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Node& node = m_nodes[path];
+    node.isDirectory = false;
+    node.size = std::max<uint64_t>(size, content.size());
+    node.lastWriteTime = lastWriteTime;
+    node.content = content.empty() ? nullptr : std::make_shared<const std::string>(content);
+}
+
+double FakeFileSystem::ElapsedMs()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Settle();
+    return m_serialClock;
+}
+
+void FakeFileSystem::ResetClock()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_jobs.clear();
+    m_threadJob.clear();
+    m_serialClock = 0;
+}
+
+FakeFileSystemStats FakeFileSystem::Stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+uint64_t FakeFileSystem::CallKey(Op op, const std::wstring& path) const
+{
+    uint64_t hash = 14695981039346656037ULL ^ m_options.seed;
+    hash = (hash ^ static_cast<uint64_t>(op)) * 1099511628211ULL;
+    for (wchar_t c : path)
+        hash = (hash ^ static_cast<uint64_t>(c)) * 1099511628211ULL;
+    return Mix(hash);
+}
+
+FsResult FakeFileSystem::Begin(Op op, const std::wstring& path, const FakeLatency& latency, bool overlaps, bool canShare)
+{
+    m_stats.calls++;
+    uint64_t key = CallKey(op, path);
+    uint32_t attempt = m_attempts[key]++;
+    uint64_t hash = Mix(key + attempt * 0x9E3779B97F4A7C15ULL);
+
+    double ms = DrawLatency(latency, hash);
+    if (overlaps)
+        ChargeJob(hash, ms, 0, op == Op::Open || op == Op::Copy);
+    else if (IsSerial())
+        ChargeSerial(ms);
+    else
+        ChargeJob(hash, ms, 0, true);
+
+    // A retry draws again, so transient faults clear up the way they do on a real share
+    double u = Unit(Mix(hash ^ 0xFA17FA17FA17FA17ULL));
+    if (u < m_options.failureRate)
+    {
+        m_stats.failures++;
+        return FsResult::Failed;
+    }
+    if (canShare && u < m_options.failureRate + m_options.sharingRate)
+    {
+        m_stats.sharingViolations++;
+        return FsResult::SharingViolation;
+    }
+    return FsResult::Ok;
+}
+
+bool FakeFileSystem::IsSerial() const
+{
+    std::thread::id self = std::this_thread::get_id();
+    return self == m_owner && m_batching.count(self) == 0;
+}
+
+// More time for the call just begun, on whichever clock it runs
+void FakeFileSystem::Charge(double ms)
+{
+    if (IsSerial())
+        ChargeSerial(ms);
+    else
+        ChargeJob(0, ms, 0, false);
+}
+
+// Serial calls start once every job before them has finished
+void FakeFileSystem::ChargeSerial(double ms)
+{
+    Settle();
+    m_serialClock += ms;
+}
+
+void FakeFileSystem::ChargeJob(uint64_t key, double ms, uint64_t bytes, bool start)
+{
+    auto it = m_threadJob.find(std::this_thread::get_id());
+    if (start || it == m_threadJob.end())
+    {
+        m_jobs.emplace_back();
+        m_jobs.back().key = key;
+        m_threadJob[std::this_thread::get_id()] = m_jobs.size() - 1;
+        it = m_threadJob.find(std::this_thread::get_id());
+    }
+    m_jobs[it->second].ms += ms;
+    m_jobs[it->second].bytes += bytes;
+}
+
+void FakeFileSystem::Settle()
+{
+    if (m_jobs.empty())
+        return;
+
+    // Longest first (what the executor's pools aim for), so the layout does not depend on
+    // which thread got the mutex first; equal jobs go by the key of their first call
+    double bytesPerMs = m_options.bandwidthMBps > 0 ? m_options.bandwidthMBps * 1048576.0 / 1000.0 : 0;
+    auto cost = [&](const Job& job) { return job.ms + (bytesPerMs > 0 ? static_cast<double>(job.bytes) / bytesPerMs : 0); };
+    std::sort(m_jobs.begin(), m_jobs.end(), [&](const Job& a, const Job& b) {
+        double costA = cost(a), costB = cost(b);
+        return costA != costB ? costA > costB : a.key < b.key;
+    });
+
+    // Each job goes to the slot that frees up first, like the next thread taking the next job
+    std::vector<double> slots(std::max(1u, m_options.slots), m_serialClock);
+    double linkFree = m_serialClock;
+    double end = m_serialClock;
+    for (const Job& job : m_jobs)
+    {
+        auto slot = std::min_element(slots.begin(), slots.end());
+        double done = *slot + job.ms;
+        if (job.bytes > 0 && bytesPerMs > 0)
+        {
+            // One shared link: transfers queue for it in job order
+            done = std::max(done, linkFree) + static_cast<double>(job.bytes) / bytesPerMs;
+            linkFree = done;
+        }
+        *slot = done;
+        end = std::max(end, done);
+    }
+    m_jobs.clear();
+    m_threadJob.clear();
+    m_serialClock = end;
+}
+
+// A batch on the creating thread starts after what came before and ends once all of its
+// requests have; on other threads its requests just join the pending jobs
+void FakeFileSystem::BeginBatch()
+{
+    if (std::this_thread::get_id() == m_owner)
+        Settle();
+    m_batching.insert(std::this_thread::get_id());
+}
+
+void FakeFileSystem::EndBatch()
+{
+    m_batching.erase(std::this_thread::get_id());
+    if (std::this_thread::get_id() == m_owner)
+        Settle();
+}
+
+FakeFileSystem::Node* FakeFileSystem::Find(const std::wstring& path)
+{
+    auto it = m_nodes.find(path);
+    return it == m_nodes.end() ? nullptr : &it->second;
+}
+
+bool FakeFileSystem::ParentIsFolder(const std::wstring& path)
+{
+    Node* parent = Find(PathParent(path));
+    return parent && parent->isDirectory;
+}
+
+void FakeFileSystem::MoveTree(const std::wstring& from, const std::wstring& to)
+{
+    std::vector<std::pair<std::wstring, Node>> moved;
+    auto root = m_nodes.find(from);
+    moved.emplace_back(to, std::move(root->second));
+    m_nodes.erase(root);
+
+    std::wstring prefix = ChildPrefix(from);
+    auto it = m_nodes.lower_bound(prefix);
+    while (it != m_nodes.end() && it->first.compare(0, prefix.size(), prefix) == 0)
+    {
+        moved.emplace_back(ChildPrefix(to) + it->first.substr(prefix.size()), std::move(it->second));
+        it = m_nodes.erase(it);
+    }
+    for (auto& [path, node] : moved)
+        m_nodes[path] = std::move(node);
+}
+
+FsResult FakeFileSystem::ListDirectory(const std::wstring& folder, std::vector<FileEntry>& entries)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    FsResult result = Begin(Op::List, folder, m_options.metadata, false, false);
+    if (result != FsResult::Ok)
+        return result;
+    Node* node = Find(folder);
+    if (!node || !node->isDirectory)
+        return FsResult::NotFound;
+
+    // Listings of a share carry sizes and times
+    entries.clear();
+    std::wstring prefix = ChildPrefix(folder);
+    for (auto it = m_nodes.lower_bound(prefix); it != m_nodes.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it)
+    {
+        if (it->first.find_first_of(L"\\/", prefix.size()) != std::wstring::npos)
+            continue;
+        FileEntry entry;
+        entry.path = it->first;
+        entry.size = it->second.size;
+        entry.lastWriteTime = it->second.lastWriteTime;
+        entry.isDirectory = it->second.isDirectory;
+        entry.hasMetadata = true;
+        entries.push_back(std::move(entry));
+    }
+    Charge(m_options.listEntryMs * static_cast<double>(entries.size()));
+    return FsResult::Ok;
+}
+
+FsResult FakeFileSystem::QueryMetadata(FileEntry& entry)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    FsResult result = Begin(Op::Stat, entry.path, m_options.metadata, false, false);
+    if (result != FsResult::Ok)
+        return result;
+    Node* node = Find(entry.path);
+    if (!node)
+        return FsResult::NotFound;
+    entry.size = node->isDirectory ? 0 : node->size;
+    entry.lastWriteTime = node->lastWriteTime;
+    entry.isDirectory = node->isDirectory;
+    entry.hasMetadata = true;
+    return FsResult::Ok;
+}
+
+bool FakeFileSystem::PathExists(const std::wstring& path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return Begin(Op::Exists, path, m_options.metadata, false, false) == FsResult::Ok && Find(path) != nullptr;
+}
+
+FsResult FakeFileSystem::CreateFolder(const std::wstring& path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    FsResult result = Begin(Op::Create, path, m_options.change, false, false);
+    if (result != FsResult::Ok)
+        return result;
+    if (Find(path))
+        return FsResult::AlreadyExists;
+    if (!ParentIsFolder(path))
+        return FsResult::NotFound;
+    m_nodes[path].isDirectory = true;
+    return FsResult::Ok;
+}
+
+FsResult FakeFileSystem::MoveEntry(const std::wstring& from, const std::wstring& to)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    FsResult result = Begin(Op::Move, from, m_options.change, false, true);
+    if (result != FsResult::Ok)
+        return result;
+    if (!Find(from) || !ParentIsFolder(to))
+        return FsResult::NotFound;
+    if (Find(to))
+        return FsResult::AlreadyExists;
+    MoveTree(from, to);
+    return FsResult::Ok;
+}
+
+FsResult FakeFileSystem::ReplaceEntry(const std::wstring& from, const std::wstring& to)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    FsResult result = Begin(Op::Replace, from, m_options.change, false, true);
+    if (result != FsResult::Ok)
+        return result;
+    Node* source = Find(from);
+    if (!source || !ParentIsFolder(to))
+        return FsResult::NotFound;
+    Node* target = Find(to);
+    if (source->isDirectory || (target && target->isDirectory))
+        return FsResult::Failed;
+    m_nodes.erase(to);
+    MoveTree(from, to);
+    return FsResult::Ok;
+}
+
+FsResult FakeFileSystem::DeleteEntry(const std::wstring& path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    FsResult result = Begin(Op::Delete, path, m_options.change, false, true);
+    if (result != FsResult::Ok)
+        return result;
+    Node* node = Find(path);
+    if (!node)
+        return FsResult::NotFound;
+    if (node->isDirectory)
+    {
+        std::wstring prefix = ChildPrefix(path);
+        auto child = m_nodes.lower_bound(prefix);
+        if (child != m_nodes.end() && child->first.compare(0, prefix.size(), prefix) == 0)
+            return FsResult::Failed;
+    }
+    m_nodes.erase(path);
+    return FsResult::Ok;
+}
+
+void FakeFileSystem::LinkEntries(const std::wstring& folder, std::vector<LinkRequest>& links)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Node* parent = Find(folder);
+    BeginBatch();
+    for (auto& link : links)
+    {
+        std::wstring target = JoinPath(folder, link.name);
+        link.result = Begin(Op::Link, target, m_options.change, false, false);
+        if (link.result != FsResult::Ok)
+            continue;
+        Node* source = Find(link.source);
+        if (!parent || !parent->isDirectory || !source)
+            link.result = FsResult::NotFound;
+        else if (Find(target))
+            link.result = FsResult::AlreadyExists;
+        else if (link.directory || source->isDirectory)
+            m_nodes[target].isDirectory = true;  // A symbolic link to a folder: listed as an empty folder
+        else
+            m_nodes[target] = *source;  // A hard link: same size, time and content
+    }
+    EndBatch();
+}
+
+FsResult FakeFileSystem::OpenReader(const std::wstring& path, std::unique_ptr<IFileReader>& reader)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    FsResult result = Begin(Op::Open, path, m_options.open, true, true);
+    if (result != FsResult::Ok)
+        return result;
+    Node* node = Find(path);
+    if (!node)
+        return FsResult::NotFound;
+    if (node->isDirectory)
+        return FsResult::AccessDenied;
+    reader = std::make_unique<FakeFileReader>(*this, path, node->content, node->size);
+    return FsResult::Ok;
+}
+
+FsResult FakeFileSystem::Read(const std::wstring& path, const std::shared_ptr<const std::string>& content, uint64_t size,
+    uint64_t offset, void* buffer, size_t length, size_t& read)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    read = 0;
+    FsResult result = Begin(Op::Read, path, m_options.io, true, false);
+    if (result != FsResult::Ok)
+        return result;
+
+    size_t count = offset >= size ? 0 : static_cast<size_t>(std::min<uint64_t>(length, size - offset));
+    size_t stored = content && offset < content->size() ? std::min(count, static_cast<size_t>(content->size() - offset)) : 0;
+    if (stored)
+        memcpy(buffer, content->data() + offset, stored);
+    memset(static_cast<uint8_t*>(buffer) + stored, 0, count - stored);
+    ChargeJob(0, 0, count, false);
+    m_stats.bytes += count;
+    read = count;
+    return FsResult::Ok;
+}
+
+FsResult FakeFileSystem::CopyEntry(const std::wstring& from, const std::wstring& to)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    FsResult result = Begin(Op::Copy, from, m_options.open, true, true);
+    if (result != FsResult::Ok)
+        return result;
+    Node* source = Find(from);
+    if (!source || !ParentIsFolder(to))
+        return FsResult::NotFound;
+    if (source->isDirectory)
+        return FsResult::AccessDenied;
+    if (Find(to))
+        return FsResult::AlreadyExists;
+
+    // One round trip per MB on top of the transfer itself
+    Node copy = *source;
+    uint64_t chunks = (copy.size + (1 << 20) - 1) >> 20;
+    double perChunk = DrawLatency(m_options.io, Mix(CallKey(Op::Copy, to)));
+    ChargeJob(0, perChunk * static_cast<double>(chunks), copy.size, false);
+    m_stats.bytes += copy.size;
+    m_nodes[to] = std::move(copy);
+    return FsResult::Ok;
+}
+
+FsResult FakeFileSystem::CreateWriter(const std::wstring& path, std::unique_ptr<IFileWriter>& writer)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    FsResult result = Begin(Op::Open, path, m_options.open, true, false);
+    if (result != FsResult::Ok)
+        return result;
+    if (Find(path))
+        return FsResult::AlreadyExists;
+    if (!ParentIsFolder(path))
+        return FsResult::NotFound;
+    m_nodes[path] = Node();
+    writer = std::make_unique<FakeFileWriter>(*this, path);
+    return FsResult::Ok;
+}
+
+FsResult FakeFileSystem::Write(const std::wstring& path, uint64_t offset, size_t length)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    FsResult result = Begin(Op::Write, path, m_options.io, true, false);
+    if (result != FsResult::Ok)
+        return result;
+    Node* node = Find(path);
+    if (!node || node->isDirectory)
+        return FsResult::Failed;
+    node->size = std::max<uint64_t>(node->size, offset + length);
+    ChargeJob(0, 0, length, false);
+    m_stats.bytes += length;
+    return FsResult::Ok;
+}
+
+FsResult FakeFileSystem::QueryVolume(const std::wstring& path, VolumeInfo& info)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    FsResult result = Begin(Op::Volume, path, m_options.metadata, false, false);
+    if (result != FsResult::Ok)
+        return result;
+    if (!Find(path))
+        return FsResult::NotFound;
+    info.device = L"fake";
+    info.kind = m_options.kind;
+    return FsResult::Ok;
+}
+
+void FakeFileSystem::QueryMetadataBatch(const std::vector<FileEntry*>& entries, std::vector<FsResult>& results)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        BeginBatch();
+    }
+    IFileSystem::QueryMetadataBatch(entries, results);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    EndBatch();
+}
+
+void FakeFileSystem::CreateFolders(const std::vector<std::wstring>& paths, std::vector<FsResult>& results)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        BeginBatch();
+    }
+    IFileSystem::CreateFolders(paths, results);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    EndBatch();
+}
+
+void FakeFileSystem::MoveEntries(std::vector<MoveRequest>& moves)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        BeginBatch();
+    }
+    IFileSystem::MoveEntries(moves);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    EndBatch();
+}
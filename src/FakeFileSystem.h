@@ -0,0 +1,145 @@
+#pragma once
+#include "FileSystem.h"
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+// In-memory IFileSystem that behaves like a slow share: every operation costs a latency
+// drawn from a log-normal distribution, data moves through a shared bandwidth cap, and
+// operations fail or hit sharing violations at configurable rates. Nothing sleeps; time
+// is virtual, so a Linux benchmark can show what 20-200 ms per call does to batching,
+// concurrency and retries in a fraction of the wall time.
+//
+// Timing is deterministic: each draw is a hash of the seed, the operation, the path and
+// how often that operation was tried on that path, and pending work is laid out in an
+// order of its own, never in the order threads happened to run in.
+//
+// Calls on the thread that created the fake are serial: each starts once everything
+// before it is done. Everything else makes up jobs that overlap across options.slots:
+// each OpenReader, CreateWriter or CopyEntry starts one on the calling thread and that
+// thread's reads and writes add to it; any other call from another thread is a job of
+// its own; and so is each request of a batch (QueryMetadataBatch, CreateFolders,
+// MoveEntries, LinkEntries), so a batch costs a round trip per slots requests. Since
+// nothing sleeps, one thread can take most jobs of a pool in real time, so jobs are not
+// timed on the thread that ran them; the next serial call (or ElapsedMs, or the end of a
+// batch on the creating thread) lays them out longest first, each on the slot that
+// frees up first, and then starts once the last one is done.
+
+struct FakeLatency
+{
+    double medianMs = 0;  // 0: instant
+    double p99Ms = 0;     // <= medianMs: always medianMs
+};
+
+struct FakeFileSystemOptions
+{
+    FakeLatency metadata;        // ListDirectory, QueryMetadata, PathExists, QueryVolume
+    double listEntryMs = 0;      // ListDirectory, per entry returned
+    FakeLatency change;          // CreateFolder, MoveEntry, ReplaceEntry, DeleteEntry, each link
+    FakeLatency open;            // OpenReader, CreateWriter, CopyEntry
+    FakeLatency io;              // Every read or write call, and every MB a copy moves
+    double bandwidthMBps = 0;    // Shared by all data moved; 0: unlimited
+    double failureRate = 0;      // Any call: FsResult::Failed, nothing changed
+    double sharingRate = 0;      // Opens, copies, moves and deletes: SharingViolation
+    uint64_t seed = 1;
+    unsigned slots = 1;          // Jobs run at once: the caller's thread count (pool size)
+    DeviceKind kind = DeviceKind::Remote;
+};
+
+struct FakeFileSystemStats
+{
+    size_t calls = 0;
+    size_t failures = 0;            // Injected Failed results
+    size_t sharingViolations = 0;   // Injected SharingViolation results
+    uint64_t bytes = 0;             // Data read, written and copied
+};
+
+class FakeFileSystem : public IFileSystem
+{
+public:
+    explicit FakeFileSystem(const FakeFileSystemOptions& options = FakeFileSystemOptions());
+
+    // Setup: free of latency and faults. Missing parent folders are created.
+    void AddFolder(const std::wstring& path);
+    // content is the start of the file; the rest up to size reads as zeros
+    void AddFile(const std::wstring& path, uint64_t size, uint64_t lastWriteTime, const std::string& content = std::string());
+
+    // Virtual time since construction (or ResetClock)
+    double ElapsedMs();
+    void ResetClock();
+    FakeFileSystemStats Stats() const;
+
+    FsResult ListDirectory(const std::wstring& folder, std::vector<FileEntry>& entries) override;
+    FsResult QueryMetadata(FileEntry& entry) override;
+    bool PathExists(const std::wstring& path) override;
+    FsResult CreateFolder(const std::wstring& path) override;
+    FsResult MoveEntry(const std::wstring& from, const std::wstring& to) override;
+    FsResult ReplaceEntry(const std::wstring& from, const std::wstring& to) override;
+    FsResult DeleteEntry(const std::wstring& path) override;
+    void LinkEntries(const std::wstring& folder, std::vector<LinkRequest>& links) override;
+    FsResult OpenReader(const std::wstring& path, std::unique_ptr<IFileReader>& reader) override;
+    FsResult CopyEntry(const std::wstring& from, const std::wstring& to) override;
+    // Written data is counted and sized but not kept; it reads back as zeros
+    FsResult CreateWriter(const std::wstring& path, std::unique_ptr<IFileWriter>& writer) override;
+    FsResult QueryVolume(const std::wstring& path, VolumeInfo& info) override;
+    // The single calls, overlapping as jobs
+    void QueryMetadataBatch(const std::vector<FileEntry*>& entries, std::vector<FsResult>& results) override;
+    void CreateFolders(const std::vector<std::wstring>& paths, std::vector<FsResult>& results) override;
+    void MoveEntries(std::vector<MoveRequest>& moves) override;
+
+private:
+    friend class FakeFileReader;
+    friend class FakeFileWriter;
+
+    enum class Op : uint8_t { List, Stat, Exists, Volume, Create, Move, Replace, Delete, Link, Open, Copy, Write, Read };
+
+    struct Node
+    {
+        bool isDirectory = false;
+        uint64_t size = 0;
+        uint64_t lastWriteTime = 0;
+        std::shared_ptr<const std::string> content;  // Shared by hard links
+    };
+
+    // For FakeFileReader / FakeFileWriter
+    FsResult Read(const std::wstring& path, const std::shared_ptr<const std::string>& content, uint64_t size,
+        uint64_t offset, void* buffer, size_t length, size_t& read);
+    FsResult Write(const std::wstring& path, uint64_t offset, size_t length);
+
+    // All below with m_mutex held
+    uint64_t CallKey(Op op, const std::wstring& path) const;
+    // Counts the call, charges its latency and decides whether it fails
+    FsResult Begin(Op op, const std::wstring& path, const FakeLatency& latency, bool overlaps, bool canShare);
+    // False on other threads and inside a batch, where calls are jobs
+    bool IsSerial() const;
+    void Charge(double ms);
+    void ChargeSerial(double ms);
+    void ChargeJob(uint64_t key, double ms, uint64_t bytes, bool start);
+    // Schedules the pending jobs and moves the serial clock past them
+    void Settle();
+    void BeginBatch();
+    void EndBatch();
+    Node* Find(const std::wstring& path);
+    bool ParentIsFolder(const std::wstring& path);
+    void MoveTree(const std::wstring& from, const std::wstring& to);
+
+    FakeFileSystemOptions m_options;
+    mutable std::mutex m_mutex;
+    std::map<std::wstring, Node> m_nodes;  // Ordered: a folder's subtree is one range
+    struct Job
+    {
+        uint64_t key = 0;  // Of the call that started it; orders equal jobs
+        double ms = 0;
+        uint64_t bytes = 0;
+    };
+
+    std::unordered_map<uint64_t, uint32_t> m_attempts;
+    std::vector<Job> m_jobs;                                 // Since the last serial call
+    std::unordered_map<std::thread::id, size_t> m_threadJob; // Each thread's current job
+    std::thread::id m_owner;                                 // Created the fake: its calls are serial
+    std::unordered_set<std::thread::id> m_batching;          // Threads inside a batch
+    double m_serialClock = 0;
+    FakeFileSystemStats m_stats;
+};
@@ -0,0 +1,1137 @@
+#include "FileSystem.h"
+#include "IoUring.h"
+#include "OrganizePlanner.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <winioctl.h>
+#else
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <linux/io_uring.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/statfs.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#include <vector>
+#endif
+
+// Files at least this large are copied without polluting the cache (Windows) or
+// in parallel chunks (Linux copy_file_range)
+static const uint64_t kLargeCopySize = 256ULL << 20;
+
+// Batches smaller than this run one call at a time whatever the backend: a ring or a
+// thread pool costs more to set up than a few calls
+static const size_t kMinParallelBatch = 16;
+
+std::string WideToUtf8(const std::wstring& text)
+{
+    std::string out;
+    out.reserve(text.size());
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        uint32_t c = static_cast<uint32_t>(text[i]);
+        // UTF-16 surrogate pair (Windows)
+        if (sizeof(wchar_t) == 2 && c >= 0xD800 && c < 0xDC00 && i + 1 < text.size())
+        {
+            uint32_t low = static_cast<uint32_t>(text[i + 1]);
+            if (low >= 0xDC00 && low < 0xE000)
+            {
+                c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                i++;
+            }
+        }
+
+        if (c < 0x80)
+        {
+            out.push_back(static_cast<char>(c));
+        }
+        else if (c < 0x800)
+        {
+            out.push_back(static_cast<char>(0xC0 | (c >> 6)));
+            out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        }
+        else if (c < 0x10000)
+        {
+            out.push_back(static_cast<char>(0xE0 | (c >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        }
+        else
+        {
+            out.push_back(static_cast<char>(0xF0 | (c >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        }
+    }
+    return out;
+}
+
+std::wstring Utf8ToWide(const char* text, size_t length)
+{
+    std::wstring out;
+    out.reserve(length);
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(text);
+    const unsigned char* end = p + length;
+    while (p < end)
+    {
+        uint32_t c = *p++;
+        int extra = 0;
+        if (c >= 0xF0) { c &= 0x07; extra = 3; }
+        else if (c >= 0xE0) { c &= 0x0F; extra = 2; }
+        else if (c >= 0xC0) { c &= 0x1F; extra = 1; }
+
+        for (; extra > 0 && p < end && (*p & 0xC0) == 0x80; extra--)
+            c = (c << 6) | (*p++ & 0x3F);
+
+        if (sizeof(wchar_t) == 2 && c >= 0x10000)
+        {
+            c -= 0x10000;
+            out.push_back(static_cast<wchar_t>(0xD800 + (c >> 10)));
+            out.push_back(static_cast<wchar_t>(0xDC00 + (c & 0x3FF)));
+        }
+        else
+        {
+            out.push_back(static_cast<wchar_t>(c));
+        }
+    }
+    return out;
+}
+
+bool ReadFileBytes(const std::wstring& path, std::string& content)
+{
+#ifdef _WIN32
+    FILE* file = _wfopen(path.c_str(), L"rb");
+#else
+    FILE* file = fopen(ToNativePath(path).c_str(), "rb");
+#endif
+    if (!file)
+        return false;
+
+    content.clear();
+    char buffer[16384];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        content.append(buffer, read);
+    fclose(file);
+    return true;
+}
+
+bool WriteFileBytes(const std::wstring& path, const std::string& content)
+{
+    std::wstring temporary = path + L".tmp";
+#ifdef _WIN32
+    FILE* file = _wfopen(temporary.c_str(), L"wb");
+#else
+    FILE* file = fopen(ToNativePath(temporary).c_str(), "wb");
+#endif
+    if (!file)
+        return false;
+
+    bool ok = fwrite(content.data(), 1, content.size(), file) == content.size();
+    ok &= fclose(file) == 0;
+#ifdef _WIN32
+    ok = ok && MoveFileExW(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING);
+    if (!ok)
+        DeleteFileW(temporary.c_str());
+#else
+    ok = ok && rename(ToNativePath(temporary).c_str(), ToNativePath(path).c_str()) == 0;
+    if (!ok)
+        unlink(ToNativePath(temporary).c_str());
+#endif
+    return ok;
+}
+
+FsResult IFileSystem::VisitDirectory(const std::wstring& folder, const std::function<void(FileEntry&)>& visit)
+{
+    std::vector<FileEntry> entries;
+    FsResult result = ListDirectory(folder, entries);
+    for (auto& entry : entries)
+        visit(entry);
+    return result;
+}
+
+void IFileSystem::QueryMetadataBatch(const std::vector<FileEntry*>& entries, std::vector<FsResult>& results)
+{
+    results.resize(entries.size());
+    for (size_t i = 0; i < entries.size(); i++)
+        results[i] = QueryMetadata(*entries[i]);
+}
+
+void IFileSystem::CreateFolders(const std::vector<std::wstring>& paths, std::vector<FsResult>& results)
+{
+    results.resize(paths.size());
+    for (size_t i = 0; i < paths.size(); i++)
+        results[i] = CreateFolder(paths[i]);
+}
+
+void IFileSystem::MoveEntries(std::vector<MoveRequest>& moves)
+{
+    for (auto& move : moves)
+        move.result = move.replace ? ReplaceEntry(move.from, move.to) : MoveEntry(move.from, move.to);
+}
+
+const char* GetIoBackendName(IoBackend backend)
+{
+    switch (backend)
+    {
+    case IoBackend::Sequential: return "sync";
+    case IoBackend::Threads: return "threads";
+    case IoBackend::Uring: return "uring";
+    default: return "default";
+    }
+}
+
+bool ParseIoBackend(const char* name, IoBackend& backend)
+{
+    for (IoBackend candidate : { IoBackend::Default, IoBackend::Sequential, IoBackend::Threads, IoBackend::Uring })
+    {
+        if (strcmp(name, GetIoBackendName(candidate)) == 0)
+        {
+            backend = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// work(0 .. count-1) spread over a few threads, a chunk at a time. The calls are
+// latency-bound, so there are more threads than cores.
+static void RunOnThreads(size_t count, const std::function<void(size_t)>& work)
+{
+    const size_t kChunk = 32;
+    unsigned threads = std::max(4u, std::min(16u, 2 * std::thread::hardware_concurrency()));
+    threads = static_cast<unsigned>(std::min<size_t>(threads, (count + kChunk - 1) / kChunk));
+
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t start = next.fetch_add(kChunk); start < count; start = next.fetch_add(kChunk))
+        {
+            for (size_t i = start; i < std::min(count, start + kChunk); i++)
+                work(i);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; t++)
+        pool.emplace_back(worker);
+    worker();
+    for (auto& thread : pool)
+        thread.join();
+}
+
+#ifdef _WIN32
+
+static FsResult FsResultFromWin32(DWORD error)
+{
+    switch (error)
+    {
+    case ERROR_SUCCESS:
+        return FsResult::Ok;
+    case ERROR_FILE_NOT_FOUND:
+    case ERROR_PATH_NOT_FOUND:
+        return FsResult::NotFound;
+    case ERROR_ALREADY_EXISTS:
+    case ERROR_FILE_EXISTS:
+        return FsResult::AlreadyExists;
+    case ERROR_ACCESS_DENIED:
+        return FsResult::AccessDenied;
+    case ERROR_SHARING_VIOLATION:
+    case ERROR_LOCK_VIOLATION:
+        return FsResult::SharingViolation;
+    default:
+        return FsResult::Failed;
+    }
+}
+
+static uint64_t FileTimeToTicks(const FILETIME& ft)
+{
+    return (static_cast<uint64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+}
+
+FsResult LocalFileSystem::VisitDirectory(const std::wstring& folder, const std::function<void(FileEntry&)>& visit)
+{
+    std::wstring searchPath = JoinPath(folder, L"*");
+    WIN32_FIND_DATAW fd;
+    HANDLE hFind = FindFirstFileExW(searchPath.c_str(), FindExInfoBasic, &fd,
+        FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+    if (hFind == INVALID_HANDLE_VALUE)
+        return FsResultFromWin32(GetLastError());
+
+    do
+    {
+        if (wcscmp(fd.cFileName, L".") == 0 || wcscmp(fd.cFileName, L"..") == 0)
+            continue;
+
+        FileEntry entry;
+        entry.path = JoinPath(folder, fd.cFileName);
+        entry.size = (static_cast<uint64_t>(fd.nFileSizeHigh) << 32) | fd.nFileSizeLow;
+        entry.lastWriteTime = FileTimeToTicks(fd.ftLastWriteTime);
+        entry.isDirectory = (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+        entry.hasMetadata = true;
+        visit(entry);
+    } while (FindNextFileW(hFind, &fd));
+
+    FindClose(hFind);
+    return FsResult::Ok;
+}
+
+FsResult LocalFileSystem::QueryMetadata(FileEntry& entry)
+{
+    WIN32_FILE_ATTRIBUTE_DATA fileInfo;
+    if (!GetFileAttributesExW(entry.path.c_str(), GetFileExInfoStandard, &fileInfo))
+        return FsResultFromWin32(GetLastError());
+
+    entry.size = (static_cast<uint64_t>(fileInfo.nFileSizeHigh) << 32) | fileInfo.nFileSizeLow;
+    entry.lastWriteTime = FileTimeToTicks(fileInfo.ftLastWriteTime);
+    entry.isDirectory = (fileInfo.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+    entry.hasMetadata = true;
+    return FsResult::Ok;
+}
+
+bool LocalFileSystem::PathExists(const std::wstring& path)
+{
+    return GetFileAttributesW(path.c_str()) != INVALID_FILE_ATTRIBUTES;
+}
+
+FsResult LocalFileSystem::CreateFolder(const std::wstring& path)
+{
+    if (CreateDirectoryW(path.c_str(), nullptr))
+        return FsResult::Ok;
+    return FsResultFromWin32(GetLastError());
+}
+
+FsResult LocalFileSystem::MoveEntry(const std::wstring& from, const std::wstring& to)
+{
+    if (MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_COPY_ALLOWED))
+        return FsResult::Ok;
+    return FsResultFromWin32(GetLastError());
+}
+
+FsResult LocalFileSystem::ReplaceEntry(const std::wstring& from, const std::wstring& to)
+{
+    if (MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_COPY_ALLOWED | MOVEFILE_REPLACE_EXISTING))
+        return FsResult::Ok;
+    return FsResultFromWin32(GetLastError());
+}
+
+FsResult LocalFileSystem::DeleteEntry(const std::wstring& path)
+{
+    // Folder symlinks carry the directory attribute and go away with RemoveDirectory, target intact
+    DWORD attributes = GetFileAttributesW(path.c_str());
+    if (attributes == INVALID_FILE_ATTRIBUTES)
+        return FsResultFromWin32(GetLastError());
+    BOOL ok = (attributes & FILE_ATTRIBUTE_DIRECTORY) ? RemoveDirectoryW(path.c_str()) : DeleteFileW(path.c_str());
+    return ok ? FsResult::Ok : FsResultFromWin32(GetLastError());
+}
+
+void LocalFileSystem::LinkEntries(const std::wstring& folder, std::vector<LinkRequest>& links)
+{
+    for (auto& link : links)
+    {
+        std::wstring target = JoinPath(folder, link.name);
+        DWORD error = ERROR_SUCCESS;
+        if (link.directory || !CreateHardLinkW(target.c_str(), link.source.c_str(), nullptr))
+        {
+            error = link.directory ? ERROR_NOT_SAME_DEVICE : GetLastError();
+            // Other volume, link count limit, or a filesystem without hard links (FAT)
+            if (error == ERROR_NOT_SAME_DEVICE || error == ERROR_TOO_MANY_LINKS || error == ERROR_INVALID_FUNCTION)
+            {
+                DWORD flags = SYMBOLIC_LINK_FLAG_ALLOW_UNPRIVILEGED_CREATE | (link.directory ? SYMBOLIC_LINK_FLAG_DIRECTORY : 0);
+                error = CreateSymbolicLinkW(target.c_str(), link.source.c_str(), flags) ? ERROR_SUCCESS : GetLastError();
+            }
+        }
+        link.result = FsResultFromWin32(error);
+    }
+}
+
+class Win32FileReader : public IFileReader
+{
+public:
+    Win32FileReader(HANDLE file, uint64_t size) : m_file(file), m_size(size) {}
+    ~Win32FileReader() override { CloseHandle(m_file); }
+
+    FsResult Read(uint64_t offset, void* buffer, size_t length, size_t& read) override
+    {
+        // Positional read: no shared file pointer between threads
+        OVERLAPPED ov = {};
+        ov.Offset = static_cast<DWORD>(offset);
+        ov.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        DWORD bytes = 0;
+        if (!ReadFile(m_file, buffer, static_cast<DWORD>(length), &bytes, &ov) && GetLastError() != ERROR_HANDLE_EOF)
+            return FsResultFromWin32(GetLastError());
+        read = bytes;
+        return FsResult::Ok;
+    }
+
+    uint64_t Size() const override { return m_size; }
+
+private:
+    HANDLE m_file;
+    uint64_t m_size;
+};
+
+FsResult LocalFileSystem::OpenReader(const std::wstring& path, std::unique_ptr<IFileReader>& reader)
+{
+    // FILE_SHARE_DELETE so a concurrent move of the same file is not blocked
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return FsResultFromWin32(GetLastError());
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+    {
+        DWORD error = GetLastError();
+        CloseHandle(file);
+        return FsResultFromWin32(error);
+    }
+    reader = std::make_unique<Win32FileReader>(file, static_cast<uint64_t>(size.QuadPart));
+    return FsResult::Ok;
+}
+
+FsResult LocalFileSystem::CopyEntry(const std::wstring& from, const std::wstring& to)
+{
+    // CopyFileEx keeps timestamps and attributes and block-clones on ReFS / Dev Drive.
+    // Large files bypass the cache so a multi-GB copy does not evict everything else.
+    DWORD flags = COPY_FILE_FAIL_IF_EXISTS;
+    WIN32_FILE_ATTRIBUTE_DATA fileInfo;
+    if (GetFileAttributesExW(from.c_str(), GetFileExInfoStandard, &fileInfo) &&
+        ((static_cast<uint64_t>(fileInfo.nFileSizeHigh) << 32) | fileInfo.nFileSizeLow) >= kLargeCopySize)
+        flags |= COPY_FILE_NO_BUFFERING;
+
+    if (CopyFileExW(from.c_str(), to.c_str(), nullptr, nullptr, nullptr, flags))
+        return FsResult::Ok;
+    return FsResultFromWin32(GetLastError());
+}
+
+class Win32FileWriter : public IFileWriter
+{
+public:
+    explicit Win32FileWriter(HANDLE file) : m_file(file) {}
+    ~Win32FileWriter() override { CloseHandle(m_file); }
+
+    FsResult Write(uint64_t offset, const void* data, size_t length) override
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        while (length > 0)
+        {
+            OVERLAPPED ov = {};
+            ov.Offset = static_cast<DWORD>(offset);
+            ov.OffsetHigh = static_cast<DWORD>(offset >> 32);
+            DWORD piece = static_cast<DWORD>(std::min<size_t>(length, 1u << 30));
+            DWORD written = 0;
+            if (!WriteFile(m_file, bytes, piece, &written, &ov))
+                return FsResultFromWin32(GetLastError());
+            bytes += written;
+            offset += written;
+            length -= written;
+        }
+        return FsResult::Ok;
+    }
+
+private:
+    HANDLE m_file;
+};
+
+FsResult LocalFileSystem::CreateWriter(const std::wstring& path, std::unique_ptr<IFileWriter>& writer)
+{
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_NEW,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return FsResultFromWin32(GetLastError());
+    writer = std::make_unique<Win32FileWriter>(file);
+    return FsResult::Ok;
+}
+
+FsResult LocalFileSystem::QueryVolume(const std::wstring& path, VolumeInfo& info)
+{
+    wchar_t root[MAX_PATH];
+    if (!GetVolumePathNameW(path.c_str(), root, MAX_PATH))
+        return FsResultFromWin32(GetLastError());
+    info.device = root;
+    info.kind = DeviceKind::Unknown;
+    if (GetDriveTypeW(root) == DRIVE_REMOTE)
+    {
+        info.kind = DeviceKind::Remote;
+        return FsResult::Ok;
+    }
+
+    // The volume GUID names it wherever it is mounted; opening it wants no trailing separator
+    wchar_t volumeName[MAX_PATH];
+    if (!GetVolumeNameForVolumeMountPointW(root, volumeName, MAX_PATH))
+        return FsResult::Ok;
+    std::wstring volumePath = volumeName;
+    if (!volumePath.empty() && volumePath.back() == L'\\')
+        volumePath.pop_back();
+    info.device = volumePath;
+
+    HANDLE volume = CreateFileW(volumePath.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, 0, nullptr);
+    if (volume == INVALID_HANDLE_VALUE)
+        return FsResult::Ok;
+
+    // Partitions of one disk share it; volumes spanning disks keep their GUID
+    DWORD bytes = 0;
+    STORAGE_DEVICE_NUMBER number;
+    if (DeviceIoControl(volume, IOCTL_STORAGE_GET_DEVICE_NUMBER, nullptr, 0, &number, sizeof(number), &bytes, nullptr))
+        info.device = L"disk" + std::to_wstring(number.DeviceNumber);
+
+    STORAGE_PROPERTY_QUERY query = {};
+    query.PropertyId = StorageDeviceSeekPenaltyProperty;
+    query.QueryType = PropertyStandardQuery;
+    DEVICE_SEEK_PENALTY_DESCRIPTOR penalty = {};
+    if (DeviceIoControl(volume, IOCTL_STORAGE_QUERY_PROPERTY, &query, sizeof(query), &penalty, sizeof(penalty), &bytes, nullptr) &&
+        bytes >= sizeof(penalty))
+        info.kind = penalty.IncursSeekPenalty ? DeviceKind::Rotational : DeviceKind::SolidState;
+    CloseHandle(volume);
+    return FsResult::Ok;
+}
+
+#else
+
+std::string ToNativePath(const std::wstring& path)
+{
+    return WideToUtf8(path);
+}
+
+std::wstring FromNativePath(const char* path)
+{
+    return Utf8ToWide(path, strlen(path));
+}
+
+static FsResult FsResultFromErrno(int error)
+{
+    switch (error)
+    {
+    case 0:
+        return FsResult::Ok;
+    case ENOENT:
+    case ENOTDIR:
+        return FsResult::NotFound;
+    case EEXIST:
+    case ENOTEMPTY:
+        return FsResult::AlreadyExists;
+    case EACCES:
+    case EPERM:
+        return FsResult::AccessDenied;
+    case EBUSY:
+    case ETXTBSY:
+        return FsResult::SharingViolation;
+    default:
+        return FsResult::Failed;
+    }
+}
+
+static uint64_t TimespecToTicks(const struct timespec& ts)
+{
+    const int64_t kUnixEpochSeconds = 11644473600LL;
+    return static_cast<uint64_t>(ts.tv_sec + kUnixEpochSeconds) * 10000000ULL +
+        static_cast<uint64_t>(ts.tv_nsec / 100);
+}
+
+static void FillFromStat(FileEntry& entry, const struct stat& st)
+{
+    entry.size = static_cast<uint64_t>(st.st_size);
+    entry.lastWriteTime = TimespecToTicks(st.st_mtim);
+    entry.isDirectory = S_ISDIR(st.st_mode);
+    entry.hasMetadata = true;
+}
+
+static void FillFromStatx(FileEntry& entry, const struct statx& st)
+{
+    struct timespec mtime;
+    mtime.tv_sec = static_cast<time_t>(st.stx_mtime.tv_sec);
+    mtime.tv_nsec = static_cast<long>(st.stx_mtime.tv_nsec);
+    entry.size = st.stx_size;
+    entry.lastWriteTime = TimespecToTicks(mtime);
+    entry.isDirectory = S_ISDIR(st.stx_mode);
+    entry.hasMetadata = true;
+}
+
+// Operations in flight per ring; the completion queue is twice this
+static const unsigned kUringDepth = 256;
+
+// The ring versions of the batched calls. Each returns how many requests it settled,
+// from the first: 0 without a ring, fewer than all when the ring failed midway. The
+// caller makes the single calls for the rest.
+static size_t UringQueryMetadata(const std::vector<FileEntry*>& entries, std::vector<FsResult>& results)
+{
+    IoUring ring(kUringDepth);
+    std::vector<std::string> paths(ring.Depth());
+    std::vector<struct statx> stats(ring.Depth());
+    return ring.Run(entries.size(),
+        [&](size_t op, unsigned slot, io_uring_sqe& sqe) {
+            paths[slot] = ToNativePath(entries[op]->path);
+            sqe.opcode = IORING_OP_STATX;
+            sqe.fd = AT_FDCWD;
+            sqe.addr = reinterpret_cast<uintptr_t>(paths[slot].c_str());
+            sqe.len = STATX_TYPE | STATX_SIZE | STATX_MTIME;
+            sqe.addr2 = reinterpret_cast<uintptr_t>(&stats[slot]);
+        },
+        [&](size_t op, unsigned slot, int result) {
+            results[op] = FsResultFromErrno(-result);
+            if (result == 0)
+                FillFromStatx(*entries[op], stats[slot]);
+        });
+}
+
+static size_t UringCreateFolders(const std::vector<std::wstring>& folders, std::vector<FsResult>& results)
+{
+    IoUring ring(kUringDepth);
+    std::vector<std::string> paths(ring.Depth());
+    return ring.Run(folders.size(),
+        [&](size_t op, unsigned slot, io_uring_sqe& sqe) {
+            paths[slot] = ToNativePath(folders[op]);
+            sqe.opcode = IORING_OP_MKDIRAT;
+            sqe.fd = AT_FDCWD;
+            sqe.addr = reinterpret_cast<uintptr_t>(paths[slot].c_str());
+            sqe.len = 0777;
+        },
+        [&](size_t op, unsigned, int result) { results[op] = FsResultFromErrno(-result); });
+}
+
+// Moves the filesystem refused RENAME_NOREPLACE for go to retry (MoveEntry checks first)
+static size_t UringMoveEntries(std::vector<MoveRequest>& moves, std::vector<size_t>& retry)
+{
+    IoUring ring(kUringDepth);
+    std::vector<std::string> paths(2 * ring.Depth());
+    return ring.Run(moves.size(),
+        [&](size_t op, unsigned slot, io_uring_sqe& sqe) {
+            paths[2 * slot] = ToNativePath(moves[op].from);
+            paths[2 * slot + 1] = ToNativePath(moves[op].to);
+            sqe.opcode = IORING_OP_RENAMEAT;
+            sqe.fd = AT_FDCWD;
+            sqe.addr = reinterpret_cast<uintptr_t>(paths[2 * slot].c_str());
+            sqe.len = static_cast<uint32_t>(AT_FDCWD);
+            sqe.addr2 = reinterpret_cast<uintptr_t>(paths[2 * slot + 1].c_str());
+            sqe.rename_flags = moves[op].replace ? 0 : RENAME_NOREPLACE;
+        },
+        [&](size_t op, unsigned, int result) {
+            if (!moves[op].replace && (result == -EINVAL || result == -ENOSYS))
+                retry.push_back(op);
+            moves[op].result = FsResultFromErrno(-result);
+        });
+}
+
+FsResult LocalFileSystem::VisitDirectory(const std::wstring& folder, const std::function<void(FileEntry&)>& visit)
+{
+    DIR* dir = opendir(ToNativePath(folder).c_str());
+    if (!dir)
+        return FsResultFromErrno(errno);
+
+    while (struct dirent* de = readdir(dir))
+    {
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+            continue;
+
+        FileEntry entry;
+        entry.path = JoinPath(folder, FromNativePath(de->d_name));
+        if (de->d_type == DT_UNKNOWN)
+        {
+            struct stat st;
+            if (fstatat(dirfd(dir), de->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0)
+                FillFromStat(entry, st);
+        }
+        else
+        {
+            entry.isDirectory = de->d_type == DT_DIR;
+        }
+        visit(entry);
+    }
+
+    closedir(dir);
+    return FsResult::Ok;
+}
+
+FsResult LocalFileSystem::QueryMetadata(FileEntry& entry)
+{
+    struct stat st;
+    if (stat(ToNativePath(entry.path).c_str(), &st) != 0)
+        return FsResultFromErrno(errno);
+    FillFromStat(entry, st);
+    return FsResult::Ok;
+}
+
+bool LocalFileSystem::PathExists(const std::wstring& path)
+{
+    return access(ToNativePath(path).c_str(), F_OK) == 0;
+}
+
+FsResult LocalFileSystem::CreateFolder(const std::wstring& path)
+{
+    if (mkdir(ToNativePath(path).c_str(), 0777) == 0)
+        return FsResult::Ok;
+    return FsResultFromErrno(errno);
+}
+
+FsResult LocalFileSystem::MoveEntry(const std::wstring& from, const std::wstring& to)
+{
+    std::string source = ToNativePath(from);
+    std::string target = ToNativePath(to);
+
+    if (renameat2(AT_FDCWD, source.c_str(), AT_FDCWD, target.c_str(), RENAME_NOREPLACE) == 0)
+        return FsResult::Ok;
+    if (errno != EINVAL && errno != ENOSYS)
+        return FsResultFromErrno(errno);
+
+    // Filesystem without RENAME_NOREPLACE: check, then rename
+    if (access(target.c_str(), F_OK) == 0)
+        return FsResult::AlreadyExists;
+    if (rename(source.c_str(), target.c_str()) == 0)
+        return FsResult::Ok;
+    return FsResultFromErrno(errno);
+}
+
+FsResult LocalFileSystem::ReplaceEntry(const std::wstring& from, const std::wstring& to)
+{
+    if (rename(ToNativePath(from).c_str(), ToNativePath(to).c_str()) == 0)
+        return FsResult::Ok;
+    return FsResultFromErrno(errno);
+}
+
+FsResult LocalFileSystem::DeleteEntry(const std::wstring& path)
+{
+    std::string native = ToNativePath(path);
+    if (unlink(native.c_str()) == 0)
+        return FsResult::Ok;
+    if (errno != EISDIR && errno != EPERM)
+        return FsResultFromErrno(errno);
+    if (rmdir(native.c_str()) == 0)
+        return FsResult::Ok;
+    return FsResultFromErrno(errno == ENOTDIR ? EPERM : errno);
+}
+
+void LocalFileSystem::LinkEntries(const std::wstring& folder, std::vector<LinkRequest>& links)
+{
+    // Names resolve against the open folder, so the folder path is walked once per batch
+    int dir = open(ToNativePath(folder).c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    int folderError = dir < 0 ? errno : 0;
+    for (auto& link : links)
+    {
+        if (dir < 0)
+        {
+            link.result = FsResultFromErrno(folderError);
+            continue;
+        }
+        std::string source = ToNativePath(link.source);
+        std::string name = ToNativePath(link.name);
+        int error = 0;
+        if (link.directory || linkat(AT_FDCWD, source.c_str(), dir, name.c_str(), 0) != 0)
+        {
+            error = link.directory ? EXDEV : errno;
+            // Other filesystem, link count limit, or protected_hardlinks refusing a foreign file
+            if (error == EXDEV || error == EMLINK || error == EPERM)
+                error = symlinkat(source.c_str(), dir, name.c_str()) == 0 ? 0 : errno;
+        }
+        link.result = FsResultFromErrno(error);
+    }
+    if (dir >= 0)
+        close(dir);
+}
+
+class PosixFileReader : public IFileReader
+{
+public:
+    PosixFileReader(int fd, uint64_t size) : m_fd(fd), m_size(size) {}
+    ~PosixFileReader() override { close(m_fd); }
+
+    FsResult Read(uint64_t offset, void* buffer, size_t length, size_t& read) override
+    {
+        read = 0;
+        while (read < length)
+        {
+            ssize_t n = pread(m_fd, static_cast<char*>(buffer) + read, length - read, static_cast<off_t>(offset + read));
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0)
+                return FsResultFromErrno(errno);
+            if (n == 0)
+                break;
+            read += static_cast<size_t>(n);
+        }
+        return FsResult::Ok;
+    }
+
+    uint64_t Size() const override { return m_size; }
+
+private:
+    int m_fd;
+    uint64_t m_size;
+};
+
+FsResult LocalFileSystem::OpenReader(const std::wstring& path, std::unique_ptr<IFileReader>& reader)
+{
+    int fd = open(ToNativePath(path).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return FsResultFromErrno(errno);
+
+    struct stat st;
+    int error = fstat(fd, &st) != 0 ? errno : (S_ISREG(st.st_mode) ? 0 : EISDIR);
+    if (error != 0)
+    {
+        close(fd);
+        return FsResultFromErrno(error);
+    }
+    // Header parsers jump around; skip readahead of data they will not use
+    posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+    reader = std::make_unique<PosixFileReader>(fd, static_cast<uint64_t>(st.st_size));
+    return FsResult::Ok;
+}
+
+// copy_file_range is missing or cannot pair these two files; a slower path may still work
+static bool CopyUnsupported(int error)
+{
+    return error == ENOSYS || error == EXDEV || error == EOPNOTSUPP || error == EINVAL;
+}
+
+// [offset, offset + length) with explicit offsets on both sides, so chunks can run in parallel
+static int CopyRange(int in, int out, uint64_t offset, uint64_t length)
+{
+    while (length > 0)
+    {
+        loff_t inOffset = static_cast<loff_t>(offset);
+        loff_t outOffset = static_cast<loff_t>(offset);
+        size_t chunk = length < (1ULL << 30) ? static_cast<size_t>(length) : (1u << 30);
+        ssize_t n = copy_file_range(in, &inOffset, out, &outOffset, chunk, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return errno;
+        if (n == 0)
+            return EIO;  // Source shrank under us
+        offset += static_cast<uint64_t>(n);
+        length -= static_cast<uint64_t>(n);
+    }
+    return 0;
+}
+
+static int CopyRangeParallel(int in, int out, uint64_t size)
+{
+    const uint64_t kChunk = 64ULL << 20;
+    uint64_t chunks = (size + kChunk - 1) / kChunk;
+    unsigned threads = std::thread::hardware_concurrency();
+    if (threads > 4)
+        threads = 4;
+    if (threads > chunks)
+        threads = static_cast<unsigned>(chunks);
+
+    std::atomic<uint64_t> next(0);
+    std::atomic<int> failure(0);
+    auto worker = [&]() {
+        for (uint64_t c = next++; c < chunks && failure == 0; c = next++)
+        {
+            uint64_t offset = c * kChunk;
+            int error = CopyRange(in, out, offset, size - offset < kChunk ? size - offset : kChunk);
+            if (error != 0)
+                failure = error;
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; t++)
+        pool.emplace_back(worker);
+    worker();
+    for (auto& thread : pool)
+        thread.join();
+    return failure;
+}
+
+static int CopyFileData(int in, int out, uint64_t size)
+{
+#ifdef FICLONE
+    // Reflink (btrfs, XFS, bcachefs): the copy shares extents, no data moves
+    if (ioctl(out, FICLONE, in) == 0)
+        return 0;
+#endif
+    posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    // In-kernel copy; server-side on NFS/SMB and clone-aware on some filesystems
+    int error = size >= kLargeCopySize ? CopyRangeParallel(in, out, size) : CopyRange(in, out, 0, size);
+    if (error == 0 || !CopyUnsupported(error))
+        return error;
+
+    // Older kernels refuse copy_file_range across filesystems; sendfile still avoids user space
+    off_t offset = 0;
+    if (lseek(out, 0, SEEK_SET) != 0)
+        return errno;
+    while (static_cast<uint64_t>(offset) < size)
+    {
+        size_t chunk = size - offset < (1ULL << 30) ? static_cast<size_t>(size - offset) : (1u << 30);
+        ssize_t n = sendfile(out, in, &offset, chunk);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+        {
+            if (offset != 0 || !CopyUnsupported(errno))
+                return errno;
+            break;
+        }
+        if (n == 0)
+            return EIO;
+    }
+    if (static_cast<uint64_t>(offset) >= size)
+        return 0;
+
+    std::vector<char> buffer(1 << 20);
+    for (uint64_t done = 0; done < size;)
+    {
+        ssize_t n = pread(in, buffer.data(), buffer.size(), static_cast<off_t>(done));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return errno;
+        if (n == 0)
+            return EIO;
+        for (ssize_t written = 0; written < n;)
+        {
+            ssize_t w = pwrite(out, buffer.data() + written, static_cast<size_t>(n - written), static_cast<off_t>(done + written));
+            if (w < 0 && errno == EINTR)
+                continue;
+            if (w < 0)
+                return errno;
+            written += w;
+        }
+        done += static_cast<uint64_t>(n);
+    }
+    return 0;
+}
+
+FsResult LocalFileSystem::CopyEntry(const std::wstring& from, const std::wstring& to)
+{
+    std::string source = ToNativePath(from);
+    std::string target = ToNativePath(to);
+
+    int in = open(source.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0)
+        return FsResultFromErrno(errno);
+    struct stat st;
+    int error = fstat(in, &st) != 0 ? errno : (S_ISREG(st.st_mode) ? 0 : EISDIR);
+    if (error != 0)
+    {
+        close(in);
+        return FsResultFromErrno(error);
+    }
+
+    // O_EXCL: never replaces an existing target
+    int out = open(target.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, st.st_mode & 07777);
+    if (out < 0)
+    {
+        error = errno;
+        close(in);
+        return FsResultFromErrno(error);
+    }
+
+    error = CopyFileData(in, out, static_cast<uint64_t>(st.st_size));
+    if (error == 0)
+    {
+        // Keep the modified time so date modes group copies like the originals
+        struct timespec times[2] = { st.st_atim, st.st_mtim };
+        futimens(out, times);
+    }
+    if (close(out) != 0 && error == 0)
+        error = errno;
+    close(in);
+
+    if (error != 0)
+    {
+        unlink(target.c_str());
+        return FsResultFromErrno(error);
+    }
+    return FsResult::Ok;
+}
+
+class PosixFileWriter : public IFileWriter
+{
+public:
+    explicit PosixFileWriter(int fd) : m_fd(fd) {}
+    ~PosixFileWriter() override { close(m_fd); }
+
+    FsResult Write(uint64_t offset, const void* data, size_t length) override
+    {
+        const char* bytes = static_cast<const char*>(data);
+        while (length > 0)
+        {
+            ssize_t n = pwrite(m_fd, bytes, length, static_cast<off_t>(offset));
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0)
+                return FsResultFromErrno(errno);
+            bytes += n;
+            offset += static_cast<uint64_t>(n);
+            length -= static_cast<size_t>(n);
+        }
+        return FsResult::Ok;
+    }
+
+private:
+    int m_fd;
+};
+
+FsResult LocalFileSystem::CreateWriter(const std::wstring& path, std::unique_ptr<IFileWriter>& writer)
+{
+    int fd = open(ToNativePath(path).c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+    if (fd < 0)
+        return FsResultFromErrno(errno);
+    writer = std::make_unique<PosixFileWriter>(fd);
+    return FsResult::Ok;
+}
+
+static bool IsRemoteFsType(unsigned long type)
+{
+    switch (type)
+    {
+    case 0x6969:      // NFS
+    case 0x517B:      // SMB
+    case 0xFF534D42:  // CIFS
+    case 0xFE534D42:  // SMB2
+    case 0x00C36400:  // Ceph
+    case 0x5346414F:  // AFS
+        return true;
+    default:
+        return false;
+    }
+}
+
+FsResult LocalFileSystem::QueryVolume(const std::wstring& path, VolumeInfo& info)
+{
+    std::string native = ToNativePath(path);
+    struct stat st;
+    if (stat(native.c_str(), &st) != 0)
+        return FsResultFromErrno(errno);
+    unsigned devMajor = major(st.st_dev);
+    unsigned devMinor = minor(st.st_dev);
+    info.device = L"dev" + std::to_wstring(devMajor) + L":" + std::to_wstring(devMinor);
+    info.kind = DeviceKind::Unknown;
+
+    struct statfs fsInfo;
+    if (statfs(native.c_str(), &fsInfo) == 0 && IsRemoteFsType(static_cast<unsigned long>(fsInfo.f_type)))
+    {
+        info.kind = DeviceKind::Remote;
+        return FsResult::Ok;
+    }
+
+    // sysfs has the partition or the disk; a partition's disk is the directory above it
+    char link[64];
+    snprintf(link, sizeof(link), "/sys/dev/block/%u:%u", devMajor, devMinor);
+    char resolved[PATH_MAX];
+    if (!realpath(link, resolved))
+        return FsResult::Ok;  // No block device (tmpfs, btrfs subvolumes, overlays)
+    std::string disk = resolved;
+    if (access((disk + "/partition").c_str(), F_OK) == 0)
+        disk.erase(disk.rfind('/'));
+
+    std::string text;
+    if (ReadFileBytes(FromNativePath((disk + "/dev").c_str()), text))
+    {
+        while (!text.empty() && (text.back() == '\n' || text.back() == ' '))
+            text.pop_back();
+        info.device = L"dev" + Utf8ToWide(text.data(), text.size());
+    }
+    if (ReadFileBytes(FromNativePath((disk + "/queue/rotational").c_str()), text) && !text.empty())
+        info.kind = text[0] == '1' ? DeviceKind::Rotational : DeviceKind::SolidState;
+    return FsResult::Ok;
+}
+
+#endif
+
+FsResult LocalFileSystem::ListDirectory(const std::wstring& folder, std::vector<FileEntry>& entries)
+{
+    return VisitDirectory(folder, [&](FileEntry& entry) { entries.push_back(std::move(entry)); });
+}
+
+// The backend a batch of count requests actually runs on
+static IoBackend BatchBackend(IoBackend backend, size_t count)
+{
+    if (count < kMinParallelBatch)
+        return IoBackend::Sequential;
+#ifdef _WIN32
+    return backend == IoBackend::Threads ? IoBackend::Threads : IoBackend::Sequential;
+#else
+    // io_uring stays opt-in: its lookups run on kernel worker threads, and so far that has
+    // only measured slower than the plain calls
+    return backend == IoBackend::Default ? IoBackend::Sequential : backend;
+#endif
+}
+
+void LocalFileSystem::QueryMetadataBatch(const std::vector<FileEntry*>& entries, std::vector<FsResult>& results)
+{
+    results.assign(entries.size(), FsResult::Ok);
+    size_t settled = 0;
+    switch (BatchBackend(m_backend, entries.size()))
+    {
+    case IoBackend::Threads:
+        RunOnThreads(entries.size(), [&](size_t i) { results[i] = QueryMetadata(*entries[i]); });
+        return;
+#ifndef _WIN32
+    case IoBackend::Uring:
+        settled = UringQueryMetadata(entries, results);
+        break;
+#endif
+    default:
+        break;
+    }
+    for (size_t i = settled; i < entries.size(); i++)
+        results[i] = QueryMetadata(*entries[i]);
+}
+
+void LocalFileSystem::CreateFolders(const std::vector<std::wstring>& paths, std::vector<FsResult>& results)
+{
+    results.assign(paths.size(), FsResult::Ok);
+    size_t settled = 0;
+    switch (BatchBackend(m_backend, paths.size()))
+    {
+    case IoBackend::Threads:
+        RunOnThreads(paths.size(), [&](size_t i) { results[i] = CreateFolder(paths[i]); });
+        return;
+#ifndef _WIN32
+    case IoBackend::Uring:
+        settled = UringCreateFolders(paths, results);
+        break;
+#endif
+    default:
+        break;
+    }
+    for (size_t i = settled; i < paths.size(); i++)
+        results[i] = CreateFolder(paths[i]);
+}
+
+void LocalFileSystem::MoveEntries(std::vector<MoveRequest>& moves)
+{
+    auto moveOne = [this](MoveRequest& move) {
+        move.result = move.replace ? ReplaceEntry(move.from, move.to) : MoveEntry(move.from, move.to);
+    };
+    size_t settled = 0;
+    switch (BatchBackend(m_backend, moves.size()))
+    {
+    case IoBackend::Threads:
+        RunOnThreads(moves.size(), [&](size_t i) { moveOne(moves[i]); });
+        return;
+#ifndef _WIN32
+    case IoBackend::Uring:
+    {
+        std::vector<size_t> retry;
+        settled = UringMoveEntries(moves, retry);
+        for (size_t i : retry)
+            moveOne(moves[i]);
+        break;
+    }
+#endif
+    default:
+        break;
+    }
+    for (size_t i = settled; i < moves.size(); i++)
+        moveOne(moves[i]);
+}
@@ -0,0 +1,173 @@
+#pragma once
+#include "OrganizeTypes.h"
+#include <functional>
+#include <memory>
+
+enum class FsResult
+{
+    Ok = 0,
+    NotFound,
+    AlreadyExists,
+    AccessDenied,
+    SharingViolation,
+    Failed
+};
+
+// Positional reads from one open file, for header parsers
+class IFileReader
+{
+public:
+    virtual ~IFileReader() = default;
+
+    // Reads up to length bytes at offset; read < length only at end of file
+    virtual FsResult Read(uint64_t offset, void* buffer, size_t length, size_t& read) = 0;
+    virtual uint64_t Size() const = 0;
+};
+
+// Positional writes to a file made by IFileSystem::CreateWriter
+class IFileWriter
+{
+public:
+    virtual ~IFileWriter() = default;
+
+    // All of length bytes at offset, or a failure
+    virtual FsResult Write(uint64_t offset, const void* data, size_t length) = 0;
+};
+
+// One link for IFileSystem::LinkEntries
+struct LinkRequest
+{
+    std::wstring source;     // Absolute path of the linked file or folder
+    std::wstring name;       // Link name inside the target folder
+    bool directory = false;  // Folders always get a symbolic link
+    FsResult result = FsResult::Ok;
+};
+
+// One move for IFileSystem::MoveEntries
+struct MoveRequest
+{
+    std::wstring from;
+    std::wstring to;
+    bool replace = false;  // ReplaceEntry instead of MoveEntry
+    FsResult result = FsResult::Ok;
+};
+
+// What a path is stored on, for scheduling (VolumeScheduler.h)
+enum class DeviceKind
+{
+    Unknown = 0,
+    SolidState,
+    Rotational,  // Seeks are expensive: one stream at a time
+    Remote,      // Network share
+};
+
+struct VolumeInfo
+{
+    std::wstring device;  // Equal for every path on one physical device, across its volumes
+    DeviceKind kind = DeviceKind::Unknown;
+};
+
+// Filesystem operations used by the organize core. Implementations must be
+// safe to call from one thread at a time; callers do their own batching.
+// RunPerDevice is the exception: it works on paths of different devices from
+// one thread per device at once.
+class IFileSystem
+{
+public:
+    virtual ~IFileSystem() = default;
+
+    // Immediate children of a folder (no "." / ".."). Fills metadata when it comes for free.
+    virtual FsResult ListDirectory(const std::wstring& folder, std::vector<FileEntry>& entries) = 0;
+    // Same children, handed to visit one at a time as they are read, for folders too large
+    // to list at once (visit may move from the entry). The default lists first.
+    virtual FsResult VisitDirectory(const std::wstring& folder, const std::function<void(FileEntry& entry)>& visit);
+    virtual FsResult QueryMetadata(FileEntry& entry) = 0;
+    virtual bool PathExists(const std::wstring& path) = 0;
+    virtual FsResult CreateFolder(const std::wstring& path) = 0;
+    // Never replaces an existing target
+    virtual FsResult MoveEntry(const std::wstring& from, const std::wstring& to) = 0;
+    // A file moved over an existing file; atomic when both are on one volume
+    virtual FsResult ReplaceEntry(const std::wstring& from, const std::wstring& to) = 0;
+    // A file, a link (never its target) or an empty folder
+    virtual FsResult DeleteEntry(const std::wstring& path) = 0;
+    // Links every source into folder: a hard link, or a symbolic link for folders and
+    // when the source is on another volume. Existing names are left alone (AlreadyExists).
+    virtual void LinkEntries(const std::wstring& folder, std::vector<LinkRequest>& links) = 0;
+    // Unlike the calls above, safe to call (and read from) on several threads at once
+    virtual FsResult OpenReader(const std::wstring& path, std::unique_ptr<IFileReader>& reader) = 0;
+    // One file's data and modified time. Never replaces an existing target; a failed copy
+    // leaves no partial target behind. Safe on several threads at once, like OpenReader.
+    virtual FsResult CopyEntry(const std::wstring& from, const std::wstring& to) = 0;
+    // A new, empty file; never replaces an existing one (AlreadyExists)
+    virtual FsResult CreateWriter(const std::wstring& path, std::unique_ptr<IFileWriter>& writer) = 0;
+    // The device path (an existing file or folder) is on
+    virtual FsResult QueryVolume(const std::wstring& path, VolumeInfo& info) = 0;
+
+    // Batched QueryMetadata, CreateFolder and MoveEntry / ReplaceEntry, one result per
+    // request. The requests of a batch must not depend on each other (a folder and its
+    // subfolder go in separate batches) and may complete in any order. The defaults make
+    // the single calls one after another.
+    virtual void QueryMetadataBatch(const std::vector<FileEntry*>& entries, std::vector<FsResult>& results);
+    virtual void CreateFolders(const std::vector<std::wstring>& paths, std::vector<FsResult>& results);
+    virtual void MoveEntries(std::vector<MoveRequest>& moves);
+};
+
+// How LocalFileSystem runs the batched calls
+enum class IoBackend
+{
+    Default = 0,  // Sequential; io_uring and threads are opt-in until they measure faster
+    Sequential,   // One call after another on the calling thread
+    Threads,      // Blocking calls spread over a few threads
+    Uring,        // Linux io_uring: statx / mkdirat / renameat, hundreds in flight per ring
+};
+
+// Stable lowercase identifiers ("default", "sync", "threads", "uring")
+const char* GetIoBackendName(IoBackend backend);
+bool ParseIoBackend(const char* name, IoBackend& backend);
+
+// Direct Win32 / POSIX calls
+class LocalFileSystem : public IFileSystem
+{
+public:
+    explicit LocalFileSystem(IoBackend backend = IoBackend::Default) : m_backend(backend) {}
+
+    FsResult ListDirectory(const std::wstring& folder, std::vector<FileEntry>& entries) override;
+    FsResult VisitDirectory(const std::wstring& folder, const std::function<void(FileEntry& entry)>& visit) override;
+    FsResult QueryMetadata(FileEntry& entry) override;
+    bool PathExists(const std::wstring& path) override;
+    FsResult CreateFolder(const std::wstring& path) override;
+    FsResult MoveEntry(const std::wstring& from, const std::wstring& to) override;
+    FsResult ReplaceEntry(const std::wstring& from, const std::wstring& to) override;
+    FsResult DeleteEntry(const std::wstring& path) override;
+    // Linux: one open of the folder, then linkat / symlinkat relative to it
+    void LinkEntries(const std::wstring& folder, std::vector<LinkRequest>& links) override;
+    FsResult OpenReader(const std::wstring& path, std::unique_ptr<IFileReader>& reader) override;
+    // CopyFileEx on Windows; reflink (FICLONE), then copy_file_range, sendfile, read/write on Linux
+    FsResult CopyEntry(const std::wstring& from, const std::wstring& to) override;
+    FsResult CreateWriter(const std::wstring& path, std::unique_ptr<IFileWriter>& writer) override;
+    // Windows: the disk number behind the volume and its seek penalty; Linux: the whole
+    // disk of st_dev and its queue/rotational flag in sysfs
+    FsResult QueryVolume(const std::wstring& path, VolumeInfo& info) override;
+    // Small batches, and io_uring where the kernel lacks it, go one call at a time
+    void QueryMetadataBatch(const std::vector<FileEntry*>& entries, std::vector<FsResult>& results) override;
+    void CreateFolders(const std::vector<std::wstring>& paths, std::vector<FsResult>& results) override;
+    void MoveEntries(std::vector<MoveRequest>& moves) override;
+
+private:
+    IoBackend m_backend;
+};
+
+// UTF-8 <-> wide (UTF-16 on Windows, UTF-32 elsewhere)
+std::string WideToUtf8(const std::wstring& text);
+std::wstring Utf8ToWide(const char* text, size_t length);
+
+// Whole file as bytes; false if it cannot be opened
+bool ReadFileBytes(const std::wstring& path, std::string& content);
+// Replaces the file atomically (temporary file, then rename)
+bool WriteFileBytes(const std::wstring& path, const std::string& content);
+
+#ifndef _WIN32
+// Wide paths <-> UTF-8 native paths
+std::string ToNativePath(const std::wstring& path);
+std::wstring FromNativePath(const char* path);
+#endif
@@ -0,0 +1,746 @@
+#include "FolderIndex.h"
+#include "CaseFold.h"
+#include "OrganizeExecutor.h"
+#include "OrganizePlanner.h"
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <winioctl.h>
+#else
+#include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const uint8_t kRecordDirectory = 1 << 0;
+    const unsigned kMediaShift = 1;  // Media fields already read sit above the directory bit
+    // Facts small enough to cache; audio tags are strings and are read each time
+    const unsigned kCachedMedia = MediaImageSize | MediaCreationTime;
+
+    struct IndexRecord
+    {
+        std::wstring name;
+        uint64_t id = 0;             // Inode / NTFS file ID
+        uint64_t size = 0;
+        uint64_t lastWriteTime = 0;
+        uint64_t creationTime = 0;   // MediaInfo::creationTime
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint8_t flags = 0;           // kRecordDirectory | cached media fields << kMediaShift
+    };
+
+    // Identity of the folder and where its change tracking stood
+    struct FolderState
+    {
+        uint64_t volume = 0;      // Volume serial / st_dev
+        uint64_t folderId = 0;    // File ID / inode of the folder itself
+        uint64_t folderTime = 0;  // Linux: the folder's mtime
+        uint64_t scanTime = 0;    // Linux: when the index last caught up
+        uint64_t journalId = 0;   // Windows: USN journal, 0 when there is none
+        uint64_t nextUsn = 0;
+    };
+
+    struct FolderIndexData
+    {
+        FolderState state;
+        std::vector<IndexRecord> records;
+    };
+}
+
+static const char kIndexMagic[4] = { 'N', 'F', 'F', 'I' };
+static const uint32_t kIndexVersion = 1;
+
+// Folder mtimes this close to the scan may hide changes made in the same tick
+static const uint64_t kRacyTicks = 2 * 10000000ULL;
+
+static bool SameFacts(const IndexRecord& a, const IndexRecord& b)
+{
+    return a.id == b.id && a.size == b.size && a.lastWriteTime == b.lastWriteTime &&
+        (a.flags & kRecordDirectory) == (b.flags & kRecordDirectory);
+}
+
+// ---------------------------------------------------------------------------
+// Platform: folder identity, full listings, single entries, changes
+
+#ifdef _WIN32
+
+static uint64_t FileTimeToTicks(const FILETIME& ft)
+{
+    return (static_cast<uint64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+}
+
+static HANDLE OpenVolume(const std::wstring& folder)
+{
+    wchar_t root[MAX_PATH];
+    if (!GetVolumePathNameW(folder.c_str(), root, MAX_PATH))
+        return INVALID_HANDLE_VALUE;
+    std::wstring device = root;
+    if (device.size() != 3 || device[1] != L':')
+        return INVALID_HANDLE_VALUE;  // UNC shares and mounted folders: no journal we can open
+    device = L"\\\\.\\" + device.substr(0, 2);
+    return CreateFileW(device.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, 0, nullptr);
+}
+
+static bool QueryFolderState(const std::wstring& folder, FolderState& state)
+{
+    HANDLE handle = CreateFileW(folder.c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+        return false;
+    BY_HANDLE_FILE_INFORMATION info;
+    bool ok = GetFileInformationByHandle(handle, &info) != FALSE;
+    CloseHandle(handle);
+    if (!ok || !(info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+        return false;
+
+    state.volume = info.dwVolumeSerialNumber;
+    state.folderId = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+    state.folderTime = FileTimeToTicks(info.ftLastWriteTime);
+
+    HANDLE volume = OpenVolume(folder);
+    if (volume != INVALID_HANDLE_VALUE)
+    {
+        USN_JOURNAL_DATA_V0 journal;
+        DWORD bytes = 0;
+        if (DeviceIoControl(volume, FSCTL_QUERY_USN_JOURNAL, nullptr, 0, &journal, sizeof(journal), &bytes, nullptr))
+        {
+            state.journalId = journal.UsnJournalID;
+            state.nextUsn = static_cast<uint64_t>(journal.NextUsn);
+        }
+        CloseHandle(volume);
+    }
+    return true;
+}
+
+// One enumeration that carries IDs, sizes and times for every child
+static bool ScanFolder(const std::wstring& folder, std::vector<IndexRecord>& records)
+{
+    HANDLE handle = CreateFileW(folder.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+        return false;
+
+    std::vector<uint64_t> buffer(64 * 1024 / sizeof(uint64_t));
+    FILE_INFO_BY_HANDLE_CLASS infoClass = FileIdBothDirectoryRestartInfo;
+    while (GetFileInformationByHandleEx(handle, infoClass, buffer.data(), static_cast<DWORD>(buffer.size() * sizeof(uint64_t))))
+    {
+        infoClass = FileIdBothDirectoryInfo;
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(buffer.data());
+        for (;;)
+        {
+            const FILE_ID_BOTH_DIR_INFO* info = reinterpret_cast<const FILE_ID_BOTH_DIR_INFO*>(p);
+            std::wstring name(info->FileName, info->FileNameLength / sizeof(wchar_t));
+            if (name != L"." && name != L"..")
+            {
+                IndexRecord record;
+                record.name = std::move(name);
+                record.id = static_cast<uint64_t>(info->FileId.QuadPart);
+                record.size = static_cast<uint64_t>(info->EndOfFile.QuadPart);
+                record.lastWriteTime = static_cast<uint64_t>(info->LastWriteTime.QuadPart);
+                if (info->FileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                    record.flags |= kRecordDirectory;
+                records.push_back(std::move(record));
+            }
+            if (info->NextEntryOffset == 0)
+                break;
+            p += info->NextEntryOffset;
+        }
+    }
+    DWORD error = GetLastError();
+    CloseHandle(handle);
+    return error == ERROR_NO_MORE_FILES;
+}
+
+// False when the entry is gone
+static bool StatEntry(const std::wstring& folder, const std::wstring& name, IndexRecord& record)
+{
+    HANDLE handle = CreateFileW(JoinPath(folder, name).c_str(), FILE_READ_ATTRIBUTES,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+        return false;
+    BY_HANDLE_FILE_INFORMATION info;
+    bool ok = GetFileInformationByHandle(handle, &info) != FALSE;
+    CloseHandle(handle);
+    if (!ok)
+        return false;
+
+    record.name = name;
+    record.id = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+    record.size = (static_cast<uint64_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+    record.lastWriteTime = FileTimeToTicks(info.ftLastWriteTime);
+    record.flags = (info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? kRecordDirectory : 0;
+    return true;
+}
+
+// Names the journal reports directly under the folder since the index was saved.
+// False when the journal cannot tell (none, recreated, wrapped, or not readable).
+static bool ReadFolderChanges(const std::wstring& folder, const FolderState& saved, const FolderState& now,
+    std::unordered_set<std::wstring>& names)
+{
+    if (saved.journalId == 0 || saved.journalId != now.journalId || saved.nextUsn > now.nextUsn)
+        return false;
+    if (saved.nextUsn == now.nextUsn)
+        return true;
+
+    HANDLE volume = OpenVolume(folder);
+    if (volume == INVALID_HANDLE_VALUE)
+        return false;
+
+    READ_USN_JOURNAL_DATA_V0 read = {};
+    read.StartUsn = static_cast<USN>(saved.nextUsn);
+    read.ReasonMask = 0xFFFFFFFF;
+    read.UsnJournalID = saved.journalId;
+
+    std::vector<uint64_t> buffer(256 * 1024 / sizeof(uint64_t));
+    DWORD bufferBytes = static_cast<DWORD>(buffer.size() * sizeof(uint64_t));
+    bool ok = true;
+    while (ok && static_cast<uint64_t>(read.StartUsn) < now.nextUsn)
+    {
+        DWORD bytes = 0;
+        // Records before FirstUsn are gone (ERROR_JOURNAL_ENTRY_DELETED): the chain is broken
+#ifdef FSCTL_READ_UNPRIVILEGED_USN_JOURNAL
+        if (!DeviceIoControl(volume, FSCTL_READ_UNPRIVILEGED_USN_JOURNAL, &read, sizeof(read), buffer.data(), bufferBytes, &bytes, nullptr) &&
+            !DeviceIoControl(volume, FSCTL_READ_USN_JOURNAL, &read, sizeof(read), buffer.data(), bufferBytes, &bytes, nullptr))
+#else
+        if (!DeviceIoControl(volume, FSCTL_READ_USN_JOURNAL, &read, sizeof(read), buffer.data(), bufferBytes, &bytes, nullptr))
+#endif
+        {
+            ok = false;
+            break;
+        }
+        if (bytes <= sizeof(USN))
+            break;
+
+        const uint8_t* base = reinterpret_cast<const uint8_t*>(buffer.data());
+        for (DWORD offset = sizeof(USN); offset < bytes;)
+        {
+            const USN_RECORD_V2* record = reinterpret_cast<const USN_RECORD_V2*>(base + offset);
+            if (record->RecordLength == 0 || record->MajorVersion != 2)
+            {
+                ok = false;  // ReFS (128-bit IDs) writes V3 records: take the full listing
+                break;
+            }
+            if (record->ParentFileReferenceNumber == saved.folderId)
+            {
+                const wchar_t* name = reinterpret_cast<const wchar_t*>(reinterpret_cast<const uint8_t*>(record) + record->FileNameOffset);
+                names.emplace(name, record->FileNameLength / sizeof(wchar_t));
+            }
+            offset += record->RecordLength;
+        }
+        read.StartUsn = *reinterpret_cast<const USN*>(base);
+    }
+    CloseHandle(volume);
+    return ok;
+}
+
+static std::wstring GetIndexCacheRoot()
+{
+    const wchar_t* localAppData = _wgetenv(L"LOCALAPPDATA");
+    if (!localAppData || !*localAppData)
+        return std::wstring();
+    return JoinPath(localAppData, L"NewFolderFromFiles");
+}
+
+#else
+
+static uint64_t TimespecToTicks(const struct timespec& ts)
+{
+    const int64_t kUnixEpochSeconds = 11644473600LL;
+    return static_cast<uint64_t>(ts.tv_sec + kUnixEpochSeconds) * 10000000ULL +
+        static_cast<uint64_t>(ts.tv_nsec / 100);
+}
+
+static uint64_t NowTicks()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return TimespecToTicks(ts);
+}
+
+static void FillRecord(IndexRecord& record, const struct stat& st)
+{
+    record.id = static_cast<uint64_t>(st.st_ino);
+    record.size = static_cast<uint64_t>(st.st_size);
+    record.lastWriteTime = TimespecToTicks(st.st_mtim);
+    record.flags = S_ISDIR(st.st_mode) ? kRecordDirectory : 0;
+}
+
+static bool QueryFolderState(const std::wstring& folder, FolderState& state)
+{
+    struct stat st;
+    if (stat(ToNativePath(folder).c_str(), &st) != 0 || !S_ISDIR(st.st_mode))
+        return false;
+    state.volume = static_cast<uint64_t>(st.st_dev);
+    state.folderId = static_cast<uint64_t>(st.st_ino);
+    state.folderTime = TimespecToTicks(st.st_mtim);
+    state.scanTime = NowTicks();
+    return true;
+}
+
+// Names and inodes straight from readdir; no per-entry calls
+static bool ListNames(DIR* dir, std::vector<std::pair<std::string, uint64_t>>& names)
+{
+    errno = 0;
+    while (struct dirent* de = readdir(dir))
+    {
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+            continue;
+        names.emplace_back(de->d_name, static_cast<uint64_t>(de->d_ino));
+    }
+    return errno == 0;
+}
+
+static bool StatAt(int dirFd, const char* name, IndexRecord& record)
+{
+    struct stat st;
+    if (fstatat(dirFd, name, &st, 0) != 0)
+        return false;
+    FillRecord(record, st);
+    return true;
+}
+
+static std::wstring GetIndexCacheRoot()
+{
+    std::wstring base;
+    if (const char* xdg = getenv("XDG_CACHE_HOME"))
+        base = FromNativePath(xdg);
+    else if (const char* home = getenv("HOME"))
+        base = JoinPath(FromNativePath(home), L".cache");
+    if (base.empty())
+        return std::wstring();
+    return JoinPath(base, L"NewFolderFromFiles");
+}
+
+#endif
+
+// ---------------------------------------------------------------------------
+// Index file: header, then one array per field so each column is read in one go
+
+template <typename T>
+static void PutColumn(std::string& out, const std::vector<IndexRecord>& records, T IndexRecord::*field)
+{
+    size_t start = out.size();
+    out.resize(start + records.size() * sizeof(T));
+    char* p = &out[start];
+    for (const auto& record : records)
+    {
+        T value = record.*field;
+        memcpy(p, &value, sizeof(T));
+        p += sizeof(T);
+    }
+}
+
+template <typename T>
+static bool GetColumn(const char*& p, const char* end, std::vector<IndexRecord>& records, T IndexRecord::*field)
+{
+    if (static_cast<size_t>(end - p) < records.size() * sizeof(T))
+        return false;
+    for (auto& record : records)
+    {
+        T value;
+        memcpy(&value, p, sizeof(T));
+        record.*field = value;
+        p += sizeof(T);
+    }
+    return true;
+}
+
+static std::string SerializeIndex(const std::wstring& folder, const FolderIndexData& data)
+{
+    std::string folderUtf8 = WideToUtf8(folder);
+    std::string out(kIndexMagic, sizeof(kIndexMagic));
+    auto put = [&out](const void* value, size_t size) { out.append(static_cast<const char*>(value), size); };
+
+    uint32_t version = kIndexVersion;
+    uint64_t count = data.records.size();
+    uint32_t folderLength = static_cast<uint32_t>(folderUtf8.size());
+    put(&version, sizeof(version));
+    put(&data.state, sizeof(data.state));
+    put(&count, sizeof(count));
+    put(&folderLength, sizeof(folderLength));
+    out += folderUtf8;
+
+    PutColumn(out, data.records, &IndexRecord::id);
+    PutColumn(out, data.records, &IndexRecord::size);
+    PutColumn(out, data.records, &IndexRecord::lastWriteTime);
+    PutColumn(out, data.records, &IndexRecord::creationTime);
+    PutColumn(out, data.records, &IndexRecord::width);
+    PutColumn(out, data.records, &IndexRecord::height);
+    PutColumn(out, data.records, &IndexRecord::flags);
+
+    // Names: end offsets, then the UTF-8 text of all of them
+    std::string names;
+    std::vector<uint32_t> ends;
+    ends.reserve(data.records.size());
+    for (const auto& record : data.records)
+    {
+        names += WideToUtf8(record.name);
+        ends.push_back(static_cast<uint32_t>(names.size()));
+    }
+    put(ends.data(), ends.size() * sizeof(uint32_t));
+    out += names;
+    return out;
+}
+
+static bool LoadIndex(const std::wstring& path, const std::wstring& folder, FolderIndexData& data)
+{
+    std::string bytes;
+    if (!ReadFileBytes(path, bytes))
+        return false;
+    const char* p = bytes.data();
+    const char* end = p + bytes.size();
+    auto get = [&p, end](void* value, size_t size) {
+        if (static_cast<size_t>(end - p) < size)
+            return false;
+        memcpy(value, p, size);
+        p += size;
+        return true;
+    };
+
+    char magic[4];
+    uint32_t version = 0, folderLength = 0;
+    uint64_t count = 0;
+    if (!get(magic, sizeof(magic)) || memcmp(magic, kIndexMagic, sizeof(magic)) != 0 ||
+        !get(&version, sizeof(version)) || version != kIndexVersion ||
+        !get(&data.state, sizeof(data.state)) || !get(&count, sizeof(count)) || !get(&folderLength, sizeof(folderLength)) ||
+        static_cast<size_t>(end - p) < folderLength || std::string(p, folderLength) != WideToUtf8(folder))
+        return false;
+    p += folderLength;
+    // Every record takes at least its fixed columns
+    if (count > static_cast<uint64_t>(end - p) / 37)
+        return false;
+
+    data.records.resize(static_cast<size_t>(count));
+    if (!GetColumn(p, end, data.records, &IndexRecord::id) ||
+        !GetColumn(p, end, data.records, &IndexRecord::size) ||
+        !GetColumn(p, end, data.records, &IndexRecord::lastWriteTime) ||
+        !GetColumn(p, end, data.records, &IndexRecord::creationTime) ||
+        !GetColumn(p, end, data.records, &IndexRecord::width) ||
+        !GetColumn(p, end, data.records, &IndexRecord::height) ||
+        !GetColumn(p, end, data.records, &IndexRecord::flags) ||
+        static_cast<size_t>(end - p) < data.records.size() * sizeof(uint32_t))
+        return false;
+
+    const char* ends = p;
+    const char* names = p + data.records.size() * sizeof(uint32_t);
+    uint32_t start = 0;
+    for (size_t i = 0; i < data.records.size(); i++)
+    {
+        uint32_t stop;
+        memcpy(&stop, ends + i * sizeof(uint32_t), sizeof(stop));
+        if (stop < start || stop > static_cast<size_t>(end - names))
+            return false;
+        data.records[i].name = Utf8ToWide(names + start, stop - start);
+        start = stop;
+    }
+    return true;
+}
+
+static bool SaveIndex(const std::wstring& path, const std::wstring& folder, const FolderIndexData& data)
+{
+    // CreateFolder makes one level: create the missing ancestors outermost first
+    LocalFileSystem fs;
+    std::vector<std::wstring> missing;
+    for (std::wstring folder = PathParent(path); !folder.empty() && !fs.PathExists(folder); folder = PathParent(folder))
+        missing.push_back(folder);
+    for (auto it = missing.rbegin(); it != missing.rend(); ++it)
+        fs.CreateFolder(*it);
+    return WriteFileBytes(path, SerializeIndex(folder, data));
+}
+
+std::wstring GetFolderIndexPath(const std::wstring& folder)
+{
+    std::wstring root = GetIndexCacheRoot();
+    if (root.empty())
+        return std::wstring();
+
+    // FNV-1a over the path as the filesystem compares it
+    uint64_t hash = 14695981039346656037ULL;
+    for (wchar_t c : folder)
+    {
+#ifdef _WIN32
+        c = FoldCase(c);
+#endif
+        hash = (hash ^ static_cast<uint64_t>(c)) * 1099511628211ULL;
+    }
+    wchar_t name[32];
+    swprintf(name, 32, L"%016llx.idx", static_cast<unsigned long long>(hash));
+    return JoinPath(JoinPath(root, L"index"), name);
+}
+
+// ---------------------------------------------------------------------------
+
+// Brings data up to date; false when the folder cannot be listed
+static bool CatchUp(const std::wstring& folder, const FolderState& now, FolderIndexData& data, bool haveIndex,
+    const FolderIndexOptions& options, FolderIndexStats& stats)
+{
+    std::unordered_map<std::wstring, size_t> byName;
+    byName.reserve(data.records.size());
+    for (size_t i = 0; i < data.records.size(); i++)
+        byName.emplace(data.records[i].name, i);
+
+    // Full listing; unchanged entries keep their cached media facts
+    auto rescan = [&]() {
+        std::vector<IndexRecord> fresh;
+#ifdef _WIN32
+        if (!ScanFolder(folder, fresh))
+            return false;
+#else
+        DIR* dir = opendir(ToNativePath(folder).c_str());
+        if (!dir)
+            return false;
+        std::vector<std::pair<std::string, uint64_t>> names;
+        bool listed = ListNames(dir, names);
+        fresh.reserve(names.size());
+        for (const auto& [name, inode] : names)
+        {
+            IndexRecord record;
+            record.name = FromNativePath(name.c_str());
+            if (StatAt(dirfd(dir), name.c_str(), record))
+                fresh.push_back(std::move(record));
+        }
+        closedir(dir);
+        if (!listed)
+            return false;
+#endif
+        stats.rebuilt = true;
+        size_t kept = 0;
+        for (auto& record : fresh)
+        {
+            auto it = byName.find(record.name);
+            kept += it != byName.end();
+            if (it != byName.end() && SameFacts(data.records[it->second], record))
+            {
+                record = std::move(data.records[it->second]);
+                stats.reused++;
+            }
+            else
+            {
+                stats.refreshed++;
+            }
+        }
+        stats.removed = data.records.size() - kept;
+        data.records = std::move(fresh);
+        return true;
+    };
+
+    if (!haveIndex)
+        return rescan();
+
+#ifdef _WIN32
+    std::unordered_set<std::wstring> changed;
+    if (!ReadFolderChanges(folder, data.state, now, changed))
+        return rescan();
+
+    size_t known = data.records.size();
+    std::vector<uint8_t> gone(data.records.size(), 0);
+    for (const auto& name : changed)
+    {
+        IndexRecord record;
+        auto it = byName.find(name);
+        bool exists = StatEntry(folder, name, record);
+        if (it == byName.end())
+        {
+            if (exists)
+            {
+                data.records.push_back(std::move(record));
+                stats.refreshed++;
+            }
+        }
+        else if (!exists)
+        {
+            gone[it->second] = 1;
+            stats.removed++;
+        }
+        else if (!SameFacts(data.records[it->second], record))
+        {
+            data.records[it->second] = std::move(record);
+            stats.refreshed++;
+        }
+    }
+    size_t added = data.records.size() - known;
+    stats.reused = known - (stats.refreshed - added) - stats.removed;
+#else
+    // Same folder mtime, and not written in the same moment as the last scan: same names
+    bool racy = data.state.folderTime + kRacyTicks >= data.state.scanTime;
+    if (!options.verify && !racy && now.folderTime == data.state.folderTime)
+    {
+        stats.reused = data.records.size();
+        return true;
+    }
+
+    DIR* dir = opendir(ToNativePath(folder).c_str());
+    if (!dir)
+        return rescan();
+    std::vector<std::pair<std::string, uint64_t>> names;
+    if (!ListNames(dir, names))
+    {
+        closedir(dir);
+        return rescan();
+    }
+
+    std::vector<uint8_t> gone(data.records.size(), 1);
+    std::vector<IndexRecord> added;
+    for (const auto& [native, inode] : names)
+    {
+        std::wstring name = FromNativePath(native.c_str());
+        auto it = byName.find(name);
+        if (it != byName.end() && data.records[it->second].id == inode && !options.verify)
+        {
+            gone[it->second] = 0;
+            stats.reused++;
+            continue;
+        }
+
+        IndexRecord record;
+        record.name = name;
+        if (!StatAt(dirfd(dir), native.c_str(), record))
+            continue;
+        if (it != byName.end())
+        {
+            gone[it->second] = 0;
+            if (SameFacts(data.records[it->second], record))
+            {
+                stats.reused++;
+                continue;
+            }
+            data.records[it->second] = std::move(record);
+        }
+        else
+        {
+            added.push_back(std::move(record));
+        }
+        stats.refreshed++;
+    }
+    closedir(dir);
+    for (auto& record : added)
+    {
+        data.records.push_back(std::move(record));
+        gone.push_back(0);
+    }
+    for (uint8_t g : gone)
+        stats.removed += g;
+#endif
+
+    if (stats.removed)
+    {
+        size_t out = 0;
+        for (size_t i = 0; i < data.records.size(); i++)
+        {
+            if (i < gone.size() && gone[i])
+                continue;
+            if (out != i)
+                data.records[out] = std::move(data.records[i]);
+            out++;
+        }
+        data.records.resize(out);
+    }
+    return true;
+}
+
+bool ListDirectoryIndexed(IFileSystem& fs, const std::wstring& folder, std::vector<FileEntry>& entries,
+    const FolderIndexOptions& options, FolderIndexStats* stats)
+{
+    FolderIndexStats local;
+    FolderIndexStats& counts = stats ? *stats : local;
+    counts = FolderIndexStats();
+
+    FolderState now;
+    if (!QueryFolderState(folder, now))
+        return false;
+
+    std::wstring indexPath = GetFolderIndexPath(folder);
+    FolderIndexData data;
+    bool haveIndex = !indexPath.empty() && LoadIndex(indexPath, folder, data) &&
+        data.state.volume == now.volume && data.state.folderId == now.folderId;
+    if (!haveIndex)
+        data = FolderIndexData();
+
+    FolderState saved = data.state;
+    if (!CatchUp(folder, now, data, haveIndex, options, counts))
+        return false;
+    bool dirty = counts.rebuilt || counts.refreshed > 0 || counts.removed > 0;
+
+    // Changed entries lost their cached media facts; read what is missing
+    unsigned cached = options.mediaFields & kCachedMedia;
+    std::vector<size_t> missing;
+    for (size_t i = 0; i < data.records.size(); i++)
+    {
+        IndexRecord& record = data.records[i];
+        if (!(record.flags & kRecordDirectory) && ((record.flags >> kMediaShift) & cached) != cached)
+            missing.push_back(i);
+    }
+
+    entries.clear();
+    entries.reserve(data.records.size());
+    for (const auto& record : data.records)
+    {
+        FileEntry entry;
+        entry.path = JoinPath(folder, record.name);
+        entry.size = record.size;
+        entry.lastWriteTime = record.lastWriteTime;
+        entry.isDirectory = (record.flags & kRecordDirectory) != 0;
+        entry.hasMetadata = true;
+        if (cached && (record.creationTime || record.width))
+        {
+            auto info = std::make_shared<MediaInfo>();
+            info->creationTime = record.creationTime;
+            info->width = record.width;
+            info->height = record.height;
+            entry.media = std::move(info);
+        }
+        entries.push_back(std::move(entry));
+    }
+
+    if (!missing.empty())
+    {
+        std::vector<FileEntry> reads;
+        reads.reserve(missing.size());
+        for (size_t i : missing)
+            reads.push_back(entries[i]);
+        QueryEntriesMediaInfo(fs, reads, cached);
+        for (size_t m = 0; m < missing.size(); m++)
+        {
+            IndexRecord& record = data.records[missing[m]];
+            record.flags |= static_cast<uint8_t>((((record.flags >> kMediaShift) | cached) & kCachedMedia) << kMediaShift);
+            if (const MediaInfo* info = reads[m].media.get())
+            {
+                record.creationTime = info->creationTime ? info->creationTime : record.creationTime;
+                record.width = info->width ? info->width : record.width;
+                record.height = info->height ? info->height : record.height;
+                entries[missing[m]].media = reads[m].media;
+            }
+        }
+        counts.mediaRead = missing.size();
+        dirty = true;
+    }
+
+    // Facts that are not cached (audio tags) are read every time
+    if (unsigned uncached = options.mediaFields & ~kCachedMedia)
+        QueryEntriesMediaInfo(fs, entries, uncached);
+
+    // Save when entries changed; a journal cursor that merely moved on is saved once it
+    // is far enough ahead that re-reading the gap would cost more than the write
+    const uint64_t kCursorSlack = 32ULL << 20;
+    data.state = now;
+    if (!dirty && now.nextUsn - saved.nextUsn < kCursorSlack && now.nextUsn >= saved.nextUsn)
+    {
+#ifndef _WIN32
+        // The racy window has passed: record the newer scan time so the next use trusts the mtime
+        if (saved.folderTime + kRacyTicks >= saved.scanTime && now.folderTime + kRacyTicks < now.scanTime && !indexPath.empty())
+            SaveIndex(indexPath, folder, data);
+#endif
+        return true;
+    }
+    if (!indexPath.empty())
+        SaveIndex(indexPath, folder, data);
+    return true;
+}
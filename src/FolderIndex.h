@@ -0,0 +1,42 @@
+#pragma once
+#include "FileSystem.h"
+
+// Persistent per-folder index for folders that are organized (or viewed) again and
+// again. One columnar file per folder keeps every child's name, file ID, size, time
+// and the media facts read from its header (capture time, pixel size). Each use only
+// catches up with what changed since the last one:
+//
+//   Windows: the NTFS change journal (USN) is read from where the index left off and
+//            only the names it reports under the folder are looked at again.
+//   Linux:   an unchanged folder mtime means the same names; otherwise the folder is
+//            listed and only names with a new inode are stat'ed. Files rewritten in
+//            place keep their inode and their cached size and time (IndexOptions::verify).
+//
+// An unchanged folder is served from the index without touching its files. Anything
+// that breaks the chain (another volume or folder ID, a recreated or wrapped journal, an
+// unreadable index) falls back to one full listing, which becomes the new index.
+
+struct FolderIndexOptions
+{
+    unsigned mediaFields = MediaNone;  // Also fill FileEntry::media (see QueryEntriesMediaInfo)
+    bool verify = false;               // Linux: stat every entry, catching in-place rewrites
+};
+
+struct FolderIndexStats
+{
+    bool rebuilt = false;  // Full listing: no usable index
+    size_t reused = 0;     // Entries served from the index as they were
+    size_t refreshed = 0;  // Entries looked at again (new or changed)
+    size_t removed = 0;
+    size_t mediaRead = 0;  // Entries whose headers had to be read
+};
+
+// Every child of folder (files and folders) with metadata, like ListDirectory followed by
+// QueryEntriesMetadata and, for options.mediaFields, QueryEntriesMediaInfo. Saves the
+// updated index when something changed. False when the folder cannot be listed.
+bool ListDirectoryIndexed(IFileSystem& fs, const std::wstring& folder, std::vector<FileEntry>& entries,
+    const FolderIndexOptions& options = FolderIndexOptions(), FolderIndexStats* stats = nullptr);
+
+// Where the index of folder is kept: %LOCALAPPDATA%\NewFolderFromFiles\index\<hash>.idx,
+// $XDG_CACHE_HOME (~/.cache)/NewFolderFromFiles/index/<hash>.idx elsewhere
+std::wstring GetFolderIndexPath(const std::wstring& folder);
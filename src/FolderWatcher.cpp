@@ -0,0 +1,199 @@
+#include "FolderWatcher.h"
+#include "OrganizePlanner.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include "FileSystem.h"
+#include <cerrno>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <unordered_map>
+#endif
+
+#ifdef _WIN32
+
+struct WatchedFolder
+{
+    std::wstring path;
+    HANDLE hDir = INVALID_HANDLE_VALUE;
+    OVERLAPPED ov = {};
+    std::vector<DWORD> buffer = std::vector<DWORD>(16 * 1024);  // 64 KB, DWORD aligned
+};
+
+struct FolderWatcher::Impl
+{
+    std::vector<std::unique_ptr<WatchedFolder>> folders;
+};
+
+static bool IssueRead(WatchedFolder& folder)
+{
+    ResetEvent(folder.ov.hEvent);
+    return ReadDirectoryChangesW(folder.hDir, folder.buffer.data(), static_cast<DWORD>(folder.buffer.size() * sizeof(DWORD)),
+        FALSE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE,
+        nullptr, &folder.ov, nullptr) != FALSE;
+}
+
+FolderWatcher::FolderWatcher() : m_impl(new Impl)
+{
+}
+
+FolderWatcher::~FolderWatcher()
+{
+    for (auto& folder : m_impl->folders)
+    {
+        CancelIoEx(folder->hDir, &folder->ov);
+        CloseHandle(folder->hDir);
+        CloseHandle(folder->ov.hEvent);
+    }
+}
+
+bool FolderWatcher::AddFolder(const std::wstring& path)
+{
+    if (m_impl->folders.size() >= MAXIMUM_WAIT_OBJECTS)
+        return false;
+
+    auto folder = std::make_unique<WatchedFolder>();
+    folder->path = path;
+    folder->hDir = CreateFileW(path.c_str(), FILE_LIST_DIRECTORY,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+        FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+    if (folder->hDir == INVALID_HANDLE_VALUE)
+        return false;
+
+    folder->ov.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (!folder->ov.hEvent || !IssueRead(*folder))
+    {
+        if (folder->ov.hEvent) CloseHandle(folder->ov.hEvent);
+        CloseHandle(folder->hDir);
+        return false;
+    }
+
+    m_impl->folders.push_back(std::move(folder));
+    return true;
+}
+
+bool FolderWatcher::Poll(int timeoutMs, std::vector<std::wstring>& changed, std::vector<std::wstring>& overflowed)
+{
+    std::vector<HANDLE> events;
+    for (auto& folder : m_impl->folders)
+        events.push_back(folder->ov.hEvent);
+    if (events.empty())
+        return false;
+
+    DWORD wait = WaitForMultipleObjects(static_cast<DWORD>(events.size()), events.data(), FALSE,
+        timeoutMs < 0 ? INFINITE : static_cast<DWORD>(timeoutMs));
+    if (wait == WAIT_TIMEOUT)
+        return true;
+    if (wait >= WAIT_OBJECT_0 + events.size())
+        return false;
+
+    // Drain every folder that is ready, not just the first one
+    for (auto& folder : m_impl->folders)
+    {
+        if (WaitForSingleObject(folder->ov.hEvent, 0) != WAIT_OBJECT_0)
+            continue;
+
+        DWORD bytes = 0;
+        if (!GetOverlappedResult(folder->hDir, &folder->ov, &bytes, FALSE) || bytes == 0)
+        {
+            overflowed.push_back(folder->path);
+        }
+        else
+        {
+            const BYTE* p = reinterpret_cast<const BYTE*>(folder->buffer.data());
+            for (;;)
+            {
+                const FILE_NOTIFY_INFORMATION* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(p);
+                if (info->Action == FILE_ACTION_ADDED || info->Action == FILE_ACTION_MODIFIED ||
+                    info->Action == FILE_ACTION_RENAMED_NEW_NAME)
+                {
+                    std::wstring name(info->FileName, info->FileNameLength / sizeof(wchar_t));
+                    changed.push_back(JoinPath(folder->path, name));
+                }
+                if (info->NextEntryOffset == 0)
+                    break;
+                p += info->NextEntryOffset;
+            }
+        }
+
+        if (!IssueRead(*folder))
+            return false;
+    }
+
+    return true;
+}
+
+#else
+
+struct FolderWatcher::Impl
+{
+    int fd = -1;
+    std::unordered_map<int, std::wstring> folders;
+    std::vector<char> buffer = std::vector<char>(256 * 1024);
+};
+
+FolderWatcher::FolderWatcher() : m_impl(new Impl)
+{
+    m_impl->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+}
+
+FolderWatcher::~FolderWatcher()
+{
+    if (m_impl->fd >= 0)
+        close(m_impl->fd);
+}
+
+bool FolderWatcher::AddFolder(const std::wstring& path)
+{
+    if (m_impl->fd < 0)
+        return false;
+
+    int wd = inotify_add_watch(m_impl->fd, ToNativePath(path).c_str(),
+        IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR);
+    if (wd < 0)
+        return false;
+
+    m_impl->folders[wd] = path;
+    return true;
+}
+
+bool FolderWatcher::Poll(int timeoutMs, std::vector<std::wstring>& changed, std::vector<std::wstring>& overflowed)
+{
+    struct pollfd pfd = { m_impl->fd, POLLIN, 0 };
+    int ready = poll(&pfd, 1, timeoutMs);
+    if (ready < 0)
+        return errno == EINTR;
+    if (ready == 0)
+        return true;
+
+    // Read until the queue is empty so bursts are handled in one call
+    for (;;)
+    {
+        ssize_t length = read(m_impl->fd, m_impl->buffer.data(), m_impl->buffer.size());
+        if (length < 0)
+            return errno == EAGAIN || errno == EINTR;
+
+        for (ssize_t offset = 0; offset < length;)
+        {
+            const struct inotify_event* ev = reinterpret_cast<const struct inotify_event*>(m_impl->buffer.data() + offset);
+            offset += sizeof(struct inotify_event) + ev->len;
+
+            if (ev->mask & IN_Q_OVERFLOW)
+            {
+                for (const auto& [wd, folder] : m_impl->folders)
+                    overflowed.push_back(folder);
+                continue;
+            }
+            if ((ev->mask & IN_ISDIR) || ev->len == 0)
+                continue;
+
+            auto it = m_impl->folders.find(ev->wd);
+            if (it != m_impl->folders.end())
+                changed.push_back(JoinPath(it->second, FromNativePath(ev->name)));
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,27 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+
+// Non-recursive change notifications for a set of folders
+// (inotify on Linux, ReadDirectoryChangesW on Windows).
+class FolderWatcher
+{
+public:
+    FolderWatcher();
+    ~FolderWatcher();
+
+    FolderWatcher(const FolderWatcher&) = delete;
+    FolderWatcher& operator=(const FolderWatcher&) = delete;
+
+    bool AddFolder(const std::wstring& folder);
+
+    // Waits up to timeoutMs (-1 = forever) and appends the full paths of files
+    // that were created, written or moved in. Folders whose kernel queue
+    // overflowed are reported in overflowed; the caller must rescan them once.
+    bool Poll(int timeoutMs, std::vector<std::wstring>& changed, std::vector<std::wstring>& overflowed);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+};
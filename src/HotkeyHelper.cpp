@@ -8,6 +8,9 @@
 #include <strsafe.h>
 #include <Shlwapi.h>
 #include <map>
+#include "OrganizePlanner.h"
+#include "OrganizeExecutor.h"
+#include "Metrics.h"
 
 #pragma comment(lib, "Shell32.lib")
 #pragma comment(lib, "Ole32.lib")
@@ -16,6 +19,7 @@
 #define HOTKEY_FOLDER 1
 #define HOTKEY_CENTER 2
 #define WM_TRAYICON (WM_USER + 1)
+#define TIMER_METRICS 1
 
 NOTIFYICONDATAW g_nid = {};
 HWND g_hwnd = nullptr;
@@ -28,6 +32,30 @@ std::map<HWND, CenterMode> g_windowCenterState;
 std::map<HWND, RECT> g_windowLastRect;      // Position after last center operation
 std::map<HWND, RECT> g_windowOriginalRect;  // Original position before any centering
 
+// Per-phase latency and per-operation file counts, kept across restarts; read with NewFolderFromFilesMetrics
+MetricsStore g_metrics;
+std::wstring g_metricsPath;
+const UINT METRICS_FLUSH_MS = 10 * 60 * 1000;
+
+void RecordMetric(OrganizeMode mode, const char* phase, uint64_t value, MetricUnit unit = MetricUnit::Microseconds)
+{
+    g_metrics.Record(std::string(GetOrganizeModeName(mode)) + "/" + phase, value, unit);
+}
+
+void CountMetric(OrganizeMode mode, const char* counter, uint64_t delta = 1)
+{
+    g_metrics.Add(std::string(GetOrganizeModeName(mode)) + "/" + counter, delta);
+}
+
+void FlushMetrics()
+{
+    if (!g_metrics.Dirty() || g_metricsPath.empty())
+        return;
+    LocalFileSystem fs;
+    fs.CreateFolder(PathParent(g_metricsPath));
+    g_metrics.Save(g_metricsPath);
+}
+
 // Settings stored in registry
 const wchar_t* REG_KEY = L"Software\\NewFolderFromFiles";
 const wchar_t* REG_FOLDER_ENABLED = L"FolderHotkeyEnabled";
@@ -75,67 +103,56 @@ void UpdateHotkeys()
         RegisterHotKey(g_hwnd, HOTKEY_CENTER, MOD_CONTROL | MOD_ALT, 'C');
 }
 
-std::wstring GenerateUniqueFolderName(const std::wstring& parentFolder, const std::wstring& baseName)
-{
-    std::wstring folderPath = parentFolder + L"\\" + baseName;
-    
-    if (!PathFileExistsW(folderPath.c_str()))
-        return folderPath;
-
-    for (int i = 2; i < 1000; i++)
-    {
-        wchar_t buffer[32];
-        StringCchPrintfW(buffer, 32, L" (%d)", i);
-        folderPath = parentFolder + L"\\" + baseName + buffer;
-        
-        if (!PathFileExistsW(folderPath.c_str()))
-            return folderPath;
-    }
-
-    return parentFolder + L"\\New Folder";
-}
-
-std::wstring GetCommonPrefix(const std::vector<std::wstring>& files)
+// Counts the items IFileOperation really moved; a queued MoveItem can still fail or be cancelled.
+// Lives on the caller's stack for one PerformOperations, between Advise and Unadvise.
+class MoveCounter : public IFileOperationProgressSink
 {
-    if (files.empty())
-        return L"New Folder";
+public:
+    size_t moved = 0;
 
-    std::vector<std::wstring> names;
-    for (const auto& path : files)
+    IFACEMETHODIMP QueryInterface(REFIID riid, void** ppv)
     {
-        wchar_t name[MAX_PATH];
-        StringCchCopyW(name, MAX_PATH, PathFindFileNameW(path.c_str()));
-        PathRemoveExtensionW(name);
-        names.push_back(name);
-    }
-
-    if (names.size() == 1)
-        return names[0];
-
-    std::wstring prefix = names[0];
-    for (size_t i = 1; i < names.size() && !prefix.empty(); i++)
-    {
-        size_t j = 0;
-        while (j < prefix.length() && j < names[i].length() && 
-               towlower(prefix[j]) == towlower(names[i][j]))
-            j++;
-        prefix = prefix.substr(0, j);
+        if (riid == IID_IUnknown || riid == IID_IFileOperationProgressSink)
+        {
+            *ppv = static_cast<IFileOperationProgressSink*>(this);
+            return S_OK;
+        }
+        *ppv = nullptr;
+        return E_NOINTERFACE;
     }
+    IFACEMETHODIMP_(ULONG) AddRef() { return 2; }
+    IFACEMETHODIMP_(ULONG) Release() { return 1; }
 
-    while (!prefix.empty())
+    IFACEMETHODIMP PostMoveItem(DWORD, IShellItem*, IShellItem*, LPCWSTR, HRESULT hrMove, IShellItem*)
     {
-        wchar_t last = prefix.back();
-        if (last == L' ' || last == L'_' || last == L'-' || last == L'.')
-            prefix.pop_back();
-        else
-            break;
+        if (SUCCEEDED(hrMove))
+            moved++;
+        return S_OK;
     }
 
-    return prefix.empty() ? L"New Folder" : prefix;
-}
+    IFACEMETHODIMP StartOperations() { return S_OK; }
+    IFACEMETHODIMP FinishOperations(HRESULT) { return S_OK; }
+    IFACEMETHODIMP PreRenameItem(DWORD, IShellItem*, LPCWSTR) { return S_OK; }
+    IFACEMETHODIMP PostRenameItem(DWORD, IShellItem*, LPCWSTR, HRESULT, IShellItem*) { return S_OK; }
+    IFACEMETHODIMP PreMoveItem(DWORD, IShellItem*, IShellItem*, LPCWSTR) { return S_OK; }
+    IFACEMETHODIMP PreCopyItem(DWORD, IShellItem*, IShellItem*, LPCWSTR) { return S_OK; }
+    IFACEMETHODIMP PostCopyItem(DWORD, IShellItem*, IShellItem*, LPCWSTR, HRESULT, IShellItem*) { return S_OK; }
+    IFACEMETHODIMP PreDeleteItem(DWORD, IShellItem*) { return S_OK; }
+    IFACEMETHODIMP PostDeleteItem(DWORD, IShellItem*, HRESULT, IShellItem*) { return S_OK; }
+    IFACEMETHODIMP PreNewItem(DWORD, IShellItem*, LPCWSTR) { return S_OK; }
+    IFACEMETHODIMP PostNewItem(DWORD, IShellItem*, LPCWSTR, LPCWSTR, DWORD, HRESULT, IShellItem*) { return S_OK; }
+    IFACEMETHODIMP UpdateProgress(UINT, UINT) { return S_OK; }
+    IFACEMETHODIMP ResetTimer() { return S_OK; }
+    IFACEMETHODIMP PauseTimer() { return S_OK; }
+    IFACEMETHODIMP ResumeTimer() { return S_OK; }
+};
 
 void NewFolderFromSelection()
 {
+    MetricsStopwatch stopwatch;
+    size_t movedFiles = 0;
+    bool found = false;
+
     CoInitialize(nullptr);
 
     CComPtr<IShellWindows> pShellWindows;
@@ -224,6 +241,8 @@ void NewFolderFromSelection()
         StringCchCopyW(parentPath, MAX_PATH, selectedFiles[0].c_str());
         PathRemoveFileSpecW(parentPath);
         parentFolder = parentPath;
+        found = true;
+        RecordMetric(OrganizeMode::Default, "find", stopwatch.Lap());
 
         CComPtr<IFileOperation> pFileOp;
         if (FAILED(pFileOp.CoCreateInstance(CLSID_FileOperation)))
@@ -231,16 +250,19 @@ void NewFolderFromSelection()
 
         pFileOp->SetOperationFlags(FOF_ALLOWUNDO | FOF_NOCONFIRMMKDIR | FOFX_ADDUNDORECORD);
 
+        LocalFileSystem fs;
         std::wstring folderName = GetCommonPrefix(selectedFiles);
-        std::wstring folderPath = GenerateUniqueFolderName(parentFolder, folderName);
+        std::wstring folderPath = GenerateUniqueFolderPath(fs, parentFolder, folderName);
         folderName = PathFindFileNameW(folderPath.c_str());
+        RecordMetric(OrganizeMode::Default, "naming", stopwatch.Lap());
 
         CComPtr<IShellItem> pParentItem;
         if (FAILED(SHCreateItemFromParsingName(parentFolder.c_str(), nullptr, IID_PPV_ARGS(&pParentItem))))
             break;
 
         pFileOp->NewItem(pParentItem, FILE_ATTRIBUTE_DIRECTORY, folderName.c_str(), nullptr, nullptr);
-        pFileOp->PerformOperations();
+        if (FAILED(pFileOp->PerformOperations()))
+            CountMetric(OrganizeMode::Default, "failures");
 
         CComPtr<IFileOperation> pMoveOp;
         if (FAILED(pMoveOp.CoCreateInstance(CLSID_FileOperation)))
@@ -252,6 +274,7 @@ void NewFolderFromSelection()
         CComPtr<IShellItem> pDestFolder;
         if (FAILED(SHCreateItemFromParsingName(folderPath.c_str(), nullptr, IID_PPV_ARGS(&pDestFolder))))
             break;
+        RecordMetric(OrganizeMode::Default, "create", stopwatch.Lap());
 
         for (const auto& file : selectedFiles)
         {
@@ -260,7 +283,18 @@ void NewFolderFromSelection()
                 pMoveOp->MoveItem(pItem, pDestFolder, nullptr, nullptr);
         }
 
-        pMoveOp->PerformOperations();
+        // Only moves the operation reports as done count as files
+        MoveCounter counter;
+        DWORD cookie = 0;
+        bool advised = SUCCEEDED(pMoveOp->Advise(&counter, &cookie));
+        if (FAILED(pMoveOp->PerformOperations()))
+            CountMetric(OrganizeMode::Default, "failures");
+        if (advised)
+        {
+            pMoveOp->Unadvise(cookie);
+            movedFiles = counter.moved;
+        }
+        RecordMetric(OrganizeMode::Default, "move", stopwatch.Lap());
 
         PIDLIST_ABSOLUTE pidlFolder = ILCreateFromPathW(folderPath.c_str());
         if (pidlFolder)
@@ -269,15 +303,28 @@ void NewFolderFromSelection()
             pShellView->SelectItem(pidlChild, SVSI_SELECT | SVSI_DESELECTOTHERS | SVSI_ENSUREVISIBLE | SVSI_FOCUSED | SVSI_EDIT);
             ILFree(pidlFolder);
         }
+        RecordMetric(OrganizeMode::Default, "select", stopwatch.Lap());
 
         break;
     }
 
     CoUninitialize();
+
+    // Presses with nothing selected only count; their latency would drown the real ones
+    if (!found)
+    {
+        CountMetric(OrganizeMode::Default, "empty");
+        return;
+    }
+    RecordMetric(OrganizeMode::Default, "total", stopwatch.Total());
+    RecordMetric(OrganizeMode::Default, "files", movedFiles, MetricUnit::Count);
+    CountMetric(OrganizeMode::Default, "runs");
+    CountMetric(OrganizeMode::Default, "files", movedFiles);
 }
 
 void CenterActiveWindow()
 {
+    MetricsStopwatch stopwatch;
     HWND hwnd = GetForegroundWindow();
     if (!hwnd || hwnd == g_hwnd)
         return;
@@ -373,6 +420,7 @@ void CenterActiveWindow()
     // Save state and new rect
     g_windowCenterState[hwnd] = nextMode;
     GetWindowRect(hwnd, &g_windowLastRect[hwnd]);
+    g_metrics.Record("center/total", stopwatch.Total());
 }
 
 void ShowContextMenu(HWND hwnd, POINT pt)
@@ -401,6 +449,7 @@ void ShowContextMenu(HWND hwnd, POINT pt)
         UpdateHotkeys();
         break;
     case 3:
+        FlushMetrics();
         Shell_NotifyIconW(NIM_DELETE, &g_nid);
         PostQuitMessage(0);
         break;
@@ -418,6 +467,16 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
             CenterActiveWindow();
         return 0;
 
+    case WM_TIMER:
+        if (wParam == TIMER_METRICS)
+            FlushMetrics();
+        return 0;
+
+    case WM_ENDSESSION:
+        if (wParam)
+            FlushMetrics();
+        return 0;
+
     case WM_TRAYICON:
         if (lParam == WM_RBUTTONUP || lParam == WM_LBUTTONUP)
         {
@@ -428,6 +487,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
         return 0;
 
     case WM_DESTROY:
+        FlushMetrics();
         Shell_NotifyIconW(NIM_DELETE, &g_nid);
         PostQuitMessage(0);
         return 0;
@@ -446,6 +506,9 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, LPWSTR, int)
     }
 
     LoadSettings();
+    g_metricsPath = GetDefaultMetricsPath();
+    if (!g_metricsPath.empty())
+        g_metrics.Load(g_metricsPath);
 
     WNDCLASSW wc = {};
     wc.lpfnWndProc = WndProc;
@@ -470,6 +533,7 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, LPWSTR, int)
     Shell_NotifyIconW(NIM_ADD, &g_nid);
 
     UpdateHotkeys();
+    SetTimer(g_hwnd, TIMER_METRICS, METRICS_FLUSH_MS, nullptr);
 
     MSG msg;
     while (GetMessageW(&msg, nullptr, 0, 0))
@@ -478,6 +542,8 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, LPWSTR, int)
         DispatchMessageW(&msg);
     }
 
+    FlushMetrics();
+    KillTimer(g_hwnd, TIMER_METRICS);
     UnregisterHotKey(g_hwnd, HOTKEY_FOLDER);
     UnregisterHotKey(g_hwnd, HOTKEY_CENTER);
     if (g_nid.hIcon) DestroyIcon(g_nid.hIcon);
@@ -0,0 +1,227 @@
+#include "IoUring.h"
+
+#ifndef _WIN32
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+static int SysSetup(unsigned entries, io_uring_params* params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int SysEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+static int SysRegister(int fd, unsigned opcode, void* arg, unsigned count)
+{
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+// Asked once per process: older kernels have the ring but not these opcodes
+static bool SupportsPathOps(int fd)
+{
+    static std::atomic<int> supported(-1);
+    int known = supported.load();
+    if (known >= 0)
+        return known != 0;
+
+    const unsigned kOps = 256;
+    std::vector<char> buffer(sizeof(io_uring_probe) + kOps * sizeof(io_uring_probe_op), 0);
+    io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+    bool ok = SysRegister(fd, IORING_REGISTER_PROBE, probe, kOps) == 0;
+    for (unsigned op : { IORING_OP_STATX, IORING_OP_MKDIRAT, IORING_OP_RENAMEAT })
+        ok = ok && op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+    supported = ok ? 1 : 0;
+    return ok;
+}
+
+IoUring::IoUring(unsigned depth)
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = SysSetup(depth, &params);
+    if (fd < 0)
+        return;
+
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single)
+        m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+    m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+    void* sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    void* cqRing = single ? sqRing : mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    void* sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    m_sqRing = sqRing == MAP_FAILED ? nullptr : sqRing;
+    m_cqRing = cqRing == MAP_FAILED ? nullptr : cqRing;
+    m_sqes = sqes == MAP_FAILED ? nullptr : static_cast<io_uring_sqe*>(sqes);
+    m_fd = fd;
+    if (!m_sqRing || !m_cqRing || !m_sqes || !SupportsPathOps(fd))
+    {
+        Release();
+        return;
+    }
+
+    char* sq = static_cast<char*>(m_sqRing);
+    char* cq = static_cast<char*>(m_cqRing);
+    m_sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    m_sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    m_sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    m_sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    m_cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    m_cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    m_cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    m_cqes = cq + params.cq_off.cqes;
+    // The completion queue is at least as large, so completions never overflow
+    m_depth = params.sq_entries;
+}
+
+IoUring::~IoUring()
+{
+    Release();
+}
+
+void IoUring::Release()
+{
+    if (m_sqes)
+        munmap(m_sqes, m_sqesSize);
+    if (m_cqRing && m_cqRing != m_sqRing)
+        munmap(m_cqRing, m_cqRingSize);
+    if (m_sqRing)
+        munmap(m_sqRing, m_sqRingSize);
+    if (m_fd >= 0)
+        close(m_fd);
+    m_sqes = nullptr;
+    m_sqRing = m_cqRing = nullptr;
+    m_fd = -1;
+}
+
+size_t IoUring::Run(size_t count, const std::function<void(size_t, unsigned, io_uring_sqe&)>& prepare,
+    const std::function<void(size_t, unsigned, int)>& complete)
+{
+    if (!IsReady())
+        return 0;
+
+    std::vector<unsigned> freeSlots(m_depth);
+    std::vector<size_t> slotOp(m_depth);
+    std::vector<bool> busy(m_depth, false);
+    for (unsigned s = 0; s < m_depth; s++)
+        freeSlots[s] = m_depth - 1 - s;
+
+    io_uring_cqe* cqes = static_cast<io_uring_cqe*>(m_cqes);
+    auto reap = [&]() {
+        unsigned head = *m_cqHead;
+        for (unsigned cqTail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE); head != cqTail; head++)
+        {
+            unsigned slot = static_cast<unsigned>(cqes[head & m_cqMask].user_data);
+            int result = cqes[head & m_cqMask].res;
+            busy[slot] = false;
+            freeSlots.push_back(slot);
+            complete(slotOp[slot], slot, result);
+        }
+        __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+    };
+
+    unsigned tail = *m_sqTail;
+    size_t next = 0;
+    while (next < count || freeSlots.size() < m_depth)
+    {
+        // Refill every free slot, then publish the new tail
+        while (next < count && !freeSlots.empty())
+        {
+            unsigned slot = freeSlots.back();
+            freeSlots.pop_back();
+            unsigned index = tail & m_sqMask;
+            io_uring_sqe& sqe = m_sqes[index];
+            memset(&sqe, 0, sizeof(sqe));
+            prepare(next, slot, sqe);
+            sqe.user_data = slot;
+            slotOp[slot] = next++;
+            busy[slot] = true;
+            m_sqArray[index] = index;
+            tail++;
+        }
+        __atomic_store_n(m_sqTail, tail, __ATOMIC_RELEASE);
+
+        // Whatever the kernel has not consumed yet goes with this call, which returns once
+        // half the ring is free again (or everything is done), not at the first completion
+        unsigned toSubmit = tail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+        unsigned inFlight = m_depth - static_cast<unsigned>(freeSlots.size());
+        unsigned wait = next < count ? std::max(1u, inFlight > m_depth / 2 ? inFlight - m_depth / 2 : 1u) : inFlight;
+        m_enters++;
+        if (SysEnter(m_fd, toSubmit, wait, IORING_ENTER_GETEVENTS) >= 0 || errno == EINTR || errno == EAGAIN || errno == EBUSY)
+        {
+            reap();
+            continue;
+        }
+
+        // The ring failed. Entries the kernel never took are withdrawn (they are the
+        // newest operations). The ones it took may still run and write into the caller's
+        // buffers, so each is waited for and reported with its real result: through
+        // io_uring_enter while it works, else by watching the completion queue, which the
+        // kernel keeps filling (each sleep also runs any completion work it queued for us).
+        unsigned consumed = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+        for (unsigned index = consumed; index != tail; index++)
+        {
+            unsigned slot = static_cast<unsigned>(m_sqes[index & m_sqMask].user_data);
+            busy[slot] = false;
+            freeSlots.push_back(slot);
+            next--;
+        }
+        __atomic_store_n(m_sqTail, consumed, __ATOMIC_RELEASE);
+        bool entering = true;
+        while (freeSlots.size() < m_depth)
+        {
+            if (entering)
+            {
+                m_enters++;
+                if (SysEnter(m_fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                    entering = false;
+            }
+            else
+            {
+                struct timespec pause = { 0, 1000000 };
+                nanosleep(&pause, nullptr);
+            }
+            reap();
+        }
+
+        // Nothing is in flight any more; later batches take the plain calls
+        Release();
+        return next;
+    }
+    return count;
+}
+
+#else
+
+IoUring::IoUring(unsigned)
+{
+}
+
+IoUring::~IoUring()
+{
+}
+
+void IoUring::Release()
+{
+}
+
+size_t IoUring::Run(size_t, const std::function<void(size_t, unsigned, io_uring_sqe&)>&,
+    const std::function<void(size_t, unsigned, int)>&)
+{
+    return 0;
+}
+
+#endif
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// A minimal io_uring over the raw system calls, for batches of independent path
+// operations (statx, mkdirat, renameat). Up to depth operations are in flight at once;
+// each io_uring_enter submits what was queued and waits for at least one completion, so
+// a batch of N operations costs about N / depth transitions instead of N. The kernel runs
+// the blocking lookups on its own worker threads.
+//
+// Linux only; elsewhere no ring is ever ready.
+
+struct io_uring_sqe;
+
+class IoUring
+{
+public:
+    explicit IoUring(unsigned depth);
+    ~IoUring();
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    // The ring exists and the kernel runs statx, mkdirat and renameat through it (5.11+).
+    // false when io_uring is missing or disabled (kernel.io_uring_disabled, seccomp).
+    bool IsReady() const { return m_fd >= 0; }
+
+    unsigned Depth() const { return m_depth; }
+
+    // Runs operations 0 .. count-1. prepare fills the entry for an operation; slot
+    // (< Depth()) is its own until complete is called for it with the result (0 or a
+    // negative errno), in completion order. Returns how many operations were submitted:
+    // less than count only when the ring failed, and the rest never ran. Every submitted
+    // operation has completed when Run returns, so its buffers may be freed; a failed
+    // ring is closed (IsReady turns false).
+    size_t Run(size_t count, const std::function<void(size_t op, unsigned slot, io_uring_sqe& sqe)>& prepare,
+        const std::function<void(size_t op, unsigned slot, int result)>& complete);
+
+    // io_uring_enter calls made so far
+    uint64_t Enters() const { return m_enters; }
+
+private:
+    void Release();
+
+    int m_fd = -1;
+    unsigned m_depth = 0;
+    uint64_t m_enters = 0;
+
+    void* m_sqRing = nullptr;
+    size_t m_sqRingSize = 0;
+    void* m_cqRing = nullptr;
+    size_t m_cqRingSize = 0;
+    io_uring_sqe* m_sqes = nullptr;
+    size_t m_sqesSize = 0;
+
+    unsigned* m_sqHead = nullptr;
+    unsigned* m_sqTail = nullptr;
+    unsigned m_sqMask = 0;
+    unsigned* m_sqArray = nullptr;
+    unsigned* m_cqHead = nullptr;
+    unsigned* m_cqTail = nullptr;
+    unsigned m_cqMask = 0;
+    void* m_cqes = nullptr;
+};
@@ -0,0 +1,87 @@
+#include "JobQueue.h"
+
+JobQueue::JobQueue(ThreadHooks hooks, std::chrono::milliseconds idleTimeout)
+    : m_hooks(std::move(hooks)), m_idleTimeout(idleTimeout)
+{
+}
+
+JobQueue::~JobQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    if (m_worker.joinable())
+        m_worker.join();
+}
+
+void JobQueue::Post(std::function<void()> job)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_jobs.push_back(std::move(job));
+    if (m_workerAlive)
+    {
+        m_wake.notify_one();
+        return;
+    }
+
+    // The previous worker timed out and has left its loop; at most its exit hook is still running
+    if (m_worker.joinable())
+        m_worker.join();
+    m_workerAlive = true;
+    m_worker = std::thread(&JobQueue::WorkerMain, this);
+}
+
+void JobQueue::Drain()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this]() { return m_jobs.empty() && m_running == 0; });
+}
+
+size_t JobQueue::Pending() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_jobs.size() + m_running;
+}
+
+void JobQueue::WorkerMain()
+{
+    if (m_hooks.start)
+        m_hooks.start();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        if (m_jobs.empty())
+        {
+            m_idle.notify_all();
+            if (m_stopping)
+                break;
+            if (!m_wake.wait_for(lock, m_idleTimeout, [this]() { return !m_jobs.empty() || m_stopping; }))
+                break;
+            continue;
+        }
+
+        std::function<void()> job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+        m_running++;
+        lock.unlock();
+        // A failing job must not take the host process (Explorer) down with it
+        try
+        {
+            job();
+        }
+        catch (...)
+        {
+        }
+        job = nullptr;
+        lock.lock();
+        m_running--;
+    }
+    m_workerAlive = false;
+    lock.unlock();
+
+    if (m_hooks.exit)
+        m_hooks.exit();
+}
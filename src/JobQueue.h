@@ -0,0 +1,48 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Runs posted jobs one at a time, in order, on a worker thread of its own, so the caller
+// (Explorer's UI thread) returns at once. The worker starts with the first job and exits
+// after idleTimeout without work; the hooks run on it at start and exit (COM apartment).
+class JobQueue
+{
+public:
+    struct ThreadHooks
+    {
+        std::function<void()> start;
+        std::function<void()> exit;
+    };
+
+    explicit JobQueue(ThreadHooks hooks = ThreadHooks(),
+        std::chrono::milliseconds idleTimeout = std::chrono::milliseconds(30000));
+    // Runs what is still queued, then joins the worker
+    ~JobQueue();
+
+    JobQueue(const JobQueue&) = delete;
+    JobQueue& operator=(const JobQueue&) = delete;
+
+    void Post(std::function<void()> job);
+    // Blocks until every job posted so far has finished
+    void Drain();
+    // Queued plus running
+    size_t Pending() const;
+
+private:
+    void WorkerMain();
+
+    ThreadHooks m_hooks;
+    std::chrono::milliseconds m_idleTimeout;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+    std::deque<std::function<void()>> m_jobs;
+    size_t m_running = 0;
+    bool m_workerAlive = false;
+    bool m_stopping = false;
+    std::thread m_worker;
+};
@@ -0,0 +1,731 @@
+#include "MediaMetadata.h"
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+HeaderCursor::HeaderCursor(IFileReader& reader, size_t budget)
+    : m_reader(reader), m_size(reader.Size()), m_budget(budget)
+{
+}
+
+const uint8_t* HeaderCursor::Fetch(uint64_t offset, size_t length)
+{
+    if (offset > m_size || length > m_size - offset)
+        return nullptr;
+
+    if (offset >= m_windowOffset && offset + length <= m_windowOffset + m_window.size())
+        return m_window.data() + (offset - m_windowOffset);
+
+    size_t want = length > kWindow ? length : kWindow;
+    if (want > m_size - offset)
+        want = static_cast<size_t>(m_size - offset);
+    if (m_bytesRead + want > m_budget)
+    {
+        // Out of budget for a full window; the exact bytes may still fit
+        want = length;
+        if (m_bytesRead + want > m_budget)
+            return nullptr;
+    }
+
+    m_window.resize(want);
+    size_t read = 0;
+    if (m_reader.Read(offset, m_window.data(), want, read) != FsResult::Ok || read < length)
+    {
+        m_window.clear();
+        return nullptr;
+    }
+    m_window.resize(read);
+    m_windowOffset = offset;
+    m_bytesRead += read;
+    return m_window.data();
+}
+
+static uint16_t Be16(const uint8_t* p) { return static_cast<uint16_t>(p[0] << 8 | p[1]); }
+static uint32_t Be32(const uint8_t* p) { return static_cast<uint32_t>(p[0]) << 24 | p[1] << 16 | p[2] << 8 | p[3]; }
+static uint16_t Le16(const uint8_t* p) { return static_cast<uint16_t>(p[1] << 8 | p[0]); }
+static uint32_t Le32(const uint8_t* p) { return static_cast<uint32_t>(p[3]) << 24 | p[2] << 16 | p[1] << 8 | p[0]; }
+static uint32_t Le24(const uint8_t* p) { return static_cast<uint32_t>(p[2]) << 16 | p[1] << 8 | p[0]; }
+
+// EXIF orientations 5-8 are rotated by 90 degrees
+static void ApplyOrientation(uint16_t orientation, uint32_t& width, uint32_t& height)
+{
+    if (orientation >= 5 && orientation <= 8)
+        std::swap(width, height);
+}
+
+// IFD0 of a TIFF structure starting at base: size and orientation tags
+static bool ReadTiffIfd(HeaderCursor& cursor, uint64_t base, uint32_t& width, uint32_t& height, uint16_t& orientation)
+{
+    const uint8_t* header = cursor.Fetch(base, 8);
+    if (!header)
+        return false;
+
+    bool little = header[0] == 'I' && header[1] == 'I';
+    if (!little && !(header[0] == 'M' && header[1] == 'M'))
+        return false;
+    auto u16 = [little](const uint8_t* p) { return little ? Le16(p) : Be16(p); };
+    auto u32 = [little](const uint8_t* p) { return little ? Le32(p) : Be32(p); };
+    if (u16(header + 2) != 42)
+        return false;
+
+    uint64_t ifd = base + u32(header + 4);
+    const uint8_t* countBytes = cursor.Fetch(ifd, 2);
+    if (!countBytes)
+        return false;
+    uint16_t count = u16(countBytes);
+    if (count > 512)
+        return false;
+
+    const uint8_t* entries = cursor.Fetch(ifd + 2, static_cast<size_t>(count) * 12);
+    if (!entries)
+        return false;
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+        const uint8_t* entry = entries + i * 12;
+        uint16_t tag = u16(entry);
+        uint16_t type = u16(entry + 2);
+        // SHORT values sit in the first two bytes of the value field
+        uint32_t value = type == 3 ? u16(entry + 8) : u32(entry + 8);
+        if (tag == 0x0100)
+            width = value;
+        else if (tag == 0x0101)
+            height = value;
+        else if (tag == 0x0112)
+            orientation = static_cast<uint16_t>(value);
+    }
+    return true;
+}
+
+static bool ReadJpegSize(HeaderCursor& cursor, uint32_t& width, uint32_t& height)
+{
+    uint16_t orientation = 1;
+    uint64_t pos = 2;
+    for (int segments = 0; segments < 64; segments++)
+    {
+        const uint8_t* marker = cursor.Fetch(pos, 4);
+        if (!marker || marker[0] != 0xFF)
+            return false;
+
+        uint8_t type = marker[1];
+        if (type == 0xFF)
+        {
+            pos++;  // Fill byte
+            continue;
+        }
+        if (type == 0x01 || (type >= 0xD0 && type <= 0xD8))
+        {
+            pos += 2;  // No length
+            continue;
+        }
+        if (type == 0xDA || type == 0xD9)
+            return false;  // Scan data before any frame header
+
+        uint16_t length = Be16(marker + 2);
+        if (length < 2)
+            return false;
+
+        bool sof = type >= 0xC0 && type <= 0xCF && type != 0xC4 && type != 0xC8 && type != 0xCC;
+        if (sof)
+        {
+            const uint8_t* frame = cursor.Fetch(pos + 4, 5);
+            if (!frame)
+                return false;
+            height = Be16(frame + 1);
+            width = Be16(frame + 3);
+            ApplyOrientation(orientation, width, height);
+            return width && height;
+        }
+
+        if (type == 0xE1)
+        {
+            const uint8_t* exif = cursor.Fetch(pos + 4, 6);
+            if (exif && memcmp(exif, "Exif\0\0", 6) == 0)
+            {
+                uint32_t ignoredWidth = 0, ignoredHeight = 0;
+                ReadTiffIfd(cursor, pos + 10, ignoredWidth, ignoredHeight, orientation);
+            }
+        }
+
+        pos += 2 + length;
+    }
+    return false;
+}
+
+static bool ReadWebpSize(HeaderCursor& cursor, uint32_t& width, uint32_t& height)
+{
+    const uint8_t* chunk = cursor.Fetch(12, 18);
+    if (!chunk)
+        return false;
+
+    if (memcmp(chunk, "VP8 ", 4) == 0)
+    {
+        // Key frame: 3-byte tag, start code 9D 01 2A, then 14-bit sizes
+        const uint8_t* frame = chunk + 8;
+        if (frame[3] != 0x9D || frame[4] != 0x01 || frame[5] != 0x2A)
+            return false;
+        const uint8_t* size = cursor.Fetch(26, 4);
+        if (!size)
+            return false;
+        width = Le16(size) & 0x3FFF;
+        height = Le16(size + 2) & 0x3FFF;
+    }
+    else if (memcmp(chunk, "VP8L", 4) == 0)
+    {
+        const uint8_t* bits = chunk + 8;
+        if (bits[0] != 0x2F)
+            return false;
+        uint32_t packed = Le32(bits + 1);
+        width = (packed & 0x3FFF) + 1;
+        height = ((packed >> 14) & 0x3FFF) + 1;
+    }
+    else if (memcmp(chunk, "VP8X", 4) == 0)
+    {
+        width = Le24(chunk + 12) + 1;
+        height = Le24(chunk + 15) + 1;
+    }
+    else
+    {
+        return false;
+    }
+    return width && height;
+}
+
+bool ReadImageSize(HeaderCursor& cursor, uint32_t& width, uint32_t& height)
+{
+    width = height = 0;
+    size_t n = cursor.Size() < 32 ? static_cast<size_t>(cursor.Size()) : 32;
+    const uint8_t* h = cursor.Fetch(0, n);
+    if (!h || n < 8)
+        return false;
+
+    if (n >= 24 && memcmp(h, "\x89PNG\r\n\x1A\n", 8) == 0 && memcmp(h + 12, "IHDR", 4) == 0)
+    {
+        width = Be32(h + 16);
+        height = Be32(h + 20);
+    }
+    else if (h[0] == 0xFF && h[1] == 0xD8)
+    {
+        return ReadJpegSize(cursor, width, height);
+    }
+    else if (n >= 10 && (memcmp(h, "GIF87a", 6) == 0 || memcmp(h, "GIF89a", 6) == 0))
+    {
+        width = Le16(h + 6);
+        height = Le16(h + 8);
+    }
+    else if (n >= 26 && h[0] == 'B' && h[1] == 'M')
+    {
+        if (Le32(h + 14) == 12)
+        {
+            width = Le16(h + 18);
+            height = Le16(h + 20);
+        }
+        else
+        {
+            // Negative height marks a top-down bitmap
+            width = Le32(h + 18);
+            int32_t signedHeight = static_cast<int32_t>(Le32(h + 22));
+            height = static_cast<uint32_t>(signedHeight < 0 ? -static_cast<int64_t>(signedHeight) : signedHeight);
+        }
+    }
+    else if (n >= 12 && memcmp(h, "RIFF", 4) == 0 && memcmp(h + 8, "WEBP", 4) == 0)
+    {
+        return ReadWebpSize(cursor, width, height);
+    }
+    else if ((h[0] == 'I' && h[1] == 'I') || (h[0] == 'M' && h[1] == 'M'))
+    {
+        uint16_t orientation = 1;
+        if (!ReadTiffIfd(cursor, 0, width, height, orientation))
+            return false;
+        ApplyOrientation(orientation, width, height);
+    }
+    else
+    {
+        return false;
+    }
+    return width && height;
+}
+
+// ---------------------------------------------------------------------------
+// Audio tags
+
+static std::wstring DecodeLatin1(const uint8_t* p, size_t n)
+{
+    std::wstring text;
+    for (size_t i = 0; i < n && p[i]; i++)
+        text.push_back(static_cast<wchar_t>(p[i]));
+    return text;
+}
+
+static std::wstring DecodeUtf16(const uint8_t* p, size_t n, bool bigEndian)
+{
+    std::wstring text;
+    for (size_t i = 0; i + 1 < n; i += 2)
+    {
+        uint32_t unit = bigEndian ? Be16(p + i) : Le16(p + i);
+        if (unit == 0)
+            break;
+        // wchar_t is UTF-32 outside Windows: join surrogate pairs
+        if (sizeof(wchar_t) == 4 && unit >= 0xD800 && unit < 0xDC00 && i + 3 < n)
+        {
+            uint32_t low = bigEndian ? Be16(p + i + 2) : Le16(p + i + 2);
+            if (low >= 0xDC00 && low < 0xE000)
+            {
+                unit = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+                i += 2;
+            }
+        }
+        text.push_back(static_cast<wchar_t>(unit));
+    }
+    return text;
+}
+
+static std::wstring DecodeUtf8(const uint8_t* p, size_t n)
+{
+    size_t length = 0;
+    while (length < n && p[length])
+        length++;
+    return Utf8ToWide(reinterpret_cast<const char*>(p), length);
+}
+
+// ID3 text frame: encoding byte, then the first value
+static std::wstring DecodeId3Text(const uint8_t* p, size_t n)
+{
+    if (n < 2)
+        return std::wstring();
+    uint8_t encoding = p[0];
+    p++;
+    n--;
+    switch (encoding)
+    {
+    case 0:
+        return DecodeLatin1(p, n);
+    case 1:
+        if (p[0] == 0xFE && p[1] == 0xFF)
+            return DecodeUtf16(p + 2, n - 2, true);
+        if (p[0] == 0xFF && p[1] == 0xFE)
+            return DecodeUtf16(p + 2, n - 2, false);
+        return DecodeUtf16(p, n, false);
+    case 2:
+        return DecodeUtf16(p, n, true);
+    case 3:
+        return DecodeUtf8(p, n);
+    default:
+        return std::wstring();
+    }
+}
+
+static uint32_t SyncSafe32(const uint8_t* p)
+{
+    return static_cast<uint32_t>(p[0] & 0x7F) << 21 | (p[1] & 0x7F) << 14 | (p[2] & 0x7F) << 7 | (p[3] & 0x7F);
+}
+
+// Tag text longer than this is not a name (lyrics, pictures)
+static const uint32_t kMaxTagText = 1024;
+
+struct AudioTagSet
+{
+    std::wstring artist;
+    std::wstring albumArtist;
+    std::wstring album;
+
+    bool Complete() const { return !albumArtist.empty() && !album.empty(); }
+};
+
+// Offset just past the ID3v2 tag, 0 when there is none
+static uint64_t ReadId3v2(HeaderCursor& cursor, AudioTagSet& tags)
+{
+    const uint8_t* h = cursor.Fetch(0, 10);
+    if (!h || memcmp(h, "ID3", 3) != 0)
+        return 0;
+
+    uint8_t version = h[3];
+    uint8_t flags = h[5];
+    uint64_t end = 10 + static_cast<uint64_t>(SyncSafe32(h + 6));
+    if (flags & 0x10)
+        end += 10;  // Footer
+    // Tag-wide unsynchronisation (before 2.4) garbles frame headers; leave it to ID3v1
+    if (version < 2 || version > 4 || ((flags & 0x80) && version < 4))
+        return end;
+
+    uint64_t pos = 10;
+    if ((flags & 0x40) && version >= 3)
+    {
+        const uint8_t* ext = cursor.Fetch(pos, 4);
+        if (!ext)
+            return end;
+        pos += version == 4 ? SyncSafe32(ext) : Be32(ext) + 4;
+    }
+
+    size_t idLength = version == 2 ? 3 : 4;
+    size_t headerLength = version == 2 ? 6 : 10;
+    for (int frames = 0; frames < 512 && pos + headerLength <= end; frames++)
+    {
+        const uint8_t* f = cursor.Fetch(pos, headerLength);
+        if (!f || f[0] == 0)
+            break;  // Padding
+
+        uint32_t size = version == 2 ? (static_cast<uint32_t>(f[3]) << 16 | f[4] << 8 | f[5])
+            : version == 4 ? SyncSafe32(f + 4) : Be32(f + 4);
+        char id[5] = {};
+        memcpy(id, f, idLength);
+        // Compressed / encrypted (2.3) or any transformed frame (2.4)
+        bool transformed = (version == 3 && (f[9] & 0xC0)) || (version == 4 && (f[9] & 0x0F));
+
+        std::wstring* target = nullptr;
+        if (strcmp(id, "TPE1") == 0 || strcmp(id, "TP1") == 0)
+            target = &tags.artist;
+        else if (strcmp(id, "TPE2") == 0 || strcmp(id, "TP2") == 0)
+            target = &tags.albumArtist;
+        else if (strcmp(id, "TALB") == 0 || strcmp(id, "TAL") == 0)
+            target = &tags.album;
+
+        uint64_t data = pos + headerLength;
+        if (target && target->empty() && !transformed && size > 0 && size <= kMaxTagText)
+        {
+            if (const uint8_t* text = cursor.Fetch(data, size))
+                *target = DecodeId3Text(text, size);
+        }
+        if (tags.Complete())
+            break;
+        pos = data + size;
+    }
+    return end;
+}
+
+static void ReadId3v1(HeaderCursor& cursor, AudioTagSet& tags)
+{
+    if (cursor.Size() < 128)
+        return;
+    const uint8_t* t = cursor.Fetch(cursor.Size() - 128, 128);
+    if (!t || memcmp(t, "TAG", 3) != 0)
+        return;
+    // Fixed 30-byte fields, padded with NULs or spaces
+    auto field = [&](size_t offset)
+    {
+        std::wstring text = DecodeLatin1(t + offset, 30);
+        while (!text.empty() && text.back() == L' ')
+            text.pop_back();
+        return text;
+    };
+    if (tags.artist.empty())
+        tags.artist = field(33);
+    if (tags.album.empty())
+        tags.album = field(63);
+}
+
+// "KEY=value" with a case-insensitive key
+static bool MatchVorbisKey(const uint8_t* comment, size_t length, const char* key)
+{
+    size_t k = strlen(key);
+    if (length <= k || comment[k] != '=')
+        return false;
+    for (size_t i = 0; i < k; i++)
+    {
+        uint8_t c = comment[i];
+        if (c >= 'a' && c <= 'z')
+            c = static_cast<uint8_t>(c - 32);
+        if (c != static_cast<uint8_t>(key[i]))
+            return false;
+    }
+    return true;
+}
+
+static void ReadVorbisComments(HeaderCursor& cursor, uint64_t pos, uint64_t end, AudioTagSet& tags)
+{
+    const uint8_t* vendor = cursor.Fetch(pos, 4);
+    if (!vendor)
+        return;
+    pos += 4 + static_cast<uint64_t>(Le32(vendor));
+    const uint8_t* countBytes = cursor.Fetch(pos, 4);
+    if (!countBytes)
+        return;
+    uint32_t count = Le32(countBytes);
+    pos += 4;
+
+    for (uint32_t i = 0; i < count && i < 1024 && pos + 4 <= end; i++)
+    {
+        const uint8_t* lengthBytes = cursor.Fetch(pos, 4);
+        if (!lengthBytes)
+            return;
+        uint32_t length = Le32(lengthBytes);
+        uint64_t text = pos + 4;
+        pos = text + length;
+        if (length > kMaxTagText)
+            continue;  // Embedded pictures
+
+        const uint8_t* comment = cursor.Fetch(text, length);
+        if (!comment)
+            return;
+        if (tags.artist.empty() && MatchVorbisKey(comment, length, "ARTIST"))
+            tags.artist = Utf8ToWide(reinterpret_cast<const char*>(comment) + 7, length - 7);
+        else if (tags.albumArtist.empty() && MatchVorbisKey(comment, length, "ALBUMARTIST"))
+            tags.albumArtist = Utf8ToWide(reinterpret_cast<const char*>(comment) + 12, length - 12);
+        else if (tags.album.empty() && MatchVorbisKey(comment, length, "ALBUM"))
+            tags.album = Utf8ToWide(reinterpret_cast<const char*>(comment) + 6, length - 6);
+        if (tags.Complete())
+            return;
+    }
+}
+
+static void ReadFlacTags(HeaderCursor& cursor, uint64_t pos, AudioTagSet& tags)
+{
+    const uint8_t* magic = cursor.Fetch(pos, 4);
+    if (!magic || memcmp(magic, "fLaC", 4) != 0)
+        return;
+    pos += 4;
+
+    for (int blocks = 0; blocks < 64; blocks++)
+    {
+        const uint8_t* block = cursor.Fetch(pos, 4);
+        if (!block)
+            return;
+        bool last = (block[0] & 0x80) != 0;
+        uint8_t type = block[0] & 0x7F;
+        uint32_t length = static_cast<uint32_t>(block[1]) << 16 | block[2] << 8 | block[3];
+        if (type == 4)
+        {
+            ReadVorbisComments(cursor, pos + 4, pos + 4 + length, tags);
+            return;
+        }
+        if (last)
+            return;
+        pos += 4 + static_cast<uint64_t>(length);
+    }
+}
+
+// First child box of the given type in [start, end): payload offset and box end.
+// Only box headers are read; skipped boxes (mdat) cost nothing.
+static bool FindBox(HeaderCursor& cursor, uint64_t start, uint64_t end, const char* type, uint64_t& payload, uint64_t& boxEnd)
+{
+    uint64_t pos = start;
+    for (int boxes = 0; boxes < 512 && pos + 8 <= end; boxes++)
+    {
+        const uint8_t* h = cursor.Fetch(pos, 8);
+        if (!h)
+            return false;
+        uint64_t size = Be32(h);
+        bool match = memcmp(h + 4, type, 4) == 0;
+        uint64_t header = 8;
+        if (size == 1)
+        {
+            const uint8_t* large = cursor.Fetch(pos + 8, 8);
+            if (!large)
+                return false;
+            size = static_cast<uint64_t>(Be32(large)) << 32 | Be32(large + 4);
+            header = 16;
+        }
+        else if (size == 0)
+        {
+            size = end - pos;  // Extends to the end
+        }
+        if (size < header || size > end - pos)
+            return false;
+
+        if (match)
+        {
+            payload = pos + header;
+            boxEnd = pos + size;
+            return true;
+        }
+        pos += size;
+    }
+    return false;
+}
+
+// Payload of an ISO 'meta' box: a full box (version/flags first) except in old QuickTime files
+static uint64_t MetaChildren(HeaderCursor& cursor, uint64_t payload)
+{
+    const uint8_t* probe = cursor.Fetch(payload + 4, 4);
+    return probe && memcmp(probe, "hdlr", 4) == 0 ? payload : payload + 4;
+}
+
+// Value of an ilst item's 'data' box, nullptr when missing or too long to be text
+static const uint8_t* FetchIlstValue(HeaderCursor& cursor, uint64_t ilst, uint64_t ilstEnd, const char* item, size_t& length)
+{
+    uint64_t payload, end, data, dataEnd;
+    if (!FindBox(cursor, ilst, ilstEnd, item, payload, end) || !FindBox(cursor, payload, end, "data", data, dataEnd))
+        return nullptr;
+    // 4-byte type (1 = UTF-8), 4-byte locale, then the value
+    if (dataEnd - data < 8 || dataEnd - data - 8 > kMaxTagText)
+        return nullptr;
+    length = static_cast<size_t>(dataEnd - data - 8);
+    return cursor.Fetch(data + 8, length);
+}
+
+static std::wstring ReadIlstText(HeaderCursor& cursor, uint64_t ilst, uint64_t ilstEnd, const char* item)
+{
+    size_t length = 0;
+    const uint8_t* text = FetchIlstValue(cursor, ilst, ilstEnd, item, length);
+    return text ? Utf8ToWide(reinterpret_cast<const char*>(text), length) : std::wstring();
+}
+
+static void ReadMp4Tags(HeaderCursor& cursor, AudioTagSet& tags)
+{
+    uint64_t moov, moovEnd, udta, udtaEnd, meta, metaEnd, ilst, ilstEnd;
+    if (!FindBox(cursor, 0, cursor.Size(), "moov", moov, moovEnd))
+        return;
+    bool found = FindBox(cursor, moov, moovEnd, "udta", udta, udtaEnd) && FindBox(cursor, udta, udtaEnd, "meta", meta, metaEnd);
+    if (!found && !FindBox(cursor, moov, moovEnd, "meta", meta, metaEnd))
+        return;
+    if (!FindBox(cursor, MetaChildren(cursor, meta), metaEnd, "ilst", ilst, ilstEnd))
+        return;
+
+    tags.artist = ReadIlstText(cursor, ilst, ilstEnd, "\xA9" "ART");
+    tags.albumArtist = ReadIlstText(cursor, ilst, ilstEnd, "aART");
+    tags.album = ReadIlstText(cursor, ilst, ilstEnd, "\xA9" "alb");
+}
+
+bool ReadAudioTags(HeaderCursor& cursor, std::wstring& artist, std::wstring& album)
+{
+    AudioTagSet tags;
+    const uint8_t* ftyp = cursor.Fetch(4, 4);
+    if (ftyp && memcmp(ftyp, "ftyp", 4) == 0)
+    {
+        ReadMp4Tags(cursor, tags);
+    }
+    else
+    {
+        uint64_t afterId3 = ReadId3v2(cursor, tags);
+        ReadFlacTags(cursor, afterId3, tags);
+        if ((tags.artist.empty() && tags.albumArtist.empty()) || tags.album.empty())
+            ReadId3v1(cursor, tags);
+    }
+
+    artist = !tags.albumArtist.empty() ? tags.albumArtist : tags.artist;
+    album = tags.album;
+    return !artist.empty() || !album.empty();
+}
+
+// ---------------------------------------------------------------------------
+// Video creation time
+
+static const uint64_t kTicksPerSecond = 10000000ULL;
+// Seconds from 1601-01-01 (FILETIME) to 1970-01-01 and to 1904-01-01 (QuickTime)
+static const int64_t kUnixEpochSeconds = 11644473600LL;
+static const int64_t kQuickTimeEpochSeconds = 9561628800LL;
+
+// Howard Hinnant's days_from_civil, days since 1970-01-01
+static int64_t DaysFromCivil(int y, int m, int d)
+{
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+// "2023-05-01T12:34:56+0200" (fraction optional; "Z", "+02:00" or no zone) -> UTC ticks
+static bool ParseIsoDateTime(const uint8_t* p, size_t n, uint64_t& ticks)
+{
+    std::string text(reinterpret_cast<const char*>(p), strnlen(reinterpret_cast<const char*>(p), n));
+    int y, mo, d, h, mi, sec, consumed = 0;
+    if (sscanf(text.c_str(), "%4d-%2d-%2dT%2d:%2d:%2d%n", &y, &mo, &d, &h, &mi, &sec, &consumed) != 6)
+        return false;
+    if (mo < 1 || mo > 12 || d < 1 || d > 31 || h > 23 || mi > 59 || sec > 60)
+        return false;
+
+    size_t pos = static_cast<size_t>(consumed);
+    if (pos < text.size() && text[pos] == '.')
+    {
+        while (++pos < text.size() && text[pos] >= '0' && text[pos] <= '9')
+            ;
+    }
+    int64_t offset = 0;
+    if (pos < text.size() && (text[pos] == '+' || text[pos] == '-'))
+    {
+        int oh = 0, om = 0;
+        if (sscanf(text.c_str() + pos + 1, "%2d:%2d", &oh, &om) != 2 && sscanf(text.c_str() + pos + 1, "%2d%2d", &oh, &om) < 1)
+            return false;
+        offset = (oh * 3600 + om * 60) * (text[pos] == '-' ? -1 : 1);
+    }
+
+    int64_t seconds = DaysFromCivil(y, mo, d) * 86400 + h * 3600 + mi * 60 + sec - offset + kUnixEpochSeconds;
+    if (seconds <= 0)
+        return false;
+    ticks = static_cast<uint64_t>(seconds) * kTicksPerSecond;
+    return true;
+}
+
+// moov/meta 'mdta' keys: com.apple.quicktime.creationdate carries the local time and
+// zone of the capture and survives edits that rewrite mvhd
+static bool ReadAppleCreationDate(HeaderCursor& cursor, uint64_t moov, uint64_t moovEnd, uint64_t& ticks)
+{
+    uint64_t meta, metaEnd, keys, keysEnd, ilst, ilstEnd;
+    if (!FindBox(cursor, moov, moovEnd, "meta", meta, metaEnd))
+        return false;
+    uint64_t children = MetaChildren(cursor, meta);
+    if (!FindBox(cursor, children, metaEnd, "keys", keys, keysEnd) || !FindBox(cursor, children, metaEnd, "ilst", ilst, ilstEnd))
+        return false;
+
+    const uint8_t* header = cursor.Fetch(keys, 8);
+    if (!header)
+        return false;
+    uint32_t count = Be32(header + 4);
+
+    static const char kCreationDate[] = "com.apple.quicktime.creationdate";
+    const size_t kKeyLength = sizeof(kCreationDate) - 1;
+    uint64_t pos = keys + 8;
+    for (uint32_t index = 1; index <= count && index <= 256 && pos + 8 <= keysEnd; index++)
+    {
+        // Entry: size, namespace ('mdta'), name
+        const uint8_t* entry = cursor.Fetch(pos, 8);
+        if (!entry)
+            return false;
+        uint32_t size = Be32(entry);
+        if (size < 8)
+            return false;
+        if (size == 8 + kKeyLength)
+        {
+            const uint8_t* name = cursor.Fetch(pos + 8, kKeyLength);
+            if (name && memcmp(name, kCreationDate, kKeyLength) == 0)
+            {
+                // ilst items are typed by their 1-based key index
+                char item[4] = { static_cast<char>(index >> 24), static_cast<char>(index >> 16),
+                                 static_cast<char>(index >> 8), static_cast<char>(index) };
+                size_t length = 0;
+                const uint8_t* value = FetchIlstValue(cursor, ilst, ilstEnd, item, length);
+                return value && ParseIsoDateTime(value, length, ticks);
+            }
+        }
+        pos += size;
+    }
+    return false;
+}
+
+static bool ReadMovieHeaderTime(HeaderCursor& cursor, uint64_t moov, uint64_t moovEnd, uint64_t& ticks)
+{
+    uint64_t mvhd, mvhdEnd;
+    if (!FindBox(cursor, moov, moovEnd, "mvhd", mvhd, mvhdEnd))
+        return false;
+    const uint8_t* p = cursor.Fetch(mvhd, 12);
+    if (!p)
+        return false;
+    uint64_t seconds = p[0] == 1 ? static_cast<uint64_t>(Be32(p + 4)) << 32 | Be32(p + 8) : Be32(p + 4);
+
+    // Unset (0) or an encoder that never set its clock: nothing before 1970 is a real capture
+    if (seconds < static_cast<uint64_t>(kUnixEpochSeconds - kQuickTimeEpochSeconds) || seconds > (1ULL << 40))
+        return false;
+    ticks = (seconds + kQuickTimeEpochSeconds) * kTicksPerSecond;
+    return true;
+}
+
+bool ReadVideoCreationTime(HeaderCursor& cursor, uint64_t& ticks)
+{
+    // ISO base media files start with ftyp; old QuickTime files may open with any top-level atom
+    const uint8_t* first = cursor.Fetch(4, 4);
+    if (!first)
+        return false;
+    static const char* const kTopLevel[] = { "ftyp", "moov", "mdat", "wide", "free", "skip", "pnot" };
+    bool media = false;
+    for (const char* type : kTopLevel)
+        media |= memcmp(first, type, 4) == 0;
+    if (!media)
+        return false;
+
+    uint64_t moov, moovEnd;
+    if (!FindBox(cursor, 0, cursor.Size(), "moov", moov, moovEnd))
+        return false;
+    return ReadAppleCreationDate(cursor, moov, moovEnd, ticks) || ReadMovieHeaderTime(cursor, moov, moovEnd, ticks);
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "FileSystem.h"
+
+// Buffered positional reads for header parsers. Bytes are fetched in small
+// windows and the total per file is capped, so a parser can follow offsets
+// anywhere in a huge file while touching only a few KB.
+class HeaderCursor
+{
+public:
+    static const size_t kWindow = 4096;
+    static const size_t kDefaultBudget = 16 * 1024;
+
+    explicit HeaderCursor(IFileReader& reader, size_t budget = kDefaultBudget);
+
+    // length bytes at offset, or nullptr when past the end of the file or over budget.
+    // The pointer stays valid until the next Fetch.
+    const uint8_t* Fetch(uint64_t offset, size_t length);
+
+    uint64_t Size() const { return m_size; }
+    size_t BytesRead() const { return m_bytesRead; }
+
+private:
+    IFileReader& m_reader;
+    uint64_t m_size;
+    std::vector<uint8_t> m_window;
+    uint64_t m_windowOffset = 0;
+    size_t m_budget;
+    size_t m_bytesRead = 0;
+};
+
+// PNG IHDR, JPEG SOF (EXIF orientation), GIF, BMP, WebP (VP8/VP8L/VP8X), TIFF IFD0.
+// Size as displayed: rotated orientations swap width and height.
+bool ReadImageSize(HeaderCursor& cursor, uint32_t& width, uint32_t& height);
+
+// ID3v2 (2.2-2.4) with ID3v1 fallback, FLAC Vorbis comments, MP4/M4A ilst atoms.
+// Stops once album artist and album are known; large frames (cover art) are
+// skipped by size, never read. Empty strings when a tag is missing.
+bool ReadAudioTags(HeaderCursor& cursor, std::wstring& artist, std::wstring& album);
+
+// MP4/MOV capture time as FILETIME ticks (UTC): the Apple keys creationdate when present,
+// else mvhd creation_time. Follows box sizes from the start of the file, so mdat is
+// skipped unread and a moov at the end of a huge file costs a few KB.
+bool ReadVideoCreationTime(HeaderCursor& cursor, uint64_t& ticks);
@@ -0,0 +1,305 @@
+#include "Metrics.h"
+#include "FileSystem.h"
+#include "OrganizePlanner.h"
+#include <cstdlib>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static const size_t kSubBuckets = 128;       // Exact values below this
+static const size_t kHalfSubBuckets = 64;    // Buckets per power of two above it
+static const uint64_t kMaxValue = 0xFFFFFFFFULL;
+static const size_t kBucketCount = kSubBuckets + 25 * kHalfSubBuckets;  // Shifts 1..25 cover 2^32
+
+static unsigned HighestBit(uint64_t value)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return index;
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+size_t HdrHistogram::BucketIndex(uint64_t value)
+{
+    if (value < kSubBuckets)
+        return static_cast<size_t>(value);
+    unsigned shift = HighestBit(value) - 6;
+    return kSubBuckets + (shift - 1) * kHalfSubBuckets + static_cast<size_t>((value >> shift) - kHalfSubBuckets);
+}
+
+uint64_t HdrHistogram::BucketHighest(size_t index)
+{
+    if (index < kSubBuckets)
+        return index;
+    size_t bucket = index - kSubBuckets;
+    unsigned shift = static_cast<unsigned>(bucket / kHalfSubBuckets + 1);
+    uint64_t top = bucket % kHalfSubBuckets + kHalfSubBuckets;
+    return ((top + 1) << shift) - 1;
+}
+
+void HdrHistogram::Record(uint64_t value)
+{
+    if (value > kMaxValue)
+        value = kMaxValue;
+    if (m_counts.empty())
+        m_counts.resize(kBucketCount, 0);
+    m_counts[BucketIndex(value)]++;
+    m_count++;
+    m_sum += value;
+    if (value < m_min) m_min = value;
+    if (value > m_max) m_max = value;
+}
+
+void HdrHistogram::Merge(const HdrHistogram& other)
+{
+    if (other.m_count == 0)
+        return;
+    if (m_counts.empty())
+        m_counts.resize(kBucketCount, 0);
+    for (size_t i = 0; i < kBucketCount; i++)
+        m_counts[i] += other.m_counts[i];
+    m_count += other.m_count;
+    m_sum += other.m_sum;
+    if (other.m_min < m_min) m_min = other.m_min;
+    if (other.m_max > m_max) m_max = other.m_max;
+}
+
+uint64_t HdrHistogram::ValueAtPercentile(double percentile) const
+{
+    if (m_count == 0)
+        return 0;
+    // Rank of the recording that the percentile falls on, 1-based
+    uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * m_count + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > m_count) rank = m_count;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount; i++)
+    {
+        seen += m_counts[i];
+        if (seen >= rank)
+            return BucketHighest(i) < m_max ? BucketHighest(i) : m_max;
+    }
+    return m_max;
+}
+
+static void PutVarint(std::string& out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+static bool GetVarint(const uint8_t*& p, const uint8_t* end, uint64_t& value)
+{
+    value = 0;
+    for (unsigned shift = 0; p < end && shift < 64; shift += 7)
+    {
+        uint8_t byte = *p++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+static void PutString(std::string& out, const std::string& text)
+{
+    PutVarint(out, text.size());
+    out += text;
+}
+
+static bool GetString(const uint8_t*& p, const uint8_t* end, std::string& text)
+{
+    uint64_t length;
+    if (!GetVarint(p, end, length) || length > static_cast<uint64_t>(end - p))
+        return false;
+    text.assign(reinterpret_cast<const char*>(p), static_cast<size_t>(length));
+    p += length;
+    return true;
+}
+
+// Count, min, max, sum, then (index delta, count) for each non-empty bucket
+void HdrHistogram::Serialize(std::string& out) const
+{
+    PutVarint(out, m_count);
+    if (m_count == 0)
+        return;
+    PutVarint(out, m_min);
+    PutVarint(out, m_max);
+    PutVarint(out, m_sum);
+
+    size_t used = 0;
+    for (uint64_t count : m_counts)
+        used += count != 0;
+    PutVarint(out, used);
+    size_t previous = 0;
+    for (size_t i = 0; i < kBucketCount; i++)
+    {
+        if (m_counts[i] == 0)
+            continue;
+        PutVarint(out, i - previous);
+        PutVarint(out, m_counts[i]);
+        previous = i;
+    }
+}
+
+bool HdrHistogram::Deserialize(const uint8_t*& p, const uint8_t* end)
+{
+    *this = HdrHistogram();
+    if (!GetVarint(p, end, m_count))
+        return false;
+    if (m_count == 0)
+        return true;
+
+    uint64_t used;
+    if (!GetVarint(p, end, m_min) || !GetVarint(p, end, m_max) || !GetVarint(p, end, m_sum) || !GetVarint(p, end, used))
+        return false;
+    m_counts.resize(kBucketCount, 0);
+    uint64_t index = 0;
+    for (uint64_t u = 0; u < used; u++)
+    {
+        uint64_t delta, count;
+        if (!GetVarint(p, end, delta) || !GetVarint(p, end, count))
+            return false;
+        index += delta;
+        if (index >= kBucketCount)
+            return false;
+        m_counts[static_cast<size_t>(index)] = count;
+    }
+    return true;
+}
+
+static uint64_t NowFileTime()
+{
+    const int64_t kUnixEpochSeconds = 11644473600LL;
+    auto sinceUnix = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch());
+    return static_cast<uint64_t>(sinceUnix.count() + kUnixEpochSeconds * 1000000) * 10;
+}
+
+void MetricsStore::Record(const std::string& series, uint64_t value, MetricUnit unit)
+{
+    MetricSeries& entry = m_series[series];
+    entry.unit = unit;
+    entry.histogram.Record(value);
+    if (m_since == 0)
+        m_since = NowFileTime();
+    m_dirty = true;
+}
+
+void MetricsStore::Add(const std::string& counter, uint64_t delta)
+{
+    m_counters[counter] += delta;
+    if (m_since == 0)
+        m_since = NowFileTime();
+    m_dirty = true;
+}
+
+static const char kMetricsMagic[4] = { 'N', 'F', 'F', 'M' };
+static const uint8_t kMetricsVersion = 1;
+
+bool MetricsStore::Load(const std::wstring& path)
+{
+    *this = MetricsStore();
+    std::string bytes;
+    if (!ReadFileBytes(path, bytes) || bytes.size() < 5 || bytes.compare(0, 4, kMetricsMagic, 4) != 0 ||
+        static_cast<uint8_t>(bytes[4]) != kMetricsVersion)
+        return false;
+
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(bytes.data()) + 5;
+    const uint8_t* end = reinterpret_cast<const uint8_t*>(bytes.data()) + bytes.size();
+    MetricsStore loaded;
+    uint64_t counters, series;
+    if (!GetVarint(p, end, loaded.m_since) || !GetVarint(p, end, loaded.m_saved) || !GetVarint(p, end, counters))
+        return false;
+    for (uint64_t c = 0; c < counters; c++)
+    {
+        std::string name;
+        uint64_t value;
+        if (!GetString(p, end, name) || !GetVarint(p, end, value))
+            return false;
+        loaded.m_counters[name] = value;
+    }
+    if (!GetVarint(p, end, series))
+        return false;
+    for (uint64_t s = 0; s < series; s++)
+    {
+        std::string name;
+        if (!GetString(p, end, name) || p >= end)
+            return false;
+        MetricSeries& entry = loaded.m_series[name];
+        entry.unit = static_cast<MetricUnit>(*p++);
+        if (!entry.histogram.Deserialize(p, end))
+            return false;
+    }
+
+    *this = std::move(loaded);
+    return true;
+}
+
+bool MetricsStore::Save(const std::wstring& path)
+{
+    std::string out(kMetricsMagic, 4);
+    out.push_back(static_cast<char>(kMetricsVersion));
+    uint64_t saved = NowFileTime();
+    PutVarint(out, m_since);
+    PutVarint(out, saved);
+    PutVarint(out, m_counters.size());
+    for (const auto& [name, value] : m_counters)
+    {
+        PutString(out, name);
+        PutVarint(out, value);
+    }
+    PutVarint(out, m_series.size());
+    for (const auto& [name, entry] : m_series)
+    {
+        PutString(out, name);
+        out.push_back(static_cast<char>(entry.unit));
+        entry.histogram.Serialize(out);
+    }
+
+    if (!WriteFileBytes(path, out))
+        return false;
+    m_saved = saved;
+    m_dirty = false;
+    return true;
+}
+
+uint64_t MetricsStopwatch::Lap()
+{
+    Clock::time_point now = Clock::now();
+    uint64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - m_lap).count();
+    m_lap = now;
+    return elapsed;
+}
+
+uint64_t MetricsStopwatch::Total() const
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - m_start).count();
+}
+
+std::wstring GetDefaultMetricsPath()
+{
+#ifdef _WIN32
+    const wchar_t* localAppData = _wgetenv(L"LOCALAPPDATA");
+    if (!localAppData || !*localAppData)
+        return std::wstring();
+    return JoinPath(JoinPath(localAppData, L"NewFolderFromFiles"), L"metrics.bin");
+#else
+    std::wstring base;
+    if (const char* xdg = getenv("XDG_STATE_HOME"))
+        base = FromNativePath(xdg);
+    else if (const char* home = getenv("HOME"))
+        base = JoinPath(JoinPath(FromNativePath(home), L".local"), L"state");
+    if (base.empty())
+        return std::wstring();
+    return JoinPath(JoinPath(base, L"NewFolderFromFiles"), L"metrics.bin");
+#endif
+}
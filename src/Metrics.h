@@ -0,0 +1,100 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Long-running usage metrics (the hotkey helper runs for weeks): named counters and
+// HDR-style histograms kept in memory and saved now and then to a small binary file,
+// which NewFolderFromFilesMetrics prints as percentiles.
+
+// Values below 128 are exact; above, each power of two is split into 64 buckets, so a
+// percentile is off by less than 1.6%. Values are clamped to 2^32 - 1 (71 minutes in
+// microseconds). Recording is a bit scan, a shift and an add; buckets are allocated on
+// first use and saved sparsely.
+class HdrHistogram
+{
+public:
+    void Record(uint64_t value);
+    void Merge(const HdrHistogram& other);
+
+    uint64_t Count() const { return m_count; }
+    uint64_t Min() const { return m_count ? m_min : 0; }
+    uint64_t Max() const { return m_max; }
+    double Mean() const { return m_count ? static_cast<double>(m_sum) / m_count : 0; }
+    // Highest value of the bucket holding the given percentile (0..100) of recordings
+    uint64_t ValueAtPercentile(double percentile) const;
+
+    void Serialize(std::string& out) const;
+    bool Deserialize(const uint8_t*& p, const uint8_t* end);
+
+private:
+    static size_t BucketIndex(uint64_t value);
+    static uint64_t BucketHighest(size_t index);
+
+    std::vector<uint64_t> m_counts;
+    uint64_t m_count = 0;
+    uint64_t m_min = UINT64_MAX;
+    uint64_t m_max = 0;
+    uint64_t m_sum = 0;
+};
+
+enum class MetricUnit : uint8_t
+{
+    Microseconds = 0,
+    Count = 1,
+};
+
+struct MetricSeries
+{
+    MetricUnit unit = MetricUnit::Microseconds;
+    HdrHistogram histogram;
+};
+
+// Series and counters by name, "<mode>/<phase>" by convention ("default/move").
+// Not thread-safe; the helper records from its UI thread only.
+class MetricsStore
+{
+public:
+    void Record(const std::string& series, uint64_t value, MetricUnit unit = MetricUnit::Microseconds);
+    void Add(const std::string& counter, uint64_t delta = 1);
+
+    const std::map<std::string, MetricSeries>& Series() const { return m_series; }
+    const std::map<std::string, uint64_t>& Counters() const { return m_counters; }
+    uint64_t Since() const { return m_since; }   // FILETIME ticks of the first recording
+    uint64_t SavedAt() const { return m_saved; }
+    bool Dirty() const { return m_dirty; }
+
+    // Load replaces the contents; a missing or unreadable file leaves the store empty
+    bool Load(const std::wstring& path);
+    // Atomic replace (WriteFileBytes)
+    bool Save(const std::wstring& path);
+
+private:
+    std::map<std::string, MetricSeries> m_series;
+    std::map<std::string, uint64_t> m_counters;
+    uint64_t m_since = 0;
+    uint64_t m_saved = 0;
+    bool m_dirty = false;
+};
+
+// Microseconds between laps, for timing the phases of one operation
+class MetricsStopwatch
+{
+public:
+    MetricsStopwatch() : m_start(Clock::now()), m_lap(m_start) {}
+
+    // Since the previous lap (or construction)
+    uint64_t Lap();
+    // Since construction
+    uint64_t Total() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point m_start;
+    Clock::time_point m_lap;
+};
+
+// %LOCALAPPDATA%\NewFolderFromFiles\metrics.bin; $XDG_STATE_HOME (~/.local/state)/NewFolderFromFiles/metrics.bin
+std::wstring GetDefaultMetricsPath();
@@ -0,0 +1,91 @@
+// Prints the metrics the hotkey helper collects (see Metrics.h) as percentiles.
+//
+//   NewFolderFromFilesMetrics [FILE]
+//
+// FILE defaults to the helper's own metrics file. Each series is "<mode>/<phase>";
+// compare p99 and p999 across saved copies of the file to spot a slow share or an
+// Explorer update that made a phase regress.
+
+#include "FileSystem.h"
+#include "Metrics.h"
+#include <cstdio>
+#include <ctime>
+#include <string>
+
+static std::string FormatValue(uint64_t value, MetricUnit unit)
+{
+    char text[32];
+    if (unit == MetricUnit::Count)
+        snprintf(text, sizeof(text), "%llu", static_cast<unsigned long long>(value));
+    else if (value < 10000)
+        snprintf(text, sizeof(text), "%.2fms", value / 1000.0);
+    else if (value < 10000000)
+        snprintf(text, sizeof(text), "%.1fms", value / 1000.0);
+    else
+        snprintf(text, sizeof(text), "%.1fs", value / 1000000.0);
+    return text;
+}
+
+static std::string FormatTime(uint64_t fileTime)
+{
+    if (fileTime == 0)
+        return "-";
+    const int64_t kUnixEpochSeconds = 11644473600LL;
+    time_t seconds = static_cast<time_t>(fileTime / 10000000 - kUnixEpochSeconds);
+    char text[32];
+    struct tm local;
+#ifdef _WIN32
+    localtime_s(&local, &seconds);
+#else
+    localtime_r(&seconds, &local);
+#endif
+    strftime(text, sizeof(text), "%Y-%m-%d %H:%M", &local);
+    return text;
+}
+
+static int RunMetricsReport(const std::wstring& path)
+{
+    MetricsStore store;
+    if (path.empty() || !store.Load(path))
+    {
+        fprintf(stderr, "Cannot read metrics from %s\n", WideToUtf8(path).c_str());
+        return 1;
+    }
+
+    printf("%s\nrecorded %s .. %s\n\n", WideToUtf8(path).c_str(), FormatTime(store.Since()).c_str(), FormatTime(store.SavedAt()).c_str());
+    printf("%-28s %10s %10s %10s %10s %10s %10s\n", "series", "count", "mean", "p50", "p99", "p999", "max");
+    for (const auto& [name, series] : store.Series())
+    {
+        const HdrHistogram& h = series.histogram;
+        printf("%-28s %10llu %10s %10s %10s %10s %10s\n", name.c_str(), static_cast<unsigned long long>(h.Count()),
+            FormatValue(static_cast<uint64_t>(h.Mean() + 0.5), series.unit).c_str(),
+            FormatValue(h.ValueAtPercentile(50), series.unit).c_str(),
+            FormatValue(h.ValueAtPercentile(99), series.unit).c_str(),
+            FormatValue(h.ValueAtPercentile(99.9), series.unit).c_str(),
+            FormatValue(h.Max(), series.unit).c_str());
+    }
+
+    if (!store.Counters().empty())
+    {
+        printf("\n%-28s %10s\n", "counter", "value");
+        for (const auto& [name, value] : store.Counters())
+            printf("%-28s %10llu\n", name.c_str(), static_cast<unsigned long long>(value));
+    }
+    return 0;
+}
+
+#ifdef _WIN32
+
+int wmain(int argc, wchar_t** argv)
+{
+    return RunMetricsReport(argc > 1 ? argv[1] : GetDefaultMetricsPath());
+}
+
+#else
+
+int main(int argc, char** argv)
+{
+    return RunMetricsReport(argc > 1 ? FromNativePath(argv[1]) : GetDefaultMetricsPath());
+}
+
+#endif
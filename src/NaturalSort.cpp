@@ -0,0 +1,170 @@
+#include "NaturalSort.h"
+#include "CaseFold.h"
+#include "OrganizePlanner.h"
+#include <algorithm>
+#include <string_view>
+
+const char kKeyDigits = 0x01;
+const size_t kMaxDigitRun = 255;
+
+static bool IsAsciiDigit(wchar_t c)
+{
+    return c >= L'0' && c <= L'9';
+}
+
+// Order-preserving and prefix-free, so concatenated units still compare per unit
+static void AppendUtf8(uint32_t c, std::string& key)
+{
+    if (c < 0x80)
+    {
+        key.push_back(static_cast<char>(c));
+    }
+    else if (c < 0x800)
+    {
+        key.push_back(static_cast<char>(0xC0 | (c >> 6)));
+        key.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    }
+    else if (c < 0x10000)
+    {
+        key.push_back(static_cast<char>(0xE0 | (c >> 12)));
+        key.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+        key.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    }
+    else
+    {
+        key.push_back(static_cast<char>(0xF0 | ((c >> 18) & 0x07)));
+        key.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+        key.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+        key.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    }
+}
+
+void AppendNaturalSortKey(const std::wstring& name, std::string& key)
+{
+    bool exact = true;  // The key alone gives back the name
+    size_t i = 0;
+    while (i < name.size())
+    {
+        wchar_t c = name[i];
+        if (!IsAsciiDigit(c))
+        {
+            // ASCII folds down so '_' stays before letters, as in Explorer; the rest through
+            // the ordinal table, so the order does not depend on the process locale
+            uint32_t folded = c < 0x80 ? static_cast<uint32_t>(c >= L'A' && c <= L'Z' ? c + 32 : c) : static_cast<uint32_t>(FoldCase(c));
+            exact &= folded == static_cast<uint32_t>(c) && folded > kKeyDigits;
+            // 0x00 and 0x01 are taken by the key itself; such names only come from POSIX
+            AppendUtf8(std::max<uint32_t>(folded, kKeyDigits + 1), key);
+            i++;
+            continue;
+        }
+
+        size_t start = i;
+        while (i < name.size() && name[i] == L'0')
+            i++;
+        size_t digits = i;
+        while (i < name.size() && IsAsciiDigit(name[i]) && i - digits < kMaxDigitRun)
+            i++;
+        exact &= digits == start;
+
+        // Longer runs are larger numbers; equal lengths compare digit by digit. A run
+        // longer than kMaxDigitRun (only in names past any filesystem's limit) goes on as a new run.
+        size_t count = i - digits;
+        key.push_back(kKeyDigits);
+        key.push_back(static_cast<char>(count));
+        for (size_t d = digits; d < i; d += 2)
+        {
+            uint8_t high = static_cast<uint8_t>(name[d] - L'0');
+            uint8_t low = d + 1 < i ? static_cast<uint8_t>(name[d + 1] - L'0') : 0;
+            key.push_back(static_cast<char>((high << 4) | low));
+        }
+    }
+
+    if (!exact)
+    {
+        key.push_back('\0');
+        for (wchar_t c : name)
+            AppendUtf8(static_cast<uint32_t>(c), key);
+    }
+}
+
+std::string NaturalSortKey(const std::wstring& name)
+{
+    std::string key;
+    key.reserve(name.size() + 8);
+    AppendNaturalSortKey(name, key);
+    return key;
+}
+
+int CompareNatural(const std::wstring& a, const std::wstring& b)
+{
+    return NaturalSortKey(a).compare(NaturalSortKey(b));
+}
+
+// All keys in one buffer: one allocation for the lot instead of one per name. The sort
+// moves the first 16 key bytes along with each index, so most comparisons never touch the
+// buffer (camera names share their first 8: "img_", then the digit run's header); only
+// names sharing all 16 go on to memcmp the rest.
+template <typename NameOf>
+static std::vector<size_t> OrderByKeys(size_t count, NameOf nameOf)
+{
+    struct Item
+    {
+        uint64_t prefix[2];  // Big-endian, zero-padded: compares like the bytes
+        size_t index;
+    };
+
+    std::string keys;
+    std::vector<size_t> offsets(count + 1);
+    std::vector<Item> items(count);
+    keys.reserve(count * 24);
+    for (size_t i = 0; i < count; i++)
+    {
+        offsets[i] = keys.size();
+        AppendNaturalSortKey(nameOf(i), keys);
+        Item& item = items[i];
+        item.index = i;
+        for (size_t w = 0; w < 2; w++)
+        {
+            item.prefix[w] = 0;
+            for (size_t b = w * 8; b < w * 8 + 8; b++)
+                item.prefix[w] = (item.prefix[w] << 8) | (offsets[i] + b < keys.size() ? static_cast<uint8_t>(keys[offsets[i] + b]) : 0);
+        }
+    }
+    offsets[count] = keys.size();
+
+    std::string_view all(keys);
+    std::sort(items.begin(), items.end(), [&](const Item& a, const Item& b) {
+        if (a.prefix[0] != b.prefix[0])
+            return a.prefix[0] < b.prefix[0];
+        if (a.prefix[1] != b.prefix[1])
+            return a.prefix[1] < b.prefix[1];
+        int cmp = all.substr(offsets[a.index], offsets[a.index + 1] - offsets[a.index])
+            .compare(all.substr(offsets[b.index], offsets[b.index + 1] - offsets[b.index]));
+        return cmp != 0 ? cmp < 0 : a.index < b.index;
+    });
+
+    std::vector<size_t> order(count);
+    for (size_t i = 0; i < count; i++)
+        order[i] = items[i].index;
+    return order;
+}
+
+std::vector<size_t> NaturalOrder(const std::vector<std::wstring>& names)
+{
+    return OrderByKeys(names.size(), [&](size_t i) -> const std::wstring& { return names[i]; });
+}
+
+std::vector<size_t> NaturalOrder(const std::vector<FileEntry>& entries)
+{
+    return OrderByKeys(entries.size(), [&](size_t i) { return PathFileName(entries[i].path); });
+}
+
+void SortEntriesNatural(std::vector<FileEntry>& entries)
+{
+    std::vector<size_t> order = NaturalOrder(entries);
+    std::vector<FileEntry> sorted;
+    sorted.reserve(entries.size());
+    for (size_t i : order)
+        sorted.push_back(std::move(entries[i]));
+    entries = std::move(sorted);
+}
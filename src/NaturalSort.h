@@ -0,0 +1,28 @@
+#pragma once
+#include "OrganizeTypes.h"
+#include <string>
+#include <vector>
+
+// Natural ("img2" before "img10") order, as Explorer sorts names: runs of digits compare
+// by value, everything else case-folded, and a digit run before any other character.
+//
+// Each name becomes a binary key whose memcmp order is that order, so sorting many names
+// builds every key once and then compares bytes. Text is the folded UTF-8; a digit run is
+// 0x01, its significant-digit count and the digits packed two per byte. Names equal in
+// that order ("IMG01" and "img1") get their exact UTF-8 after a 0x00, so no two different
+// names share a key and ties break the same way every time.
+
+void AppendNaturalSortKey(const std::wstring& name, std::string& key);
+std::string NaturalSortKey(const std::wstring& name);
+
+// <0, 0, >0
+int CompareNatural(const std::wstring& a, const std::wstring& b);
+
+// Indices of names in natural order
+std::vector<size_t> NaturalOrder(const std::vector<std::wstring>& names);
+
+// Same, by file name (the path's last component)
+std::vector<size_t> NaturalOrder(const std::vector<FileEntry>& entries);
+
+// Sorts a folder listing by file name
+void SortEntriesNatural(std::vector<FileEntry>& entries);
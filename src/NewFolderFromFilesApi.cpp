@@ -0,0 +1,318 @@
+#include "NewFolderFromFilesApi.h"
+#include "OrganizeConflicts.h"
+#include "OrganizeExecutor.h"
+#include "OrganizePlanner.h"
+#include "OrganizeRules.h"
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <new>
+
+struct NffSelection
+{
+    std::vector<FileEntry> entries;
+};
+
+struct NffPlan
+{
+    LocalFileSystem fs;
+    std::wstring parent;
+    std::vector<FileEntry> entries;
+    OrganizePlan plan;
+    std::vector<std::wstring> destinations;
+    bool executed = false;
+
+    // Everything handed out: one buffer of NUL-terminated strings, then the records
+    // pointing into it, built once so iterating costs nothing per call
+    std::string strings;
+    std::vector<NffPlanGroup> groups;
+    std::vector<NffPlanEntry> items;
+};
+
+static thread_local std::string t_lastError;
+
+static NffStatus Fail(NffStatus status, const std::string& message)
+{
+    t_lastError = message;
+    return status;
+}
+
+// Nothing may unwind into a C caller
+template <typename Body>
+static NffStatus Guard(Body body)
+{
+    t_lastError.clear();
+    try
+    {
+        return body();
+    }
+    catch (const std::bad_alloc&)
+    {
+        return Fail(NffOutOfMemory, "out of memory");
+    }
+    catch (const std::exception& e)
+    {
+        return Fail(NffFailed, e.what());
+    }
+    catch (...)
+    {
+        return Fail(NffFailed, "unexpected error");
+    }
+}
+
+// Linux paths are bytes; the native conversion keeps names that are not valid UTF-8
+static std::wstring PathFromApi(const char* path)
+{
+#ifdef _WIN32
+    return Utf8ToWide(path, strlen(path));
+#else
+    return FromNativePath(path);
+#endif
+}
+
+static std::string PathToApi(const std::wstring& path)
+{
+#ifdef _WIN32
+    return WideToUtf8(path);
+#else
+    return ToNativePath(path);
+#endif
+}
+
+// Copies the fields the caller's version of T has; the rest keep their defaults
+template <typename T>
+static T ReadSized(const T* input)
+{
+    T value = {};
+    if (input && input->size > 0)
+        memcpy(&value, input, std::min<size_t>(input->size, sizeof(T)));
+    value.size = sizeof(T);
+    return value;
+}
+
+uint32_t NffGetApiVersion(void)
+{
+    return NFF_API_VERSION;
+}
+
+const char* NffGetLastError(void)
+{
+    return t_lastError.c_str();
+}
+
+NffStatus NffCreateSelectionFromPaths(const char* const* paths, size_t count, NffSelection** selection)
+{
+    return Guard([&]() {
+        if (!selection || (!paths && count > 0))
+            return Fail(NffInvalidArgument, "null argument");
+        *selection = nullptr;
+        auto created = std::make_unique<NffSelection>();
+        created->entries.resize(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!paths[i] || !*paths[i])
+                return Fail(NffInvalidArgument, "empty path at index " + std::to_string(i));
+            created->entries[i].path = PathFromApi(paths[i]);
+        }
+        *selection = created.release();
+        return NffOk;
+    });
+}
+
+NffStatus NffCreateSelectionFromDirectory(const char* folder, NffSelection** selection)
+{
+    return Guard([&]() {
+        if (!selection || !folder || !*folder)
+            return Fail(NffInvalidArgument, "null argument");
+        *selection = nullptr;
+        auto created = std::make_unique<NffSelection>();
+        LocalFileSystem fs;
+        FsResult result = fs.ListDirectory(PathFromApi(folder), created->entries);
+        if (result == FsResult::NotFound)
+            return Fail(NffNotFound, std::string("folder not found: ") + folder);
+        if (result != FsResult::Ok)
+            return Fail(NffFailed, std::string("cannot list ") + folder);
+        *selection = created.release();
+        return NffOk;
+    });
+}
+
+size_t NffGetSelectionCount(const NffSelection* selection)
+{
+    return selection ? selection->entries.size() : 0;
+}
+
+void NffFreeSelection(NffSelection* selection)
+{
+    delete selection;
+}
+
+// Fills strings, groups and items from the finished plan
+static void PublishPlan(NffPlan& plan)
+{
+    std::vector<size_t> groupOffsets;  // folderName, destination per group
+    std::vector<size_t> itemOffsets;   // source, targetName per item
+    auto add = [&](const std::string& text) {
+        size_t offset = plan.strings.size();
+        plan.strings.append(text);
+        plan.strings.push_back('\0');
+        return offset;
+    };
+
+    for (size_t g = 0; g < plan.plan.groups.size(); g++)
+    {
+        const OrganizeGroup& group = plan.plan.groups[g];
+        groupOffsets.push_back(add(WideToUtf8(group.folderName)));
+        groupOffsets.push_back(add(PathToApi(g < plan.destinations.size() ? plan.destinations[g] : plan.parent)));
+        for (size_t k = 0; k < group.items.size(); k++)
+        {
+            const FileEntry& entry = plan.entries[group.items[k]];
+            itemOffsets.push_back(add(PathToApi(entry.path)));
+            itemOffsets.push_back(add(WideToUtf8(k < group.targetNames.size() ? group.targetNames[k] : PathFileName(entry.path))));
+        }
+    }
+
+    // Only now is the buffer final
+    const char* base = plan.strings.data();
+    size_t item = 0;
+    for (size_t g = 0; g < plan.plan.groups.size(); g++)
+    {
+        const OrganizeGroup& group = plan.plan.groups[g];
+        plan.groups.push_back({ base + groupOffsets[2 * g], base + groupOffsets[2 * g + 1], item, group.items.size() });
+        for (size_t k = 0; k < group.items.size(); k++, item++)
+        {
+            const FileEntry& entry = plan.entries[group.items[k]];
+            bool replaces = k < group.replaces.size() && group.replaces[k];
+            plan.items.push_back({ base + itemOffsets[2 * item], base + itemOffsets[2 * item + 1], g,
+                entry.isDirectory ? 0 : entry.size, replaces ? 1 : 0 });
+        }
+    }
+}
+
+NffStatus NffCreatePlan(const NffSelection* selection, const char* mode, const NffPlanOptions* options, NffPlan** plan)
+{
+    return Guard([&]() {
+        if (!selection || !mode || !plan)
+            return Fail(NffInvalidArgument, "null argument");
+        *plan = nullptr;
+        NffPlanOptions settings = ReadSized(options);
+
+        OrganizeMode organizeMode;
+        if (!ParseOrganizeMode(mode, organizeMode))
+            return Fail(NffInvalidArgument, std::string("unknown mode: ") + mode);
+        ConflictPolicy policy = ConflictPolicy::RenameSuffix;
+        if (settings.conflictPolicy && !ParseConflictPolicy(settings.conflictPolicy, policy))
+            return Fail(NffInvalidArgument, std::string("unknown conflict policy: ") + settings.conflictPolicy);
+
+        OrganizeOptions organize;
+        RuleSet rules;
+        if (settings.destinationTemplate)
+            organize.destinationTemplate = Utf8ToWide(settings.destinationTemplate, strlen(settings.destinationTemplate));
+        if (organizeMode == OrganizeMode::ByTemplate && !IsValidDestinationTemplate(organize.destinationTemplate))
+            return Fail(NffInvalidArgument, "mode template needs a valid destinationTemplate");
+        if (organizeMode == OrganizeMode::ByRules)
+        {
+            if (!settings.rulesFile)
+                return Fail(NffInvalidArgument, "mode rules needs rulesFile");
+            std::wstring rulesPath = PathFromApi(settings.rulesFile);
+            LocalFileSystem probe;
+            if (!probe.PathExists(rulesPath))
+                return Fail(NffNotFound, std::string("rules file not found: ") + settings.rulesFile);
+            std::wstring error;
+            if (!LoadRulesFile(rulesPath, rules, &error))
+                return Fail(NffInvalidArgument, WideToUtf8(error));
+            organize.rules = &rules;
+        }
+
+        auto created = std::make_unique<NffPlan>();
+        created->entries = selection->entries;
+        if (settings.parent && *settings.parent)
+            created->parent = PathFromApi(settings.parent);
+        else if (!created->entries.empty())
+            created->parent = PathParent(created->entries[0].path);
+
+        // The same steps as the shell extension: facts, plan, names, conflicts
+        IFileSystem& fs = created->fs;
+        if (organizeMode == OrganizeMode::Flatten)
+            created->entries = ExpandFolderContents(fs, created->entries);
+        else if (OrganizeModeNeedsMetadata(organizeMode, organize))
+            QueryEntriesMetadata(fs, created->entries);
+        if (unsigned fields = OrganizeModeMediaFields(organizeMode, organize))
+            QueryEntriesMediaInfo(fs, created->entries, fields);
+
+        if (!BuildOrganizePlan(created->entries, organizeMode, created->plan, organize))
+            return Fail(NffFailed, std::string("cannot plan mode ") + mode);
+        created->destinations = ResolveDestinations(fs, created->parent, created->plan);
+        ResolveConflicts(fs, created->entries, created->plan, created->destinations, policy);
+        PublishPlan(*created);
+
+        *plan = created.release();
+        return NffOk;
+    });
+}
+
+size_t NffGetPlanGroupCount(const NffPlan* plan)
+{
+    return plan ? plan->groups.size() : 0;
+}
+
+NffStatus NffGetPlanGroup(const NffPlan* plan, size_t index, NffPlanGroup* group)
+{
+    if (!plan || !group || index >= plan->groups.size())
+        return Fail(NffInvalidArgument, "no such group");
+    *group = plan->groups[index];
+    return NffOk;
+}
+
+size_t NffGetPlanEntryCount(const NffPlan* plan)
+{
+    return plan ? plan->items.size() : 0;
+}
+
+NffStatus NffGetPlanEntry(const NffPlan* plan, size_t index, NffPlanEntry* entry)
+{
+    if (!plan || !entry || index >= plan->items.size())
+        return Fail(NffInvalidArgument, "no such entry");
+    *entry = plan->items[index];
+    return NffOk;
+}
+
+NffStatus NffExecutePlan(NffPlan* plan, const NffExecuteOptions* options, NffExecuteResult* result)
+{
+    return Guard([&]() {
+        if (result)
+            *result = NffExecuteResult{};
+        if (!plan)
+            return Fail(NffInvalidArgument, "null argument");
+        if (plan->executed)
+            return Fail(NffInvalidArgument, "plan already executed");
+        plan->executed = true;
+        NffExecuteOptions settings = ReadSized(options);
+
+        ExecuteOptions execute;
+        execute.copy = settings.copy != 0;
+        execute.verify = settings.verify != 0;
+        execute.threads = settings.threads;
+        if (settings.progress)
+        {
+            execute.progress = [&settings](size_t done, size_t total) {
+                return settings.progress(settings.context, done, total) == 0;
+            };
+        }
+
+        OrganizeResult organized;
+        ExecuteOrganizePlan(plan->fs, plan->parent, plan->entries, plan->plan, plan->destinations, organized, execute);
+        if (result)
+        {
+            result->moved = organized.moved;
+            result->failed = organized.failed;
+        }
+        return organized.cancelled ? Fail(NffCancelled, "cancelled") : NffOk;
+    });
+}
+
+void NffFreePlan(NffPlan* plan)
+{
+    delete plan;
+}
@@ -0,0 +1,145 @@
+/* C interface to the organize core, for pipelines that plan and move files in-process
+ * (Python ctypes, other languages' FFIs) instead of going through Explorer.
+ *
+ * The ABI is stable: handles are opaque, structs passed in start with their own size so
+ * later versions can add fields, and modes and conflict policies are named by the same
+ * lowercase identifiers the command-line tools use ("type", "fulldate", "rename", ...).
+ * Strings are UTF-8 in and out. A handle may be used by one thread at a time.
+ *
+ *   NffSelection* selection;
+ *   NffPlan* plan;
+ *   NffCreateSelectionFromDirectory("/data/ingest", &selection);
+ *   NffCreatePlan(selection, "fulldate", NULL, &plan);
+ *   for (size_t i = 0; i < NffGetPlanEntryCount(plan); i++) { NffPlanEntry e; NffGetPlanEntry(plan, i, &e); ... }
+ *   NffExecutePlan(plan, NULL, &result);
+ *   NffFreePlan(plan);
+ *   NffFreeSelection(selection);
+ */
+#ifndef NEWFOLDERFROMFILES_API_H
+#define NEWFOLDERFROMFILES_API_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(NFF_BUILDING_API)
+#define NFF_API __declspec(dllexport)
+#else
+#define NFF_API __declspec(dllimport)
+#endif
+#else
+#define NFF_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NFF_API_VERSION 1
+
+typedef enum NffStatus
+{
+    NffOk = 0,
+    NffInvalidArgument = 1,  /* Null handle, unknown mode or policy, index out of range, plan already executed */
+    NffNotFound = 2,         /* A folder or rules file that does not exist */
+    NffFailed = 3,           /* Anything else; see NffGetLastError */
+    NffCancelled = 4,        /* The progress callback asked to stop */
+    NffOutOfMemory = 5
+} NffStatus;
+
+typedef struct NffSelection NffSelection;
+typedef struct NffPlan NffPlan;
+
+/* NFF_API_VERSION of the library actually loaded */
+NFF_API uint32_t NffGetApiVersion(void);
+
+/* Message for the last failure on the calling thread; empty when there is none. Valid
+ * until the next call on that thread. */
+NFF_API const char* NffGetLastError(void);
+
+/* --- Selections: the files and folders to organize ---------------------------------- */
+
+/* Absolute paths; sizes and times are read when a plan needs them */
+NFF_API NffStatus NffCreateSelectionFromPaths(const char* const* paths, size_t count, NffSelection** selection);
+
+/* Everything directly inside folder; on Windows with the listing's sizes and times, elsewhere
+ * these too are read when a plan needs them */
+NFF_API NffStatus NffCreateSelectionFromDirectory(const char* folder, NffSelection** selection);
+
+NFF_API size_t NffGetSelectionCount(const NffSelection* selection);
+NFF_API void NffFreeSelection(NffSelection* selection);
+
+/* --- Plans: destination folders for every entry, conflicts settled ----------------- */
+
+typedef struct NffPlanOptions
+{
+    uint32_t size;                     /* sizeof(NffPlanOptions) */
+    const char* parent;                /* Folder the destinations go into; NULL: the folder holding the first entry */
+    const char* destinationTemplate;   /* Mode "template", e.g. "{yyyy}/{MM}/{category}" */
+    const char* rulesFile;             /* Mode "rules" */
+    const char* conflictPolicy;        /* "rename" (NULL), "skip", "newer", "keep-both" or "none" */
+} NffPlanOptions;
+
+/* Reads what mode needs (sizes, times, media headers), groups the entries, names the
+ * destination folders under parent and settles name conflicts. The selection may be
+ * freed afterwards. options may be NULL. */
+NFF_API NffStatus NffCreatePlan(const NffSelection* selection, const char* mode, const NffPlanOptions* options, NffPlan** plan);
+
+typedef struct NffPlanGroup
+{
+    const char* folderName;    /* Relative to parent; "" for the parent itself */
+    const char* destination;   /* Absolute destination folder */
+    size_t firstEntry;         /* The group's entries are firstEntry .. firstEntry + entryCount - 1 */
+    size_t entryCount;
+} NffPlanGroup;
+
+typedef struct NffPlanEntry
+{
+    const char* source;        /* Absolute path now */
+    const char* targetName;    /* Name in the destination (differs after a conflict rename) */
+    size_t group;
+    uint64_t size;             /* Bytes; 0 for folders and when the mode needed no sizes */
+    int replaces;              /* Nonzero: replaces an existing file of that name */
+} NffPlanEntry;
+
+/* Strings point into the plan and stay valid until NffFreePlan; nothing is copied per call */
+NFF_API size_t NffGetPlanGroupCount(const NffPlan* plan);
+NFF_API NffStatus NffGetPlanGroup(const NffPlan* plan, size_t index, NffPlanGroup* group);
+NFF_API size_t NffGetPlanEntryCount(const NffPlan* plan);
+NFF_API NffStatus NffGetPlanEntry(const NffPlan* plan, size_t index, NffPlanEntry* entry);
+
+/* --- Execution -------------------------------------------------------------------- */
+
+/* done of total entries moved (copy: files copied). Return nonzero to stop; moves run in
+ * batches of up to 1024 and the current batch still finishes. Copies report from worker
+ * threads, one call at a time. */
+typedef int (*NffProgressCallback)(void* context, uint64_t done, uint64_t total);
+
+typedef struct NffExecuteOptions
+{
+    uint32_t size;                 /* sizeof(NffExecuteOptions) */
+    int copy;                      /* Nonzero: copy and leave the originals (plan with parent set to the target) */
+    int verify;                    /* Copy: compare every copy with its source */
+    uint32_t threads;              /* Copy: files copied at once; 0 picks a default */
+    NffProgressCallback progress;  /* May be NULL */
+    void* context;                 /* Passed to progress */
+} NffExecuteOptions;
+
+typedef struct NffExecuteResult
+{
+    uint64_t moved;   /* Entries moved (copied) */
+    uint64_t failed;
+} NffExecuteResult;
+
+/* Creates the folders and moves (copies) every entry. A plan executes once. Returns
+ * NffCancelled when progress stopped it, with result counting what was done. options
+ * and result may be NULL. */
+NFF_API NffStatus NffExecutePlan(NffPlan* plan, const NffExecuteOptions* options, NffExecuteResult* result);
+
+NFF_API void NffFreePlan(NffPlan* plan);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,10 +1,21 @@
 #include "NewFolderFromFilesContextMenuHandler.h"
+#include "OrganizePlanner.h"
+#include "CaseFold.h"
+#include "OrganizeConflicts.h"
+#include "OrganizeExecutor.h"
+#include "OrganizeRules.h"
+#include "SelectionPrePlanner.h"
+#include "SharedConfig.h"
+#include "VolumeScheduler.h"
+#include "ZipArchive.h"
+#include "JobQueue.h"
 #include <Shlwapi.h>
 #include <strsafe.h>
 #include <algorithm>
 #include <shobjidl.h>
 #include <exdisp.h>
 #include <atlbase.h>
+#include <new>
 #include <set>
 
 #pragma comment(lib, "Shlwapi.lib")
@@ -25,14 +36,30 @@
 #define CMD_FLATTEN         10
 #define CMD_NUMBERED        11
 #define CMD_ALPHABETICAL    12
-#define CMD_COUNT           13
+#define CMD_BY_RULES        13
+#define CMD_NESTED_YM       14
+#define CMD_NESTED_YMT      15
+#define CMD_NESTED_TE       16
+#define CMD_NESTED_TY       17
+#define CMD_BY_SEQUENCE     18
+#define CMD_BY_SIMILAR      19
+#define CMD_BY_ORIENTATION  20
+#define CMD_BY_RESOLUTION   21
+#define CMD_BY_ARTIST       22
+#define CMD_BY_ARTIST_ALBUM 23
+#define CMD_NEW_ARCHIVE     24
+#define CMD_COUNT           25
 
 NewFolderFromFilesContextMenuHandler::~NewFolderFromFilesContextMenuHandler()
 {
+    // Menu dismissed without a command: a queued or running pre-plan has no use any more
+    if (m_prePlanner)
+        m_prePlanner->Cancel();
     InterlockedDecrement(&g_cObjCount);
 }
 
-NewFolderFromFilesContextMenuHandler::NewFolderFromFilesContextMenuHandler() : m_ObjRefCount(1), m_idCmdFirst(0)
+NewFolderFromFilesContextMenuHandler::NewFolderFromFilesContextMenuHandler() : m_ObjRefCount(1), m_idCmdFirst(0),
+    m_copyToFolder(false), m_invokeWindow(nullptr), m_config(GetSharedConfig())
 {
     InterlockedIncrement(&g_cObjCount);
 }
@@ -140,70 +167,6 @@ HRESULT STDMETHODCALLTYPE NewFolderFromFilesContextMenuHandler::GetCommandString
     return E_NOTIMPL;
 }
 
-std::wstring NewFolderFromFilesContextMenuHandler::GetCommonPrefix()
-{
-    if (m_selectedFiles.empty())
-        return L"New Folder";
-
-    std::vector<std::wstring> names;
-    for (const auto& path : m_selectedFiles)
-    {
-        wchar_t name[MAX_PATH];
-        StringCchCopyW(name, MAX_PATH, PathFindFileNameW(path.c_str()));
-        PathRemoveExtensionW(name);
-        names.push_back(name);
-    }
-
-    if (names.size() == 1)
-        return names[0];
-
-    std::wstring prefix = names[0];
-    for (size_t i = 1; i < names.size() && !prefix.empty(); i++)
-    {
-        size_t j = 0;
-        while (j < prefix.length() && j < names[i].length() &&
-            towlower(prefix[j]) == towlower(names[i][j]))
-            j++;
-        prefix = prefix.substr(0, j);
-    }
-
-    while (!prefix.empty())
-    {
-        wchar_t last = prefix.back();
-        if (last == L' ' || last == L'_' || last == L'-' || last == L'.')
-            prefix.pop_back();
-        else
-            break;
-    }
-
-    return prefix.empty() ? L"New Folder" : prefix;
-}
-
-std::wstring NewFolderFromFilesContextMenuHandler::GenerateUniqueFolderName(const std::wstring& baseName)
-{
-    return GenerateUniqueFolderPath(m_parentFolder, baseName);
-}
-
-std::wstring NewFolderFromFilesContextMenuHandler::GenerateUniqueFolderPath(const std::wstring& parent, const std::wstring& baseName)
-{
-    std::wstring folderPath = parent + L"\\" + baseName;
-
-    if (!PathFileExistsW(folderPath.c_str()))
-        return folderPath;
-
-    for (int i = 2; i < 1000; i++)
-    {
-        wchar_t buffer[32];
-        StringCchPrintfW(buffer, 32, L" (%d)", i);
-        folderPath = parent + L"\\" + baseName + buffer;
-
-        if (!PathFileExistsW(folderPath.c_str()))
-            return folderPath;
-    }
-
-    return parent + L"\\New Folder";
-}
-
 // Find the current Explorer window's shell view
 static HRESULT GetActiveShellView(const std::wstring& folderPath, IShellView** ppShellView, IShellBrowser** ppShellBrowser = nullptr)
 {
@@ -251,7 +214,7 @@ static HRESULT GetActiveShellView(const std::wstring& folderPath, IShellView** p
                         wchar_t szPath[MAX_PATH];
                         if (SHGetPathFromIDListW(pidlFolder, szPath))
                         {
-                            if (_wcsicmp(szPath, folderPath.c_str()) == 0)
+                            if (EqualsFolded(szPath, wcslen(szPath), folderPath.data(), folderPath.size()))
                             {
                                 *ppShellView = pShellView.Detach();
                                 if (ppShellBrowser) *ppShellBrowser = pShellBrowser.Detach();
@@ -311,304 +274,198 @@ void NewFolderFromFilesContextMenuHandler::SelectMultipleFoldersInExplorer(const
     }
 }
 
-std::wstring NewFolderFromFilesContextMenuHandler::GetFileExtension(const std::wstring& path)
+std::vector<FileEntry> NewFolderFromFilesContextMenuHandler::TakeSelectionEntries()
 {
-    const wchar_t* ext = PathFindExtensionW(path.c_str());
-    if (ext && *ext == L'.')
-    {
-        std::wstring result(ext + 1);
-        // Convert to uppercase for consistency
-        for (auto& c : result) c = towupper(c);
-        return result;
-    }
-    return L"No Extension";
+    std::vector<FileEntry> entries;
+    if (m_prePlanner && m_prePlanner->Take(m_selectedFiles, entries))
+        return entries;
+
+    entries.resize(m_selectedFiles.size());
+    for (size_t i = 0; i < m_selectedFiles.size(); i++)
+        entries[i].path = m_selectedFiles[i];
+    return entries;
 }
 
-std::wstring NewFolderFromFilesContextMenuHandler::GetFileTypeCategory(const std::wstring& path)
+// Entries as the mode needs them: Flatten expands folders, other modes read what their keys use
+static void GatherEntryFacts(IFileSystem& fs, std::vector<FileEntry>& entries, OrganizeMode mode, const OrganizeOptions& options)
 {
-    std::wstring ext = GetFileExtension(path);
-    for (auto& c : ext) c = towlower(c);
-
-    // Video
-    if (ext == L"mp4" || ext == L"avi" || ext == L"mkv" || ext == L"mov" ||
-        ext == L"wmv" || ext == L"flv" || ext == L"webm" || ext == L"m4v" ||
-        ext == L"mpg" || ext == L"mpeg" || ext == L"3gp")
-        return L"Video";
-
-    // Photo
-    if (ext == L"jpg" || ext == L"jpeg" || ext == L"png" || ext == L"gif" ||
-        ext == L"bmp" || ext == L"tiff" || ext == L"tif" || ext == L"webp" ||
-        ext == L"ico" || ext == L"svg" || ext == L"raw" || ext == L"psd" ||
-        ext == L"heic" || ext == L"heif")
-        return L"Photo";
-
-    // Audio
-    if (ext == L"mp3" || ext == L"wav" || ext == L"flac" || ext == L"aac" ||
-        ext == L"ogg" || ext == L"wma" || ext == L"m4a" || ext == L"aiff")
-        return L"Audio";
-
-    // Document
-    if (ext == L"doc" || ext == L"docx" || ext == L"pdf" || ext == L"txt" ||
-        ext == L"rtf" || ext == L"odt" || ext == L"xls" || ext == L"xlsx" ||
-        ext == L"ppt" || ext == L"pptx" || ext == L"csv" || ext == L"md")
-        return L"Document";
-
-    return L"Other";
+    if (mode == OrganizeMode::Flatten)
+        entries = ExpandFolderContents(fs, entries);
+    else if (OrganizeModeNeedsMetadata(mode, options))
+        QueryEntriesMetadata(fs, entries);
+    if (unsigned fields = OrganizeModeMediaFields(mode, options))
+        QueryEntriesMediaInfo(fs, entries, fields);
 }
 
-std::wstring NewFolderFromFilesContextMenuHandler::GetFileDateFolder(const std::wstring& path, OrganizeMode mode)
+HRESULT NewFolderFromFilesContextMenuHandler::ExecuteOrganize(OrganizeMode mode, OrganizeOptions options)
 {
-    WIN32_FILE_ATTRIBUTE_DATA fileInfo;
-    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &fileInfo))
-        return L"Unknown Date";
+    if (m_selectedFiles.empty() || m_parentFolder.empty())
+        return E_FAIL;
 
-    SYSTEMTIME st;
-    FileTimeToSystemTime(&fileInfo.ftLastWriteTime, &st);
+    LocalFileSystem fs;
+    std::vector<FileEntry> entries = TakeSelectionEntries();
 
-    wchar_t buffer[64];
-    switch (mode)
+    // Rules come compiled from the shared image, which QueryContextMenu refreshes,
+    // so edits still apply without restarting Explorer
+    if (mode == OrganizeMode::ByRules)
     {
-    case OrganizeMode::ByDay:
-        StringCchPrintfW(buffer, 64, L"%02d", st.wDay);
-        break;
-    case OrganizeMode::ByMonth:
-        StringCchPrintfW(buffer, 64, L"%02d", st.wMonth);
-        break;
-    case OrganizeMode::ByYear:
-        StringCchPrintfW(buffer, 64, L"%04d", st.wYear);
-        break;
-    case OrganizeMode::ByMonthYear:
-        StringCchPrintfW(buffer, 64, L"%04d-%02d", st.wYear, st.wMonth);
-        break;
-    case OrganizeMode::ByFullDate:
-    default:
-        StringCchPrintfW(buffer, 64, L"%04d-%02d-%02d", st.wYear, st.wMonth, st.wDay);
-        break;
+        options.rules = m_config ? m_config->Rules() : nullptr;
+        if (!options.rules)
+            return E_FAIL;
     }
-    return buffer;
-}
-
-std::wstring NewFolderFromFilesContextMenuHandler::GetFileSizeCategory(const std::wstring& path)
-{
-    WIN32_FILE_ATTRIBUTE_DATA fileInfo;
-    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &fileInfo))
-        return L"Unknown Size";
-
-    ULONGLONG size = (static_cast<ULONGLONG>(fileInfo.nFileSizeHigh) << 32) | fileInfo.nFileSizeLow;
 
-    if (size < 1024 * 1024)  // < 1 MB
-        return L"Small (under 1 MB)";
-    else if (size < 100 * 1024 * 1024)  // < 100 MB
-        return L"Medium (1-100 MB)";
-    else
-        return L"Large (over 100 MB)";
-}
-
-HRESULT NewFolderFromFilesContextMenuHandler::ExecuteOrganize(OrganizeMode mode)
-{
-    switch (mode)
+    // A selection from several folders (search results, libraries) is organized inside
+    // each of them. "New folder with selection" still gathers everything in one place,
+    // and copies all land in the folder the user picks.
+    if (mode != OrganizeMode::Default && !m_copyToFolder)
     {
-    case OrganizeMode::Default:
-        return OrganizeDefault();
-    case OrganizeMode::ByDay:
-    case OrganizeMode::ByMonth:
-    case OrganizeMode::ByYear:
-    case OrganizeMode::ByMonthYear:
-    case OrganizeMode::ByFullDate:
-        return OrganizeByDate(mode);
-    case OrganizeMode::ByTypeVideo:
-    case OrganizeMode::ByTypePhoto:
-    case OrganizeMode::ByTypeAudio:
-    case OrganizeMode::ByTypeDocument:
-    case OrganizeMode::ByTypeOther:
-        return OrganizeByType();
-    case OrganizeMode::ByExtension:
-        return OrganizeByExtension();
-    case OrganizeMode::BySize:
-        return OrganizeBySize();
-    case OrganizeMode::Flatten:
-        return OrganizeFlatten();
-    case OrganizeMode::Numbered:
-        return OrganizeNumbered();
-    case OrganizeMode::Alphabetical:
-        return OrganizeAlphabetical();
-    default:
-        return E_INVALIDARG;
+        std::vector<SelectionPartition> parts = PartitionByParent(std::move(entries));
+        if (parts.size() > 1)
+            return ExecutePartitions(mode, options, parts);
+        entries = std::move(parts[0].entries);
     }
-}
-
-HRESULT NewFolderFromFilesContextMenuHandler::OrganizeDefault()
-{
-    if (m_selectedFiles.empty() || m_parentFolder.empty())
-        return E_FAIL;
-
-    CComPtr<IFileOperation> pFileOp;
-    HRESULT hr = pFileOp.CoCreateInstance(CLSID_FileOperation);
-    if (FAILED(hr)) return hr;
-
-    pFileOp->SetOperationFlags(FOF_ALLOWUNDO | FOF_NOCONFIRMMKDIR | FOFX_ADDUNDORECORD);
-
-    std::wstring suggestedName = GetCommonPrefix();
-    std::wstring folderPath = GenerateUniqueFolderName(suggestedName);
-    std::wstring folderName = PathFindFileNameW(folderPath.c_str());
 
-    CComPtr<IShellItem> pParentItem;
-    hr = SHCreateItemFromParsingName(m_parentFolder.c_str(), nullptr, IID_PPV_ARGS(&pParentItem));
-    if (FAILED(hr)) return hr;
-
-    pFileOp->NewItem(pParentItem, FILE_ATTRIBUTE_DIRECTORY, folderName.c_str(), nullptr, nullptr);
-    hr = pFileOp->PerformOperations();
-    if (FAILED(hr)) return hr;
-
-    CComPtr<IFileOperation> pMoveOp;
-    hr = pMoveOp.CoCreateInstance(CLSID_FileOperation);
-    if (FAILED(hr)) return hr;
+    GatherEntryFacts(fs, entries, mode, options);
+    OrganizePlan plan;
+    if (!BuildOrganizePlan(entries, mode, plan, options))
+        return E_INVALIDARG;
 
-    pMoveOp->SetOperationFlags(FOF_ALLOWUNDO | FOF_NOCONFIRMMKDIR | FOFX_ADDUNDORECORD);
+    return m_copyToFolder ? CopyPlan(fs, entries, plan) : PerformPlan(fs, entries, plan);
+}
 
-    Sleep(50);
-    CComPtr<IShellItem> pDestFolder;
-    hr = SHCreateItemFromParsingName(folderPath.c_str(), nullptr, IID_PPV_ARGS(&pDestFolder));
-    if (FAILED(hr)) return hr;
+// Each folder's share is read and then moved by its own handler, with that folder as
+// parent. Devices work at once (RunPerDevice), so an HDD and an SSD are both kept busy;
+// planning stays on this thread because compiled rules match from one thread at a time.
+HRESULT NewFolderFromFilesContextMenuHandler::ExecutePartitions(OrganizeMode mode, const OrganizeOptions& options,
+    std::vector<SelectionPartition>& parts)
+{
+    LocalFileSystem fs;
+    std::vector<std::wstring> parents;
+    for (const auto& part : parts)
+        parents.push_back(part.parent);
+
+    RunPerDevice(fs, parents, [&](size_t p) {
+        LocalFileSystem partFs;
+        GatherEntryFacts(partFs, parts[p].entries, mode, options);
+    });
+
+    std::vector<OrganizePlan> plans(parts.size());
+    for (size_t p = 0; p < parts.size(); p++)
+    {
+        if (!BuildOrganizePlan(parts[p].entries, mode, plans[p], options))
+            return E_INVALIDARG;
+    }
+
+    // IFileOperation wants a single-threaded apartment on every worker
+    DeviceThreadHooks hooks;
+    hooks.start = []() { CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE); };
+    hooks.exit = []() { CoUninitialize(); };
+    std::vector<HRESULT> results(parts.size(), S_OK);
+    RunPerDevice(fs, parents, [&](size_t p) {
+        NewFolderFromFilesContextMenuHandler* part = new (std::nothrow) NewFolderFromFilesContextMenuHandler();
+        if (!part)
+        {
+            results[p] = E_OUTOFMEMORY;
+            return;
+        }
+        part->m_parentFolder = parts[p].parent;
+        part->m_invokeWindow = m_invokeWindow;
+        part->m_config = m_config;
+        LocalFileSystem partFs;
+        results[p] = part->PerformPlan(partFs, parts[p].entries, plans[p]);
+        part->Release();
+    }, hooks);
 
-    for (const auto& filePath : m_selectedFiles)
+    for (HRESULT hr : results)
     {
-        CComPtr<IShellItem> pItem;
-        if (SUCCEEDED(SHCreateItemFromParsingName(filePath.c_str(), nullptr, IID_PPV_ARGS(&pItem))))
-            pMoveOp->MoveItem(pItem, pDestFolder, nullptr, nullptr);
+        if (FAILED(hr))
+            return hr;
     }
-
-    hr = pMoveOp->PerformOperations();
-    if (FAILED(hr)) return hr;
-
-    SelectFolderInExplorer(folderPath);
     return S_OK;
 }
 
-HRESULT NewFolderFromFilesContextMenuHandler::OrganizeByDate(OrganizeMode mode)
+HRESULT NewFolderFromFilesContextMenuHandler::ExecuteTemplate(const wchar_t* destinationTemplate)
 {
-    if (m_selectedFiles.empty() || m_parentFolder.empty())
-        return E_FAIL;
-
-    std::map<std::wstring, std::vector<std::wstring>> groups;
-    for (const auto& file : m_selectedFiles)
-        groups[GetFileDateFolder(file, mode)].push_back(file);
-
-    CComPtr<IFileOperation> pFileOp;
-    HRESULT hr = pFileOp.CoCreateInstance(CLSID_FileOperation);
-    if (FAILED(hr)) return hr;
-
-    pFileOp->SetOperationFlags(FOF_ALLOWUNDO | FOF_NOCONFIRMMKDIR | FOFX_ADDUNDORECORD);
+    OrganizeOptions options;
+    options.destinationTemplate = destinationTemplate;
+    return ExecuteOrganize(OrganizeMode::ByTemplate, options);
+}
 
-    std::vector<std::wstring> createdFolders;
-    for (auto& [dateName, files] : groups)
+// Nested plans: one IFileOperation per depth, since a NewItem needs its parent to exist.
+// Only folders under an existing parent are probed; below a new one everything is new.
+HRESULT NewFolderFromFilesContextMenuHandler::CreatePlannedFolders(IFileSystem& fs, const OrganizePlan& plan)
+{
+    std::vector<int> depth(plan.folders.size(), 0);
+    std::vector<bool> missing(plan.folders.size(), false);
+    int maxDepth = 0;
+    for (size_t f = 0; f < plan.folders.size(); f++)
     {
-        std::wstring folderPath = GenerateUniqueFolderPath(m_parentFolder, dateName);
-        std::wstring folderName = PathFindFileNameW(folderPath.c_str());
-
-        if (!PathFileExistsW(folderPath.c_str()))
-        {
-            CComPtr<IShellItem> pParentItem;
-            SHCreateItemFromParsingName(m_parentFolder.c_str(), nullptr, IID_PPV_ARGS(&pParentItem));
-            pFileOp->NewItem(pParentItem, FILE_ATTRIBUTE_DIRECTORY, folderName.c_str(), nullptr, nullptr);
-        }
-        createdFolders.push_back(folderPath);
+        int parent = plan.folders[f].parent;
+        depth[f] = parent < 0 ? 0 : depth[parent] + 1;
+        if (depth[f] > maxDepth)
+            maxDepth = depth[f];
+        missing[f] = (parent >= 0 && missing[parent]) || !fs.PathExists(JoinPath(m_parentFolder, plan.folders[f].relativePath));
     }
 
-    pFileOp->PerformOperations();
-    Sleep(50);
-
-    CComPtr<IFileOperation> pMoveOp;
-    hr = pMoveOp.CoCreateInstance(CLSID_FileOperation);
-    if (FAILED(hr)) return hr;
-
-    pMoveOp->SetOperationFlags(FOF_ALLOWUNDO | FOF_NOCONFIRMMKDIR | FOFX_ADDUNDORECORD);
-
-    for (auto& [dateName, files] : groups)
+    for (int d = 0; d <= maxDepth; d++)
     {
-        std::wstring folderPath = m_parentFolder + L"\\" + dateName;
-        CComPtr<IShellItem> pDestFolder;
-        if (FAILED(SHCreateItemFromParsingName(folderPath.c_str(), nullptr, IID_PPV_ARGS(&pDestFolder))))
-            continue;
+        CComPtr<IFileOperation> pFileOp;
+        HRESULT hr = pFileOp.CoCreateInstance(CLSID_FileOperation);
+        if (FAILED(hr)) return hr;
 
-        for (const auto& file : files)
-        {
-            CComPtr<IShellItem> pItem;
-            if (SUCCEEDED(SHCreateItemFromParsingName(file.c_str(), nullptr, IID_PPV_ARGS(&pItem))))
-                pMoveOp->MoveItem(pItem, pDestFolder, nullptr, nullptr);
-        }
-    }
-
-    hr = pMoveOp->PerformOperations();
-    SelectMultipleFoldersInExplorer(createdFolders);
-    return hr;
-}
+        pFileOp->SetOperationFlags(FOF_ALLOWUNDO | FOF_NOCONFIRMMKDIR | FOFX_ADDUNDORECORD);
 
-HRESULT NewFolderFromFilesContextMenuHandler::OrganizeByType()
-{
-    if (m_selectedFiles.empty() || m_parentFolder.empty())
-        return E_FAIL;
-
-    std::map<std::wstring, std::vector<std::wstring>> groups;
-    for (const auto& file : m_selectedFiles)
-        groups[GetFileTypeCategory(file)].push_back(file);
+        bool any = false;
+        for (size_t f = 0; f < plan.folders.size(); f++)
+        {
+            if (depth[f] != d || !missing[f])
+                continue;
 
-    CComPtr<IFileOperation> pFileOp;
-    HRESULT hr = pFileOp.CoCreateInstance(CLSID_FileOperation);
-    if (FAILED(hr)) return hr;
+            const OrganizeFolder& folder = plan.folders[f];
+            std::wstring parentPath = folder.parent < 0 ? m_parentFolder : JoinPath(m_parentFolder, plan.folders[folder.parent].relativePath);
+            CComPtr<IShellItem> pParentItem;
+            if (FAILED(SHCreateItemFromParsingName(parentPath.c_str(), nullptr, IID_PPV_ARGS(&pParentItem))))
+                continue;
 
-    pFileOp->SetOperationFlags(FOF_ALLOWUNDO | FOF_NOCONFIRMMKDIR | FOFX_ADDUNDORECORD);
+            pFileOp->NewItem(pParentItem, FILE_ATTRIBUTE_DIRECTORY, PathFileName(folder.relativePath).c_str(), nullptr, nullptr);
+            any = true;
+        }
 
-    std::vector<std::wstring> createdFolders;
-    for (auto& [typeName, files] : groups)
-    {
-        std::wstring folderPath = m_parentFolder + L"\\" + typeName;
-        if (!PathFileExistsW(folderPath.c_str()))
+        if (any)
         {
-            CComPtr<IShellItem> pParentItem;
-            SHCreateItemFromParsingName(m_parentFolder.c_str(), nullptr, IID_PPV_ARGS(&pParentItem));
-            pFileOp->NewItem(pParentItem, FILE_ATTRIBUTE_DIRECTORY, typeName.c_str(), nullptr, nullptr);
+            hr = pFileOp->PerformOperations();
+            if (FAILED(hr)) return hr;
         }
-        createdFolders.push_back(folderPath);
     }
 
-    pFileOp->PerformOperations();
-    Sleep(50);
-
-    CComPtr<IFileOperation> pMoveOp;
-    hr = pMoveOp.CoCreateInstance(CLSID_FileOperation);
-    if (FAILED(hr)) return hr;
+    return S_OK;
+}
 
-    pMoveOp->SetOperationFlags(FOF_ALLOWUNDO | FOF_NOCONFIRMMKDIR | FOFX_ADDUNDORECORD);
+// Settings stored in registry (shared with the hotkey helper)
+static const wchar_t* REG_KEY = L"Software\\NewFolderFromFiles";
+static const wchar_t* REG_CONFLICT_POLICY = L"ConflictPolicy";
+static const wchar_t* REG_SHOW_GROUP_COUNTS = L"ShowGroupCounts";
 
-    for (auto& [typeName, files] : groups)
-    {
-        std::wstring folderPath = m_parentFolder + L"\\" + typeName;
-        CComPtr<IShellItem> pDestFolder;
-        if (FAILED(SHCreateItemFromParsingName(folderPath.c_str(), nullptr, IID_PPV_ARGS(&pDestFolder))))
-            continue;
-
-        for (const auto& file : files)
-        {
-            CComPtr<IShellItem> pItem;
-            if (SUCCEEDED(SHCreateItemFromParsingName(file.c_str(), nullptr, IID_PPV_ARGS(&pItem))))
-                pMoveOp->MoveItem(pItem, pDestFolder, nullptr, nullptr);
-        }
-    }
-
-    hr = pMoveOp->PerformOperations();
-    SelectMultipleFoldersInExplorer(createdFolders);
-    return hr;
+// Name conflicts are settled before anything moves, so IFileOperation never stops
+// on its conflict dialog. ConflictPolicy (DWORD, ConflictPolicy values) defaults to rename.
+static ConflictPolicy LoadConflictPolicy()
+{
+    DWORD value = static_cast<DWORD>(ConflictPolicy::RenameSuffix);
+    DWORD size = sizeof(value);
+    if (RegGetValueW(HKEY_CURRENT_USER, REG_KEY, REG_CONFLICT_POLICY, RRF_RT_REG_DWORD, nullptr, &value, &size) != ERROR_SUCCESS ||
+        value > static_cast<DWORD>(ConflictPolicy::KeepBothIfDifferent))
+        value = static_cast<DWORD>(ConflictPolicy::RenameSuffix);
+    return static_cast<ConflictPolicy>(value);
 }
 
-HRESULT NewFolderFromFilesContextMenuHandler::OrganizeByExtension()
+// Run a plan through IFileOperation so the whole organize is a single undo step
+HRESULT NewFolderFromFilesContextMenuHandler::PerformPlan(IFileSystem& fs, const std::vector<FileEntry>& entries, OrganizePlan& plan)
 {
-    if (m_selectedFiles.empty() || m_parentFolder.empty())
-        return E_FAIL;
+    if (plan.groups.empty())
+        return S_OK;
 
-    std::map<std::wstring, std::vector<std::wstring>> groups;
-    for (const auto& file : m_selectedFiles)
-        groups[GetFileExtension(file)].push_back(file);
+    std::vector<std::wstring> destinations = ResolveDestinations(fs, m_parentFolder, plan);
+    ResolveConflicts(fs, entries, plan, destinations, LoadConflictPolicy());
 
     CComPtr<IFileOperation> pFileOp;
     HRESULT hr = pFileOp.CoCreateInstance(CLSID_FileOperation);
@@ -616,288 +473,246 @@ HRESULT NewFolderFromFilesContextMenuHandler::OrganizeByExtension()
 
     pFileOp->SetOperationFlags(FOF_ALLOWUNDO | FOF_NOCONFIRMMKDIR | FOFX_ADDUNDORECORD);
 
+    CComPtr<IShellItem> pParentItem;
+    hr = SHCreateItemFromParsingName(m_parentFolder.c_str(), nullptr, IID_PPV_ARGS(&pParentItem));
+    if (FAILED(hr)) return hr;
+
     std::vector<std::wstring> createdFolders;
-    for (auto& [extName, files] : groups)
+    bool newFolders = false;
+    if (!plan.folders.empty())
     {
-        std::wstring folderPath = m_parentFolder + L"\\" + extName;
-        if (!PathFileExistsW(folderPath.c_str()))
+        hr = CreatePlannedFolders(fs, plan);
+        if (FAILED(hr)) return hr;
+
+        // Select the top level of the new hierarchy
+        for (const auto& folder : plan.folders)
         {
-            CComPtr<IShellItem> pParentItem;
-            SHCreateItemFromParsingName(m_parentFolder.c_str(), nullptr, IID_PPV_ARGS(&pParentItem));
-            pFileOp->NewItem(pParentItem, FILE_ATTRIBUTE_DIRECTORY, extName.c_str(), nullptr, nullptr);
+            if (folder.parent < 0)
+                createdFolders.push_back(JoinPath(m_parentFolder, folder.relativePath));
         }
-        createdFolders.push_back(folderPath);
     }
 
-    pFileOp->PerformOperations();
-    Sleep(50);
-
-    CComPtr<IFileOperation> pMoveOp;
-    hr = pMoveOp.CoCreateInstance(CLSID_FileOperation);
-    if (FAILED(hr)) return hr;
-
-    pMoveOp->SetOperationFlags(FOF_ALLOWUNDO | FOF_NOCONFIRMMKDIR | FOFX_ADDUNDORECORD);
-
-    for (auto& [extName, files] : groups)
+    for (size_t g = 0; g < destinations.size() && plan.folders.empty(); g++)
     {
-        std::wstring folderPath = m_parentFolder + L"\\" + extName;
-        CComPtr<IShellItem> pDestFolder;
-        if (FAILED(SHCreateItemFromParsingName(folderPath.c_str(), nullptr, IID_PPV_ARGS(&pDestFolder))))
+        const std::wstring& folderPath = destinations[g];
+        if (folderPath == m_parentFolder)
             continue;
 
-        for (const auto& file : files)
+        if (!fs.PathExists(folderPath))
         {
-            CComPtr<IShellItem> pItem;
-            if (SUCCEEDED(SHCreateItemFromParsingName(file.c_str(), nullptr, IID_PPV_ARGS(&pItem))))
-                pMoveOp->MoveItem(pItem, pDestFolder, nullptr, nullptr);
+            pFileOp->NewItem(pParentItem, FILE_ATTRIBUTE_DIRECTORY, PathFindFileNameW(folderPath.c_str()), nullptr, nullptr);
+            newFolders = true;
         }
+        createdFolders.push_back(folderPath);
     }
 
-    hr = pMoveOp->PerformOperations();
-    SelectMultipleFoldersInExplorer(createdFolders);
-    return hr;
-}
-
-HRESULT NewFolderFromFilesContextMenuHandler::OrganizeBySize()
-{
-    if (m_selectedFiles.empty() || m_parentFolder.empty())
-        return E_FAIL;
-
-    std::map<std::wstring, std::vector<std::wstring>> groups;
-    for (const auto& file : m_selectedFiles)
-        groups[GetFileSizeCategory(file)].push_back(file);
-
-    CComPtr<IFileOperation> pFileOp;
-    HRESULT hr = pFileOp.CoCreateInstance(CLSID_FileOperation);
-    if (FAILED(hr)) return hr;
-
-    pFileOp->SetOperationFlags(FOF_ALLOWUNDO | FOF_NOCONFIRMMKDIR | FOFX_ADDUNDORECORD);
-
-    std::vector<std::wstring> createdFolders;
-    for (auto& [sizeName, files] : groups)
+    if (newFolders)
     {
-        std::wstring folderPath = m_parentFolder + L"\\" + sizeName;
-        if (!PathFileExistsW(folderPath.c_str()))
-        {
-            CComPtr<IShellItem> pParentItem;
-            SHCreateItemFromParsingName(m_parentFolder.c_str(), nullptr, IID_PPV_ARGS(&pParentItem));
-            pFileOp->NewItem(pParentItem, FILE_ATTRIBUTE_DIRECTORY, sizeName.c_str(), nullptr, nullptr);
-        }
-        createdFolders.push_back(folderPath);
+        hr = pFileOp->PerformOperations();
+        if (FAILED(hr)) return hr;
+        Sleep(50);
     }
 
-    pFileOp->PerformOperations();
-    Sleep(50);
-
     CComPtr<IFileOperation> pMoveOp;
     hr = pMoveOp.CoCreateInstance(CLSID_FileOperation);
     if (FAILED(hr)) return hr;
 
     pMoveOp->SetOperationFlags(FOF_ALLOWUNDO | FOF_NOCONFIRMMKDIR | FOFX_ADDUNDORECORD);
 
-    for (auto& [sizeName, files] : groups)
+    // Replacements decided by the conflict policy overwrite without asking
+    CComPtr<IFileOperation> pReplaceOp;
+    bool anyReplace = false;
+
+    for (size_t g = 0; g < plan.groups.size(); g++)
     {
-        std::wstring folderPath = m_parentFolder + L"\\" + sizeName;
         CComPtr<IShellItem> pDestFolder;
-        if (FAILED(SHCreateItemFromParsingName(folderPath.c_str(), nullptr, IID_PPV_ARGS(&pDestFolder))))
+        if (FAILED(SHCreateItemFromParsingName(destinations[g].c_str(), nullptr, IID_PPV_ARGS(&pDestFolder))))
             continue;
 
-        for (const auto& file : files)
+        const OrganizeGroup& group = plan.groups[g];
+        for (size_t k = 0; k < group.items.size(); k++)
         {
             CComPtr<IShellItem> pItem;
-            if (SUCCEEDED(SHCreateItemFromParsingName(file.c_str(), nullptr, IID_PPV_ARGS(&pItem))))
-                pMoveOp->MoveItem(pItem, pDestFolder, nullptr, nullptr);
-        }
-    }
+            if (FAILED(SHCreateItemFromParsingName(entries[group.items[k]].path.c_str(), nullptr, IID_PPV_ARGS(&pItem))))
+                continue;
 
-    hr = pMoveOp->PerformOperations();
-    SelectMultipleFoldersInExplorer(createdFolders);
-    return hr;
-}
-
-HRESULT NewFolderFromFilesContextMenuHandler::OrganizeFlatten()
-{
-    // Collect all files from selected folders recursively
-    std::vector<std::wstring> allFiles;
-    
-    for (const auto& path : m_selectedFiles)
-    {
-        DWORD attrs = GetFileAttributesW(path.c_str());
-        if (attrs == INVALID_FILE_ATTRIBUTES)
-            continue;
-            
-        if (attrs & FILE_ATTRIBUTE_DIRECTORY)
-        {
-            // Recursively find all files
-            std::wstring searchPath = path + L"\\*";
-            WIN32_FIND_DATAW fd;
-            HANDLE hFind = FindFirstFileW(searchPath.c_str(), &fd);
-            if (hFind != INVALID_HANDLE_VALUE)
+            const wchar_t* newName = k < group.targetNames.size() ? group.targetNames[k].c_str() : nullptr;
+            if (k < group.replaces.size() && group.replaces[k])
             {
-                do
+                if (!pReplaceOp)
                 {
-                    if (wcscmp(fd.cFileName, L".") == 0 || wcscmp(fd.cFileName, L"..") == 0)
-                        continue;
-                    
-                    std::wstring fullPath = path + L"\\" + fd.cFileName;
-                    if (!(fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
-                        allFiles.push_back(fullPath);
-                } while (FindNextFileW(hFind, &fd));
-                FindClose(hFind);
+                    hr = pReplaceOp.CoCreateInstance(CLSID_FileOperation);
+                    if (FAILED(hr)) return hr;
+                    pReplaceOp->SetOperationFlags(FOF_ALLOWUNDO | FOF_NOCONFIRMATION | FOFX_ADDUNDORECORD);
+                }
+                pReplaceOp->MoveItem(pItem, pDestFolder, newName, nullptr);
+                anyReplace = true;
+            }
+            else
+            {
+                pMoveOp->MoveItem(pItem, pDestFolder, newName, nullptr);
             }
-        }
-        else
-        {
-            allFiles.push_back(path);
         }
     }
 
-    if (allFiles.empty())
-        return S_OK;
-
-    CComPtr<IFileOperation> pMoveOp;
-    HRESULT hr = pMoveOp.CoCreateInstance(CLSID_FileOperation);
-    if (FAILED(hr)) return hr;
-
-    pMoveOp->SetOperationFlags(FOF_ALLOWUNDO | FOF_NOCONFIRMMKDIR | FOFX_ADDUNDORECORD);
-
-    CComPtr<IShellItem> pDestFolder;
-    hr = SHCreateItemFromParsingName(m_parentFolder.c_str(), nullptr, IID_PPV_ARGS(&pDestFolder));
+    hr = pMoveOp->PerformOperations();
     if (FAILED(hr)) return hr;
-
-    for (const auto& file : allFiles)
+    if (anyReplace)
     {
-        CComPtr<IShellItem> pItem;
-        if (SUCCEEDED(SHCreateItemFromParsingName(file.c_str(), nullptr, IID_PPV_ARGS(&pItem))))
-            pMoveOp->MoveItem(pItem, pDestFolder, nullptr, nullptr);
+        hr = pReplaceOp->PerformOperations();
+        if (FAILED(hr)) return hr;
     }
 
-    return pMoveOp->PerformOperations();
+    if (plan.mode == OrganizeMode::Default)
+        SelectFolderInExplorer(destinations[0]);
+    else
+        SelectMultipleFoldersInExplorer(createdFolders);
+    return S_OK;
 }
 
-HRESULT NewFolderFromFilesContextMenuHandler::OrganizeNumbered()
+// Shift+click: the same grouping as copies in a folder the user picks; the selection stays put.
+// Copies run through the core executor (CopyFileEx, several files at once), not IFileOperation.
+HRESULT NewFolderFromFilesContextMenuHandler::CopyPlan(IFileSystem& fs, const std::vector<FileEntry>& entries, OrganizePlan& plan)
 {
-    if (m_selectedFiles.empty() || m_parentFolder.empty())
-        return E_FAIL;
+    if (plan.groups.empty())
+        return S_OK;
 
-    CComPtr<IFileOperation> pFileOp;
-    HRESULT hr = pFileOp.CoCreateInstance(CLSID_FileOperation);
+    CComPtr<IFileOpenDialog> pDialog;
+    HRESULT hr = pDialog.CoCreateInstance(CLSID_FileOpenDialog);
     if (FAILED(hr)) return hr;
 
-    pFileOp->SetOperationFlags(FOF_ALLOWUNDO | FOF_NOCONFIRMMKDIR | FOFX_ADDUNDORECORD);
-
-    std::vector<std::wstring> createdFolders;
-    int folderNum = 1;
-    
-    for (const auto& file : m_selectedFiles)
-    {
-        wchar_t folderName[32];
-        StringCchPrintfW(folderName, 32, L"Folder %d", folderNum++);
-        
-        std::wstring folderPath = GenerateUniqueFolderPath(m_parentFolder, folderName);
-        std::wstring actualName = PathFindFileNameW(folderPath.c_str());
-
-        CComPtr<IShellItem> pParentItem;
-        SHCreateItemFromParsingName(m_parentFolder.c_str(), nullptr, IID_PPV_ARGS(&pParentItem));
-        pFileOp->NewItem(pParentItem, FILE_ATTRIBUTE_DIRECTORY, actualName.c_str(), nullptr, nullptr);
-        createdFolders.push_back(folderPath);
-    }
-
-    pFileOp->PerformOperations();
-    Sleep(50);
+    DWORD flags = 0;
+    pDialog->GetOptions(&flags);
+    pDialog->SetOptions(flags | FOS_PICKFOLDERS | FOS_FORCEFILESYSTEM);
+    pDialog->SetTitle(L"Copy organized items to");
+    hr = pDialog->Show(m_invokeWindow);
+    if (hr == HRESULT_FROM_WIN32(ERROR_CANCELLED))
+        return S_OK;
+    if (FAILED(hr)) return hr;
 
-    CComPtr<IFileOperation> pMoveOp;
-    hr = pMoveOp.CoCreateInstance(CLSID_FileOperation);
+    CComPtr<IShellItem> pFolder;
+    hr = pDialog->GetResult(&pFolder);
+    if (FAILED(hr)) return hr;
+    PWSTR pszPath = nullptr;
+    hr = pFolder->GetDisplayName(SIGDN_FILESYSPATH, &pszPath);
     if (FAILED(hr)) return hr;
+    std::wstring staging = pszPath;
+    CoTaskMemFree(pszPath);
 
-    pMoveOp->SetOperationFlags(FOF_ALLOWUNDO | FOF_NOCONFIRMMKDIR | FOFX_ADDUNDORECORD);
+    std::vector<std::wstring> destinations = ResolveDestinations(fs, staging, plan);
+    ResolveConflicts(fs, entries, plan, destinations, LoadConflictPolicy());
+    ExecuteOptions options;
+    options.copy = true;
+    OrganizeResult result;
+    ExecuteOrganizePlan(fs, staging, entries, plan, destinations, result, options);
 
-    for (size_t i = 0; i < m_selectedFiles.size() && i < createdFolders.size(); i++)
+    PIDLIST_ABSOLUTE pidlStaging = ILCreateFromPathW(staging.c_str());
+    if (pidlStaging)
     {
-        CComPtr<IShellItem> pDestFolder;
-        if (FAILED(SHCreateItemFromParsingName(createdFolders[i].c_str(), nullptr, IID_PPV_ARGS(&pDestFolder))))
-            continue;
-
-        CComPtr<IShellItem> pItem;
-        if (SUCCEEDED(SHCreateItemFromParsingName(m_selectedFiles[i].c_str(), nullptr, IID_PPV_ARGS(&pItem))))
-            pMoveOp->MoveItem(pItem, pDestFolder, nullptr, nullptr);
+        SHOpenFolderAndSelectItems(pidlStaging, 0, nullptr, 0);
+        ILFree(pidlStaging);
     }
-
-    hr = pMoveOp->PerformOperations();
-    SelectMultipleFoldersInExplorer(createdFolders);
-    return hr;
+    return result.failed == 0 ? S_OK : E_FAIL;
 }
 
-HRESULT NewFolderFromFilesContextMenuHandler::OrganizeAlphabetical()
+// A .zip next to the selection, named like the default folder ("Name.zip", "Name (2).zip").
+// The selection stays in place; the new archive is selected for renaming, like a new folder.
+HRESULT NewFolderFromFilesContextMenuHandler::CreateArchive()
 {
     if (m_selectedFiles.empty() || m_parentFolder.empty())
         return E_FAIL;
 
-    std::map<std::wstring, std::vector<std::wstring>> groups;
-    for (const auto& file : m_selectedFiles)
-    {
-        std::wstring filename = PathFindFileNameW(file.c_str());
-        wchar_t letter[2] = { towupper(filename[0]), 0 };
-        if (!iswalpha(letter[0]))
-            wcscpy_s(letter, L"#");
-        groups[letter].push_back(file);
-    }
-
-    CComPtr<IFileOperation> pFileOp;
-    HRESULT hr = pFileOp.CoCreateInstance(CLSID_FileOperation);
-    if (FAILED(hr)) return hr;
-
-    pFileOp->SetOperationFlags(FOF_ALLOWUNDO | FOF_NOCONFIRMMKDIR | FOFX_ADDUNDORECORD);
-
-    std::vector<std::wstring> createdFolders;
-    for (auto& [letter, files] : groups)
-    {
-        std::wstring folderPath = m_parentFolder + L"\\" + letter;
-        if (!PathFileExistsW(folderPath.c_str()))
-        {
-            CComPtr<IShellItem> pParentItem;
-            SHCreateItemFromParsingName(m_parentFolder.c_str(), nullptr, IID_PPV_ARGS(&pParentItem));
-            pFileOp->NewItem(pParentItem, FILE_ATTRIBUTE_DIRECTORY, letter.c_str(), nullptr, nullptr);
-        }
-        createdFolders.push_back(folderPath);
-    }
-
-    pFileOp->PerformOperations();
-    Sleep(50);
+    LocalFileSystem fs;
+    std::vector<FileEntry> entries = TakeSelectionEntries();
+    QueryEntriesMetadata(fs, entries);
 
-    CComPtr<IFileOperation> pMoveOp;
-    hr = pMoveOp.CoCreateInstance(CLSID_FileOperation);
-    if (FAILED(hr)) return hr;
+    std::wstring baseName = GetCommonPrefix(m_selectedFiles);
+    if (baseName == L"New Folder")
+        baseName = L"New Archive";
+    std::wstring archivePath = GenerateUniqueFilePath(fs, m_parentFolder, SanitizeFolderName(baseName), L".zip");
 
-    pMoveOp->SetOperationFlags(FOF_ALLOWUNDO | FOF_NOCONFIRMMKDIR | FOFX_ADDUNDORECORD);
+    ArchiveResult result;
+    if (!CreateZipArchive(fs, archivePath, entries, result))
+        return E_FAIL;
 
-    for (auto& [letter, files] : groups)
-    {
-        std::wstring folderPath = m_parentFolder + L"\\" + letter;
-        CComPtr<IShellItem> pDestFolder;
-        if (FAILED(SHCreateItemFromParsingName(folderPath.c_str(), nullptr, IID_PPV_ARGS(&pDestFolder))))
-            continue;
+    SHChangeNotify(SHCNE_CREATE, SHCNF_PATHW | SHCNF_FLUSH, archivePath.c_str(), nullptr);
+    SelectFolderInExplorer(archivePath);
+    return result.failed == 0 ? S_OK : E_FAIL;
+}
 
-        for (const auto& file : files)
-        {
-            CComPtr<IShellItem> pItem;
-            if (SUCCEEDED(SHCreateItemFromParsingName(file.c_str(), nullptr, IID_PPV_ARGS(&pItem))))
-                pMoveOp->MoveItem(pItem, pDestFolder, nullptr, nullptr);
-        }
-    }
+// One worker for the whole process, in a single-threaded apartment of its own (IFileOperation,
+// the folder picker and the shell window enumeration all want an STA). The DLL is pinned
+// once a job has been posted, so an idle worker exiting can never race DllCanUnloadNow.
+static JobQueue& GetBackgroundQueue()
+{
+    static JobQueue* queue = []() {
+        HMODULE module = nullptr;
+        GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_PIN,
+            reinterpret_cast<LPCWSTR>(&GetBackgroundQueue), &module);
+        JobQueue::ThreadHooks hooks;
+        hooks.start = []() { CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE); };
+        hooks.exit = []() { CoUninitialize(); };
+        // Never destroyed: joining a thread from DllMain at process exit would deadlock
+        return new JobQueue(hooks);
+    }();
+    return *queue;
+}
 
-    hr = pMoveOp->PerformOperations();
-    SelectMultipleFoldersInExplorer(createdFolders);
-    return hr;
+// Metadata for the selection while the user is still in the menu, at background CPU and
+// I/O priority. Skipped when a command is already running: the pre-plan would only queue
+// behind it and delay the next one.
+void NewFolderFromFilesContextMenuHandler::StartPrePlanner()
+{
+    JobQueue& queue = GetBackgroundQueue();
+    if (m_prePlanner || queue.Pending() > 0)
+        return;
+
+    m_prePlanner = std::make_shared<SelectionPrePlanner>(m_selectedFiles);
+    std::shared_ptr<SelectionPrePlanner> prePlanner = m_prePlanner;
+    queue.Post([prePlanner]() {
+        SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+        LocalFileSystem fs;
+        prePlanner->Run(fs, SelectionPrePlanner::Budget());
+        SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_END);
+    });
 }
 
+// Explorer's UI thread only snapshots the selection into a handler of its own and queues it;
+// planning, file operations and selecting the results happen on the background worker
 HRESULT STDMETHODCALLTYPE NewFolderFromFilesContextMenuHandler::InvokeCommand(LPCMINVOKECOMMANDINFO pici)
 {
     if (HIWORD(pici->lpVerb) != 0)
         return E_INVALIDARG;
 
     UINT cmd = LOWORD(pici->lpVerb);
+    if (cmd >= CMD_COUNT || m_selectedFiles.empty())
+        return E_INVALIDARG;
 
+    NewFolderFromFilesContextMenuHandler* job = new (std::nothrow) NewFolderFromFilesContextMenuHandler();
+    if (!job)
+        return E_OUTOFMEMORY;
+    job->m_selectedFiles = m_selectedFiles;
+    job->m_parentFolder = m_parentFolder;
+    job->m_copyToFolder = (pici->fMask & CMIC_MASK_SHIFT_DOWN) != 0;
+    job->m_invokeWindow = pici->hwnd;
+    job->m_config = m_config;
+    // Stop gathering now so the job, queued behind the pre-plan, starts at once
+    if (m_prePlanner)
+    {
+        m_prePlanner->Cancel();
+        job->m_prePlanner = m_prePlanner;
+    }
+
+    // The job's reference keeps the DLL loaded (g_cObjCount) until it has run
+    GetBackgroundQueue().Post([job, cmd]() {
+        job->RunCommand(cmd);
+        job->Release();
+    });
+    return S_OK;
+}
+
+HRESULT NewFolderFromFilesContextMenuHandler::RunCommand(UINT cmd)
+{
     switch (cmd)
     {
     case CMD_DEFAULT:
@@ -925,11 +740,81 @@ HRESULT STDMETHODCALLTYPE NewFolderFromFilesContextMenuHandler::InvokeCommand(LP
         return ExecuteOrganize(OrganizeMode::Numbered);
     case CMD_ALPHABETICAL:
         return ExecuteOrganize(OrganizeMode::Alphabetical);
+    case CMD_BY_RULES:
+        return ExecuteOrganize(OrganizeMode::ByRules);
+    case CMD_NESTED_YM:
+        return ExecuteTemplate(L"{yyyy}\\{MM}");
+    case CMD_NESTED_YMT:
+        return ExecuteTemplate(L"{yyyy}\\{MM}\\{category}");
+    case CMD_NESTED_TE:
+        return ExecuteTemplate(L"{category}\\{ext}");
+    case CMD_NESTED_TY:
+        return ExecuteTemplate(L"{category}\\{yyyy}");
+    case CMD_BY_SEQUENCE:
+        return ExecuteOrganize(OrganizeMode::BySequence);
+    case CMD_BY_SIMILAR:
+        return ExecuteOrganize(OrganizeMode::BySimilarName);
+    case CMD_BY_ORIENTATION:
+        return ExecuteOrganize(OrganizeMode::ByOrientation);
+    case CMD_BY_RESOLUTION:
+        return ExecuteOrganize(OrganizeMode::ByResolution);
+    case CMD_BY_ARTIST:
+        return ExecuteOrganize(OrganizeMode::ByArtist);
+    case CMD_BY_ARTIST_ALBUM:
+        return ExecuteOrganize(OrganizeMode::ByArtistAlbum);
+    case CMD_NEW_ARCHIVE:
+        return CreateArchive();
     default:
         return E_INVALIDARG;
     }
 }
 
+// Off unless ShowGroupCounts (DWORD) is 1: the counts cost a pass over the names on
+// Explorer's UI thread
+static bool LoadShowGroupCounts()
+{
+    DWORD value = 0;
+    DWORD size = sizeof(value);
+    return RegGetValueW(HKEY_CURRENT_USER, REG_KEY, REG_SHOW_GROUP_COUNTS, RRF_RT_REG_DWORD, nullptr, &value, &size) == ERROR_SUCCESS &&
+        value == 1;
+}
+
+// 3102 -> "3,102" with the user's digit grouping
+static std::wstring FormatCount(size_t count)
+{
+    wchar_t thousand[8] = L",";
+    GetLocaleInfoEx(LOCALE_NAME_USER_DEFAULT, LOCALE_STHOUSAND, thousand, ARRAYSIZE(thousand));
+    NUMBERFMTW format = {};
+    format.Grouping = 3;
+    format.lpDecimalSep = const_cast<LPWSTR>(L".");
+    format.lpThousandSep = thousand;
+    wchar_t text[32];
+    if (!GetNumberFormatEx(LOCALE_NAME_USER_DEFAULT, 0, std::to_wstring(count).c_str(), &format, text, ARRAYSIZE(text)))
+        return std::to_wstring(count);
+    return text;
+}
+
+// "By Type (Photo 3,102, Video 88, ...)" with a middle dot: the largest categories, from the names alone
+static std::wstring FormatTypeLabel(const std::vector<std::wstring>& selection)
+{
+    const size_t kMaxNames = 20000;
+    const size_t kMaxParts = 3;
+    if (selection.size() > kMaxNames)
+        return L"By Type";
+
+    std::vector<std::pair<std::wstring, size_t>> counts = CountFileTypes(selection);
+    std::wstring label = L"By Type (";
+    for (size_t i = 0; i < counts.size() && i < kMaxParts; i++)
+    {
+        if (i > 0)
+            label += L" \u00B7 ";
+        label += counts[i].first + L" " + FormatCount(counts[i].second);
+    }
+    if (counts.size() > kMaxParts)
+        label += L" \u2026";
+    return label + L")";
+}
+
 HRESULT STDMETHODCALLTYPE NewFolderFromFilesContextMenuHandler::QueryContextMenu(
     HMENU hmenu, UINT indexMenu, UINT idCmdFirst, UINT idCmdLast, UINT uFlags)
 {
@@ -946,6 +831,7 @@ HRESULT STDMETHODCALLTYPE NewFolderFromFilesContextMenuHandler::QueryContextMenu
     
     // Submenu items
     AppendMenuW(hSubMenu, MF_STRING, idCmdFirst + CMD_SUBMENU_DEFAULT, L"New folder with selection");
+    AppendMenuW(hSubMenu, MF_STRING, idCmdFirst + CMD_NEW_ARCHIVE, L"New archive with selection");
     AppendMenuW(hSubMenu, MF_SEPARATOR, 0, nullptr);
     
     // Date submenu
@@ -957,14 +843,42 @@ HRESULT STDMETHODCALLTYPE NewFolderFromFilesContextMenuHandler::QueryContextMenu
     AppendMenuW(hDateMenu, MF_STRING, idCmdFirst + CMD_BY_FULLDATE, L"Full Date");
     AppendMenuW(hSubMenu, MF_POPUP, (UINT_PTR)hDateMenu, L"By Date");
     
-    AppendMenuW(hSubMenu, MF_STRING, idCmdFirst + CMD_BY_TYPE, L"By Type");
+    std::wstring typeLabel = LoadShowGroupCounts() ? FormatTypeLabel(m_selectedFiles) : L"By Type";
+    AppendMenuW(hSubMenu, MF_STRING, idCmdFirst + CMD_BY_TYPE, typeLabel.c_str());
     AppendMenuW(hSubMenu, MF_STRING, idCmdFirst + CMD_BY_EXTENSION, L"By Extension");
     AppendMenuW(hSubMenu, MF_STRING, idCmdFirst + CMD_BY_SIZE, L"By Size");
+
+    HMENU hImageMenu = CreatePopupMenu();
+    AppendMenuW(hImageMenu, MF_STRING, idCmdFirst + CMD_BY_ORIENTATION, L"Orientation");
+    AppendMenuW(hImageMenu, MF_STRING, idCmdFirst + CMD_BY_RESOLUTION, L"Resolution");
+    AppendMenuW(hSubMenu, MF_POPUP, (UINT_PTR)hImageMenu, L"By Image");
+
+    HMENU hMusicMenu = CreatePopupMenu();
+    AppendMenuW(hMusicMenu, MF_STRING, idCmdFirst + CMD_BY_ARTIST, L"Artist");
+    AppendMenuW(hMusicMenu, MF_STRING, idCmdFirst + CMD_BY_ARTIST_ALBUM, L"Artist \\ Album");
+    AppendMenuW(hSubMenu, MF_POPUP, (UINT_PTR)hMusicMenu, L"By Artist");
+
+    HMENU hNestedMenu = CreatePopupMenu();
+    AppendMenuW(hNestedMenu, MF_STRING, idCmdFirst + CMD_NESTED_YM, L"Year \\ Month");
+    AppendMenuW(hNestedMenu, MF_STRING, idCmdFirst + CMD_NESTED_YMT, L"Year \\ Month \\ Type");
+    AppendMenuW(hNestedMenu, MF_STRING, idCmdFirst + CMD_NESTED_TE, L"Type \\ Extension");
+    AppendMenuW(hNestedMenu, MF_STRING, idCmdFirst + CMD_NESTED_TY, L"Type \\ Year");
+    AppendMenuW(hSubMenu, MF_POPUP, (UINT_PTR)hNestedMenu, L"Nested");
+    AppendMenuW(hSubMenu, MF_STRING, idCmdFirst + CMD_BY_SEQUENCE, L"By Sequence");
+    AppendMenuW(hSubMenu, MF_STRING, idCmdFirst + CMD_BY_SIMILAR, L"By Similar Name");
     AppendMenuW(hSubMenu, MF_SEPARATOR, 0, nullptr);
     AppendMenuW(hSubMenu, MF_STRING, idCmdFirst + CMD_FLATTEN, L"Flatten");
     AppendMenuW(hSubMenu, MF_STRING, idCmdFirst + CMD_NUMBERED, L"Numbered");
     AppendMenuW(hSubMenu, MF_STRING, idCmdFirst + CMD_ALPHABETICAL, L"Alphabetical");
 
+    // Only offered once the user has written a rules file
+    m_config = RefreshSharedConfig();
+    if (m_config && m_config->HasRules())
+    {
+        AppendMenuW(hSubMenu, MF_SEPARATOR, 0, nullptr);
+        AppendMenuW(hSubMenu, MF_STRING, idCmdFirst + CMD_BY_RULES, L"By Rules");
+    }
+
     // Main menu item with submenu
     MENUITEMINFOW mii = {};
     mii.cbSize = sizeof(MENUITEMINFOW);
@@ -977,5 +891,6 @@ HRESULT STDMETHODCALLTYPE NewFolderFromFilesContextMenuHandler::QueryContextMenu
     if (!InsertMenuItemW(hmenu, indexMenu, TRUE, &mii))
         return HRESULT_FROM_WIN32(GetLastError());
 
+    StartPrePlanner();
     return MAKE_HRESULT(SEVERITY_SUCCESS, FACILITY_NULL, CMD_COUNT);
 }
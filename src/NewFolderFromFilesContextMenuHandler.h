@@ -3,29 +3,15 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <memory>
+#include "OrganizeTypes.h"
+#include "FileSystem.h"
 
 extern UINT g_cObjCount;
 
-enum class OrganizeMode
-{
-    Default = 0,
-    ByDay,
-    ByMonth,
-    ByYear,
-    ByMonthYear,
-    ByFullDate,
-    ByTypeVideo,
-    ByTypePhoto,
-    ByTypeAudio,
-    ByTypeDocument,
-    ByTypeOther,
-    ByExtension,
-    BySize,
-    Flatten,
-    Numbered,
-    Alphabetical,
-    COUNT
-};
+class ConfigSnapshot;
+class SelectionPrePlanner;
+struct SelectionPartition;
 
 class NewFolderFromFilesContextMenuHandler : public IShellExtInit, public IContextMenu
 {
@@ -34,6 +20,10 @@ protected:
     std::vector<std::wstring> m_selectedFiles;
     std::wstring m_parentFolder;
     UINT m_idCmdFirst;
+    bool m_copyToFolder;   // Shift held at invoke: copy into a picked folder instead of moving
+    HWND m_invokeWindow;
+    std::shared_ptr<const ConfigSnapshot> m_config;  // Compiled rules shared across instances (SharedConfig.h)
+    std::shared_ptr<SelectionPrePlanner> m_prePlanner;  // Started by QueryContextMenu, handed to the job
     ~NewFolderFromFilesContextMenuHandler();
 
 public:
@@ -53,23 +43,20 @@ public:
     HRESULT STDMETHODCALLTYPE QueryContextMenu(HMENU hmenu, UINT indexMenu, UINT idCmdFirst, UINT idCmdLast, UINT uFlags);
 
 private:
-    std::wstring GetCommonPrefix();
-    std::wstring GenerateUniqueFolderName(const std::wstring& baseName);
-    std::wstring GenerateUniqueFolderPath(const std::wstring& parent, const std::wstring& baseName);
-    HRESULT ExecuteOrganize(OrganizeMode mode);
-    HRESULT OrganizeDefault();
-    HRESULT OrganizeByDate(OrganizeMode mode);
-    HRESULT OrganizeByType();
-    HRESULT OrganizeByExtension();
-    HRESULT OrganizeBySize();
-    HRESULT OrganizeFlatten();
-    HRESULT OrganizeNumbered();
-    HRESULT OrganizeAlphabetical();
-    
-    std::wstring GetFileTypeCategory(const std::wstring& path);
-    std::wstring GetFileDateFolder(const std::wstring& path, OrganizeMode mode);
-    std::wstring GetFileSizeCategory(const std::wstring& path);
-    std::wstring GetFileExtension(const std::wstring& path);
+    // Runs on the background worker, on a snapshot handler made by InvokeCommand
+    HRESULT RunCommand(UINT cmd);
+    // The selection as entries, with whatever the pre-planner gathered while the menu was open
+    std::vector<FileEntry> TakeSelectionEntries();
+    void StartPrePlanner();
+    HRESULT ExecuteOrganize(OrganizeMode mode, OrganizeOptions options = OrganizeOptions());
+    // A selection spanning folders: every part organized in its own folder, devices in parallel
+    HRESULT ExecutePartitions(OrganizeMode mode, const OrganizeOptions& options, std::vector<SelectionPartition>& parts);
+    HRESULT ExecuteTemplate(const wchar_t* destinationTemplate);
+    HRESULT CreatePlannedFolders(IFileSystem& fs, const OrganizePlan& plan);
+    // Both settle name conflicts (ResolveConflicts) first, which prunes and renames plan items
+    HRESULT PerformPlan(IFileSystem& fs, const std::vector<FileEntry>& entries, OrganizePlan& plan);
+    HRESULT CopyPlan(IFileSystem& fs, const std::vector<FileEntry>& entries, OrganizePlan& plan);
+    HRESULT CreateArchive();
     void SelectFolderInExplorer(const std::wstring& folderPath);
     void SelectMultipleFoldersInExplorer(const std::vector<std::wstring>& folders);
 };
@@ -0,0 +1,192 @@
+#include "OrganizeConflicts.h"
+#include "CaseFold.h"
+#include "OrganizeExecutor.h"
+#include "OrganizePlanner.h"
+#include <cstring>
+#include <unordered_map>
+
+static const char* const kConflictPolicyNames[] = { "none", "rename", "skip", "newer", "keep-both" };
+
+const char* GetConflictPolicyName(ConflictPolicy policy)
+{
+    size_t index = static_cast<size_t>(policy);
+    return index < sizeof(kConflictPolicyNames) / sizeof(kConflictPolicyNames[0]) ? kConflictPolicyNames[index] : "unknown";
+}
+
+bool ParseConflictPolicy(const char* name, ConflictPolicy& policy)
+{
+    for (size_t i = 0; i < sizeof(kConflictPolicyNames) / sizeof(kConflictPolicyNames[0]); i++)
+    {
+        if (strcmp(name, kConflictPolicyNames[i]) == 0)
+        {
+            policy = static_cast<ConflictPolicy>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace
+{
+    // Who holds a name in a destination: a file that was there before, or a planned item
+    struct Occupant
+    {
+        FileEntry* existing = nullptr;  // Listing entry; null for a planned item
+        size_t group = 0;
+        size_t item = 0;                // Position in the group's items
+    };
+
+    // One destination folder: its listing and every name taken so far
+    struct Destination
+    {
+        std::vector<FileEntry> listing;
+        // Names as the filesystem compares them: case-insensitive on Windows
+        std::unordered_map<std::wstring, Occupant, PathKeyHash, PathKeyEqual> names;
+        std::unordered_map<std::wstring, int, PathKeyHash, PathKeyEqual> nextSuffix;  // Per base name, so renames stay O(1) amortized
+    };
+}
+
+static bool EnsureMetadata(IFileSystem& fs, FileEntry& entry)
+{
+    return entry.hasMetadata || fs.QueryMetadata(entry) == FsResult::Ok;
+}
+
+// "Name (2).ext", "Name (3).ext", ... first one not taken in the destination
+static std::wstring TakeSuffixedName(Destination& destination, const std::wstring& name, bool isDirectory, const Occupant& occupant)
+{
+    std::wstring stem = isDirectory ? name : PathStem(name);
+    std::wstring extension = name.substr(stem.size());
+    int& next = destination.nextSuffix[name];
+    if (next < 2)
+        next = 2;
+
+    for (;; next++)
+    {
+        std::wstring candidate = stem + L" (" + std::to_wstring(next) + L")" + extension;
+        if (destination.names.emplace(candidate, occupant).second)
+        {
+            next++;
+            return candidate;
+        }
+    }
+}
+
+ConflictSummary ResolveConflicts(IFileSystem& fs, const std::vector<FileEntry>& entries, OrganizePlan& plan,
+    const std::vector<std::wstring>& destinations, ConflictPolicy policy)
+{
+    ConflictSummary summary;
+    if (policy == ConflictPolicy::None)
+        return summary;
+
+    // Metadata of the planned entries, filled on first use (OverwriteIfNewer and size checks)
+    std::vector<FileEntry> incoming(entries.begin(), entries.end());
+
+    // Groups that share a destination (flat plans merging into one folder) share its names
+    std::unordered_map<std::wstring, Destination, PathKeyHash, PathKeyEqual> folders;
+    std::vector<std::vector<uint8_t>> keep(plan.groups.size());
+
+    for (size_t g = 0; g < plan.groups.size() && g < destinations.size(); g++)
+    {
+        OrganizeGroup& group = plan.groups[g];
+        const std::wstring& folder = destinations[g];
+        auto [slot, added] = folders.try_emplace(folder);
+        Destination& destination = slot->second;
+        if (added)
+        {
+            // A missing folder (a fresh "Name (N)") simply has no names yet
+            fs.ListDirectory(destinations[g], destination.listing);
+            destination.names.reserve(destination.listing.size() + group.items.size());
+            for (auto& entry : destination.listing)
+                destination.names.emplace(PathFileName(entry.path), Occupant{ &entry, 0, 0 });
+        }
+
+        group.targetNames.resize(group.items.size());
+        group.replaces.assign(group.items.size(), 0);
+        keep[g].assign(group.items.size(), 1);
+
+        for (size_t k = 0; k < group.items.size(); k++)
+        {
+            FileEntry& entry = incoming[group.items[k]];
+            std::wstring name = PathFileName(entry.path);
+            group.targetNames[k] = name;
+
+            // Already in its destination: the executor leaves it alone
+            if (PathKeyEqual()(PathParent(entry.path), folder))
+                continue;
+
+            Occupant self{ nullptr, g, k };
+            auto [held, free] = destination.names.emplace(name, self);
+            if (free)
+                continue;
+
+            summary.conflicts++;
+            Occupant& occupant = held->second;
+            FileEntry* other = occupant.existing ? occupant.existing :
+                &incoming[plan.groups[occupant.group].items[occupant.item]];
+            EnsureMetadata(fs, entry);
+            EnsureMetadata(fs, *other);
+            bool folderInvolved = entry.isDirectory || other->isDirectory;
+
+            ConflictPolicy action = policy;
+            if (policy == ConflictPolicy::KeepBothIfDifferent)
+            {
+                bool same = !folderInvolved && entry.size == other->size && SameFileContent(fs, entry.path, other->path);
+                action = same ? ConflictPolicy::Skip : ConflictPolicy::RenameSuffix;
+            }
+            else if (policy == ConflictPolicy::OverwriteIfNewer && (folderInvolved || entry.lastWriteTime <= other->lastWriteTime))
+            {
+                action = ConflictPolicy::Skip;
+            }
+
+            switch (action)
+            {
+            case ConflictPolicy::RenameSuffix:
+                group.targetNames[k] = TakeSuffixedName(destination, name, entry.isDirectory, self);
+                summary.renamed++;
+                break;
+            case ConflictPolicy::OverwriteIfNewer:
+                if (occupant.existing)
+                {
+                    group.replaces[k] = 1;
+                    summary.replaced++;
+                }
+                else
+                {
+                    // The newer of two planned items wins; it inherits whatever the older one replaced
+                    OrganizeGroup& older = plan.groups[occupant.group];
+                    group.replaces[k] = older.replaces[occupant.item];
+                    keep[occupant.group][occupant.item] = 0;
+                    summary.skipped++;
+                }
+                occupant = self;
+                break;
+            default:
+                keep[g][k] = 0;
+                summary.skipped++;
+                break;
+            }
+        }
+    }
+
+    for (size_t g = 0; g < plan.groups.size() && g < destinations.size(); g++)
+    {
+        OrganizeGroup& group = plan.groups[g];
+        size_t out = 0;
+        for (size_t k = 0; k < group.items.size(); k++)
+        {
+            if (!keep[g][k])
+                continue;
+            if (out != k)
+            {
+                group.items[out] = group.items[k];
+                group.targetNames[out] = std::move(group.targetNames[k]);
+                group.replaces[out] = group.replaces[k];
+            }
+            out++;
+        }
+        group.items.resize(out);
+        group.targetNames.resize(out);
+        group.replaces.resize(out);
+    }
+    return summary;
+}
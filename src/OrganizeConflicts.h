@@ -0,0 +1,28 @@
+#pragma once
+#include "FileSystem.h"
+
+// Name conflicts, settled before anything moves. Each destination folder is listed
+// once and its names go into a hash set together with the names the plan sends there,
+// so clashes with what is already on disk and clashes inside the plan itself (Flatten
+// pulling two "notes.txt" out of different folders) are both found in one pass. Items
+// are taken in plan order, which makes the outcome the same on every run.
+
+struct ConflictSummary
+{
+    size_t conflicts = 0;  // Items whose name was taken
+    size_t renamed = 0;
+    size_t skipped = 0;    // Items dropped from the plan (stay where they are)
+    size_t replaced = 0;   // Items that replace an existing file
+};
+
+// Stable lowercase identifiers ("rename", "skip", "newer", "keep-both", "none")
+const char* GetConflictPolicyName(ConflictPolicy policy);
+bool ParseConflictPolicy(const char* name, ConflictPolicy& policy);
+
+// Applies policy to every conflict of plan, whose groups go to destinations
+// (ResolveDestinations). Afterwards each group's items holds only entries that move,
+// with targetNames and replaces filled in for ExecuteOrganizePlan. Folders are never
+// replaced: OverwriteIfNewer skips them and KeepBothIfDifferent renames them.
+// ConflictPolicy::None leaves the plan untouched.
+ConflictSummary ResolveConflicts(IFileSystem& fs, const std::vector<FileEntry>& entries, OrganizePlan& plan,
+    const std::vector<std::wstring>& destinations, ConflictPolicy policy);
@@ -0,0 +1,460 @@
+#include "OrganizeExecutor.h"
+#include "MediaMetadata.h"
+#include "NaturalSort.h"
+#include "OrganizePlanner.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+std::wstring GenerateUniqueFolderPath(IFileSystem& fs, const std::wstring& parent, const std::wstring& baseName)
+{
+    std::wstring folderPath = JoinPath(parent, baseName);
+
+    if (!fs.PathExists(folderPath))
+        return folderPath;
+
+    for (int i = 2; i < 1000; i++)
+    {
+        folderPath = JoinPath(parent, baseName + L" (" + std::to_wstring(i) + L")");
+
+        if (!fs.PathExists(folderPath))
+            return folderPath;
+    }
+
+    return JoinPath(parent, L"New Folder");
+}
+
+std::wstring GenerateUniqueFilePath(IFileSystem& fs, const std::wstring& parent, const std::wstring& baseName,
+    const std::wstring& extension)
+{
+    std::wstring filePath = JoinPath(parent, baseName + extension);
+
+    if (!fs.PathExists(filePath))
+        return filePath;
+
+    for (int i = 2; i < 1000; i++)
+    {
+        filePath = JoinPath(parent, baseName + L" (" + std::to_wstring(i) + L")" + extension);
+
+        if (!fs.PathExists(filePath))
+            return filePath;
+    }
+
+    return JoinPath(parent, L"New Archive" + extension);
+}
+
+std::vector<FileEntry> ExpandFolderContents(IFileSystem& fs, const std::vector<FileEntry>& entries)
+{
+    std::vector<FileEntry> allFiles;
+
+    for (const auto& entry : entries)
+    {
+        FileEntry item = entry;
+        if (!item.hasMetadata && fs.QueryMetadata(item) != FsResult::Ok)
+            continue;
+
+        if (!item.isDirectory)
+        {
+            allFiles.push_back(std::move(item));
+            continue;
+        }
+
+        std::vector<FileEntry> children;
+        if (fs.ListDirectory(item.path, children) != FsResult::Ok)
+            continue;
+        SortEntriesNatural(children);
+
+        for (auto& child : children)
+        {
+            if (!child.isDirectory)
+                allFiles.push_back(std::move(child));
+        }
+    }
+
+    return allFiles;
+}
+
+size_t QueryEntriesMetadata(IFileSystem& fs, std::vector<FileEntry>& entries)
+{
+    std::vector<FileEntry*> missing;
+    for (auto& entry : entries)
+    {
+        if (!entry.hasMetadata)
+            missing.push_back(&entry);
+    }
+
+    std::vector<FsResult> results;
+    fs.QueryMetadataBatch(missing, results);
+    return static_cast<size_t>(std::count_if(results.begin(), results.end(), [](FsResult r) { return r != FsResult::Ok; }));
+}
+
+// Fields the file's type can carry
+static unsigned MediaFieldsForFile(const std::wstring& path, unsigned fields)
+{
+    std::wstring category = GetFileTypeCategory(path);
+    if (category == L"Photo")
+        return fields & MediaImageSize;
+    if (category == L"Audio")
+        return fields & MediaAudioTags;
+    if (category == L"Video")
+        return fields & MediaCreationTime;
+    return MediaNone;
+}
+
+static bool ReadMediaInfo(IFileSystem& fs, const std::wstring& path, unsigned fields, MediaInfo& info)
+{
+    std::unique_ptr<IFileReader> reader;
+    if (fs.OpenReader(path, reader) != FsResult::Ok)
+        return false;
+
+    bool found = false;
+    HeaderCursor cursor(*reader);
+    if (fields & MediaImageSize)
+        found |= ReadImageSize(cursor, info.width, info.height);
+    if (fields & MediaAudioTags)
+        found |= ReadAudioTags(cursor, info.artist, info.album);
+    if (fields & MediaCreationTime)
+        found |= ReadVideoCreationTime(cursor, info.creationTime);
+    return found;
+}
+
+size_t QueryEntriesMediaInfo(IFileSystem& fs, std::vector<FileEntry>& entries, unsigned fields, unsigned threads)
+{
+    std::vector<std::pair<size_t, unsigned>> work;
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        unsigned wanted = entries[i].isDirectory ? MediaNone : MediaFieldsForFile(entries[i].path, fields);
+        if (wanted != MediaNone)
+            work.emplace_back(i, wanted);
+    }
+    if (work.empty())
+        return 0;
+
+    // Header reads are small and latency bound; overlap more of them than there are cores
+    if (threads == 0)
+        threads = std::max(4u, std::min(32u, 2 * std::thread::hardware_concurrency()));
+    const size_t kBatch = 32;
+    threads = static_cast<unsigned>(std::min<size_t>(threads, (work.size() + kBatch - 1) / kBatch));
+
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> found(0);
+    auto worker = [&]() {
+        for (;;)
+        {
+            size_t start = next.fetch_add(kBatch);
+            if (start >= work.size())
+                break;
+            size_t end = std::min(start + kBatch, work.size());
+            for (size_t w = start; w < end; w++)
+            {
+                FileEntry& entry = entries[work[w].first];
+                auto info = std::make_shared<MediaInfo>();
+                if (ReadMediaInfo(fs, entry.path, work[w].second, *info))
+                {
+                    entry.media = std::move(info);
+                    found++;
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; t++)
+        pool.emplace_back(worker);
+    worker();
+    for (auto& thread : pool)
+        thread.join();
+    return found;
+}
+
+std::vector<std::wstring> ResolveDestinations(IFileSystem& fs, const std::wstring& parent, const OrganizePlan& plan)
+{
+    std::vector<std::wstring> destinations;
+    destinations.reserve(plan.groups.size());
+
+    for (const auto& group : plan.groups)
+    {
+        if (group.folderName.empty())
+            destinations.push_back(parent);
+        else if (group.uniqueName)
+            destinations.push_back(GenerateUniqueFolderPath(fs, parent, group.folderName));
+        else
+            destinations.push_back(JoinPath(parent, group.folderName));
+    }
+
+    return destinations;
+}
+
+struct CopyJob
+{
+    std::wstring source;
+    std::wstring target;
+    uint64_t size;
+    size_t slot;  // Selected entry the file belongs to
+    bool replace = false;  // Over an existing file (ResolveConflicts): copied aside, then swapped in
+};
+
+// Folders are recreated here, on the calling thread; their files become jobs
+static bool CollectCopyJobs(IFileSystem& fs, const FileEntry& entry, const std::wstring& target, size_t slot, std::vector<CopyJob>& jobs)
+{
+    if (!entry.isDirectory)
+    {
+        jobs.push_back({ entry.path, target, entry.size, slot, false });
+        return true;
+    }
+
+    std::vector<FileEntry> children;
+    if (fs.CreateFolder(target) != FsResult::Ok || fs.ListDirectory(entry.path, children) != FsResult::Ok)
+        return false;
+    bool ok = true;
+    for (auto& child : children)
+    {
+        // Sizes order the jobs; listings without metadata need a stat
+        if (!child.hasMetadata && !child.isDirectory)
+            fs.QueryMetadata(child);
+        ok &= CollectCopyJobs(fs, child, JoinPath(target, PathFileName(child.path)), slot, jobs);
+    }
+    return ok;
+}
+
+bool SameFileContent(IFileSystem& fs, const std::wstring& a, const std::wstring& b)
+{
+    std::unique_ptr<IFileReader> readerA, readerB;
+    if (fs.OpenReader(a, readerA) != FsResult::Ok || fs.OpenReader(b, readerB) != FsResult::Ok ||
+        readerA->Size() != readerB->Size())
+        return false;
+
+    const uint64_t kMaxBlock = 1 << 20;
+    size_t block = static_cast<size_t>(std::max<uint64_t>(1, std::min(kMaxBlock, readerA->Size())));
+    std::vector<uint8_t> blockA(block), blockB(block);
+    for (uint64_t offset = 0; offset < readerA->Size(); offset += block)
+    {
+        size_t readA = 0, readB = 0;
+        if (readerA->Read(offset, blockA.data(), block, readA) != FsResult::Ok ||
+            readerB->Read(offset, blockB.data(), block, readB) != FsResult::Ok ||
+            readA != readB || readA == 0 || memcmp(blockA.data(), blockB.data(), readA) != 0)
+            return false;
+    }
+    return true;
+}
+
+// Replacing copies are written next to the file they replace
+static std::wstring PartialCopyPath(const std::wstring& target)
+{
+    return target + L".nffpartial";
+}
+
+// Moves handed to IFileSystem::MoveEntries at once
+const size_t kMoveBatch = 1024;
+
+const char kSlotDone = 0;
+const char kSlotFailed = 1;
+const char kSlotSkipped = 2;  // Cancelled before all of its files were copied
+
+// Marks the slot of every job that fails or is never run
+static void RunCopyJobs(IFileSystem& fs, std::vector<CopyJob>& jobs, const ExecuteOptions& options, std::vector<char>& slotState,
+    bool& cancelled)
+{
+    if (jobs.empty())
+        return;
+
+    // Largest first, so a big file never starts last and runs alone
+    std::stable_sort(jobs.begin(), jobs.end(), [](const CopyJob& a, const CopyJob& b) { return a.size > b.size; });
+
+    unsigned threads = options.threads;
+    if (threads == 0)
+        threads = std::max(2u, std::min(8u, std::thread::hardware_concurrency()));
+    threads = static_cast<unsigned>(std::min<size_t>(threads, jobs.size()));
+
+    std::vector<char> jobState(jobs.size(), kSlotSkipped);
+    std::atomic<size_t> next(0);
+    std::atomic<bool> stop(false);
+    std::mutex progressMutex;
+    size_t done = 0;
+    auto worker = [&]() {
+        for (size_t j = next++; j < jobs.size() && !stop; j = next++)
+        {
+            const CopyJob& job = jobs[j];
+            std::wstring copyPath = job.replace ? PartialCopyPath(job.target) : job.target;
+            bool ok = fs.CopyEntry(job.source, copyPath) == FsResult::Ok &&
+                (!options.verify || SameFileContent(fs, job.source, copyPath));
+            jobState[j] = ok ? kSlotDone : kSlotFailed;
+            if (options.progress)
+            {
+                std::lock_guard<std::mutex> lock(progressMutex);
+                if (!options.progress(++done, jobs.size()))
+                    stop = true;
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; t++)
+        pool.emplace_back(worker);
+    worker();
+    for (auto& thread : pool)
+        thread.join();
+    if (stop)
+        cancelled = true;
+
+    for (size_t j = 0; j < jobs.size(); j++)
+    {
+        // Replacements are swapped in here, one thread at a time like every other change
+        if (jobs[j].replace && jobState[j] != kSlotSkipped)
+        {
+            std::wstring copyPath = PartialCopyPath(jobs[j].target);
+            if (jobState[j] == kSlotFailed || fs.ReplaceEntry(copyPath, jobs[j].target) != FsResult::Ok)
+            {
+                fs.DeleteEntry(copyPath);
+                jobState[j] = kSlotFailed;
+            }
+        }
+        char& slot = slotState[jobs[j].slot];
+        if (jobState[j] == kSlotFailed || (jobState[j] == kSlotSkipped && slot == kSlotDone))
+            slot = jobState[j];
+    }
+}
+
+void ExecuteOrganizePlan(IFileSystem& fs, const std::wstring& parent, const std::vector<FileEntry>& entries,
+    const OrganizePlan& plan, const std::vector<std::wstring>& destinations, OrganizeResult& result,
+    const ExecuteOptions& options)
+{
+    result.folders = destinations;
+
+    // Nested plans: each folder is created once, parents first, one batch per depth.
+    // CreateFolder reports existing folders itself, so nothing is probed beforehand,
+    // and a failed folder fails its whole subtree without touching the disk again.
+    std::vector<bool> folderCreated(plan.folders.size(), false);
+    std::vector<size_t> depth(plan.folders.size(), 0);
+    size_t maxDepth = 0;
+    for (size_t f = 0; f < plan.folders.size(); f++)
+    {
+        if (plan.folders[f].parent >= 0)
+            depth[f] = depth[plan.folders[f].parent] + 1;
+        maxDepth = std::max(maxDepth, depth[f]);
+    }
+    std::vector<size_t> wave;
+    std::vector<std::wstring> wavePaths;
+    std::vector<FsResult> waveResults;
+    for (size_t level = 0; level <= maxDepth && !plan.folders.empty(); level++)
+    {
+        wave.clear();
+        wavePaths.clear();
+        for (size_t f = 0; f < plan.folders.size(); f++)
+        {
+            const auto& folder = plan.folders[f];
+            if (depth[f] == level && (folder.parent < 0 || folderCreated[folder.parent]))
+            {
+                wave.push_back(f);
+                wavePaths.push_back(JoinPath(parent, folder.relativePath));
+            }
+        }
+        fs.CreateFolders(wavePaths, waveResults);
+        for (size_t i = 0; i < wave.size(); i++)
+            folderCreated[wave[i]] = waveResults[i] == FsResult::Ok || waveResults[i] == FsResult::AlreadyExists;
+    }
+
+    // Flat plans: every group's folder in one batch
+    std::vector<bool> groupReady(plan.groups.size(), true);
+    wave.clear();
+    wavePaths.clear();
+    for (size_t g = 0; g < plan.groups.size() && g < destinations.size(); g++)
+    {
+        if (plan.groups[g].folder >= 0)
+        {
+            groupReady[g] = folderCreated[plan.groups[g].folder];
+        }
+        else if (destinations[g] != parent)
+        {
+            wave.push_back(g);
+            wavePaths.push_back(destinations[g]);
+        }
+    }
+    fs.CreateFolders(wavePaths, waveResults);
+    for (size_t i = 0; i < wave.size(); i++)
+        groupReady[wave[i]] = waveResults[i] == FsResult::Ok || waveResults[i] == FsResult::AlreadyExists;
+
+    // Copy mode: one slot per selected entry, its files copied after all folders exist
+    std::vector<CopyJob> copies;
+    std::vector<char> slotState;
+
+    size_t total = 0, done = 0;
+    for (const auto& group : plan.groups)
+        total += group.items.size();
+
+    // Moves go to the filesystem in batches; progress is reported per entry after each
+    // batch, and a stop takes effect before the next one
+    std::vector<MoveRequest> moves;
+    auto flushMoves = [&]() {
+        fs.MoveEntries(moves);
+        for (const auto& move : moves)
+        {
+            if (move.result == FsResult::Ok)
+                result.moved++;
+            else
+                result.failed++;
+            if (options.progress && !result.cancelled && !options.progress(++done, total))
+                result.cancelled = true;
+        }
+        moves.clear();
+    };
+
+    for (size_t g = 0; g < plan.groups.size() && g < destinations.size() && !result.cancelled; g++)
+    {
+        const auto& group = plan.groups[g];
+        const std::wstring& folderPath = destinations[g];
+
+        if (!groupReady[g])
+        {
+            result.failed += group.items.size();
+            done += group.items.size();
+            continue;
+        }
+
+        for (size_t k = 0; k < group.items.size() && !result.cancelled; k++)
+        {
+            const std::wstring& source = entries[group.items[k]].path;
+            std::wstring target = JoinPath(folderPath, k < group.targetNames.size() ? group.targetNames[k] : PathFileName(source));
+            bool replace = k < group.replaces.size() && group.replaces[k];
+            if (target == source)
+            {
+                done++;
+                continue;
+            }
+
+            if (options.copy)
+            {
+                FileEntry entry = entries[group.items[k]];
+                size_t firstJob = copies.size();
+                bool ok = (entry.hasMetadata || fs.QueryMetadata(entry) == FsResult::Ok) &&
+                    CollectCopyJobs(fs, entry, target, slotState.size(), copies);
+                // A file is one job; a folder's files (0..N jobs) are copied into it and replace nothing
+                if (ok && replace && !entry.isDirectory && copies.size() == firstJob + 1)
+                    copies[firstJob].replace = true;
+                slotState.push_back(ok ? kSlotDone : kSlotFailed);
+                continue;
+            }
+
+            MoveRequest move;
+            move.from = source;
+            move.to = std::move(target);
+            move.replace = replace;
+            moves.push_back(std::move(move));
+            if (moves.size() == kMoveBatch)
+                flushMoves();
+        }
+    }
+    if (!moves.empty())
+        flushMoves();
+
+    RunCopyJobs(fs, copies, options, slotState, result.cancelled);
+    for (char state : slotState)
+    {
+        if (state == kSlotFailed)
+            result.failed++;
+        else if (state == kSlotDone)
+            result.moved++;
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "FileSystem.h"
+#include <functional>
+
+struct OrganizeResult
+{
+    std::vector<std::wstring> folders;  // Destination of each plan group, in plan order
+    size_t moved = 0;   // Entries moved (copied, with ExecuteOptions::copy)
+    size_t failed = 0;
+    bool cancelled = false;  // progress asked to stop; entries not reached count as neither
+};
+
+struct ExecuteOptions
+{
+    bool copy = false;     // Copy into the destinations and leave the originals in place
+    bool verify = false;   // Copy: compare every copy with its source byte for byte afterwards
+    unsigned threads = 0;  // Copy: files copied at once; 0 picks a default
+    // After each entry moved (copy: each file copied, from the copy threads one call at a
+    // time) with the count done and the total; returning false stops before the next one.
+    // Moves run in batches of up to 1024, so a stop lets the current batch finish.
+    std::function<bool(size_t done, size_t total)> progress;
+};
+
+// "Name", "Name (2)", ... first one that does not exist under parent
+std::wstring GenerateUniqueFolderPath(IFileSystem& fs, const std::wstring& parent, const std::wstring& baseName);
+// "Name.zip", "Name (2).zip", ... the same for a new file
+std::wstring GenerateUniqueFilePath(IFileSystem& fs, const std::wstring& parent, const std::wstring& baseName,
+    const std::wstring& extension);
+
+// Byte-for-byte comparison of two files (false when either cannot be read)
+bool SameFileContent(IFileSystem& fs, const std::wstring& a, const std::wstring& b);
+
+// Replace selected folders by the files directly inside them (Flatten)
+std::vector<FileEntry> ExpandFolderContents(IFileSystem& fs, const std::vector<FileEntry>& entries);
+
+// Fill size/time for entries that do not have it yet. Returns the number of failures.
+size_t QueryEntriesMetadata(IFileSystem& fs, std::vector<FileEntry>& entries);
+
+// Reads the requested MediaField facts from file headers (a few KB per file) for
+// the entries whose type carries them, on several threads. threads = 0 picks a
+// default. Returns the number of entries that got media info.
+size_t QueryEntriesMediaInfo(IFileSystem& fs, std::vector<FileEntry>& entries, unsigned fields, unsigned threads = 0);
+
+// Naming phase: absolute destination folder for each plan group
+std::vector<std::wstring> ResolveDestinations(IFileSystem& fs, const std::wstring& parent, const OrganizePlan& plan);
+
+// Execute phase: create destination folders (nested plans: plan.folders, parents first)
+// and move every entry into its group's folder. Copies go through IFileSystem::CopyEntry
+// on several threads, largest files first; selected folders are copied recursively.
+// To copy into a staging area, resolve and execute with the staging folder as parent.
+// Groups resolved by ResolveConflicts (OrganizeConflicts.h) use their targetNames and
+// replace where replaces says so; other groups never overwrite anything.
+void ExecuteOrganizePlan(IFileSystem& fs, const std::wstring& parent, const std::vector<FileEntry>& entries,
+    const OrganizePlan& plan, const std::vector<std::wstring>& destinations, OrganizeResult& result,
+    const ExecuteOptions& options = ExecuteOptions());
@@ -0,0 +1,970 @@
+#include "OrganizePlanner.h"
+#include "CaseFold.h"
+#include "NaturalSort.h"
+#include "OrganizeRules.h"
+#include "OrganizeSequences.h"
+#include "OrganizeSimilarity.h"
+#include <algorithm>
+#include <cwctype>
+#include <cwchar>
+#include <cstring>
+#include <unordered_map>
+
+static bool IsSeparator(wchar_t c)
+{
+    return c == L'\\' || c == L'/';
+}
+
+std::wstring PathFileName(const std::wstring& path)
+{
+    size_t pos = path.find_last_of(L"\\/");
+    return pos == std::wstring::npos ? path : path.substr(pos + 1);
+}
+
+std::wstring PathParent(const std::wstring& path)
+{
+    size_t pos = path.find_last_of(L"\\/");
+    if (pos == std::wstring::npos)
+        return std::wstring();
+    if (pos == 0)
+        return path.substr(0, 1);
+    // Keep the separator of a drive root ("C:\")
+    if (pos == 2 && path[1] == L':')
+        return path.substr(0, 3);
+    return path.substr(0, pos);
+}
+
+// Same rule as PathFindExtensionW: last '.' in the file name, reset by spaces
+static size_t FindExtension(const std::wstring& path)
+{
+    size_t dot = std::wstring::npos;
+    for (size_t i = 0; i < path.length(); i++)
+    {
+        if (IsSeparator(path[i]) || path[i] == L' ')
+            dot = std::wstring::npos;
+        else if (path[i] == L'.')
+            dot = i;
+    }
+    return dot;
+}
+
+std::wstring PathStem(const std::wstring& path)
+{
+    std::wstring name = PathFileName(path);
+    size_t dot = FindExtension(name);
+    return dot == std::wstring::npos ? name : name.substr(0, dot);
+}
+
+std::wstring JoinPath(const std::wstring& parent, const std::wstring& name)
+{
+    if (parent.empty())
+        return name;
+    if (IsSeparator(parent.back()))
+        return parent + name;
+    return parent + kPathSeparator + name;
+}
+
+std::wstring GetCommonPrefix(const std::vector<std::wstring>& paths)
+{
+    if (paths.empty())
+        return L"New Folder";
+
+    std::vector<std::wstring> names;
+    names.reserve(paths.size());
+    for (const auto& path : paths)
+        names.push_back(PathStem(path));
+
+    if (names.size() == 1)
+        return names[0];
+
+    std::wstring prefix = names[0];
+    for (size_t i = 1; i < names.size() && !prefix.empty(); i++)
+    {
+        size_t j = 0;
+        while (j < prefix.length() && j < names[i].length() &&
+            FoldCase(prefix[j]) == FoldCase(names[i][j]))
+            j++;
+        prefix.resize(j);
+    }
+
+    while (!prefix.empty())
+    {
+        wchar_t last = prefix.back();
+        if (last == L' ' || last == L'_' || last == L'-' || last == L'.')
+            prefix.pop_back();
+        else
+            break;
+    }
+
+    return prefix.empty() ? L"New Folder" : prefix;
+}
+
+std::wstring GetFileExtension(const std::wstring& path)
+{
+    size_t dot = FindExtension(path);
+    if (dot != std::wstring::npos)
+    {
+        // Uppercase for consistency: "Jpg" and "JPG" are one group
+        return FoldCase(path.substr(dot + 1));
+    }
+    return L"No Extension";
+}
+
+std::wstring GetFileTypeCategory(const std::wstring& path)
+{
+    // Already case folded (uppercase)
+    std::wstring ext = GetFileExtension(path);
+
+    // Video
+    if (ext == L"MP4" || ext == L"AVI" || ext == L"MKV" || ext == L"MOV" ||
+        ext == L"WMV" || ext == L"FLV" || ext == L"WEBM" || ext == L"M4V" ||
+        ext == L"MPG" || ext == L"MPEG" || ext == L"3GP")
+        return L"Video";
+
+    // Photo
+    if (ext == L"JPG" || ext == L"JPEG" || ext == L"PNG" || ext == L"GIF" ||
+        ext == L"BMP" || ext == L"TIFF" || ext == L"TIF" || ext == L"WEBP" ||
+        ext == L"ICO" || ext == L"SVG" || ext == L"RAW" || ext == L"PSD" ||
+        ext == L"HEIC" || ext == L"HEIF")
+        return L"Photo";
+
+    // Audio
+    if (ext == L"MP3" || ext == L"WAV" || ext == L"FLAC" || ext == L"AAC" ||
+        ext == L"OGG" || ext == L"WMA" || ext == L"M4A" || ext == L"AIFF")
+        return L"Audio";
+
+    // Document
+    if (ext == L"DOC" || ext == L"DOCX" || ext == L"PDF" || ext == L"TXT" ||
+        ext == L"RTF" || ext == L"ODT" || ext == L"XLS" || ext == L"XLSX" ||
+        ext == L"PPT" || ext == L"PPTX" || ext == L"CSV" || ext == L"MD")
+        return L"Document";
+
+    return L"Other";
+}
+
+// FILETIME ticks -> UTC civil date (same result as FileTimeToSystemTime)
+static void TicksToDate(uint64_t ticks, int& year, int& month, int& day)
+{
+    const int64_t kUnixEpochSeconds = 11644473600LL;
+    int64_t seconds = static_cast<int64_t>(ticks / 10000000ULL) - kUnixEpochSeconds;
+    int64_t days = seconds >= 0 ? seconds / 86400 : (seconds - 86399) / 86400;
+
+    // Howard Hinnant's civil_from_days
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    int64_t doe = days - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    day = static_cast<int>(doy - (153 * mp + 2) / 5 + 1);
+    month = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+    year = static_cast<int>(yoe + era * 400 + (month <= 2 ? 1 : 0));
+}
+
+// Capture time read from the file when known (survives copies), else the modified time
+static bool GetEntryDate(const FileEntry& entry, uint64_t& ticks)
+{
+    if (entry.media && entry.media->creationTime)
+        ticks = entry.media->creationTime;
+    else if (entry.hasMetadata)
+        ticks = entry.lastWriteTime;
+    else
+        return false;
+    return true;
+}
+
+std::wstring GetFileDateFolder(const FileEntry& entry, OrganizeMode mode)
+{
+    uint64_t ticks;
+    if (!GetEntryDate(entry, ticks))
+        return L"Unknown Date";
+
+    int year, month, day;
+    TicksToDate(ticks, year, month, day);
+
+    wchar_t buffer[64];
+    switch (mode)
+    {
+    case OrganizeMode::ByDay:
+        swprintf(buffer, 64, L"%02d", day);
+        break;
+    case OrganizeMode::ByMonth:
+        swprintf(buffer, 64, L"%02d", month);
+        break;
+    case OrganizeMode::ByYear:
+        swprintf(buffer, 64, L"%04d", year);
+        break;
+    case OrganizeMode::ByMonthYear:
+        swprintf(buffer, 64, L"%04d-%02d", year, month);
+        break;
+    case OrganizeMode::ByFullDate:
+    default:
+        swprintf(buffer, 64, L"%04d-%02d-%02d", year, month, day);
+        break;
+    }
+    return buffer;
+}
+
+std::wstring GetFileSizeCategory(const FileEntry& entry)
+{
+    if (!entry.hasMetadata)
+        return L"Unknown Size";
+
+    if (entry.size < 1024 * 1024)  // < 1 MB
+        return L"Small (under 1 MB)";
+    else if (entry.size < 100 * 1024 * 1024)  // < 100 MB
+        return L"Medium (1-100 MB)";
+    else
+        return L"Large (over 100 MB)";
+}
+
+std::wstring GetAlphabeticalFolder(const std::wstring& path)
+{
+    std::wstring filename = PathFileName(path);
+    wchar_t letter = filename.empty() ? L'#' : FoldCase(filename[0]);
+    if (!iswalpha(letter))
+        letter = L'#';
+    return std::wstring(1, letter);
+}
+
+std::wstring GetImageOrientationFolder(const FileEntry& entry)
+{
+    if (GetFileTypeCategory(entry.path) != L"Photo")
+        return std::wstring();
+    if (!entry.media || !entry.media->width || !entry.media->height)
+        return L"Unknown Orientation";
+
+    // Within 1% counts as square
+    uint64_t w = entry.media->width, h = entry.media->height;
+    uint64_t larger = w > h ? w : h;
+    if ((w > h ? w - h : h - w) * 100 <= larger)
+        return L"Square";
+    return w > h ? L"Landscape" : L"Portrait";
+}
+
+std::wstring GetImageResolutionFolder(const FileEntry& entry)
+{
+    if (GetFileTypeCategory(entry.path) != L"Photo")
+        return std::wstring();
+    if (!entry.media || !entry.media->width || !entry.media->height)
+        return L"Unknown Resolution";
+
+    uint64_t pixels = static_cast<uint64_t>(entry.media->width) * entry.media->height;
+    if (pixels < 1000000)
+        return L"Under 1 MP";
+    if (pixels < 4000000)
+        return L"1-4 MP";
+    if (pixels < 12000000)
+        return L"4-12 MP";
+    if (pixels < 24000000)
+        return L"12-24 MP";
+    return L"24 MP and up";
+}
+
+// Tag text as a folder name: whitespace runs collapsed, trimmed, length capped
+static std::wstring TagFolderName(const std::wstring& tag)
+{
+    static const size_t kMaxTagFolder = 80;
+    std::wstring name;
+    for (wchar_t c : tag)
+    {
+        if (iswspace(c))
+        {
+            if (!name.empty() && name.back() != L' ')
+                name.push_back(L' ');
+        }
+        else
+        {
+            name.push_back(c);
+        }
+    }
+    if (name.size() > kMaxTagFolder)
+    {
+        // Never split a UTF-16 surrogate pair (wchar_t is 16 bits on Windows)
+        size_t length = kMaxTagFolder;
+        if (sizeof(wchar_t) == 2 && name[length - 1] >= 0xD800 && name[length - 1] <= 0xDBFF)
+            length--;
+        name.resize(length);
+    }
+    return SanitizeFolderName(name);
+}
+
+std::wstring GetAudioArtistFolder(const FileEntry& entry)
+{
+    if (GetFileTypeCategory(entry.path) != L"Audio")
+        return std::wstring();
+    std::wstring name = entry.media ? TagFolderName(entry.media->artist) : std::wstring();
+    return name.empty() ? L"Unknown Artist" : name;
+}
+
+std::wstring GetAudioAlbumFolder(const FileEntry& entry)
+{
+    if (GetFileTypeCategory(entry.path) != L"Audio")
+        return std::wstring();
+    std::wstring name = entry.media ? TagFolderName(entry.media->album) : std::wstring();
+    return name.empty() ? L"Unknown Album" : name;
+}
+
+static bool IsReservedDeviceName(const std::wstring& base)
+{
+    std::wstring upper = FoldCase(base);
+    if (upper == L"CON" || upper == L"PRN" || upper == L"AUX" || upper == L"NUL")
+        return true;
+    return upper.size() == 4 && (upper.compare(0, 3, L"COM") == 0 || upper.compare(0, 3, L"LPT") == 0) &&
+        upper[3] >= L'1' && upper[3] <= L'9';
+}
+
+std::wstring SanitizeFolderName(const std::wstring& name)
+{
+    std::wstring result;
+    result.reserve(name.size());
+    for (wchar_t c : name)
+    {
+        if (c < 32 || wcschr(L"<>:\"/\\|?*", c))
+            result.push_back(L'_');
+        else
+            result.push_back(c);
+    }
+    while (!result.empty() && (result.back() == L'.' || result.back() == L' '))
+        result.pop_back();
+
+    // Reserved device names, bare or with an extension ("CON", "nul.txt")
+    size_t baseLength = result.find(L'.');
+    if (IsReservedDeviceName(result.substr(0, baseLength)))
+        result.insert(baseLength == std::wstring::npos ? result.size() : baseLength, 1, L'_');
+    return result;
+}
+
+enum class TemplateKey { Literal, Year, Month, Day, Category, Extension, Size, Letter, Orientation, Resolution, Artist, Album };
+
+struct TemplatePart
+{
+    TemplateKey key;
+    std::wstring text;  // Literal only
+};
+
+// One entry per folder level
+typedef std::vector<std::vector<TemplatePart>> TemplateLevels;
+
+static bool ParseDestinationTemplate(const std::wstring& text, TemplateLevels& levels)
+{
+    levels.assign(1, {});
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        wchar_t c = text[i];
+        if (IsSeparator(c))
+        {
+            if (!levels.back().empty())
+                levels.emplace_back();
+            continue;
+        }
+
+        if (c == L'{')
+        {
+            size_t close = text.find(L'}', i);
+            if (close == std::wstring::npos)
+                return false;
+
+            std::wstring name = text.substr(i + 1, close - i - 1);
+            TemplateKey key;
+            if (name == L"yyyy") key = TemplateKey::Year;
+            else if (name == L"MM") key = TemplateKey::Month;
+            else if (name == L"dd") key = TemplateKey::Day;
+            else if (name == L"category") key = TemplateKey::Category;
+            else if (name == L"ext") key = TemplateKey::Extension;
+            else if (name == L"size") key = TemplateKey::Size;
+            else if (name == L"letter") key = TemplateKey::Letter;
+            else if (name == L"orientation") key = TemplateKey::Orientation;
+            else if (name == L"resolution") key = TemplateKey::Resolution;
+            else if (name == L"artist") key = TemplateKey::Artist;
+            else if (name == L"album") key = TemplateKey::Album;
+            else return false;
+
+            levels.back().push_back({ key, std::wstring() });
+            i = close;
+            continue;
+        }
+
+        if (levels.back().empty() || levels.back().back().key != TemplateKey::Literal)
+            levels.back().push_back({ TemplateKey::Literal, std::wstring() });
+        levels.back().back().text.push_back(c);
+    }
+
+    if (levels.back().empty())
+        levels.pop_back();
+    return !levels.empty();
+}
+
+static bool IsDateKey(TemplateKey key)
+{
+    return key == TemplateKey::Year || key == TemplateKey::Month || key == TemplateKey::Day;
+}
+
+// Relative folder path for one entry. Without a known date every date level
+// collapses into a single "Unknown Date" level.
+static void ExpandDestinationTemplate(const TemplateLevels& levels, const FileEntry& entry, std::wstring& path)
+{
+    path.clear();
+    int year = 0, month = 0, day = 0;
+    uint64_t ticks;
+    bool knownDate = GetEntryDate(entry, ticks);
+    if (knownDate)
+        TicksToDate(ticks, year, month, day);
+
+    bool unknownDate = false;
+    std::wstring level;
+    wchar_t buffer[16];
+    for (const auto& parts : levels)
+    {
+        level.clear();
+        bool hasDate = false;
+        for (const auto& part : parts)
+        {
+            switch (part.key)
+            {
+            case TemplateKey::Literal:
+                level += part.text;
+                break;
+            case TemplateKey::Year:
+                swprintf(buffer, 16, L"%04d", year);
+                level += buffer;
+                break;
+            case TemplateKey::Month:
+                swprintf(buffer, 16, L"%02d", month);
+                level += buffer;
+                break;
+            case TemplateKey::Day:
+                swprintf(buffer, 16, L"%02d", day);
+                level += buffer;
+                break;
+            case TemplateKey::Category:
+                level += GetFileTypeCategory(entry.path);
+                break;
+            case TemplateKey::Extension:
+                level += GetFileExtension(entry.path);
+                break;
+            case TemplateKey::Size:
+                level += GetFileSizeCategory(entry);
+                break;
+            case TemplateKey::Letter:
+                level += GetAlphabeticalFolder(entry.path);
+                break;
+            case TemplateKey::Orientation:
+                level += GetImageOrientationFolder(entry);
+                break;
+            case TemplateKey::Resolution:
+                level += GetImageResolutionFolder(entry);
+                break;
+            case TemplateKey::Artist:
+                level += GetAudioArtistFolder(entry);
+                break;
+            case TemplateKey::Album:
+                level += GetAudioAlbumFolder(entry);
+                break;
+            }
+            hasDate |= IsDateKey(part.key);
+        }
+
+        if (hasDate && !knownDate)
+        {
+            if (unknownDate)
+                continue;
+            unknownDate = true;
+            level = L"Unknown Date";
+        }
+
+        // "." and ".." sanitize to nothing, so a template cannot climb out of the parent
+        level = SanitizeFolderName(level);
+        if (level.empty())
+            continue;
+        if (!path.empty())
+            path.push_back(kPathSeparator);
+        path += level;
+    }
+}
+
+bool IsValidDestinationTemplate(const std::wstring& destinationTemplate)
+{
+    TemplateLevels levels;
+    return ParseDestinationTemplate(destinationTemplate, levels);
+}
+
+// Index of a planned folder, adding it (and any missing ancestors, parents first) on first use
+// Folder names differing only in case are one folder on Windows, so they are one everywhere
+using FolderIndexMap = std::unordered_map<std::wstring, int, FoldedHash, FoldedEqual>;
+
+static int AddPlannedFolder(OrganizePlan& plan, FolderIndexMap& index, const std::wstring& relativePath)
+{
+    auto it = index.find(relativePath);
+    if (it != index.end())
+        return it->second;
+
+    size_t separator = relativePath.find_last_of(kPathSeparator);
+    int parent = separator == std::wstring::npos ? -1 : AddPlannedFolder(plan, index, relativePath.substr(0, separator));
+
+    int id = static_cast<int>(plan.folders.size());
+    plan.folders.push_back({ relativePath, parent });
+    index.emplace(relativePath, id);
+    return id;
+}
+
+// Nested plan: one group per expanded path. Entries whose every level is empty stay put.
+static bool BuildTemplatePlan(const std::vector<FileEntry>& entries, const std::wstring& destinationTemplate, OrganizePlan& plan)
+{
+    TemplateLevels levels;
+    if (!ParseDestinationTemplate(destinationTemplate, levels))
+        return false;
+
+    std::unordered_map<std::wstring, size_t, FoldedHash, FoldedEqual> groupIndex;
+    FolderIndexMap folderIndex;
+    std::wstring path;
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        ExpandDestinationTemplate(levels, entries[i], path);
+        if (path.empty())
+            continue;
+        auto [it, inserted] = groupIndex.emplace(path, plan.groups.size());
+        if (inserted)
+        {
+            OrganizeGroup group;
+            group.folderName = path;
+            group.folder = AddPlannedFolder(plan, folderIndex, path);
+            plan.groups.push_back(std::move(group));
+        }
+        plan.groups[it->second].items.push_back(i);
+    }
+    return true;
+}
+
+static const char* const kOrganizeModeNames[] =
+{
+    "default",
+    "day",
+    "month",
+    "year",
+    "monthyear",
+    "fulldate",
+    "type",
+    "type-photo",
+    "type-audio",
+    "type-document",
+    "type-other",
+    "extension",
+    "size",
+    "flatten",
+    "numbered",
+    "alphabetical",
+    "rules",
+    "template",
+    "sequence",
+    "similar",
+    "orientation",
+    "resolution",
+    "artist",
+    "artist-album",
+};
+
+static_assert(sizeof(kOrganizeModeNames) / sizeof(kOrganizeModeNames[0]) == static_cast<size_t>(OrganizeMode::COUNT),
+    "kOrganizeModeNames must match OrganizeMode");
+
+const char* GetOrganizeModeName(OrganizeMode mode)
+{
+    size_t index = static_cast<size_t>(mode);
+    return index < static_cast<size_t>(OrganizeMode::COUNT) ? kOrganizeModeNames[index] : "unknown";
+}
+
+bool ParseOrganizeMode(const char* name, OrganizeMode& mode)
+{
+    for (size_t i = 0; i < static_cast<size_t>(OrganizeMode::COUNT); i++)
+    {
+        if (strcmp(name, kOrganizeModeNames[i]) == 0)
+        {
+            mode = static_cast<OrganizeMode>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool OrganizeModeNeedsMetadata(OrganizeMode mode)
+{
+    switch (mode)
+    {
+    case OrganizeMode::ByDay:
+    case OrganizeMode::ByMonth:
+    case OrganizeMode::ByYear:
+    case OrganizeMode::ByMonthYear:
+    case OrganizeMode::ByFullDate:
+    case OrganizeMode::BySize:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool OrganizeModeNeedsMetadata(OrganizeMode mode, const OrganizeOptions& options)
+{
+    if (mode == OrganizeMode::ByRules)
+        return options.rules && options.rules->NeedsMetadata();
+
+    if (mode == OrganizeMode::ByTemplate)
+    {
+        TemplateLevels levels;
+        if (!ParseDestinationTemplate(options.destinationTemplate, levels))
+            return false;
+        for (const auto& parts : levels)
+        {
+            for (const auto& part : parts)
+            {
+                if (IsDateKey(part.key) || part.key == TemplateKey::Size)
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    return OrganizeModeNeedsMetadata(mode);
+}
+
+bool OrganizeModeUsesUniqueFolders(OrganizeMode mode)
+{
+    switch (mode)
+    {
+    case OrganizeMode::ByDay:
+    case OrganizeMode::ByMonth:
+    case OrganizeMode::ByYear:
+    case OrganizeMode::ByMonthYear:
+    case OrganizeMode::ByFullDate:
+        return true;
+    default:
+        return false;
+    }
+}
+
+unsigned OrganizeModeMediaFields(OrganizeMode mode, const OrganizeOptions& options)
+{
+    switch (mode)
+    {
+    case OrganizeMode::ByRules:
+        return options.rules ? options.rules->MediaFields() : MediaNone;
+    case OrganizeMode::ByDay:
+    case OrganizeMode::ByMonth:
+    case OrganizeMode::ByYear:
+    case OrganizeMode::ByMonthYear:
+    case OrganizeMode::ByFullDate:
+        return MediaCreationTime;
+    case OrganizeMode::ByOrientation:
+    case OrganizeMode::ByResolution:
+        return MediaImageSize;
+    case OrganizeMode::ByArtist:
+    case OrganizeMode::ByArtistAlbum:
+        return MediaAudioTags;
+    case OrganizeMode::ByTemplate:
+    {
+        TemplateLevels levels;
+        if (!ParseDestinationTemplate(options.destinationTemplate, levels))
+            return MediaNone;
+        unsigned fields = MediaNone;
+        for (const auto& parts : levels)
+        {
+            for (const auto& part : parts)
+            {
+                if (part.key == TemplateKey::Orientation || part.key == TemplateKey::Resolution)
+                    fields |= MediaImageSize;
+                else if (part.key == TemplateKey::Artist || part.key == TemplateKey::Album)
+                    fields |= MediaAudioTags;
+                else if (IsDateKey(part.key))
+                    fields |= MediaCreationTime;
+            }
+        }
+        return fields;
+    }
+    default:
+        return MediaNone;
+    }
+}
+
+// Empty key: the entry stays where it is
+static std::wstring GetGroupKey(const FileEntry& entry, OrganizeMode mode)
+{
+    switch (mode)
+    {
+    case OrganizeMode::ByDay:
+    case OrganizeMode::ByMonth:
+    case OrganizeMode::ByYear:
+    case OrganizeMode::ByMonthYear:
+    case OrganizeMode::ByFullDate:
+        return GetFileDateFolder(entry, mode);
+    case OrganizeMode::ByTypeVideo:
+    case OrganizeMode::ByTypePhoto:
+    case OrganizeMode::ByTypeAudio:
+    case OrganizeMode::ByTypeDocument:
+    case OrganizeMode::ByTypeOther:
+        return GetFileTypeCategory(entry.path);
+    case OrganizeMode::ByExtension:
+        return GetFileExtension(entry.path);
+    case OrganizeMode::BySize:
+        return GetFileSizeCategory(entry);
+    case OrganizeMode::ByOrientation:
+        return GetImageOrientationFolder(entry);
+    case OrganizeMode::ByResolution:
+        return GetImageResolutionFolder(entry);
+    case OrganizeMode::ByArtist:
+        return GetAudioArtistFolder(entry);
+    case OrganizeMode::Alphabetical:
+    default:
+        return GetAlphabeticalFolder(entry.path);
+    }
+}
+
+std::vector<SelectionPartition> PartitionByParent(std::vector<FileEntry> entries)
+{
+    std::vector<SelectionPartition> parts;
+    std::unordered_map<std::wstring, size_t, PathKeyHash, PathKeyEqual> byParent;
+    for (auto& entry : entries)
+    {
+        std::wstring parent = PathParent(entry.path);
+        auto inserted = byParent.emplace(parent, parts.size());
+        if (inserted.second)
+        {
+            parts.emplace_back();
+            parts.back().parent = std::move(parent);
+        }
+        parts[inserted.first->second].entries.push_back(std::move(entry));
+    }
+    return parts;
+}
+
+static bool BuildPlanGroups(const std::vector<FileEntry>& entries, OrganizeMode mode, OrganizePlan& plan,
+    const OrganizeOptions& options)
+{
+    plan.mode = mode;
+    plan.groups.clear();
+    plan.folders.clear();
+
+    if (entries.empty())
+        return mode == OrganizeMode::Flatten;
+
+    switch (mode)
+    {
+    case OrganizeMode::Default:
+    {
+        std::vector<std::wstring> paths;
+        paths.reserve(entries.size());
+        for (const auto& entry : entries)
+            paths.push_back(entry.path);
+
+        OrganizeGroup group;
+        group.folderName = GetCommonPrefix(paths);
+        group.uniqueName = true;
+        for (size_t i = 0; i < entries.size(); i++)
+            group.items.push_back(i);
+        plan.groups.push_back(std::move(group));
+        return true;
+    }
+
+    case OrganizeMode::Flatten:
+    {
+        OrganizeGroup group;
+        for (size_t i = 0; i < entries.size(); i++)
+            group.items.push_back(i);
+        plan.groups.push_back(std::move(group));
+        return true;
+    }
+
+    case OrganizeMode::Numbered:
+    {
+        // By name, not selection order: "img2" lands in a lower folder than "img10"
+        std::vector<size_t> order = NaturalOrder(entries);
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            OrganizeGroup group;
+            group.folderName = L"Folder " + std::to_wstring(i + 1);
+            group.uniqueName = true;
+            group.items.push_back(order[i]);
+            plan.groups.push_back(std::move(group));
+        }
+        return true;
+    }
+
+    case OrganizeMode::ByRules:
+    {
+        if (!options.rules)
+            return false;
+
+        // Groups follow rule order; files no rule claims stay put
+        std::vector<std::vector<size_t>> matched(options.rules->Count());
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            int rule = options.rules->Match(entries[i]);
+            if (rule >= 0)
+                matched[rule].push_back(i);
+        }
+
+        // Destinations are templates: one rule may fill several folders, and several
+        // rules may share one. Entries whose every level is empty stay put.
+        std::unordered_map<std::wstring, size_t, FoldedHash, FoldedEqual> groupIndex;
+        FolderIndexMap folderIndex;
+        TemplateLevels levels;
+        std::wstring path;
+        for (size_t r = 0; r < matched.size(); r++)
+        {
+            if (matched[r].empty())
+                continue;
+            if (!ParseDestinationTemplate(options.rules->Rule(r).destination, levels))
+                return false;
+            for (size_t i : matched[r])
+            {
+                ExpandDestinationTemplate(levels, entries[i], path);
+                if (path.empty())
+                    continue;
+                auto [it, inserted] = groupIndex.emplace(path, plan.groups.size());
+                if (inserted)
+                {
+                    OrganizeGroup group;
+                    group.folderName = path;
+                    group.folder = AddPlannedFolder(plan, folderIndex, path);
+                    plan.groups.push_back(std::move(group));
+                }
+                plan.groups[it->second].items.push_back(i);
+            }
+        }
+        for (auto& group : plan.groups)
+            std::sort(group.items.begin(), group.items.end());
+        return true;
+    }
+
+    case OrganizeMode::ByTemplate:
+        return BuildTemplatePlan(entries, options.destinationTemplate, plan);
+
+    case OrganizeMode::ByArtistAlbum:
+        return BuildTemplatePlan(entries, L"{artist}/{album}", plan);
+
+    case OrganizeMode::BySequence:
+        return BuildSequencePlan(entries, plan);
+
+    case OrganizeMode::BySimilarName:
+        return BuildSimilarNamePlan(entries, plan);
+
+    case OrganizeMode::COUNT:
+        return false;
+
+    default:
+    {
+        // Keys differing only in case ("Jpg", "JPG"; artists) share a folder; the first
+        // spelling names it. Group order is settled afterwards.
+        bool uniqueName = OrganizeModeUsesUniqueFolders(mode);
+        std::unordered_map<std::wstring, size_t, FoldedHash, FoldedEqual> groupIndex;
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            std::wstring key = GetGroupKey(entries[i], mode);
+            if (key.empty())
+                continue;
+            auto [it, inserted] = groupIndex.emplace(std::move(key), plan.groups.size());
+            if (inserted)
+            {
+                OrganizeGroup group;
+                group.folderName = it->first;
+                group.uniqueName = uniqueName;
+                plan.groups.push_back(std::move(group));
+            }
+            plan.groups[it->second].items.push_back(i);
+        }
+        return true;
+    }
+    }
+}
+
+// Files within each group by name, and groups by folder name unless their order means something
+static void SortPlanNatural(const std::vector<FileEntry>& entries, OrganizePlan& plan, bool sortGroups)
+{
+    bool multiple = std::any_of(plan.groups.begin(), plan.groups.end(), [](const OrganizeGroup& g) { return g.items.size() > 1; });
+    if (multiple)
+    {
+        std::vector<size_t> order = NaturalOrder(entries);
+        std::vector<size_t> rank(entries.size());
+        for (size_t r = 0; r < order.size(); r++)
+            rank[order[r]] = r;
+        for (auto& group : plan.groups)
+            std::sort(group.items.begin(), group.items.end(), [&](size_t a, size_t b) { return rank[a] < rank[b]; });
+    }
+
+    if (sortGroups && plan.groups.size() > 1)
+    {
+        std::vector<std::wstring> names;
+        names.reserve(plan.groups.size());
+        for (const auto& group : plan.groups)
+            names.push_back(group.folderName);
+        std::vector<OrganizeGroup> sorted;
+        sorted.reserve(plan.groups.size());
+        for (size_t g : NaturalOrder(names))
+            sorted.push_back(std::move(plan.groups[g]));
+        plan.groups = std::move(sorted);
+    }
+}
+
+bool BuildOrganizePlan(const std::vector<FileEntry>& entries, OrganizeMode mode, OrganizePlan& plan,
+    const OrganizeOptions& options)
+{
+    if (!BuildPlanGroups(entries, mode, plan, options))
+        return false;
+    // Rules keep rule order; Numbered is already numbered in natural order
+    SortPlanNatural(entries, plan, mode != OrganizeMode::ByRules && mode != OrganizeMode::Numbered);
+    return true;
+}
+
+bool OrganizeModeIsPerEntry(OrganizeMode mode)
+{
+    switch (mode)
+    {
+    case OrganizeMode::Default:
+    case OrganizeMode::Flatten:
+    case OrganizeMode::Numbered:
+    case OrganizeMode::BySequence:
+    case OrganizeMode::BySimilarName:
+    case OrganizeMode::COUNT:
+        return false;
+    default:
+        return true;
+    }
+}
+
+bool MakeEntryDestination(OrganizeMode mode, const OrganizeOptions& options,
+    std::function<void(const FileEntry& entry, std::wstring& folder)>& destination)
+{
+    if (!OrganizeModeIsPerEntry(mode))
+        return false;
+
+    if (mode == OrganizeMode::ByRules)
+    {
+        const RuleSet* rules = options.rules;
+        if (!rules)
+            return false;
+        std::vector<TemplateLevels> templates(rules->Count());
+        for (size_t r = 0; r < rules->Count(); r++)
+        {
+            if (!ParseDestinationTemplate(rules->Rule(r).destination, templates[r]))
+                return false;
+        }
+        destination = [rules, templates](const FileEntry& entry, std::wstring& folder) {
+            int rule = rules->Match(entry);
+            if (rule >= 0)
+                ExpandDestinationTemplate(templates[rule], entry, folder);
+            else
+                folder.clear();
+        };
+        return true;
+    }
+
+    if (mode == OrganizeMode::ByTemplate || mode == OrganizeMode::ByArtistAlbum)
+    {
+        TemplateLevels levels;
+        if (!ParseDestinationTemplate(mode == OrganizeMode::ByTemplate ? options.destinationTemplate : L"{artist}/{album}", levels))
+            return false;
+        destination = [levels](const FileEntry& entry, std::wstring& folder) { ExpandDestinationTemplate(levels, entry, folder); };
+        return true;
+    }
+
+    destination = [mode](const FileEntry& entry, std::wstring& folder) { folder = GetGroupKey(entry, mode); };
+    return true;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "OrganizeTypes.h"
+#include <functional>
+
+#ifdef _WIN32
+const wchar_t kPathSeparator = L'\\';
+#else
+const wchar_t kPathSeparator = L'/';
+#endif
+
+// Path helpers (work on both separators)
+std::wstring PathFileName(const std::wstring& path);
+std::wstring PathParent(const std::wstring& path);
+std::wstring PathStem(const std::wstring& path);
+std::wstring JoinPath(const std::wstring& parent, const std::wstring& name);
+
+// Grouping keys
+std::wstring GetCommonPrefix(const std::vector<std::wstring>& paths);
+std::wstring GetFileExtension(const std::wstring& path);
+std::wstring GetFileTypeCategory(const std::wstring& path);
+// Videos use their recorded capture time when MediaCreationTime was read
+std::wstring GetFileDateFolder(const FileEntry& entry, OrganizeMode mode);
+std::wstring GetFileSizeCategory(const FileEntry& entry);
+std::wstring GetAlphabeticalFolder(const std::wstring& path);
+// Photos only (empty for anything else); need MediaImageSize
+std::wstring GetImageOrientationFolder(const FileEntry& entry);
+std::wstring GetImageResolutionFolder(const FileEntry& entry);
+// Audio only; need MediaAudioTags. Album artist when tagged, else track artist
+std::wstring GetAudioArtistFolder(const FileEntry& entry);
+std::wstring GetAudioAlbumFolder(const FileEntry& entry);
+
+// Replaces characters that are invalid in folder names with '_', trims trailing dots/spaces
+// and defuses reserved device names ("CON" -> "CON_")
+std::wstring SanitizeFolderName(const std::wstring& name);
+
+// Destination templates combine the keys above into nested folders, one level per
+// '/' or '\\': {yyyy} {MM} {dd} {category} {ext} {size} {letter} {orientation} {resolution}
+// {artist} {album}, plus literal text. Keys that do not apply to a file (photo keys on a video)
+// drop their level.
+bool IsValidDestinationTemplate(const std::wstring& destinationTemplate);
+
+// Stable lowercase identifiers ("type", "fulldate", ...) for command lines, configs and reports
+const char* GetOrganizeModeName(OrganizeMode mode);
+bool ParseOrganizeMode(const char* name, OrganizeMode& mode);
+
+// True when the mode's keys depend on size or timestamps
+bool OrganizeModeNeedsMetadata(OrganizeMode mode);
+
+// Same, for modes driven by options: ByRules asks the rule set, ByTemplate looks for date and size keys
+bool OrganizeModeNeedsMetadata(OrganizeMode mode, const OrganizeOptions& options);
+
+// True for the date modes: like the original shell extension they put their files in a fresh
+// "2024-05 (2)" beside an existing "2024-05" rather than merging into it (OrganizeGroup::uniqueName)
+bool OrganizeModeUsesUniqueFolders(OrganizeMode mode);
+
+// MediaField bits the mode reads from file contents (QueryEntriesMediaInfo)
+unsigned OrganizeModeMediaFields(OrganizeMode mode, const OrganizeOptions& options = OrganizeOptions());
+
+// A selection spread over several folders (search results, libraries), split by the
+// folder each entry is in, so every part is organized inside its own folder
+struct SelectionPartition
+{
+    std::wstring parent;
+    std::vector<FileEntry> entries;
+};
+
+// Parts in order of first appearance; entries keep their selection order
+std::vector<SelectionPartition> PartitionByParent(std::vector<FileEntry> entries);
+
+// Group entries into destination folders. Groups come in natural order of their folder
+// names (ByRules: rule order) and files within a group in natural order of their names;
+// Numbered numbers the files in that order. Flatten expects entries already expanded;
+// ByRules fails without options.rules and leaves unmatched entries out of the plan;
+// ByTemplate fails on an invalid template. Both expand templates and fill plan.folders
+// parent-first.
+bool BuildOrganizePlan(const std::vector<FileEntry>& entries, OrganizeMode mode, OrganizePlan& plan,
+    const OrganizeOptions& options = OrganizeOptions());
+
+// Modes whose destination depends on the entry alone, so a plan can be built one entry at
+// a time (OrganizeStreaming.h): all but Default, Flatten, Numbered, BySequence and
+// BySimilarName, which look at the whole selection
+bool OrganizeModeIsPerEntry(OrganizeMode mode);
+
+// The destination folder of one entry in such a mode (nested for templates), named as
+// BuildOrganizePlan names it; empty when the entry stays where it is. Fails for other
+// modes, ByRules without options.rules and invalid templates; options.rules must outlive
+// the function.
+bool MakeEntryDestination(OrganizeMode mode, const OrganizeOptions& options,
+    std::function<void(const FileEntry& entry, std::wstring& folder)>& destination);
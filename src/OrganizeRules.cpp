@@ -0,0 +1,701 @@
+#include "OrganizeRules.h"
+#include "CaseFold.h"
+#include "FileSystem.h"
+#include "OrganizePlanner.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cwctype>
+
+static const size_t kMaxDfaStates = 4096;
+
+void RuleMask::Fill(size_t bits)
+{
+    m_words.assign((bits + 63) / 64, ~0ULL);
+    if (bits % 64)
+        m_words.back() = (1ULL << (bits % 64)) - 1;
+}
+
+void RuleMask::And(const RuleMask& other)
+{
+    for (size_t i = 0; i < m_words.size(); i++)
+        m_words[i] &= i < other.m_words.size() ? other.m_words[i] : 0;
+}
+
+void RuleMask::Or(const RuleMask& other)
+{
+    if (m_words.size() < other.m_words.size())
+        m_words.resize(other.m_words.size(), 0);
+    for (size_t i = 0; i < other.m_words.size(); i++)
+        m_words[i] |= other.m_words[i];
+}
+
+bool RuleMask::Intersects(const RuleMask& other) const
+{
+    size_t n = std::min(m_words.size(), other.m_words.size());
+    for (size_t i = 0; i < n; i++)
+    {
+        if (m_words[i] & other.m_words[i])
+            return true;
+    }
+    return false;
+}
+
+bool RuleMask::Any() const
+{
+    for (uint64_t word : m_words)
+    {
+        if (word)
+            return true;
+    }
+    return false;
+}
+
+int RuleMask::NextSet(size_t start) const
+{
+    for (size_t w = start / 64; w < m_words.size(); w++)
+    {
+        uint64_t word = m_words[w];
+        if (w == start / 64)
+            word &= ~0ULL << (start % 64);
+        for (int bit = 0; word && bit < 64; bit++)
+        {
+            if ((word >> bit) & 1)
+                return static_cast<int>(w * 64 + bit);
+        }
+    }
+    return -1;
+}
+
+// ---------------------------------------------------------------------------
+// GlobAutomaton
+
+void GlobAutomaton::Reset(size_t ruleCount)
+{
+    m_ruleCount = ruleCount;
+    m_patterns.clear();
+    m_nfaOwner.clear();
+    m_dfa.clear();
+    m_dfaIndex.clear();
+}
+
+bool GlobAutomaton::Add(const std::wstring& pattern, size_t rule)
+{
+    Pattern compiled;
+    compiled.rule = rule;
+
+    for (size_t i = 0; i < pattern.size(); i++)
+    {
+        Token token;
+        wchar_t c = pattern[i];
+        if (c == L'*')
+        {
+            if (!compiled.tokens.empty() && compiled.tokens.back().kind == Token::Star)
+                continue;
+            token.kind = Token::Star;
+        }
+        else if (c == L'?')
+        {
+            token.kind = Token::AnyChar;
+        }
+        else if (c == L'[')
+        {
+            token.kind = Token::Class;
+            size_t j = i + 1;
+            if (j < pattern.size() && (pattern[j] == L'!' || pattern[j] == L'^'))
+            {
+                token.negate = true;
+                j++;
+            }
+            for (; j < pattern.size() && pattern[j] != L']'; j++)
+            {
+                wchar_t lo = FoldCase(pattern[j]);
+                wchar_t hi = lo;
+                if (j + 2 < pattern.size() && pattern[j + 1] == L'-' && pattern[j + 2] != L']')
+                {
+                    hi = FoldCase(pattern[j + 2]);
+                    j += 2;
+                }
+                token.ranges.emplace_back(lo, hi);
+            }
+            if (j >= pattern.size())
+                return false;  // Unterminated class
+            i = j;
+        }
+        else
+        {
+            token.kind = Token::Literal;
+            token.ch = FoldCase(c);
+        }
+        compiled.tokens.push_back(std::move(token));
+    }
+
+    compiled.firstState = static_cast<uint32_t>(m_nfaOwner.size());
+    for (size_t t = 0; t <= compiled.tokens.size(); t++)
+        m_nfaOwner.emplace_back(static_cast<uint32_t>(m_patterns.size()), static_cast<uint32_t>(t));
+
+    m_patterns.push_back(std::move(compiled));
+    m_dfa.clear();
+    m_dfaIndex.clear();
+    return true;
+}
+
+bool GlobAutomaton::TokenMatches(const Token& token, wchar_t c) const
+{
+    switch (token.kind)
+    {
+    case Token::Literal:
+        return token.ch == c;
+    case Token::AnyChar:
+        return true;
+    case Token::Class:
+    {
+        bool in = false;
+        for (const auto& [lo, hi] : token.ranges)
+        {
+            if (c >= lo && c <= hi)
+            {
+                in = true;
+                break;
+            }
+        }
+        return in != token.negate;
+    }
+    default:
+        return false;
+    }
+}
+
+// A star can match nothing, so the position after it is live too
+void GlobAutomaton::Closure(std::vector<uint32_t>& states) const
+{
+    for (size_t i = 0; i < states.size(); i++)
+    {
+        const auto& [p, t] = m_nfaOwner[states[i]];
+        const Pattern& pattern = m_patterns[p];
+        if (t < pattern.tokens.size() && pattern.tokens[t].kind == Token::Star)
+            states.push_back(states[i] + 1);
+    }
+    std::sort(states.begin(), states.end());
+    states.erase(std::unique(states.begin(), states.end()), states.end());
+}
+
+uint32_t GlobAutomaton::Intern(std::vector<uint32_t>&& states) const
+{
+    auto it = m_dfaIndex.find(states);
+    if (it != m_dfaIndex.end())
+        return it->second;
+
+    auto state = std::make_unique<DfaState>();
+    state->accepts = RuleMask(m_ruleCount);
+    for (uint32_t s : states)
+    {
+        const auto& [p, t] = m_nfaOwner[s];
+        if (t == m_patterns[p].tokens.size())
+            state->accepts.Set(m_patterns[p].rule);
+    }
+    std::fill(std::begin(state->ascii), std::end(state->ascii), UINT32_MAX);
+    state->nfa = states;
+
+    uint32_t id = static_cast<uint32_t>(m_dfa.size());
+    m_dfaIndex.emplace(std::move(states), id);
+    m_dfa.push_back(std::move(state));
+    return id;
+}
+
+uint32_t GlobAutomaton::Step(uint32_t dfa, wchar_t c) const
+{
+    DfaState& state = *m_dfa[dfa];
+    if (c >= 0 && c < 128 && state.ascii[c] != UINT32_MAX)
+        return state.ascii[c];
+    if (c >= 128)
+    {
+        auto it = state.other.find(c);
+        if (it != state.other.end())
+            return it->second;
+    }
+
+    std::vector<uint32_t> next;
+    for (uint32_t s : state.nfa)
+    {
+        const auto& [p, t] = m_nfaOwner[s];
+        const Pattern& pattern = m_patterns[p];
+        if (t >= pattern.tokens.size())
+            continue;
+        const Token& token = pattern.tokens[t];
+        if (token.kind == Token::Star)
+            next.push_back(s);
+        else if (TokenMatches(token, c))
+            next.push_back(s + 1);
+    }
+    Closure(next);
+
+    uint32_t id = Intern(std::move(next));
+    // Intern may grow m_dfa; re-fetch the state before caching
+    DfaState& from = *m_dfa[dfa];
+    if (c >= 0 && c < 128)
+        from.ascii[c] = id;
+    else
+        from.other[c] = id;
+    return id;
+}
+
+RuleMask GlobAutomaton::Match(const std::wstring& name) const
+{
+    if (m_patterns.empty())
+        return RuleMask(m_ruleCount);
+
+    // Pathological pattern sets can blow up the DFA; start over between names
+    if (m_dfa.size() > kMaxDfaStates)
+    {
+        m_dfa.clear();
+        m_dfaIndex.clear();
+    }
+
+    if (m_dfa.empty())
+    {
+        std::vector<uint32_t> start;
+        for (const auto& pattern : m_patterns)
+            start.push_back(pattern.firstState);
+        Closure(start);
+        Intern(std::move(start));
+    }
+
+    uint32_t state = 0;
+    for (wchar_t c : name)
+    {
+        state = Step(state, FoldCase(c));
+        if (m_dfa[state]->nfa.empty())
+            return RuleMask(m_ruleCount);
+    }
+    return m_dfa[state]->accepts;
+}
+
+// ---------------------------------------------------------------------------
+// Rule parsing
+
+static std::wstring Trim(const std::wstring& text)
+{
+    size_t begin = text.find_first_not_of(L" \t\r\n");
+    if (begin == std::wstring::npos)
+        return std::wstring();
+    size_t end = text.find_last_not_of(L" \t\r\n");
+    return text.substr(begin, end - begin + 1);
+}
+
+static std::vector<std::wstring> SplitComma(const std::wstring& text)
+{
+    std::vector<std::wstring> items;
+    size_t start = 0;
+    for (;;)
+    {
+        size_t comma = text.find(L',', start);
+        std::wstring item = Trim(text.substr(start, comma == std::wstring::npos ? std::wstring::npos : comma - start));
+        if (!item.empty())
+            items.push_back(item);
+        if (comma == std::wstring::npos)
+            break;
+        start = comma + 1;
+    }
+    return items;
+}
+
+// "->" outside double quotes
+static size_t FindArrow(const std::wstring& line)
+{
+    bool quoted = false;
+    for (size_t i = 0; i + 1 < line.size(); i++)
+    {
+        if (line[i] == L'"')
+            quoted = !quoted;
+        else if (!quoted && line[i] == L'-' && line[i + 1] == L'>')
+            return i;
+    }
+    return std::wstring::npos;
+}
+
+// Whitespace-separated key:value tokens; values may be "quoted"
+static std::vector<std::wstring> SplitConditions(const std::wstring& text)
+{
+    std::vector<std::wstring> tokens;
+    std::wstring current;
+    bool quoted = false;
+    for (wchar_t c : text)
+    {
+        if (c == L'"')
+            quoted = !quoted;
+        else if (!quoted && iswspace(c))
+        {
+            if (!current.empty()) tokens.push_back(current);
+            current.clear();
+        }
+        else
+            current.push_back(c);
+    }
+    if (!current.empty())
+        tokens.push_back(current);
+    return tokens;
+}
+
+static bool ParseSize(const std::wstring& text, uint64_t& value)
+{
+    wchar_t* end = nullptr;
+    double number = wcstod(text.c_str(), &end);
+    if (end == text.c_str() || number < 0)
+        return false;
+
+    std::wstring unit = FoldCase(Trim(end));
+    double scale = 1;
+    if (unit.empty() || unit == L"B") scale = 1;
+    else if (unit == L"KB" || unit == L"K") scale = 1024.0;
+    else if (unit == L"MB" || unit == L"M") scale = 1024.0 * 1024;
+    else if (unit == L"GB" || unit == L"G") scale = 1024.0 * 1024 * 1024;
+    else if (unit == L"TB" || unit == L"T") scale = 1024.0 * 1024 * 1024 * 1024;
+    else return false;
+
+    value = static_cast<uint64_t>(number * scale);
+    return true;
+}
+
+// YYYY-MM-DD -> FILETIME ticks at 00:00 UTC
+static bool ParseDate(const std::wstring& text, uint64_t& ticks)
+{
+    int y, m, d;
+    if (swscanf(text.c_str(), L"%d-%d-%d", &y, &m, &d) != 3 || m < 1 || m > 12 || d < 1 || d > 31)
+        return false;
+
+    // Howard Hinnant's days_from_civil
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    int64_t days = era * 146097 + doe - 719468;
+
+    const int64_t kUnixEpochSeconds = 11644473600LL;
+    int64_t seconds = days * 86400 + kUnixEpochSeconds;
+    if (seconds < 0)
+        return false;
+    ticks = static_cast<uint64_t>(seconds) * 10000000ULL;
+    return true;
+}
+
+// ">x", ">=x", "<x", "<=x" or "a..b" (inclusive)
+static bool ParseRange(const std::wstring& text, RangeCheck& range)
+{
+    const uint64_t kDayTicks = 86400ULL * 10000000ULL;
+    auto parse = [&](const std::wstring& value, uint64_t& out) {
+        return range.field == RangeCheck::Size ? ParseSize(value, out) : ParseDate(value, out);
+    };
+    // A date bound covers its whole day
+    uint64_t lastUnit = range.field == RangeCheck::Date ? kDayTicks - 1 : 0;
+
+    uint64_t value;
+    if (text.compare(0, 2, L">=") == 0)
+    {
+        if (!parse(text.substr(2), value)) return false;
+        range.min = value;
+    }
+    else if (text.compare(0, 2, L"<=") == 0)
+    {
+        if (!parse(text.substr(2), value)) return false;
+        range.max = value + lastUnit;
+    }
+    else if (text[0] == L'>')
+    {
+        if (!parse(text.substr(1), value)) return false;
+        range.min = value + lastUnit + 1;
+    }
+    else if (text[0] == L'<')
+    {
+        if (!parse(text.substr(1), value)) return false;
+        if (value == 0) return false;
+        range.max = value - 1;
+    }
+    else
+    {
+        size_t dots = text.find(L"..");
+        if (dots == std::wstring::npos)
+            return false;
+        uint64_t hi;
+        if (!parse(text.substr(0, dots), value) || !parse(text.substr(dots + 2), hi) || hi < value)
+            return false;
+        range.min = value;
+        range.max = hi + lastUnit;
+    }
+
+    // Rough share of real-world files inside the range: sizes spread over ~2^40,
+    // timestamps over ~10 years
+    if (range.field == RangeCheck::Size)
+    {
+        double width = std::log2(static_cast<double>(range.max) + 1) - std::log2(static_cast<double>(range.min) + 1);
+        range.selectivity = std::min(1.0, std::max(0.01, width / 40.0));
+    }
+    else
+    {
+        double lo = static_cast<double>(range.min);
+        double hi = range.max == UINT64_MAX ? lo + 3650.0 * kDayTicks : static_cast<double>(range.max);
+        range.selectivity = std::min(1.0, std::max(0.01, (hi - lo) / (3650.0 * kDayTicks)));
+    }
+    return true;
+}
+
+bool RuleSet::Compile(const std::wstring& text, std::wstring* error)
+{
+    struct Conditions
+    {
+        std::vector<std::wstring> exts;
+        std::vector<std::wstring> categories;
+        std::vector<std::wstring> globs;
+    };
+
+    m_rules.clear();
+    m_needsMetadata = false;
+    m_mediaFields = MediaNone;
+    std::vector<Conditions> conditions;
+
+    auto fail = [&](int line, const std::wstring& reason) {
+        if (error)
+            *error = L"line " + std::to_wstring(line) + L": " + reason;
+        m_rules.clear();
+        return false;
+    };
+
+    size_t start = 0;
+    int lineNumber = 0;
+    while (start <= text.size())
+    {
+        size_t end = text.find(L'\n', start);
+        std::wstring line = Trim(text.substr(start, end == std::wstring::npos ? std::wstring::npos : end - start));
+        start = end == std::wstring::npos ? text.size() + 1 : end + 1;
+        lineNumber++;
+
+        if (line.empty() || line[0] == L'#' || line[0] == L';')
+            continue;
+
+        size_t arrow = FindArrow(line);
+        if (arrow == std::wstring::npos)
+            return fail(lineNumber, L"expected 'conditions -> destination'");
+
+        OrganizeRule rule;
+        rule.line = lineNumber;
+        // Each level is sanitized when the template is expanded
+        rule.destination = Trim(line.substr(arrow + 2));
+        if (rule.destination.empty())
+            return fail(lineNumber, L"empty destination");
+        OrganizeOptions destination;
+        destination.destinationTemplate = rule.destination;
+        if (!IsValidDestinationTemplate(rule.destination))
+            return fail(lineNumber, L"invalid destination template '" + rule.destination + L"'");
+        m_needsMetadata |= OrganizeModeNeedsMetadata(OrganizeMode::ByTemplate, destination);
+        m_mediaFields |= OrganizeModeMediaFields(OrganizeMode::ByTemplate, destination);
+
+        Conditions cond;
+        for (const auto& token : SplitConditions(line.substr(0, arrow)))
+        {
+            if (EqualsFolded(token, L"any"))
+                continue;
+
+            size_t colon = token.find(L':');
+            if (colon == std::wstring::npos)
+                return fail(lineNumber, L"unknown condition '" + token + L"'");
+
+            std::wstring key = token.substr(0, colon);
+            std::wstring value = token.substr(colon + 1);
+            if (value.empty())
+                return fail(lineNumber, L"empty value for '" + key + L"'");
+
+            if (EqualsFolded(key, L"ext"))
+            {
+                for (auto& ext : SplitComma(value))
+                    cond.exts.push_back(FoldCase(ext[0] == L'.' ? ext.substr(1) : ext));
+            }
+            else if (EqualsFolded(key, L"category"))
+            {
+                for (auto& category : SplitComma(value))
+                    cond.categories.push_back(FoldCase(category));
+            }
+            else if (EqualsFolded(key, L"glob"))
+            {
+                cond.globs.push_back(value);
+            }
+            else if (EqualsFolded(key, L"regex"))
+            {
+                try
+                {
+                    rule.regex = std::make_unique<std::wregex>(value, std::regex::ECMAScript | std::regex::icase | std::regex::optimize);
+                }
+                catch (const std::regex_error&)
+                {
+                    return fail(lineNumber, L"invalid regex");
+                }
+            }
+            else if (EqualsFolded(key, L"size") || EqualsFolded(key, L"date"))
+            {
+                RangeCheck range;
+                range.field = EqualsFolded(key, L"size") ? RangeCheck::Size : RangeCheck::Date;
+                if (!ParseRange(value, range))
+                    return fail(lineNumber, L"invalid " + key + L" range '" + value + L"'");
+                rule.ranges.push_back(range);
+                m_needsMetadata = true;
+            }
+            else
+            {
+                return fail(lineNumber, L"unknown condition '" + key + L"'");
+            }
+        }
+
+        std::sort(rule.ranges.begin(), rule.ranges.end(),
+            [](const RangeCheck& a, const RangeCheck& b) { return a.selectivity < b.selectivity; });
+
+        m_rules.push_back(std::move(rule));
+        conditions.push_back(std::move(cond));
+    }
+
+    // Build the decision structure
+    size_t count = m_rules.size();
+    m_extIndex.clear();
+    m_categoryIndex.clear();
+    m_extFree = RuleMask(count);
+    m_categoryFree = RuleMask(count);
+    m_globRules = RuleMask(count);
+    m_globFree = RuleMask(count);
+    m_globs.Reset(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const Conditions& cond = conditions[i];
+
+        if (cond.exts.empty())
+            m_extFree.Set(i);
+        for (const auto& ext : cond.exts)
+        {
+            auto it = m_extIndex.try_emplace(ext, RuleMask(count)).first;
+            it->second.Set(i);
+        }
+
+        if (cond.categories.empty())
+            m_categoryFree.Set(i);
+        for (const auto& category : cond.categories)
+        {
+            auto it = m_categoryIndex.try_emplace(category, RuleMask(count)).first;
+            it->second.Set(i);
+        }
+
+        // Several glob: conditions on one rule are alternatives
+        if (cond.globs.empty())
+            m_globFree.Set(i);
+        else
+            m_globRules.Set(i);
+        for (const auto& glob : cond.globs)
+        {
+            if (!m_globs.Add(glob, i))
+                return fail(m_rules[i].line, L"invalid glob '" + glob + L"'");
+        }
+    }
+
+    return true;
+}
+
+int RuleSet::Match(const FileEntry& entry) const
+{
+    if (m_rules.empty())
+        return -1;
+
+    // Stage 1: extension hash index
+    RuleMask candidates = m_extFree;
+    std::wstring ext = GetFileExtension(entry.path);
+    if (ext != L"No Extension")
+    {
+        auto it = m_extIndex.find(ext);  // Folded already
+        if (it != m_extIndex.end())
+            candidates.Or(it->second);
+    }
+    if (!candidates.Any())
+        return -1;
+
+    // Stage 2: category index
+    if (!m_categoryIndex.empty())
+    {
+        RuleMask allowed = m_categoryFree;
+        auto it = m_categoryIndex.find(FoldCase(GetFileTypeCategory(entry.path)));
+        if (it != m_categoryIndex.end())
+            allowed.Or(it->second);
+        candidates.And(allowed);
+        if (!candidates.Any())
+            return -1;
+    }
+
+    // Stage 3: one pass of the combined glob automaton, only if a glob rule is still in play
+    if (candidates.Intersects(m_globRules))
+    {
+        RuleMask allowed = m_globFree;
+        allowed.Or(m_globs.Match(PathFileName(entry.path)));
+        candidates.And(allowed);
+    }
+
+    // Stage 4: remaining candidates in priority order; cheap ranges before regex
+    std::wstring name;
+    for (int i = candidates.NextSet(0); i >= 0; i = candidates.NextSet(i + 1))
+    {
+        const OrganizeRule& rule = m_rules[i];
+
+        bool pass = true;
+        for (const auto& range : rule.ranges)
+        {
+            uint64_t value = range.field == RangeCheck::Size ? entry.size : entry.lastWriteTime;
+            if (!entry.hasMetadata || value < range.min || value > range.max)
+            {
+                pass = false;
+                break;
+            }
+        }
+        if (!pass)
+            continue;
+
+        if (rule.regex)
+        {
+            if (name.empty())
+                name = PathFileName(entry.path);
+            if (!std::regex_search(name, *rule.regex))
+                continue;
+        }
+
+        return i;
+    }
+
+    return -1;
+}
+
+std::wstring GetDefaultRulesPath()
+{
+#ifdef _WIN32
+    const wchar_t* appData = _wgetenv(L"APPDATA");
+    if (!appData || !*appData)
+        return std::wstring();
+    return JoinPath(JoinPath(appData, L"NewFolderFromFiles"), L"rules.ini");
+#else
+    std::wstring base;
+    if (const char* xdg = getenv("XDG_CONFIG_HOME"))
+        base = FromNativePath(xdg);
+    else if (const char* home = getenv("HOME"))
+        base = JoinPath(FromNativePath(home), L".config");
+    if (base.empty())
+        return std::wstring();
+    return JoinPath(JoinPath(base, L"NewFolderFromFiles"), L"rules.ini");
+#endif
+}
+
+bool LoadRulesFile(const std::wstring& path, RuleSet& rules, std::wstring* error)
+{
+    std::string bytes;
+    if (path.empty() || !ReadFileBytes(path, bytes))
+    {
+        if (error)
+            *error = L"cannot read " + path;
+        return false;
+    }
+
+    size_t offset = bytes.compare(0, 3, "\xEF\xBB\xBF") == 0 ? 3 : 0;
+    return rules.Compile(Utf8ToWide(bytes.data() + offset, bytes.size() - offset), error);
+}
@@ -0,0 +1,138 @@
+#pragma once
+#include "OrganizeTypes.h"
+#include <map>
+#include <memory>
+#include <regex>
+#include <unordered_map>
+
+// User routing rules, one per line, first match wins:
+//
+//   # conditions (all must hold)              -> destination
+//   ext:jpg,jpeg,png                          -> Photos
+//   glob:IMG_*.HEIC                           -> iPhone
+//   regex:"^invoice.*\.pdf$"                  -> Invoices
+//   category:Video size:>1GB                  -> Big Videos
+//   size:1MB..100MB date:2023-01-01..2023-12-31 -> 2023 Medium
+//   category:Photo                            -> Photos/{yyyy}/{MM}
+//   any                                       -> Unsorted
+//
+// Destinations are destination templates (IsValidDestinationTemplate), expanded per file.
+// Files that match no rule are left where they are.
+
+// Dynamic bitset over rule indices
+class RuleMask
+{
+public:
+    RuleMask() = default;
+    explicit RuleMask(size_t bits) : m_words((bits + 63) / 64, 0) {}
+
+    void Set(size_t bit) { m_words[bit / 64] |= 1ULL << (bit % 64); }
+    bool Test(size_t bit) const { return (m_words[bit / 64] >> (bit % 64)) & 1; }
+    void Fill(size_t bits);
+    void And(const RuleMask& other);
+    void Or(const RuleMask& other);
+    bool Intersects(const RuleMask& other) const;
+    bool Any() const;
+    // Lowest set bit at or after start, or -1
+    int NextSet(size_t start) const;
+
+private:
+    std::vector<uint64_t> m_words;
+};
+
+// All glob patterns compiled into one automaton. The NFA (one position per
+// pattern token) is turned into a DFA lazily, so matching a name costs one
+// table step per character no matter how many globs there are.
+class GlobAutomaton
+{
+public:
+    void Reset(size_t ruleCount);
+    bool Add(const std::wstring& pattern, size_t rule);
+    RuleMask Match(const std::wstring& name) const;
+    bool Empty() const { return m_patterns.empty(); }
+
+private:
+    struct Token
+    {
+        enum Kind { Literal, AnyChar, Star, Class } kind;
+        wchar_t ch = 0;
+        bool negate = false;
+        std::vector<std::pair<wchar_t, wchar_t>> ranges;
+    };
+
+    struct Pattern
+    {
+        std::vector<Token> tokens;
+        size_t rule;
+        uint32_t firstState;  // Global NFA index of token 0
+    };
+
+    struct DfaState
+    {
+        std::vector<uint32_t> nfa;                       // Sorted NFA positions
+        RuleMask accepts;
+        uint32_t ascii[128];                             // Cached transitions, UINT32_MAX = unknown
+        std::unordered_map<wchar_t, uint32_t> other;     // Cached non-ASCII transitions
+    };
+
+    void Closure(std::vector<uint32_t>& states) const;
+    uint32_t Intern(std::vector<uint32_t>&& states) const;
+    uint32_t Step(uint32_t dfa, wchar_t c) const;
+    bool TokenMatches(const Token& token, wchar_t c) const;
+
+    size_t m_ruleCount = 0;
+    std::vector<Pattern> m_patterns;
+    std::vector<std::pair<uint32_t, uint32_t>> m_nfaOwner;  // NFA index -> (pattern, token)
+    mutable std::vector<std::unique_ptr<DfaState>> m_dfa;
+    mutable std::map<std::vector<uint32_t>, uint32_t> m_dfaIndex;
+};
+
+struct RangeCheck
+{
+    enum Field { Size, Date } field;
+    uint64_t min = 0;
+    uint64_t max = UINT64_MAX;
+    double selectivity = 1.0;  // Estimated fraction of files that pass; lowest checked first
+};
+
+struct OrganizeRule
+{
+    std::wstring destination;               // Destination template
+    std::vector<RangeCheck> ranges;         // Ordered by selectivity
+    std::unique_ptr<std::wregex> regex;     // Checked last
+    int line = 0;
+};
+
+class RuleSet
+{
+public:
+    // Parses and compiles rule text; error gets "line N: reason" on failure
+    bool Compile(const std::wstring& text, std::wstring* error = nullptr);
+
+    // Index of the first matching rule, or -1
+    int Match(const FileEntry& entry) const;
+
+    size_t Count() const { return m_rules.size(); }
+    const OrganizeRule& Rule(size_t index) const { return m_rules[index]; }
+    bool NeedsMetadata() const { return m_needsMetadata; }
+    unsigned MediaFields() const { return m_mediaFields; }  // Read by destination templates
+
+private:
+    std::vector<OrganizeRule> m_rules;
+
+    // Decision structure: each stage narrows the candidate rules
+    std::unordered_map<std::wstring, RuleMask> m_extIndex;       // Folded extension -> rules requiring it
+    RuleMask m_extFree;                                          // Rules without an ext: condition
+    std::unordered_map<std::wstring, RuleMask> m_categoryIndex;
+    RuleMask m_categoryFree;
+    GlobAutomaton m_globs;
+    RuleMask m_globRules;
+    RuleMask m_globFree;
+    bool m_needsMetadata = false;
+    unsigned m_mediaFields = MediaNone;
+};
+
+// %APPDATA%\NewFolderFromFiles\rules.ini, or $XDG_CONFIG_HOME/NewFolderFromFiles/rules.ini
+std::wstring GetDefaultRulesPath();
+
+bool LoadRulesFile(const std::wstring& path, RuleSet& rules, std::wstring* error = nullptr);
@@ -0,0 +1,190 @@
+#include "OrganizeSequences.h"
+#include "CaseFold.h"
+#include "OrganizePlanner.h"
+#include <cwctype>
+#include <unordered_map>
+
+// Frame numbers longer than this are ids or timestamps, not frames
+static const size_t kMaxFrameDigits = 9;
+
+struct NameRun
+{
+    size_t start;
+    size_t length;
+    bool digits;
+};
+
+// Alternating text / digit runs of a stem
+static void TokenizeName(const std::wstring& stem, std::vector<NameRun>& runs)
+{
+    runs.clear();
+    for (size_t i = 0; i < stem.size(); i++)
+    {
+        bool digit = stem[i] >= L'0' && stem[i] <= L'9';
+        if (runs.empty() || runs.back().digits != digit)
+            runs.push_back({ i, 0, digit });
+        runs.back().length++;
+    }
+}
+
+static uint64_t RunValue(const std::wstring& stem, const NameRun& run)
+{
+    uint64_t value = 0;
+    for (size_t i = run.start; i < run.start + run.length; i++)
+        value = value * 10 + (stem[i] - L'0');
+    return value;
+}
+
+// Index of the season digits of an "S01E02" marker, or -1
+static int FindEpisodeMarker(const std::wstring& stem, const std::vector<NameRun>& runs)
+{
+    for (size_t k = 1; k + 2 < runs.size(); k++)
+    {
+        const NameRun& before = runs[k - 1];
+        const NameRun& e = runs[k + 1];
+        if (!runs[k].digits || before.digits || !runs[k + 2].digits || e.length != 1)
+            continue;
+
+        // 'S' must start a word: "Show.S01", not "Bus01"
+        size_t s = before.start + before.length - 1;
+        if (FoldCase(stem[s]) != L'S' || FoldCase(stem[e.start]) != L'E')
+            continue;
+        if (s > 0 && iswalpha(stem[s - 1]))
+            continue;
+        return static_cast<int>(k);
+    }
+    return -1;
+}
+
+// "The.Show_Name - " -> "The Show Name"
+static std::wstring CleanShowName(const std::wstring& text)
+{
+    std::wstring name;
+    for (wchar_t c : text)
+    {
+        wchar_t out = c == L'.' || c == L'_' ? L' ' : c;
+        if (out == L' ' && (name.empty() || name.back() == L' '))
+            continue;
+        name.push_back(out);
+    }
+    while (!name.empty() && (name.back() == L' ' || name.back() == L'-'))
+        name.pop_back();
+    return name;
+}
+
+static std::wstring FormatFrame(uint64_t value, size_t width)
+{
+    std::wstring digits = std::to_wstring(value);
+    if (digits.size() < width)
+        digits.insert(0, width - digits.size(), L'0');
+    return digits;
+}
+
+struct Sequence
+{
+    std::wstring prefix;     // Frame sequences: text around the frame number
+    std::wstring suffix;
+    std::wstring folderName; // Episodic series: fixed name
+    uint64_t first = UINT64_MAX;
+    uint64_t last = 0;
+    size_t width = SIZE_MAX; // Narrowest frame run, so unpadded sequences print unpadded
+    std::vector<size_t> items;
+};
+
+bool BuildSequencePlan(const std::vector<FileEntry>& entries, OrganizePlan& plan)
+{
+    std::vector<Sequence> sequences;
+    std::unordered_map<std::wstring, size_t> index;
+    index.reserve(entries.size() / 16 + 16);
+
+    std::vector<NameRun> runs;
+    std::wstring key;
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        if (entries[i].isDirectory)
+            continue;
+
+        std::wstring name = PathFileName(entries[i].path);
+        std::wstring stem = PathStem(name);
+        TokenizeName(stem, runs);
+
+        // Key kinds are tagged so a show can never collide with a frame template
+        int marker = FindEpisodeMarker(stem, runs);
+        NameRun frame = {};
+        std::wstring folderName;
+        key.clear();
+        if (marker >= 0)
+        {
+            uint64_t season = RunValue(stem, runs[marker]);
+            std::wstring show = CleanShowName(stem.substr(0, runs[marker - 1].start + runs[marker - 1].length - 1));
+            folderName = (show.empty() ? std::wstring(L"Season ") : show + L" S") + FormatFrame(season, 2);
+            key = L"E" + FoldCase(folderName);
+        }
+        else
+        {
+            int last = -1;
+            for (int k = static_cast<int>(runs.size()) - 1; k >= 0; k--)
+            {
+                if (runs[k].digits)
+                {
+                    last = k;
+                    break;
+                }
+            }
+            if (last < 0 || runs[last].length > kMaxFrameDigits)
+                continue;
+
+            // Template: everything but the frame digits, extension included
+            frame = runs[last];
+            key = L"F";
+            key.append(name, 0, frame.start);
+            key.push_back(L'\x1');
+            key.append(name, frame.start + frame.length, std::wstring::npos);
+        }
+
+        auto [it, inserted] = index.try_emplace(key, sequences.size());
+        if (inserted)
+        {
+            Sequence sequence;
+            if (marker >= 0)
+            {
+                sequence.folderName = std::move(folderName);
+            }
+            else
+            {
+                sequence.prefix = name.substr(0, frame.start);
+                sequence.suffix = name.substr(frame.start + frame.length);
+            }
+            sequences.push_back(std::move(sequence));
+        }
+
+        Sequence& sequence = sequences[it->second];
+        sequence.items.push_back(i);
+        if (marker < 0)
+        {
+            uint64_t value = RunValue(stem, frame);
+            if (value < sequence.first) sequence.first = value;
+            if (value > sequence.last) sequence.last = value;
+            if (frame.length < sequence.width) sequence.width = frame.length;
+        }
+    }
+
+    for (auto& sequence : sequences)
+    {
+        bool episodic = !sequence.folderName.empty();
+        if (!episodic && sequence.items.size() < 2)
+            continue;
+
+        OrganizeGroup group;
+        if (episodic)
+            group.folderName = SanitizeFolderName(sequence.folderName);
+        else
+            group.folderName = SanitizeFolderName(sequence.prefix + L"[" + FormatFrame(sequence.first, sequence.width) +
+                L"-" + FormatFrame(sequence.last, sequence.width) + L"]" + sequence.suffix);
+        if (group.folderName.empty())
+            continue;
+        group.items = std::move(sequence.items);
+        plan.groups.push_back(std::move(group));
+    }
+    return true;
+}
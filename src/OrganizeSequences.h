@@ -0,0 +1,14 @@
+#pragma once
+#include "OrganizeTypes.h"
+
+// By Sequence: frame sequences and episodic series, one folder each.
+//
+//   shot010_v002.0001.exr ... shot010_v002.2400.exr  -> "shot010_v002.[0001-2400].exr"
+//   Show.S01E01.mkv, Show.S01E02.mkv                   -> "Show S01"
+//
+// Names are split into text and number runs in one pass. A name with a
+// season/episode marker (S01E02) joins its show and season; otherwise its last
+// number run is treated as the frame and the rest of the name is the sequence
+// template. Frame templates with a single member are not sequences, and their
+// files stay where they are.
+bool BuildSequencePlan(const std::vector<FileEntry>& entries, OrganizePlan& plan);
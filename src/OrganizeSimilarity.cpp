@@ -0,0 +1,168 @@
+#include "OrganizeSimilarity.h"
+#include "CaseFold.h"
+#include "OrganizePlanner.h"
+#include <cwctype>
+#include <unordered_map>
+
+// 16 bands of 2 rows: pairs with shingle similarity around 0.25 and up usually
+// share a band; the signature check then keeps the ones at kMinAgreement or better.
+static const size_t kMinHashes = 32;
+static const size_t kBands = 16;
+static const size_t kRows = kMinHashes / kBands;
+static const size_t kMinAgreement = 14;
+static const size_t kShingle = 3;
+
+typedef uint32_t Signature[kMinHashes];
+
+static uint64_t Mix64(uint64_t x)
+{
+    // splitmix64 finalizer
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// Case folded, with runs of separators and punctuation collapsed to one space and
+// a space on both ends so short words still produce shingles. Anything past ASCII
+// counts as a word character: iswalnum knows only ASCII in the C locale, and would
+// reduce Cyrillic or CJK names to nothing.
+static void NormalizeStem(const std::wstring& stem, std::wstring& text)
+{
+    text.assign(1, L' ');
+    for (wchar_t c : stem)
+    {
+        if (iswalnum(c) || static_cast<uint32_t>(c) >= 0x80)
+            text.push_back(FoldCase(c));
+        else if (text.back() != L' ')
+            text.push_back(L' ');
+    }
+    if (text.back() != L' ')
+        text.push_back(L' ');
+}
+
+// False when text is too short for a single shingle; the signature is then meaningless
+static bool ComputeSignature(const std::wstring& text, Signature& signature)
+{
+    for (auto& value : signature)
+        value = UINT32_MAX;
+
+    for (size_t i = 0; i + kShingle <= text.size(); i++)
+    {
+        uint64_t shingle = 0;
+        for (size_t j = 0; j < kShingle; j++)
+            shingle = shingle * 0x100000001B3ULL + static_cast<uint32_t>(text[i + j]);
+        shingle = Mix64(shingle);
+
+        // Cheap independent permutations of one good hash
+        for (size_t k = 0; k < kMinHashes; k++)
+        {
+            uint32_t value = static_cast<uint32_t>(Mix64(shingle + (k + 1) * 0x9E3779B97F4A7C15ULL) >> 32);
+            if (value < signature[k])
+                signature[k] = value;
+        }
+    }
+    return text.size() >= kShingle;
+}
+
+static size_t Agreement(const Signature& a, const Signature& b)
+{
+    size_t same = 0;
+    for (size_t k = 0; k < kMinHashes; k++)
+        same += a[k] == b[k];
+    return same;
+}
+
+static size_t FindRoot(std::vector<size_t>& parent, size_t x)
+{
+    while (parent[x] != x)
+    {
+        parent[x] = parent[parent[x]];
+        x = parent[x];
+    }
+    return x;
+}
+
+bool BuildSimilarNamePlan(const std::vector<FileEntry>& entries, OrganizePlan& plan)
+{
+    std::vector<Signature> signatures(entries.size());
+    std::vector<size_t> parent(entries.size());
+    // Stems without letters or digits (".bashrc", "---") have no shingles and match nothing
+    std::vector<bool> shingled(entries.size());
+    std::wstring text;
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        parent[i] = i;
+        NormalizeStem(PathStem(entries[i].path), text);
+        shingled[i] = ComputeSignature(text, signatures[i]);
+    }
+
+    // Per band: first and most recent entry seen in each bucket
+    for (size_t band = 0; band < kBands; band++)
+    {
+        std::unordered_map<uint64_t, std::pair<size_t, size_t>> buckets;
+        buckets.reserve(entries.size());
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            if (!shingled[i])
+                continue;
+            uint64_t key = band;
+            for (size_t r = 0; r < kRows; r++)
+                key = Mix64(key ^ signatures[i][band * kRows + r]);
+
+            auto [it, inserted] = buckets.try_emplace(key, i, i);
+            if (inserted)
+                continue;
+
+            for (size_t other : { it->second.first, it->second.second })
+            {
+                size_t a = FindRoot(parent, i);
+                size_t b = FindRoot(parent, other);
+                if (a != b && Agreement(signatures[i], signatures[other]) >= kMinAgreement)
+                    parent[a < b ? b : a] = a < b ? a : b;
+            }
+            it->second.second = i;
+        }
+    }
+
+    // Clusters in order of their first member
+    std::unordered_map<size_t, size_t> groupIndex;
+    std::vector<std::vector<size_t>> clusters;
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        auto [it, inserted] = groupIndex.try_emplace(FindRoot(parent, i), clusters.size());
+        if (inserted)
+            clusters.emplace_back();
+        clusters[it->second].push_back(i);
+    }
+
+    std::vector<std::wstring> paths;
+    for (auto& items : clusters)
+    {
+        if (items.size() < 2)
+            continue;
+
+        paths.clear();
+        for (size_t index : items)
+            paths.push_back(entries[index].path);
+
+        OrganizeGroup group;
+        group.folderName = GetCommonPrefix(paths);
+        // Similar names need not share a prefix; fall back to the first member's name
+        if (group.folderName == L"New Folder")
+            group.folderName = SanitizeFolderName(PathStem(paths[0]));
+        if (group.folderName.empty())
+            continue;
+        // An extensionless member can carry the folder's name; pick "Name (2)" then
+        for (const auto& path : paths)
+        {
+            if (PathFileName(path) == group.folderName)
+                group.uniqueName = true;
+        }
+        group.items = std::move(items);
+        plan.groups.push_back(std::move(group));
+    }
+    return true;
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include "OrganizeTypes.h"
+
+// By Similar Name: fuzzy clusters of near-duplicate names, e.g.
+// "Invoice March final.pdf" and "invoice-march-v2.pdf", each in a folder named
+// like GetCommonPrefix names the default folder.
+//
+// Every stem becomes a set of character 3-gram shingles summarized by a MinHash
+// signature. LSH banding buckets signatures that share a band; bucket hits whose
+// signatures agree on enough positions are merged. Each entry is compared with
+// at most two bucket members per band, so the cost stays linear in the number
+// of names. Entries without a similar partner stay where they are.
+bool BuildSimilarNamePlan(const std::vector<FileEntry>& entries, OrganizePlan& plan);
@@ -0,0 +1,517 @@
+#include "OrganizeStreaming.h"
+#include "CaseFold.h"
+#include "NaturalSort.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+// Runs open at once while merging; more are first merged into bigger runs
+const size_t kMaxMergeWidth = 64;
+
+// Entries read before their metadata is fetched and their records are added
+const size_t kVisitBatch = 4096;
+
+// Moves handed to IFileSystem::MoveEntries at once
+const size_t kStreamMoveBatch = 1024;
+
+// A record is four fields, each a 32-bit length and its bytes: the destination's key
+// (natural order, case folded), the file name's key, the folder name and the source path,
+// both UTF-8. Records sort by the two keys; runs on disk hold them back to back.
+static void AppendField(std::string& record, const std::string& field)
+{
+    uint32_t length = static_cast<uint32_t>(field.size());
+    record.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    record.append(field);
+}
+
+static size_t FieldLength(const char* field)
+{
+    uint32_t length;
+    memcpy(&length, field, sizeof(length));
+    return length;
+}
+
+static size_t RecordSize(const char* record)
+{
+    size_t size = 0;
+    for (int field = 0; field < 4; field++)
+        size += sizeof(uint32_t) + FieldLength(record + size);
+    return size;
+}
+
+static int CompareRecords(const char* a, const char* b)
+{
+    for (int field = 0; field < 2; field++)
+    {
+        size_t lengthA = FieldLength(a), lengthB = FieldLength(b);
+        int c = memcmp(a + sizeof(uint32_t), b + sizeof(uint32_t), std::min(lengthA, lengthB));
+        if (c != 0)
+            return c;
+        if (lengthA != lengthB)
+            return lengthA < lengthB ? -1 : 1;
+        a += sizeof(uint32_t) + lengthA;
+        b += sizeof(uint32_t) + lengthB;
+    }
+    return 0;
+}
+
+// Heap order over run readers: the smallest record on top, the earlier run first on ties
+template <typename Readers>
+static auto HeapOrder(const Readers& readers)
+{
+    return [&readers](size_t a, size_t b) {
+        int c = CompareRecords(readers[a]->record.data(), readers[b]->record.data());
+        return c != 0 ? c > 0 : a > b;
+    };
+}
+
+static FILE* OpenRun(const std::wstring& path, bool write)
+{
+#ifdef _WIN32
+    FILE* file = _wfopen(path.c_str(), write ? L"wb" : L"rb");
+#else
+    FILE* file = fopen(ToNativePath(path).c_str(), write ? "wb" : "rb");
+#endif
+    if (file)
+        setvbuf(file, nullptr, _IOFBF, 1 << 16);
+    return file;
+}
+
+static void RemoveRun(const std::wstring& path)
+{
+#ifdef _WIN32
+    _wremove(path.c_str());
+#else
+    remove(ToNativePath(path).c_str());
+#endif
+}
+
+static std::wstring TemporaryFolder()
+{
+#ifdef _WIN32
+    wchar_t buffer[MAX_PATH + 1];
+    DWORD length = GetTempPathW(MAX_PATH + 1, buffer);
+    return length > 0 && length <= MAX_PATH ? std::wstring(buffer, length) : L".";
+#else
+    const char* folder = getenv("TMPDIR");
+    return FromNativePath(folder && *folder ? folder : "/tmp");
+#endif
+}
+
+// Unique among the plans of every process sharing the folder
+static std::wstring NewRunPath(const std::wstring& folder)
+{
+    static std::atomic<unsigned> counter(0);
+#ifdef _WIN32
+    unsigned pid = static_cast<unsigned>(_getpid());
+#else
+    unsigned pid = static_cast<unsigned>(getpid());
+#endif
+    return JoinPath(folder.empty() ? TemporaryFolder() : folder,
+        L"nffstream-" + std::to_wstring(pid) + L"-" + std::to_wstring(counter++) + L".run");
+}
+
+struct StreamingPlan::RunReader
+{
+    FILE* file = nullptr;
+    std::string record;
+    bool failed = false;
+
+    ~RunReader()
+    {
+        if (file)
+            fclose(file);
+    }
+
+    // The next record into record; false at the end or on a short read (failed)
+    bool Read()
+    {
+        record.clear();
+        for (int field = 0; field < 4; field++)
+        {
+            uint32_t length;
+            if (fread(&length, sizeof(length), 1, file) != 1)
+            {
+                failed = field > 0 || ferror(file);
+                return false;
+            }
+            size_t start = record.size();
+            record.append(reinterpret_cast<const char*>(&length), sizeof(length));
+            record.resize(start + sizeof(length) + length);
+            if (length > 0 && fread(&record[start + sizeof(length)], 1, length, file) != length)
+            {
+                failed = true;
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+StreamingPlan::StreamingPlan(const StreamingPlanOptions& options) : m_options(options)
+{
+    m_options.memoryLimit = std::max<size_t>(m_options.memoryLimit, 1 << 20);
+}
+
+StreamingPlan::~StreamingPlan()
+{
+    m_readers.clear();
+    for (const auto& path : m_runPaths)
+        RemoveRun(path);
+}
+
+const std::string& StreamingPlan::GroupKey(const std::wstring& folder)
+{
+    // Listings come in no useful order, but most folders hold few distinct destinations
+    if (m_count == 0 || folder != m_folderKeyFor)
+    {
+        m_folderKeyFor = folder;
+        m_folderKey = NaturalSortKey(FoldCase(folder));
+    }
+    return m_folderKey;
+}
+
+bool StreamingPlan::Add(const std::wstring& folder, const std::wstring& source)
+{
+    if (m_finished || m_failed)
+        return false;
+
+    m_record.clear();
+    AppendField(m_record, GroupKey(folder));
+    AppendField(m_record, NaturalSortKey(PathFileName(source)));
+    AppendField(m_record, WideToUtf8(folder));
+    AppendField(m_record, WideToUtf8(source));
+
+    // Only touched pages count, so the whole buffer is reserved once and never moves
+    size_t used = m_buffer.size() + m_record.size() + (m_offsets.size() + 1) * sizeof(size_t);
+    if (!m_offsets.empty() && used > m_options.memoryLimit && !Spill())
+    {
+        m_failed = true;
+        return false;
+    }
+    if (m_buffer.capacity() < m_options.memoryLimit)
+        m_buffer.reserve(m_options.memoryLimit);
+
+    m_offsets.push_back(m_buffer.size());
+    m_buffer.append(m_record);
+    m_count++;
+    return true;
+}
+
+bool StreamingPlan::WriteSortedBuffer(FILE* file)
+{
+    // Stable, so equal keys keep the order they were added in
+    const char* base = m_buffer.data();
+    std::stable_sort(m_offsets.begin(), m_offsets.end(),
+        [base](size_t a, size_t b) { return CompareRecords(base + a, base + b) < 0; });
+    for (size_t offset : m_offsets)
+    {
+        size_t size = RecordSize(base + offset);
+        if (fwrite(base + offset, 1, size, file) != size)
+            return false;
+    }
+    return true;
+}
+
+bool StreamingPlan::Spill()
+{
+    std::wstring path = NewRunPath(m_options.spillFolder);
+    FILE* file = OpenRun(path, true);
+    if (!file)
+        return false;
+    m_runPaths.push_back(path);
+    bool ok = WriteSortedBuffer(file);
+    ok &= fclose(file) == 0;
+    m_buffer.clear();
+    m_offsets.clear();
+    return ok;
+}
+
+bool StreamingPlan::MergeRuns(size_t first, size_t count, const std::wstring& path)
+{
+    std::vector<std::unique_ptr<RunReader>> readers;
+    std::vector<size_t> heap;
+    FILE* out = OpenRun(path, true);
+    if (!out)
+        return false;
+    bool ok = OpenReaders(first, count, readers, heap);
+    auto greater = HeapOrder(readers);
+    while (ok && !heap.empty())
+    {
+        std::pop_heap(heap.begin(), heap.end(), greater);
+        RunReader& reader = *readers[heap.back()];
+        ok = fwrite(reader.record.data(), 1, reader.record.size(), out) == reader.record.size();
+        if (reader.Read())
+            std::push_heap(heap.begin(), heap.end(), greater);
+        else
+            heap.pop_back();
+        ok = ok && !reader.failed;
+    }
+    ok &= fclose(out) == 0;
+    return ok;
+}
+
+// Opens runs first .. first+count-1 and heaps the ones that hold a record
+bool StreamingPlan::OpenReaders(size_t first, size_t count, std::vector<std::unique_ptr<RunReader>>& readers,
+    std::vector<size_t>& heap)
+{
+    for (size_t r = first; r < first + count; r++)
+    {
+        readers.push_back(std::make_unique<RunReader>());
+        RunReader& reader = *readers.back();
+        reader.file = OpenRun(m_runPaths[r], false);
+        if (!reader.file)
+            return false;
+        if (reader.Read())
+            heap.push_back(readers.size() - 1);
+        else if (reader.failed)
+            return false;
+    }
+    std::make_heap(heap.begin(), heap.end(), HeapOrder(readers));
+    return true;
+}
+
+bool StreamingPlan::Finish()
+{
+    if (m_finished)
+        return !m_failed;
+    m_finished = true;
+
+    // Everything fit: sorted in place, nothing touches the disk
+    if (m_runPaths.empty())
+    {
+        const char* base = m_buffer.data();
+        std::stable_sort(m_offsets.begin(), m_offsets.end(),
+            [base](size_t a, size_t b) { return CompareRecords(base + a, base + b) < 0; });
+        return true;
+    }
+
+    if (!m_offsets.empty() && !Spill())
+        m_failed = true;
+    std::string().swap(m_buffer);
+    std::vector<size_t>().swap(m_offsets);
+
+    // Too many runs to open at once: the oldest are merged into one that takes their place,
+    // which keeps equal keys in the order they were added
+    while (!m_failed && m_runPaths.size() > kMaxMergeWidth)
+    {
+        std::wstring merged = NewRunPath(m_options.spillFolder);
+        bool ok = MergeRuns(0, kMaxMergeWidth, merged);
+        for (size_t r = 0; r < kMaxMergeWidth; r++)
+            RemoveRun(m_runPaths[r]);
+        m_runPaths.erase(m_runPaths.begin(), m_runPaths.begin() + kMaxMergeWidth);
+        m_runPaths.insert(m_runPaths.begin(), merged);
+        m_failed = !ok;
+    }
+
+    if (!m_failed && !OpenReaders(0, m_runPaths.size(), m_readers, m_heap))
+        m_failed = true;
+    return !m_failed;
+}
+
+bool StreamingPlan::Next(StreamingItem& item)
+{
+    if (!m_finished || m_failed)
+        return false;
+
+    const char* record;
+    if (m_runPaths.empty())
+    {
+        if (m_nextBuffered >= m_offsets.size())
+            return false;
+        record = m_buffer.data() + m_offsets[m_nextBuffered++];
+    }
+    else
+    {
+        if (m_heap.empty())
+            return false;
+        auto greater = HeapOrder(m_readers);
+        std::pop_heap(m_heap.begin(), m_heap.end(), greater);
+        RunReader& reader = *m_readers[m_heap.back()];
+        m_record.swap(reader.record);
+        if (reader.Read())
+            std::push_heap(m_heap.begin(), m_heap.end(), greater);
+        else
+            m_heap.pop_back();
+        if (reader.failed)
+        {
+            m_failed = true;
+            return false;
+        }
+        record = m_record.data();
+    }
+
+    const char* group = record + sizeof(uint32_t);
+    size_t groupLength = FieldLength(record);
+    const char* field = group + groupLength;
+    field += sizeof(uint32_t) + FieldLength(field);  // File name key
+    size_t folderLength = FieldLength(field);
+    const char* folder = field + sizeof(uint32_t);
+    field = folder + folderLength;
+    size_t sourceLength = FieldLength(field);
+    const char* source = field + sizeof(uint32_t);
+
+    item.newFolder = !m_started || m_lastGroup.size() != groupLength ||
+        memcmp(m_lastGroup.data(), group, groupLength) != 0;
+    if (item.newFolder)
+    {
+        m_started = true;
+        m_lastGroup.assign(group, groupLength);
+        item.folder = Utf8ToWide(folder, folderLength);
+    }
+    item.source = Utf8ToWide(source, sourceLength);
+    return true;
+}
+
+bool BuildStreamingPlan(IFileSystem& fs, const std::wstring& folder, OrganizeMode mode, const OrganizeOptions& options,
+    StreamingPlan& plan, size_t* metadataFailures)
+{
+    std::function<void(const FileEntry&, std::wstring&)> destination;
+    if (!MakeEntryDestination(mode, options, destination))
+        return false;
+    bool needsMetadata = OrganizeModeNeedsMetadata(mode, options);
+    unsigned mediaFields = OrganizeModeMediaFields(mode, options);
+    plan.SetUniqueFolders(OrganizeModeUsesUniqueFolders(mode));
+
+    std::vector<FileEntry> batch;
+    batch.reserve(kVisitBatch);
+    std::wstring destinationFolder;
+    size_t failures = 0;
+    bool ok = true;
+    auto addBatch = [&]() {
+        if (needsMetadata)
+            failures += QueryEntriesMetadata(fs, batch);
+        if (mediaFields)
+            QueryEntriesMediaInfo(fs, batch, mediaFields);
+        for (const auto& entry : batch)
+        {
+            destination(entry, destinationFolder);
+            if (!destinationFolder.empty())
+                ok = ok && plan.Add(destinationFolder, entry.path);
+        }
+        batch.clear();
+    };
+
+    // Only files stream: subfolders stay put, among them the destinations of an earlier run
+    FsResult listed = fs.VisitDirectory(folder, [&](FileEntry& entry) {
+        if (entry.isDirectory)
+            return;
+        batch.push_back(std::move(entry));
+        if (batch.size() == kVisitBatch)
+            addBatch();
+    });
+    addBatch();
+
+    if (metadataFailures)
+        *metadataFailures = failures;
+    return plan.Finish() && ok && listed == FsResult::Ok;
+}
+
+// Creates the levels of folder under parent that chain (the levels made for the previous
+// destination) does not already cover; chain becomes folder's levels
+static bool CreateDestination(IFileSystem& fs, const std::wstring& parent, const std::wstring& folder,
+    std::vector<std::wstring>& chain)
+{
+    std::vector<std::wstring> levels;
+    for (size_t end = folder.find(kPathSeparator); ; end = folder.find(kPathSeparator, end + 1))
+    {
+        levels.push_back(folder.substr(0, end));
+        if (end == std::wstring::npos)
+            break;
+    }
+
+    size_t same = 0;
+    while (same < levels.size() && same < chain.size() && levels[same] == chain[same])
+        same++;
+    chain.resize(same);
+    for (size_t level = same; level < levels.size(); level++)
+    {
+        FsResult created = fs.CreateFolder(JoinPath(parent, levels[level]));
+        if (created != FsResult::Ok && created != FsResult::AlreadyExists)
+            return false;
+        chain.push_back(levels[level]);
+    }
+    return true;
+}
+
+bool ExecuteStreamingPlan(IFileSystem& fs, const std::wstring& parent, StreamingPlan& plan, OrganizeResult& result,
+    const ExecuteOptions& options)
+{
+    if (options.copy)
+        return false;
+
+    size_t total = static_cast<size_t>(plan.Count()), done = 0;
+    std::vector<MoveRequest> moves;
+    auto flushMoves = [&]() {
+        fs.MoveEntries(moves);
+        for (const auto& move : moves)
+        {
+            if (move.result == FsResult::Ok)
+                result.moved++;
+            else
+                result.failed++;
+            if (options.progress && !result.cancelled && !options.progress(++done, total))
+                result.cancelled = true;
+        }
+        moves.clear();
+    };
+
+    StreamingItem item;
+    std::vector<std::wstring> chain;
+    std::wstring destination;
+    bool folderReady = false;
+    while (!result.cancelled && plan.Next(item))
+    {
+        if (item.newFolder)
+        {
+            // One destination at a time: its folders, then its files
+            if (!moves.empty())
+                flushMoves();
+            if (result.cancelled)
+                break;
+            if (plan.UniqueFolders())
+            {
+                destination = GenerateUniqueFolderPath(fs, parent, item.folder);
+                FsResult created = fs.CreateFolder(destination);
+                folderReady = created == FsResult::Ok || created == FsResult::AlreadyExists;
+                chain.clear();
+            }
+            else
+            {
+                destination = JoinPath(parent, item.folder);
+                folderReady = CreateDestination(fs, parent, item.folder, chain);
+            }
+            result.folders.push_back(destination);
+        }
+
+        if (!folderReady)
+        {
+            result.failed++;
+            done++;
+            continue;
+        }
+
+        MoveRequest move;
+        move.to = JoinPath(destination, PathFileName(item.source));
+        if (move.to == item.source)
+        {
+            done++;
+            continue;
+        }
+        move.from = item.source;
+        moves.push_back(std::move(move));
+        if (moves.size() == kStreamMoveBatch)
+            flushMoves();
+    }
+    if (!moves.empty())
+        flushMoves();
+    return !plan.Failed();
+}
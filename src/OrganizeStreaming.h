@@ -0,0 +1,96 @@
+#pragma once
+#include "OrganizeExecutor.h"
+#include "OrganizePlanner.h"
+#include <cstdio>
+#include <memory>
+
+// Plans for folders too large to hold in memory (millions of entries). Entries are read one
+// at a time (IFileSystem::VisitDirectory) and each becomes a (destination, file) record.
+// Records collect in a buffer of at most memoryLimit bytes; a full buffer is sorted and
+// written to disk as a run. Executing merges the runs and works through the destinations
+// one at a time, so memory stays flat whatever the folder holds. Only modes whose
+// destination depends on the entry alone can stream (OrganizeModeIsPerEntry).
+//
+// Destinations come in natural order of their folder names and files in natural order of
+// their names, as in BuildOrganizePlan. Folder names differing only in case are one
+// folder, spelled as for the first of its files in that order.
+
+struct StreamingPlanOptions
+{
+    size_t memoryLimit = 64 << 20;  // Record buffer in bytes (at least 1 MB); a full one spills a sorted run
+    std::wstring spillFolder;       // Runs go here; empty: the system's temporary folder
+};
+
+// One file of a streaming plan, in destination order
+struct StreamingItem
+{
+    std::wstring folder;  // Relative to the parent; nested for templates
+    std::wstring source;
+    bool newFolder = false;  // First file of its destination
+};
+
+class StreamingPlan
+{
+public:
+    explicit StreamingPlan(const StreamingPlanOptions& options = StreamingPlanOptions());
+    ~StreamingPlan();  // Deletes the runs
+    StreamingPlan(const StreamingPlan&) = delete;
+    StreamingPlan& operator=(const StreamingPlan&) = delete;
+
+    // Records source for folder; false when a run could not be written
+    bool Add(const std::wstring& folder, const std::wstring& source);
+    // Sorts what is buffered and starts the merge; nothing can be added afterwards
+    bool Finish();
+    // The next file; false at the end, or when a run could not be read (Failed)
+    bool Next(StreamingItem& item);
+
+    uint64_t Count() const { return m_count; }
+    size_t Runs() const { return m_runPaths.size(); }
+    bool Failed() const { return m_failed; }
+
+    // Each destination goes to a fresh folder beside a taken one ("2024-05 (2)"), as
+    // OrganizeGroup::uniqueName; BuildStreamingPlan sets it for the date modes
+    void SetUniqueFolders(bool unique) { m_uniqueFolders = unique; }
+    bool UniqueFolders() const { return m_uniqueFolders; }
+
+private:
+    struct RunReader;
+
+    bool Spill();
+    bool WriteSortedBuffer(FILE* file);
+    bool OpenReaders(size_t first, size_t count, std::vector<std::unique_ptr<RunReader>>& readers,
+        std::vector<size_t>& heap);
+    bool MergeRuns(size_t first, size_t count, const std::wstring& path);
+    const std::string& GroupKey(const std::wstring& folder);
+
+    StreamingPlanOptions m_options;
+    std::string m_buffer;            // Records back to back
+    std::vector<size_t> m_offsets;   // Record starts in m_buffer
+    std::vector<std::wstring> m_runPaths;
+    std::vector<std::unique_ptr<RunReader>> m_readers;
+    std::vector<size_t> m_heap;      // Readers by their current record, smallest first
+    size_t m_nextBuffered = 0;       // Nothing spilled: the next record of m_offsets
+    std::string m_lastGroup;         // Key of the destination Next is in
+    bool m_started = false;
+    std::string m_record;
+    std::wstring m_folderKeyFor;     // Last folder Add saw, and its key
+    std::string m_folderKey;
+    uint64_t m_count = 0;
+    bool m_finished = false;
+    bool m_failed = false;
+    bool m_uniqueFolders = false;
+};
+
+// Reads folder's files (subfolders are left alone), fills in the metadata and media facts the mode needs a few
+// thousand entries at a time, and records each one's destination. False for modes that do
+// not stream, invalid options, an unreadable folder or a failed spill. metadataFailures,
+// when given, counts entries whose metadata could not be read.
+bool BuildStreamingPlan(IFileSystem& fs, const std::wstring& folder, OrganizeMode mode, const OrganizeOptions& options,
+    StreamingPlan& plan, size_t* metadataFailures = nullptr);
+
+// Creates each destination under parent (nested levels parents first; a fresh name for
+// unique folders) and moves its files in batches, one destination at a time. Nothing is replaced: a taken name fails,
+// as with ConflictPolicy::None. Copy is not supported (false). result.folders lists the
+// destinations; progress works as in ExecuteOrganizePlan.
+bool ExecuteStreamingPlan(IFileSystem& fs, const std::wstring& parent, StreamingPlan& plan, OrganizeResult& result,
+    const ExecuteOptions& options = ExecuteOptions());
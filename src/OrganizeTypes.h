@@ -0,0 +1,109 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum class OrganizeMode
+{
+    Default = 0,
+    ByDay,
+    ByMonth,
+    ByYear,
+    ByMonthYear,
+    ByFullDate,
+    ByTypeVideo,
+    ByTypePhoto,
+    ByTypeAudio,
+    ByTypeDocument,
+    ByTypeOther,
+    ByExtension,
+    BySize,
+    Flatten,
+    Numbered,
+    Alphabetical,
+    ByRules,
+    ByTemplate,
+    BySequence,
+    BySimilarName,
+    ByOrientation,
+    ByResolution,
+    ByArtist,
+    ByArtistAlbum,
+    COUNT
+};
+
+// Facts that need a look inside the file; see QueryEntriesMediaInfo
+enum MediaField : unsigned
+{
+    MediaNone = 0,
+    MediaImageSize = 1 << 0,     // Photos: pixel size, EXIF/TIFF orientation applied
+    MediaAudioTags = 1 << 1,     // Audio: artist and album tags
+    MediaCreationTime = 1 << 2,  // Video: capture time from the MP4/MOV header
+};
+
+struct MediaInfo
+{
+    uint32_t width = 0;   // 0 when unknown
+    uint32_t height = 0;
+    std::wstring artist;  // Album artist when tagged, else track artist; raw tag text
+    std::wstring album;
+    uint64_t creationTime = 0;  // FILETIME ticks (UTC); 0 when unknown
+};
+
+// One selected item. Times are FILETIME ticks (100ns since 1601-01-01 UTC) on every platform.
+struct FileEntry
+{
+    std::wstring path;
+    uint64_t size = 0;
+    uint64_t lastWriteTime = 0;
+    bool isDirectory = false;
+    bool hasMetadata = false;
+    std::shared_ptr<const MediaInfo> media;  // Set by QueryEntriesMediaInfo when something was read
+};
+
+// A destination folder and the entries that move into it.
+struct OrganizeGroup
+{
+    std::wstring folderName;    // Relative to the parent folder; empty means the parent itself
+    std::vector<size_t> items;  // Indices into the entry list the plan was built from
+    bool uniqueName = false;    // true: pick a fresh "Name (N)"; false: merge into an existing folder
+    int folder = -1;            // Nested destinations: index into OrganizePlan::folders
+    // Set by ResolveConflicts, parallel to items: the name in the destination folder, and
+    // whether it replaces an existing file there. Empty: every item keeps its own name.
+    std::vector<std::wstring> targetNames;
+    std::vector<uint8_t> replaces;
+};
+
+// A folder of a nested plan. Parents are listed before their children.
+struct OrganizeFolder
+{
+    std::wstring relativePath;  // Relative to the parent folder
+    int parent = -1;            // Enclosing planned folder, -1 for a direct child of the parent folder
+};
+
+// What happens when a destination already holds an item of the same name
+enum class ConflictPolicy
+{
+    None = 0,             // Not resolved up front: the mover fails (or asks, in Explorer)
+    RenameSuffix,         // "Name (2).ext", first free one
+    Skip,                 // Leave the incoming item where it is
+    OverwriteIfNewer,     // Replace an older file; keep the existing one otherwise
+    KeepBothIfDifferent,  // Identical content: skip; different: rename
+};
+
+class RuleSet;
+
+// Inputs some modes need beyond the entries themselves
+struct OrganizeOptions
+{
+    const RuleSet* rules = nullptr;  // ByRules
+    std::wstring destinationTemplate;  // ByTemplate, e.g. L"{yyyy}/{MM}/{category}"
+};
+
+struct OrganizePlan
+{
+    OrganizeMode mode = OrganizeMode::Default;
+    std::vector<OrganizeGroup> groups;
+    std::vector<OrganizeFolder> folders;  // Every folder a nested plan needs, each once; empty for flat plans
+};
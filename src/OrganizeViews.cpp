@@ -0,0 +1,287 @@
+#include "OrganizeViews.h"
+#include "OrganizePlanner.h"
+#include <cstring>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+
+const wchar_t* const kViewManifestName = L".nffview";
+
+static const char kManifestHeader[] = "nffview 1\n";
+
+struct ViewLink
+{
+    std::wstring source;
+    uint64_t size = 0;
+    uint64_t lastWriteTime = 0;
+    bool directory = false;
+    bool present = false;  // In the view now: kept or linked by this rebuild
+
+    bool SameSource(const ViewLink& other) const
+    {
+        return source == other.source && size == other.size && lastWriteTime == other.lastWriteTime &&
+            directory == other.directory;
+    }
+};
+
+// Manifest fields are tab separated; names may contain anything but NUL
+static void AppendEscaped(std::string& out, const std::wstring& text)
+{
+    for (char c : WideToUtf8(text))
+    {
+        if (c == '\\') out += "\\\\";
+        else if (c == '\t') out += "\\t";
+        else if (c == '\n') out += "\\n";
+        else out.push_back(c);
+    }
+}
+
+static std::wstring Unescape(const char* text, size_t length, std::string& scratch)
+{
+    if (memchr(text, '\\', length) == nullptr)
+        return Utf8ToWide(text, length);
+
+    scratch.clear();
+    for (size_t i = 0; i < length; i++)
+    {
+        if (text[i] == '\\' && i + 1 < length)
+        {
+            char c = text[++i];
+            scratch.push_back(c == 't' ? '\t' : c == 'n' ? '\n' : c);
+        }
+        else
+        {
+            scratch.push_back(text[i]);
+        }
+    }
+    return Utf8ToWide(scratch.data(), scratch.size());
+}
+
+// Manifests are plain files in a user-visible folder; never follow one outside the view
+static bool IsViewRelativePath(const std::wstring& relative)
+{
+    if (relative.empty())
+        return false;
+    size_t start = 0;
+    for (;;)
+    {
+        size_t end = relative.find_first_of(L"/\\", start);
+        std::wstring part = relative.substr(start, end == std::wstring::npos ? std::wstring::npos : end - start);
+        if (part.empty() || part == L"." || part == L".." || part.find(L':') != std::wstring::npos)
+            return false;
+        if (end == std::wstring::npos)
+            return true;
+        start = end + 1;
+    }
+}
+
+// link \t source \t size \t mtime \t d|f
+static void ReadManifest(const std::wstring& path, std::unordered_map<std::wstring, ViewLink>& links)
+{
+    std::string content;
+    if (!ReadFileBytes(path, content) || content.compare(0, sizeof(kManifestHeader) - 1, kManifestHeader) != 0)
+        return;
+
+    const char* fields[5];
+    size_t lengths[5];
+    std::string scratch;
+    size_t pos = sizeof(kManifestHeader) - 1;
+    while (pos < content.size())
+    {
+        size_t end = content.find('\n', pos);
+        if (end == std::string::npos)
+            break;  // Torn last line
+
+        size_t count = 0;
+        for (size_t start = pos; start <= end && count < 5; count++)
+        {
+            size_t tab = content.find('\t', start);
+            size_t stop = tab < end ? tab : end;
+            fields[count] = content.data() + start;
+            lengths[count] = stop - start;
+            start = stop + 1;
+        }
+        bool complete = count == 5 && fields[4] + lengths[4] == content.data() + end;
+        pos = end + 1;
+        if (!complete)
+            continue;
+
+        ViewLink link;
+        link.source = Unescape(fields[1], lengths[1], scratch);
+        link.size = strtoull(fields[2], nullptr, 10);
+        link.lastWriteTime = strtoull(fields[3], nullptr, 10);
+        link.directory = lengths[4] == 1 && fields[4][0] == 'd';
+        std::wstring relative = Unescape(fields[0], lengths[0], scratch);
+        if (IsViewRelativePath(relative))
+            links[std::move(relative)] = std::move(link);
+    }
+}
+
+static bool WriteManifest(const std::wstring& path, const std::unordered_map<std::wstring, ViewLink>& links)
+{
+    std::string content = kManifestHeader;
+    for (const auto& [name, link] : links)
+    {
+        if (!link.present)
+            continue;
+        AppendEscaped(content, name);
+        content.push_back('\t');
+        AppendEscaped(content, link.source);
+        content += "\t" + std::to_string(link.size) + "\t" + std::to_string(link.lastWriteTime) + (link.directory ? "\td\n" : "\tf\n");
+    }
+    return WriteFileBytes(path, content);
+}
+
+// "a/b/c" -> "a/b", "a" -> ""
+static std::wstring RelativeParent(const std::wstring& relative)
+{
+    size_t separator = relative.find_last_of(kPathSeparator);
+    return separator == std::wstring::npos ? std::wstring() : relative.substr(0, separator);
+}
+
+// Creates a view folder and any missing ancestors, once each
+static bool EnsureViewFolder(IFileSystem& fs, const std::wstring& viewRoot, const std::wstring& relative,
+    std::unordered_set<std::wstring>& known)
+{
+    if (relative.empty() || known.count(relative))
+        return true;
+    if (!EnsureViewFolder(fs, viewRoot, RelativeParent(relative), known))
+        return false;
+    FsResult fr = fs.CreateFolder(JoinPath(viewRoot, relative));
+    if (fr != FsResult::Ok && fr != FsResult::AlreadyExists)
+        return false;
+    known.insert(relative);
+    return true;
+}
+
+bool BuildLinkView(IFileSystem& fs, const std::wstring& viewRoot, const std::vector<FileEntry>& entries,
+    const OrganizePlan& plan, ViewResult& result)
+{
+    FsResult rootResult = fs.CreateFolder(viewRoot);
+    if (rootResult != FsResult::Ok && rootResult != FsResult::AlreadyExists)
+        return false;
+
+    // Planned links: relative path in the view -> source
+    std::unordered_map<std::wstring, ViewLink> planned;
+    planned.reserve(entries.size());
+    for (const auto& group : plan.groups)
+    {
+        for (size_t index : group.items)
+        {
+            FileEntry queried;
+            const FileEntry* source = &entries[index];
+            if (!source->hasMetadata)
+            {
+                queried = *source;
+                if (fs.QueryMetadata(queried) != FsResult::Ok)
+                {
+                    result.failed++;
+                    continue;
+                }
+                source = &queried;
+            }
+            const FileEntry& entry = *source;
+
+            std::wstring name = PathFileName(entry.path);
+            std::wstring relative = group.folderName.empty() ? name : JoinPath(group.folderName, name);
+            ViewLink link;
+            link.source = entry.path;
+            link.size = entry.size;
+            link.lastWriteTime = entry.lastWriteTime;
+            link.directory = entry.isDirectory;
+            // Two sources with the same name in one folder: the first one wins
+            if (!planned.emplace(relative, std::move(link)).second)
+                result.failed++;
+        }
+    }
+
+    std::wstring manifestPath = JoinPath(viewRoot, kViewManifestName);
+    std::unordered_map<std::wstring, ViewLink> existing;
+    ReadManifest(manifestPath, existing);
+
+    // Folders the manifest proves exist; stale links whose folders may empty out
+    std::unordered_set<std::wstring> knownFolders;
+    std::set<std::wstring> vacated;
+    bool changed = false;
+    for (const auto& [relative, link] : existing)
+    {
+        auto it = planned.find(relative);
+        if (it != planned.end() && it->second.SameSource(link))
+        {
+            it->second.present = true;
+            result.unchanged++;
+            for (std::wstring folder = RelativeParent(relative); !folder.empty(); folder = RelativeParent(folder))
+            {
+                if (!knownFolders.insert(folder).second)
+                    break;
+            }
+            continue;
+        }
+
+        changed = true;
+        FsResult fr = fs.DeleteEntry(JoinPath(viewRoot, relative));
+        if (fr == FsResult::Ok || fr == FsResult::NotFound)
+        {
+            if (it == planned.end())
+                result.removed++;
+            for (std::wstring folder = RelativeParent(relative); !folder.empty(); folder = RelativeParent(folder))
+                vacated.insert(folder);
+        }
+        else
+        {
+            // Still there: a replacement could not be linked either
+            result.failed++;
+            if (it != planned.end())
+                planned.erase(it);
+        }
+    }
+
+    // New and changed links, one LinkEntries batch per folder. The map keeps parents first.
+    std::map<std::wstring, std::vector<LinkRequest>> batches;
+    for (const auto& [relative, link] : planned)
+    {
+        if (link.present)
+            continue;
+        LinkRequest request;
+        request.source = link.source;
+        request.name = PathFileName(relative);
+        request.directory = link.directory;
+        batches[RelativeParent(relative)].push_back(std::move(request));
+    }
+
+    for (auto& [folder, links] : batches)
+    {
+        changed = true;
+        if (!EnsureViewFolder(fs, viewRoot, folder, knownFolders))
+        {
+            result.failed += links.size();
+            continue;
+        }
+
+        std::wstring folderPath = folder.empty() ? viewRoot : JoinPath(viewRoot, folder);
+        fs.LinkEntries(folderPath, links);
+        for (const auto& link : links)
+        {
+            if (link.result != FsResult::Ok)
+            {
+                result.failed++;
+                continue;
+            }
+            planned[folder.empty() ? link.name : JoinPath(folder, link.name)].present = true;
+            result.linked++;
+        }
+    }
+
+    // Folders left empty by removed links; deepest first, and only if really empty
+    for (auto it = vacated.rbegin(); it != vacated.rend(); ++it)
+    {
+        if (!knownFolders.count(*it))
+            fs.DeleteEntry(JoinPath(viewRoot, *it));
+    }
+
+    // A no-op rebuild leaves the manifest alone
+    if (!changed)
+        return true;
+    return WriteManifest(manifestPath, planned);
+}
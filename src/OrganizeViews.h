@@ -0,0 +1,28 @@
+#pragma once
+#include "FileSystem.h"
+
+// Link views: a plan's tree built from hard links to the selected files (symbolic
+// links for folders and across volumes) under a separate root, so several organized
+// views of the same files (by date, by type, ...) can exist side by side without
+// moving or duplicating any data.
+//
+// The view root holds a manifest (.nffview) with every link and its source's size and
+// modified time. A rebuild diffs the new plan against it and only touches links that
+// were added, removed, or whose source changed; unchanged links are not even probed.
+
+struct ViewResult
+{
+    size_t linked = 0;     // New or replaced links
+    size_t unchanged = 0;
+    size_t removed = 0;    // Stale links deleted
+    size_t failed = 0;
+};
+
+// Name of the manifest file inside a view root
+extern const wchar_t* const kViewManifestName;
+
+// Builds or refreshes the view at viewRoot (created when missing). Group folder names
+// are used as they are; uniqueName does not apply inside a view. Returns false when the
+// root cannot be created or the manifest cannot be written.
+bool BuildLinkView(IFileSystem& fs, const std::wstring& viewRoot, const std::vector<FileEntry>& entries,
+    const OrganizePlan& plan, ViewResult& result);
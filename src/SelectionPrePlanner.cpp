@@ -0,0 +1,73 @@
+#include "SelectionPrePlanner.h"
+#include "OrganizePlanner.h"
+#include <algorithm>
+#include <chrono>
+
+SelectionPrePlanner::SelectionPrePlanner(const std::vector<std::wstring>& paths) : m_entries(paths.size())
+{
+    for (size_t i = 0; i < paths.size(); i++)
+        m_entries[i].path = paths[i];
+}
+
+void SelectionPrePlanner::Run(IFileSystem& fs, const Budget& budget)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_state != State::Queued || m_cancel)
+        {
+            m_state = State::Done;
+            return;
+        }
+        m_state = State::Running;
+    }
+
+    using Clock = std::chrono::steady_clock;
+    auto deadline = Clock::now() + std::chrono::milliseconds(budget.timeMs);
+    size_t limit = std::min(budget.maxEntries, m_entries.size());
+    for (size_t i = 0; i < limit && !m_cancel; i++)
+    {
+        if (Clock::now() >= deadline)
+            break;
+        fs.QueryMetadata(m_entries[i]);
+        m_gathered = i + 1;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_state = State::Done;
+    m_stopped.notify_all();
+}
+
+bool SelectionPrePlanner::Take(const std::vector<std::wstring>& paths, std::vector<FileEntry>& entries)
+{
+    m_cancel = true;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_stopped.wait(lock, [this]() { return m_state != State::Running; });
+    bool queued = m_state == State::Queued;
+    m_state = State::Done;
+    if (queued || m_entries.size() != paths.size())
+        return false;
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        if (m_entries[i].path != paths[i])
+            return false;
+    }
+    entries = std::move(m_entries);
+    m_entries.clear();
+    return true;
+}
+
+std::vector<std::pair<std::wstring, size_t>> CountFileTypes(const std::vector<std::wstring>& paths)
+{
+    std::vector<std::pair<std::wstring, size_t>> counts;
+    for (const auto& path : paths)
+    {
+        std::wstring category = GetFileTypeCategory(path);
+        auto it = std::find_if(counts.begin(), counts.end(), [&](const auto& c) { return c.first == category; });
+        if (it == counts.end())
+            counts.emplace_back(std::move(category), 1);
+        else
+            it->second++;
+    }
+    std::stable_sort(counts.begin(), counts.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+    return counts;
+}
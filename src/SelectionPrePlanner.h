@@ -0,0 +1,54 @@
+#pragma once
+#include "FileSystem.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+// Work done on a selection while its context menu is open. QueryContextMenu posts Run
+// to a worker, the user spends a few hundred milliseconds picking a command, and the
+// command starts from whatever was gathered by then instead of from bare paths.
+//
+// Run stays inside a budget (wall time and entries looked at) and stops at the next
+// entry once the menu is dismissed or a command is picked. Results are only ever
+// partial in order: the first Gathered() entries have their metadata.
+class SelectionPrePlanner
+{
+public:
+    struct Budget
+    {
+        uint32_t timeMs = 250;        // Wall time for the whole run
+        size_t maxEntries = 20000;    // Entries whose metadata is read
+    };
+
+    explicit SelectionPrePlanner(const std::vector<std::wstring>& paths);
+
+    SelectionPrePlanner(const SelectionPrePlanner&) = delete;
+    SelectionPrePlanner& operator=(const SelectionPrePlanner&) = delete;
+
+    // Reads metadata in selection order until done, cancelled or out of budget. Returns
+    // at once when Take or Cancel came first (a run still queued behind another job).
+    void Run(IFileSystem& fs, const Budget& budget);
+
+    // Stops a run at its next entry; what was gathered stays available to Take
+    void Cancel() { m_cancel = true; }
+
+    // Cancels, waits for a running Run to stop, and hands over the entries when they
+    // still describe paths (the selection the command runs on). Callable once.
+    bool Take(const std::vector<std::wstring>& paths, std::vector<FileEntry>& entries);
+
+    size_t Gathered() const { return m_gathered.load(); }
+
+private:
+    enum class State { Queued, Running, Done };
+
+    std::vector<FileEntry> m_entries;
+    std::atomic<bool> m_cancel{ false };
+    std::atomic<size_t> m_gathered{ 0 };
+    std::mutex m_mutex;
+    std::condition_variable m_stopped;
+    State m_state = State::Queued;
+};
+
+// Files per type category (GetFileTypeCategory, as By Type groups them) from the names
+// alone, largest first; ties keep the first-seen order
+std::vector<std::pair<std::wstring, size_t>> CountFileTypes(const std::vector<std::wstring>& paths);
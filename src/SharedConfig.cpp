@@ -0,0 +1,293 @@
+#include "SharedConfig.h"
+#include "FileSystem.h"
+#include "OrganizePlanner.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char kConfigMagic[4] = { 'N', 'F', 'F', 'C' };
+static const uint32_t kConfigVersion = 1;
+
+std::string BuildConfigImage(const std::string& rulesText, bool hasRules, uint64_t sourceSize, uint64_t sourceTime,
+    RuleSet* compiled)
+{
+    ConfigImageHeader header = {};
+    memcpy(header.magic, kConfigMagic, sizeof(header.magic));
+    header.version = kConfigVersion;
+    header.sourceSize = sourceSize;
+    header.sourceTime = sourceTime;
+    header.rulesOffset = sizeof(ConfigImageHeader);
+    header.ready = 1;
+
+    if (hasRules)
+    {
+        header.flags |= ConfigHasRules;
+        RuleSet local;
+        RuleSet& rules = compiled ? *compiled : local;
+        if (rules.Compile(Utf8ToWide(rulesText.data(), rulesText.size())))
+        {
+            header.flags |= ConfigRulesValid;
+            if (rules.NeedsMetadata())
+                header.flags |= ConfigRulesNeedMetadata;
+            header.ruleCount = static_cast<uint32_t>(rules.Count());
+            header.rulesLength = rulesText.size();
+        }
+    }
+    header.imageSize = header.rulesOffset + header.rulesLength;
+
+    std::string image(reinterpret_cast<const char*>(&header), sizeof(header));
+    image.append(rulesText.data(), static_cast<size_t>(header.rulesLength));
+    return image;
+}
+
+static bool IsValidImage(const void* data, size_t size)
+{
+    if (size < sizeof(ConfigImageHeader))
+        return false;
+    const ConfigImageHeader* header = static_cast<const ConfigImageHeader*>(data);
+    return memcmp(header->magic, kConfigMagic, sizeof(header->magic)) == 0 && header->version == kConfigVersion &&
+        header->imageSize <= size && header->rulesOffset + header->rulesLength <= header->imageSize;
+}
+
+ConfigSnapshot::~ConfigSnapshot()
+{
+#ifdef _WIN32
+    if (m_view)
+        UnmapViewOfFile(m_view);
+    if (m_section)
+        CloseHandle(m_section);
+#else
+    if (m_view)
+        munmap(m_view, m_viewSize);
+#endif
+}
+
+const RuleSet* ConfigSnapshot::Rules() const
+{
+    if (!(Header().flags & ConfigRulesValid))
+        return nullptr;
+
+    std::call_once(m_compileOnce, [this]() {
+        if (m_rules)
+            return;
+        const char* text = reinterpret_cast<const char*>(m_image + Header().rulesOffset);
+        auto rules = std::make_unique<RuleSet>();
+        if (rules->Compile(Utf8ToWide(text, static_cast<size_t>(Header().rulesLength))))
+            m_rules = std::move(rules);
+    });
+    return m_rules.get();
+}
+
+struct ConfigLoader
+{
+    // Image kept in this process only
+    static std::shared_ptr<ConfigSnapshot> FromPrivate(std::string image, std::unique_ptr<RuleSet> rules)
+    {
+        auto snapshot = std::make_shared<ConfigSnapshot>();
+        snapshot->m_private = std::move(image);
+        snapshot->m_image = reinterpret_cast<const uint8_t*>(snapshot->m_private.data());
+        snapshot->m_rules = std::move(rules);
+        return snapshot;
+    }
+
+#ifdef _WIN32
+    static std::wstring SectionName(uint64_t sourceSize, uint64_t sourceTime)
+    {
+        return L"Local\\NewFolderFromFiles.Config." + std::to_wstring(kConfigVersion) + L"." +
+            std::to_wstring(sourceSize) + L"." + std::to_wstring(sourceTime);
+    }
+
+    // Another process's finished section; nullptr while it is still being filled
+    static std::shared_ptr<ConfigSnapshot> FromSection(HANDLE section)
+    {
+        void* view = MapViewOfFile(section, FILE_MAP_READ, 0, 0, 0);
+        MEMORY_BASIC_INFORMATION info = {};
+        if (!view || !VirtualQuery(view, &info, sizeof(info)) || !IsValidImage(view, info.RegionSize) ||
+            ReadAcquire(reinterpret_cast<const volatile LONG*>(&static_cast<const ConfigImageHeader*>(view)->ready)) == 0)
+        {
+            if (view)
+                UnmapViewOfFile(view);
+            CloseHandle(section);
+            return nullptr;
+        }
+
+        auto snapshot = std::make_shared<ConfigSnapshot>();
+        snapshot->m_view = view;
+        snapshot->m_viewSize = info.RegionSize;
+        snapshot->m_section = section;
+        snapshot->m_image = static_cast<const uint8_t*>(view);
+        return snapshot;
+    }
+
+    // Publishes a freshly built image; readers ignore it until ready is set
+    static std::shared_ptr<ConfigSnapshot> Publish(const std::wstring& name, const std::string& image)
+    {
+        HANDLE section = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0,
+            static_cast<DWORD>(image.size()), name.c_str());
+        if (!section)
+            return nullptr;
+        if (GetLastError() == ERROR_ALREADY_EXISTS)
+            return FromSection(section);
+
+        void* view = MapViewOfFile(section, FILE_MAP_WRITE, 0, 0, 0);
+        if (!view)
+        {
+            CloseHandle(section);
+            return nullptr;
+        }
+        ConfigImageHeader header;
+        memcpy(&header, image.data(), sizeof(header));
+        header.ready = 0;
+        memcpy(view, &header, sizeof(header));
+        memcpy(static_cast<char*>(view) + sizeof(header), image.data() + sizeof(header), image.size() - sizeof(header));
+        InterlockedExchange(reinterpret_cast<volatile LONG*>(&static_cast<ConfigImageHeader*>(view)->ready), 1);
+
+        auto snapshot = std::make_shared<ConfigSnapshot>();
+        snapshot->m_view = view;
+        snapshot->m_viewSize = image.size();
+        snapshot->m_section = section;
+        snapshot->m_image = static_cast<const uint8_t*>(view);
+        return snapshot;
+    }
+#else
+    static std::shared_ptr<ConfigSnapshot> FromFile(const std::wstring& path, uint64_t sourceSize, uint64_t sourceTime)
+    {
+        int fd = open(ToNativePath(path).c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return nullptr;
+        struct stat st;
+        void* view = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(ConfigImageHeader)))
+            view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (view == MAP_FAILED)
+            return nullptr;
+
+        auto snapshot = std::make_shared<ConfigSnapshot>();
+        snapshot->m_view = view;
+        snapshot->m_viewSize = static_cast<size_t>(st.st_size);
+        snapshot->m_image = static_cast<const uint8_t*>(view);
+        if (!IsValidImage(view, snapshot->m_viewSize) || !snapshot->Matches(sourceSize, sourceTime))
+            return nullptr;
+        return snapshot;
+    }
+#endif
+
+    static std::shared_ptr<ConfigSnapshot> Load(const std::wstring& rulesPath, bool hasRules, uint64_t sourceSize, uint64_t sourceTime)
+    {
+        // Nothing to share without a rules file
+        if (!hasRules)
+            return FromPrivate(BuildConfigImage(std::string(), false, 0, 0), nullptr);
+
+#ifdef _WIN32
+        std::wstring name = SectionName(sourceSize, sourceTime);
+        if (HANDLE section = OpenFileMappingW(FILE_MAP_READ, FALSE, name.c_str()))
+        {
+            if (auto shared = FromSection(section))
+                return shared;
+        }
+#else
+        std::wstring imagePath = GetDefaultConfigImagePath();
+        if (!imagePath.empty())
+        {
+            if (auto shared = FromFile(imagePath, sourceSize, sourceTime))
+                return shared;
+        }
+#endif
+
+        std::string bytes;
+        ReadFileBytes(rulesPath, bytes);
+        size_t offset = bytes.compare(0, 3, "\xEF\xBB\xBF") == 0 ? 3 : 0;
+        auto rules = std::make_unique<RuleSet>();
+        std::string image = BuildConfigImage(bytes.substr(offset), true, sourceSize, sourceTime, rules.get());
+        if (!(reinterpret_cast<const ConfigImageHeader*>(image.data())->flags & ConfigRulesValid))
+            rules.reset();
+
+#ifdef _WIN32
+        if (auto shared = Publish(name, image))
+        {
+            shared->m_rules = std::move(rules);
+            return shared;
+        }
+#else
+        if (!imagePath.empty())
+        {
+            LocalFileSystem fs;
+            fs.CreateFolder(PathParent(PathParent(imagePath)));  // ~/.cache may not exist yet
+            fs.CreateFolder(PathParent(imagePath));
+            if (WriteFileBytes(imagePath, image))
+            {
+                if (auto shared = FromFile(imagePath, sourceSize, sourceTime))
+                {
+                    shared->m_rules = std::move(rules);
+                    return shared;
+                }
+            }
+        }
+#endif
+        return FromPrivate(std::move(image), std::move(rules));
+    }
+};
+
+static std::shared_ptr<const ConfigSnapshot> g_config;
+static std::mutex g_refreshMutex;
+static std::atomic<int64_t> g_lastCheckMs(0);
+
+std::shared_ptr<const ConfigSnapshot> GetSharedConfig()
+{
+    std::shared_ptr<const ConfigSnapshot> current = std::atomic_load(&g_config);
+    return current ? current : RefreshSharedConfig();
+}
+
+std::shared_ptr<const ConfigSnapshot> RefreshSharedConfig()
+{
+    using namespace std::chrono;
+    int64_t now = duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+    std::shared_ptr<const ConfigSnapshot> current = std::atomic_load(&g_config);
+    if (current && now - g_lastCheckMs.load() < 1000)
+        return current;
+
+    std::lock_guard<std::mutex> lock(g_refreshMutex);
+    current = std::atomic_load(&g_config);
+    if (current && now - g_lastCheckMs.load() < 1000)
+        return current;
+    g_lastCheckMs = now;
+
+    std::wstring rulesPath = GetDefaultRulesPath();
+    FileEntry source;
+    source.path = rulesPath;
+    LocalFileSystem fs;
+    bool hasRules = !rulesPath.empty() && fs.QueryMetadata(source) == FsResult::Ok && !source.isDirectory;
+    uint64_t sourceSize = hasRules ? source.size : 0;
+    uint64_t sourceTime = hasRules ? source.lastWriteTime : 0;
+    if (current && current->HasRules() == hasRules && current->Matches(sourceSize, sourceTime))
+        return current;
+
+    std::shared_ptr<const ConfigSnapshot> loaded = ConfigLoader::Load(rulesPath, hasRules, sourceSize, sourceTime);
+    std::atomic_store(&g_config, loaded);
+    return loaded;
+}
+
+#ifndef _WIN32
+std::wstring GetDefaultConfigImagePath()
+{
+    std::wstring base;
+    if (const char* xdg = getenv("XDG_CACHE_HOME"))
+        base = FromNativePath(xdg);
+    else if (const char* home = getenv("HOME"))
+        base = JoinPath(FromNativePath(home), L".cache");
+    if (base.empty())
+        return std::wstring();
+    return JoinPath(JoinPath(base, L"NewFolderFromFiles"), L"config.bin");
+}
+#endif
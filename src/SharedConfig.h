@@ -0,0 +1,86 @@
+#pragma once
+#include "OrganizeRules.h"
+#include <memory>
+#include <mutex>
+
+// User configuration (rules.ini) compiled once into a flat image that every process
+// loading the shell extension maps instead of reparsing: Explorer, its dialogs and
+// the file pickers of other programs all share one copy. On Windows the image lives
+// in a named section keyed by the source file's size and time; elsewhere in a cache
+// file that is replaced atomically. When the source changes a new image is built and
+// swapped in; snapshots already handed out stay valid until released.
+
+// Flat, position-independent layout: offsets are relative to the start of the image
+struct ConfigImageHeader
+{
+    char magic[4];          // "NFFC"
+    uint32_t version;
+    uint64_t imageSize;
+    uint64_t sourceSize;    // rules.ini the image was built from (0 and 0: no file)
+    uint64_t sourceTime;
+    uint32_t flags;         // ConfigImageFlags
+    uint32_t ruleCount;
+    uint64_t rulesOffset;   // UTF-8 rule text, no BOM
+    uint64_t rulesLength;
+    uint32_t ready;         // Set last by the builder of a shared section
+    uint32_t reserved;
+};
+
+enum ConfigImageFlags : uint32_t
+{
+    ConfigHasRules = 1 << 0,         // A rules file exists (the menu offers By Rules)
+    ConfigRulesValid = 1 << 1,       // ... and compiles
+    ConfigRulesNeedMetadata = 1 << 2,
+};
+
+class ConfigSnapshot
+{
+public:
+    ConfigSnapshot() = default;
+    ~ConfigSnapshot();
+    ConfigSnapshot(const ConfigSnapshot&) = delete;
+    ConfigSnapshot& operator=(const ConfigSnapshot&) = delete;
+
+    bool HasRules() const { return (Header().flags & ConfigHasRules) != 0; }
+    size_t RuleCount() const { return Header().ruleCount; }
+    bool RulesNeedMetadata() const { return (Header().flags & ConfigRulesNeedMetadata) != 0; }
+    // The image's rules, compiled on first use in this process and then shared by every
+    // handler; nullptr without a valid rules file. Matching is not thread-safe (the glob
+    // DFA grows lazily), so use it from one thread at a time.
+    const RuleSet* Rules() const;
+
+    bool Matches(uint64_t sourceSize, uint64_t sourceTime) const
+    {
+        return Header().sourceSize == sourceSize && Header().sourceTime == sourceTime;
+    }
+
+private:
+    friend struct ConfigLoader;
+
+    const ConfigImageHeader& Header() const { return *reinterpret_cast<const ConfigImageHeader*>(m_image); }
+
+    const uint8_t* m_image = nullptr;
+    std::string m_private;          // Image held in process memory when it cannot be shared
+    void* m_view = nullptr;         // Mapped view, unmapped on destruction
+    size_t m_viewSize = 0;
+    void* m_section = nullptr;      // Windows section handle
+    mutable std::once_flag m_compileOnce;
+    mutable std::unique_ptr<RuleSet> m_rules;
+};
+
+// The current snapshot: one atomic load, cheap enough for every handler instance
+std::shared_ptr<const ConfigSnapshot> GetSharedConfig();
+
+// Compares the rules file with the current image (at most once per second; a stat)
+// and swaps in a matching image, mapping or building it as needed. Returns the
+// snapshot that is current afterwards.
+std::shared_ptr<const ConfigSnapshot> RefreshSharedConfig();
+
+// Builds the image for rule text; sourceSize/sourceTime identify the file it came from
+std::string BuildConfigImage(const std::string& rulesText, bool hasRules, uint64_t sourceSize, uint64_t sourceTime,
+    RuleSet* compiled = nullptr);
+
+#ifndef _WIN32
+// Image cache: $XDG_CACHE_HOME (~/.cache)/NewFolderFromFiles/config.bin
+std::wstring GetDefaultConfigImagePath();
+#endif
@@ -0,0 +1,90 @@
+#include "VolumeScheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+
+unsigned GetDeviceConcurrency(DeviceKind kind)
+{
+    switch (kind)
+    {
+    case DeviceKind::Rotational:
+        return 1;
+    case DeviceKind::SolidState:
+    case DeviceKind::Remote:
+        return 4;
+    default:
+        return 2;
+    }
+}
+
+namespace
+{
+    struct DeviceQueue
+    {
+        DeviceKind kind = DeviceKind::Unknown;
+        std::vector<size_t> tasks;
+        std::atomic<size_t> next{ 0 };
+    };
+}
+
+void RunPerDevice(IFileSystem& fs, const std::vector<std::wstring>& paths, const std::function<void(size_t)>& task,
+    const DeviceThreadHooks& hooks, DeviceScheduleStats* stats)
+{
+    std::vector<std::unique_ptr<DeviceQueue>> queues;
+    std::unordered_map<std::wstring, size_t> byDevice;
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        VolumeInfo info;
+        if (fs.QueryVolume(paths[i], info) != FsResult::Ok)
+            info = VolumeInfo();
+        auto inserted = byDevice.emplace(info.device, queues.size());
+        if (inserted.second)
+        {
+            queues.push_back(std::make_unique<DeviceQueue>());
+            queues.back()->kind = info.kind;
+        }
+        queues[inserted.first->second]->tasks.push_back(i);
+    }
+
+    std::vector<std::pair<DeviceQueue*, unsigned>> workers;
+    unsigned threads = 0;
+    for (auto& queue : queues)
+    {
+        unsigned count = static_cast<unsigned>(std::min<size_t>(GetDeviceConcurrency(queue->kind), queue->tasks.size()));
+        workers.emplace_back(queue.get(), count);
+        threads += count;
+    }
+    if (stats)
+    {
+        stats->devices = queues.size();
+        stats->threads = threads > 1 ? threads : 0;
+    }
+
+    if (threads <= 1)
+    {
+        for (size_t i = 0; i < paths.size(); i++)
+            task(i);
+        return;
+    }
+
+    auto worker = [&](DeviceQueue* queue) {
+        if (hooks.start)
+            hooks.start();
+        for (size_t t = queue->next++; t < queue->tasks.size(); t = queue->next++)
+            task(queue->tasks[t]);
+        if (hooks.exit)
+            hooks.exit();
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads);
+    for (const auto& [queue, count] : workers)
+    {
+        for (unsigned t = 0; t < count; t++)
+            pool.emplace_back(worker, queue);
+    }
+    for (auto& thread : pool)
+        thread.join();
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "FileSystem.h"
+#include <functional>
+
+// Work spread over several devices runs on all of them at once, each at the concurrency
+// it handles best: one stream on a disk that seeks, several on flash and on network
+// shares, where requests in flight hide the latency.
+
+// Tasks one device runs at once
+unsigned GetDeviceConcurrency(DeviceKind kind);
+
+struct DeviceThreadHooks
+{
+    std::function<void()> start;  // On each worker thread before its first task (COM apartment)
+    std::function<void()> exit;
+};
+
+struct DeviceScheduleStats
+{
+    size_t devices = 0;
+    unsigned threads = 0;  // 0: everything ran on the calling thread
+};
+
+// Runs task(i) for every paths[i], an existing file or folder the task works in. Tasks on
+// one device form a queue, taken in order by GetDeviceConcurrency threads, and the queues
+// of all devices run at once; paths fs cannot place share one queue. A task must only
+// touch its own device through fs. When one thread would do, tasks run on the calling
+// thread and the hooks are not called.
+void RunPerDevice(IFileSystem& fs, const std::vector<std::wstring>& paths, const std::function<void(size_t)>& task,
+    const DeviceThreadHooks& hooks = DeviceThreadHooks(), DeviceScheduleStats* stats = nullptr);
@@ -0,0 +1,382 @@
+// Watch-folder daemon: organizes new arrivals in drop folders (scanner output,
+// camera ingest, ...) once they stop changing.
+//
+//   NewFolderFromFilesWatch [--quiet-ms 2000] [--batch 10000] [--interval-ms 250] --mode type D:\Scans --mode fulldate D:\Camera
+//
+// Only files reported by change notifications are considered; files already in
+// a folder when the daemon starts are left alone. A name that is taken in the
+// destination never stops a batch: --conflict picks rename (default), skip,
+// newer or keep-both, settled up front by ResolveConflicts.
+//
+// With --view, a folder is not organized in place: its files are mirrored as a
+// link view (see OrganizeViews.h) that is rebuilt incrementally after arrivals.
+// Several views of one folder may run side by side; --once builds them and exits.
+//
+//   NewFolderFromFilesWatch --once --mode fulldate --view D:\Views\Date D:\Photos --mode type --view D:\Views\Type D:\Photos
+
+#include "ArrivalDebouncer.h"
+#include "FolderIndex.h"
+#include "FolderWatcher.h"
+#include "OrganizeConflicts.h"
+#include "OrganizeExecutor.h"
+#include "OrganizePlanner.h"
+#include "OrganizeViews.h"
+#include "VolumeScheduler.h"
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cwchar>
+#include <cwctype>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _WIN32
+#include <csignal>
+#endif
+
+struct WatchFolder
+{
+    std::wstring path;
+    OrganizeMode mode;
+    OrganizeOptions organize;
+    std::wstring view;  // Non-empty: mirror the folder as a link view here instead
+};
+
+struct WatchOptions
+{
+    uint64_t quietMs = 2000;
+    size_t maxBatch = 10000;
+    uint64_t batchIntervalMs = 250;
+    bool once = false;
+    ConflictPolicy conflict = ConflictPolicy::RenameSuffix;
+    std::vector<WatchFolder> folders;
+};
+
+static uint64_t NowMs()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Partial downloads and editor temp files are renamed when complete; wait for that
+static bool IsTransientName(const std::wstring& name)
+{
+    if (name.empty() || name[0] == L'.' || name[0] == L'~')
+        return true;
+
+    std::wstring ext = GetFileExtension(name);
+    return ext == L"PART" || ext == L"CRDOWNLOAD" || ext == L"TMP" || ext == L"PARTIAL" || ext == L"DOWNLOAD";
+}
+
+static void OrganizeBatch(IFileSystem& fs, const WatchFolder& watch, ConflictPolicy conflict, const std::vector<std::wstring>& paths)
+{
+    const std::wstring& folder = watch.path;
+    OrganizeMode mode = watch.mode;
+    std::vector<FileEntry> entries;
+    entries.reserve(paths.size());
+    for (const auto& path : paths)
+    {
+        FileEntry entry;
+        entry.path = path;
+        // Gone again or a folder (possibly one of ours): nothing to do
+        if (fs.QueryMetadata(entry) != FsResult::Ok || entry.isDirectory)
+            continue;
+        entries.push_back(std::move(entry));
+    }
+
+    if (entries.empty())
+        return;
+    if (unsigned fields = OrganizeModeMediaFields(mode, watch.organize))
+        QueryEntriesMediaInfo(fs, entries, fields);
+
+    OrganizePlan plan;
+    if (!BuildOrganizePlan(entries, mode, plan, watch.organize))
+        return;
+    // Arrivals join the folders earlier batches made instead of starting "2024-05 (2)"
+    for (auto& group : plan.groups)
+        group.uniqueName = false;
+
+    std::vector<std::wstring> destinations = ResolveDestinations(fs, folder, plan);
+    ConflictSummary conflicts = ResolveConflicts(fs, entries, plan, destinations, conflict);
+    OrganizeResult result;
+    ExecuteOrganizePlan(fs, folder, entries, plan, destinations, result);
+
+    fwprintf(stdout, L"[%hs] %ls: %zu moved, %zu failed, %zu folders, %zu conflicts (%zu renamed, %zu skipped, %zu replaced)\n",
+        GetOrganizeModeName(mode), folder.c_str(), result.moved, result.failed, plan.groups.size(),
+        conflicts.conflicts, conflicts.renamed, conflicts.skipped, conflicts.replaced);
+    fflush(stdout);
+}
+
+// Views follow the whole folder, so they are planned from a fresh listing
+static void RefreshView(IFileSystem& fs, const WatchFolder& watch)
+{
+    // Views are rebuilt on every change; the index keeps that from re-reading every header.
+    // Files here are often still being written, so sizes and times are always checked.
+    FolderIndexOptions indexOptions;
+    indexOptions.mediaFields = OrganizeModeMediaFields(watch.mode, watch.organize);
+    indexOptions.verify = true;
+    std::vector<FileEntry> listing;
+    if (!ListDirectoryIndexed(fs, watch.path, listing, indexOptions))
+        return;
+
+    std::vector<FileEntry> entries;
+    for (auto& entry : listing)
+    {
+        if (!entry.isDirectory && !IsTransientName(PathFileName(entry.path)))
+            entries.push_back(std::move(entry));
+    }
+
+    OrganizePlan plan;
+    ViewResult result;
+    if (!BuildOrganizePlan(entries, watch.mode, plan, watch.organize) || !BuildLinkView(fs, watch.view, entries, plan, result))
+    {
+        fwprintf(stderr, L"Cannot build view %ls\n", watch.view.c_str());
+        return;
+    }
+
+    fwprintf(stdout, L"[%hs] %ls -> %ls: %zu linked, %zu unchanged, %zu removed, %zu failed\n",
+        GetOrganizeModeName(watch.mode), watch.path.c_str(), watch.view.c_str(),
+        result.linked, result.unchanged, result.removed, result.failed);
+    fflush(stdout);
+}
+
+// Arrivals are matched by PathParent, which never ends in a separator except at a root
+static std::wstring TrimTrailingSeparators(std::wstring path)
+{
+    while (path.size() > 1 && (path.back() == L'/' || path.back() == L'\\') &&
+        !(path.size() == 3 && path[1] == L':'))
+        path.pop_back();
+    return path;
+}
+
+// Whole decimal numbers only; std::stoull would throw, or take "-1" and "5s"
+static bool ParseCount(const std::wstring& text, uint64_t& value)
+{
+    if (text.empty() || !iswdigit(text[0]))
+        return false;
+    wchar_t* end = nullptr;
+    errno = 0;
+    unsigned long long parsed = wcstoull(text.c_str(), &end, 10);
+    if (errno == ERANGE || *end != L'\0')
+        return false;
+    value = parsed;
+    return true;
+}
+
+static void PrintUsage()
+{
+    fprintf(stderr,
+        "Usage: NewFolderFromFilesWatch [--quiet-ms N] [--batch N] [--interval-ms N] [--conflict P] [--once] --mode MODE [--view DIR] FOLDER ...\n"
+        "  --quiet-ms N     a file must be unchanged this long before it is organized (default 2000)\n"
+        "  --batch N        maximum files organized per batch (default 10000)\n"
+        "  --interval-ms N  minimum time between batches, so steady streams coalesce (default 250)\n"
+        "  --conflict P     name taken in the destination: rename, skip, newer, keep-both (default rename)\n"
+        "  --mode MODE      organize mode for the next folder (type, extension, fulldate, monthyear, ...)\n"
+        "  --template T     nested destination for the next folder, e.g. {yyyy}/{MM}/{category}\n"
+        "  --view DIR       mirror the next folder as a hard-link view in DIR instead of organizing it\n"
+        "  --once           build the views once and exit\n");
+}
+
+static bool ParseOptions(const std::vector<std::wstring>& args, WatchOptions& options)
+{
+    OrganizeMode mode = OrganizeMode::ByTypeVideo;
+    OrganizeOptions organize;
+    std::wstring view;
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        const std::wstring& arg = args[i];
+        if (arg == L"--once")
+        {
+            options.once = true;
+        }
+        else if (arg == L"--view" && i + 1 < args.size())
+        {
+            view = args[++i];
+        }
+        else if ((arg == L"--quiet-ms" || arg == L"--batch" || arg == L"--interval-ms") && i + 1 < args.size())
+        {
+            uint64_t value;
+            if (!ParseCount(args[i + 1], value))
+            {
+                fwprintf(stderr, L"Invalid number for %ls: %ls\n", arg.c_str(), args[i + 1].c_str());
+                return false;
+            }
+            if (arg == L"--quiet-ms")
+                options.quietMs = value;
+            else if (arg == L"--batch")
+                options.maxBatch = static_cast<size_t>(value);
+            else
+                options.batchIntervalMs = value;
+            i++;
+        }
+        else if (arg == L"--conflict" && i + 1 < args.size())
+        {
+            std::string name(args[i + 1].begin(), args[i + 1].end());
+            if (!ParseConflictPolicy(name.c_str(), options.conflict) || options.conflict == ConflictPolicy::None)
+            {
+                fprintf(stderr, "Unsupported conflict policy: %s\n", name.c_str());
+                return false;
+            }
+            i++;
+        }
+        else if (arg == L"--mode" && i + 1 < args.size())
+        {
+            std::string name(args[i + 1].begin(), args[i + 1].end());
+            if (!ParseOrganizeMode(name.c_str(), mode) || mode == OrganizeMode::Flatten ||
+                mode == OrganizeMode::ByRules || mode == OrganizeMode::ByTemplate)
+            {
+                fprintf(stderr, "Unsupported mode: %s\n", name.c_str());
+                return false;
+            }
+            i++;
+        }
+        else if (arg == L"--template" && i + 1 < args.size())
+        {
+            organize.destinationTemplate = args[++i];
+            if (!IsValidDestinationTemplate(organize.destinationTemplate))
+            {
+                fwprintf(stderr, L"Invalid template: %ls\n", organize.destinationTemplate.c_str());
+                return false;
+            }
+            mode = OrganizeMode::ByTemplate;
+        }
+        else if (arg.size() > 2 && arg.compare(0, 2, L"--") == 0)
+        {
+            return false;
+        }
+        else
+        {
+            // A view belongs to one folder; mode and template carry over
+            options.folders.push_back({ TrimTrailingSeparators(arg), mode, organize, view });
+            view.clear();
+        }
+    }
+    return !options.folders.empty() && options.maxBatch > 0;
+}
+
+static int RunWatchDaemon(const std::vector<std::wstring>& args)
+{
+    WatchOptions options;
+    if (!ParseOptions(args, options))
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    LocalFileSystem fs;
+    for (const auto& watch : options.folders)
+    {
+        if (!watch.view.empty())
+            RefreshView(fs, watch);
+    }
+    if (options.once)
+        return 0;
+
+    FolderWatcher watcher;
+    std::unordered_map<std::wstring, std::vector<const WatchFolder*>> folderModes;
+    for (const auto& watch : options.folders)
+    {
+        auto& watches = folderModes[watch.path];
+        if (watches.empty() && !watcher.AddFolder(watch.path))
+        {
+            fwprintf(stderr, L"Cannot watch %ls\n", watch.path.c_str());
+            return 1;
+        }
+        watches.push_back(&watch);
+        fwprintf(stdout, L"Watching %ls (%hs)\n", watch.path.c_str(), GetOrganizeModeName(watch.mode));
+    }
+    fflush(stdout);
+
+    ArrivalDebouncer debouncer(options.quietMs);
+    std::vector<std::wstring> changed;
+    std::vector<std::wstring> overflowed;
+    uint64_t lastBatch = 0;
+
+    for (;;)
+    {
+        uint64_t start = NowMs();
+        int64_t deadline = debouncer.NextDeadline(start);
+        uint64_t nextBatch = lastBatch + options.batchIntervalMs;
+        if (deadline >= 0 && start + deadline < nextBatch)
+            deadline = static_cast<int64_t>(nextBatch - start);
+        changed.clear();
+        overflowed.clear();
+        if (!watcher.Poll(static_cast<int>(deadline), changed, overflowed))
+            return 1;
+
+        uint64_t now = NowMs();
+        for (const auto& path : changed)
+        {
+            if (!IsTransientName(PathFileName(path)))
+                debouncer.Touch(path, now);
+        }
+
+        // Events were dropped: one listing of that folder recovers them
+        for (const auto& folder : overflowed)
+        {
+            std::vector<FileEntry> entries;
+            fs.ListDirectory(folder, entries);
+            for (const auto& entry : entries)
+            {
+                if (!entry.isDirectory && !IsTransientName(PathFileName(entry.path)))
+                    debouncer.Touch(entry.path, now);
+            }
+        }
+
+        if (now < lastBatch + options.batchIntervalMs)
+            continue;
+
+        std::vector<std::wstring> settled = debouncer.TakeSettled(now, options.maxBatch);
+        if (settled.empty())
+            continue;
+        lastBatch = now;
+
+        std::unordered_map<std::wstring, std::vector<std::wstring>> byFolder;
+        for (auto& path : settled)
+            byFolder[PathParent(path)].push_back(std::move(path));
+
+        // Folders on different drives are organized at the same time
+        std::vector<std::wstring> folders;
+        std::vector<const std::vector<std::wstring>*> batches;
+        for (const auto& [folder, paths] : byFolder)
+        {
+            if (folderModes.count(folder))
+            {
+                folders.push_back(folder);
+                batches.push_back(&paths);
+            }
+        }
+        RunPerDevice(fs, folders, [&](size_t f) {
+            for (const WatchFolder* watch : folderModes.at(folders[f]))
+            {
+                if (watch->view.empty())
+                    OrganizeBatch(fs, *watch, options.conflict, *batches[f]);
+                else
+                    RefreshView(fs, *watch);
+            }
+        });
+    }
+}
+
+#ifdef _WIN32
+
+int wmain(int argc, wchar_t** argv)
+{
+    return RunWatchDaemon(std::vector<std::wstring>(argv + 1, argv + argc));
+}
+
+#else
+
+int main(int argc, char** argv)
+{
+    std::vector<std::wstring> args;
+    for (int i = 1; i < argc; i++)
+        args.push_back(FromNativePath(argv[i]));
+
+    // Keep running if stdout goes away
+    signal(SIGPIPE, SIG_IGN);
+    return RunWatchDaemon(args);
+}
+
+#endif
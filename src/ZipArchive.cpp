@@ -0,0 +1,529 @@
+#include "ZipArchive.h"
+#include "Deflate.h"
+#include "NaturalSort.h"
+#include "OrganizePlanner.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <thread>
+
+static const size_t kChunkSize = 1 << 20;
+static const size_t kDictionarySize = 32768;
+static const size_t kOutputBuffer = 1 << 20;
+static const uint32_t kNoValue32 = 0xFFFFFFFFu;
+// Entries this large get ZIP64 sizes in their local header up front, since deflate can
+// grow incompressible data by a few bytes per block and the header is written first
+static const uint64_t kZip64EntrySize = 0xFF000000ull;
+
+bool IsCompressedFormat(const std::wstring& path)
+{
+    std::wstring ext = GetFileExtension(path);
+    // Uncompressed formats inside the media categories
+    for (const wchar_t* raw : { L"BMP", L"TIF", L"TIFF", L"PSD", L"RAW", L"SVG", L"ICO", L"WAV", L"AIFF" })
+    {
+        if (ext == raw)
+            return false;
+    }
+    for (const wchar_t* packed : { L"ZIP", L"7Z", L"RAR", L"GZ", L"XZ", L"BZ2", L"ZST", L"DOCX", L"XLSX", L"PPTX", L"ODT" })
+    {
+        if (ext == packed)
+            return true;
+    }
+    std::wstring category = GetFileTypeCategory(path);
+    return category == L"Video" || category == L"Photo" || category == L"Audio";
+}
+
+struct ArchiveItem
+{
+    std::wstring source;
+    std::string name;  // UTF-8 with '/' separators; folders end with '/'
+    uint64_t size = 0;
+    uint64_t lastWriteTime = 0;
+    bool directory = false;
+    bool deflate = false;
+    uint64_t chunks = 1;
+};
+
+static void CollectArchiveItems(IFileSystem& fs, const FileEntry& entry, const std::string& name,
+    std::vector<ArchiveItem>& items, ArchiveResult& result)
+{
+    ArchiveItem item;
+    item.source = entry.path;
+    item.lastWriteTime = entry.lastWriteTime;
+    item.directory = entry.isDirectory;
+    if (!entry.isDirectory)
+    {
+        item.name = name;
+        item.size = entry.size;
+        item.deflate = entry.size > 0 && !IsCompressedFormat(entry.path);
+        item.chunks = std::max<uint64_t>(1, (entry.size + kChunkSize - 1) / kChunkSize);
+        items.push_back(std::move(item));
+        return;
+    }
+
+    item.name = name + "/";
+    items.push_back(std::move(item));
+    std::vector<FileEntry> children;
+    if (fs.ListDirectory(entry.path, children) != FsResult::Ok)
+    {
+        result.failed++;
+        return;
+    }
+    // Archive listings come out in the order Explorer shows the folder
+    SortEntriesNatural(children);
+    for (auto& child : children)
+    {
+        if (!child.hasMetadata && fs.QueryMetadata(child) != FsResult::Ok)
+        {
+            result.failed++;
+            continue;
+        }
+        CollectArchiveItems(fs, child, name + "/" + WideToUtf8(PathFileName(child.path)), items, result);
+    }
+}
+
+// FILETIME ticks (UTC) -> MS-DOS local date and time, as every unzip tool expects
+static void TicksToDosTime(uint64_t ticks, uint16_t& date, uint16_t& time)
+{
+    const int64_t kUnixEpochSeconds = 11644473600LL;
+    time_t seconds = static_cast<time_t>(static_cast<int64_t>(ticks / 10000000ULL) - kUnixEpochSeconds);
+    struct tm local = {};
+#ifdef _WIN32
+    bool ok = localtime_s(&local, &seconds) == 0;
+#else
+    bool ok = localtime_r(&seconds, &local) != nullptr;
+#endif
+    if (!ok || local.tm_year < 80)
+    {
+        date = (1 << 5) | 1;  // 1980-01-01, the earliest DOS date
+        time = 0;
+        return;
+    }
+    date = static_cast<uint16_t>(((local.tm_year - 80) << 9) | ((local.tm_mon + 1) << 5) | local.tm_mday);
+    time = static_cast<uint16_t>((local.tm_hour << 11) | (local.tm_min << 5) | (local.tm_sec / 2));
+}
+
+static void Put16(std::string& out, uint32_t value)
+{
+    out.push_back(static_cast<char>(value));
+    out.push_back(static_cast<char>(value >> 8));
+}
+
+static void Put32(std::string& out, uint32_t value)
+{
+    Put16(out, value & 0xFFFF);
+    Put16(out, value >> 16);
+}
+
+static void Put64(std::string& out, uint64_t value)
+{
+    Put32(out, static_cast<uint32_t>(value));
+    Put32(out, static_cast<uint32_t>(value >> 32));
+}
+
+// Sequential output with a write-behind buffer; local headers are patched in place
+// once their entry is complete, in the buffer or on disk
+class ArchiveOutput
+{
+public:
+    explicit ArchiveOutput(IFileWriter& writer) : m_writer(writer) { m_buffer.reserve(kOutputBuffer); }
+
+    uint64_t Position() const { return m_flushed + m_buffer.size(); }
+    bool Failed() const { return m_failed; }
+
+    void Append(const void* data, size_t length)
+    {
+        if (m_buffer.size() + length > kOutputBuffer)
+            Flush();
+        if (length >= kOutputBuffer)
+        {
+            WriteAt(m_flushed, data, length);
+            m_flushed += length;
+            return;
+        }
+        m_buffer.append(static_cast<const char*>(data), length);
+    }
+
+    void Append(const std::string& data) { Append(data.data(), data.size()); }
+
+    // Headers are appended whole, so a patch is entirely in the buffer or entirely flushed
+    void Patch(uint64_t offset, const std::string& data)
+    {
+        if (offset >= m_flushed)
+            memcpy(&m_buffer[static_cast<size_t>(offset - m_flushed)], data.data(), data.size());
+        else
+            WriteAt(offset, data.data(), data.size());
+    }
+
+    void Flush()
+    {
+        if (m_buffer.empty())
+            return;
+        WriteAt(m_flushed, m_buffer.data(), m_buffer.size());
+        m_flushed += m_buffer.size();
+        m_buffer.clear();
+    }
+
+private:
+    void WriteAt(uint64_t offset, const void* data, size_t length)
+    {
+        if (!m_failed && m_writer.Write(offset, data, length) != FsResult::Ok)
+            m_failed = true;
+    }
+
+    IFileWriter& m_writer;
+    std::string m_buffer;
+    uint64_t m_flushed = 0;
+    bool m_failed = false;
+};
+
+struct ChunkJob
+{
+    size_t item = 0;
+    uint64_t offset = 0;
+    size_t length = 0;
+    bool last = false;
+};
+
+// One chunk between a worker and the writer
+struct ChunkSlot
+{
+    ChunkJob job;
+    std::vector<uint8_t> data;  // Deflated or stored bytes, ready to write
+    uint32_t crc = 0;
+    size_t read = 0;            // Input bytes the data stands for
+    bool stored = false;        // A whole small file that deflate would have grown
+    bool failed = false;
+    bool done = false;
+};
+
+// Reads the chunk (and the 32 KB before it, as deflate history) and compresses it
+static void ProcessChunk(IFileSystem& fs, const ArchiveItem& item, ChunkSlot& slot, std::vector<uint8_t>& input)
+{
+    const ChunkJob& job = slot.job;
+    slot.data.clear();
+    slot.crc = 0;
+    slot.read = 0;
+    slot.stored = true;
+    slot.failed = false;
+    if (item.directory || item.size == 0)
+        return;
+
+    size_t dictionary = item.deflate ? static_cast<size_t>(std::min<uint64_t>(job.offset, kDictionarySize)) : 0;
+    input.resize(dictionary + job.length);
+    size_t got = 0;
+    std::unique_ptr<IFileReader> reader;
+    if (fs.OpenReader(item.source, reader) != FsResult::Ok ||
+        reader->Read(job.offset - dictionary, input.data(), input.size(), got) != FsResult::Ok)
+        got = 0;
+    if (got < dictionary)
+        dictionary = got = 0;
+    slot.read = got - dictionary;
+    slot.failed = slot.read < job.length;
+    slot.crc = Crc32(0, input.data() + dictionary, slot.read);
+
+    // A failed chunk still gets its deflate framing, so the entry stays a valid stream
+    if (item.deflate)
+        DeflateChunk(input.data(), dictionary, slot.read, job.last, slot.data);
+    // Deflate grows tiny and incompressible files; a single-chunk entry can still switch method
+    slot.stored = !item.deflate || (job.offset == 0 && job.last && slot.data.size() >= slot.read);
+    if (slot.stored)
+        slot.data.assign(input.begin() + dictionary, input.begin() + dictionary + slot.read);
+}
+
+// Local header; CRC and sizes stay zero until the entry is complete and they are patched in
+static std::string LocalHeader(const ArchiveItem& item, bool deflate, bool zip64)
+{
+    uint16_t date, time;
+    TicksToDosTime(item.lastWriteTime, date, time);
+
+    std::string header;
+    Put32(header, 0x04034b50);
+    Put16(header, zip64 ? 45 : 20);     // Version needed
+    Put16(header, 0x0800);              // UTF-8 names
+    Put16(header, deflate ? 8 : 0);
+    Put16(header, time);
+    Put16(header, date);
+    Put32(header, 0);                   // CRC
+    Put32(header, zip64 ? kNoValue32 : 0);
+    Put32(header, zip64 ? kNoValue32 : 0);
+    Put16(header, static_cast<uint32_t>(item.name.size()));
+    Put16(header, zip64 ? 20 : 0);
+    header += item.name;
+    if (zip64)
+    {
+        Put16(header, 0x0001);
+        Put16(header, 16);
+        Put64(header, 0);
+        Put64(header, 0);
+    }
+    return header;
+}
+
+static void AppendCentralRecord(std::string& directory, const ArchiveItem& item, bool deflate, bool zip64Sizes, uint32_t crc,
+    uint64_t compressed, uint64_t uncompressed, uint64_t localOffset)
+{
+    uint16_t date, time;
+    TicksToDosTime(item.lastWriteTime, date, time);
+    zip64Sizes = zip64Sizes || compressed >= kNoValue32 || uncompressed >= kNoValue32;
+    bool zip64Offset = localOffset >= kNoValue32;
+
+    std::string zip64;
+    if (zip64Sizes)
+    {
+        Put64(zip64, uncompressed);
+        Put64(zip64, compressed);
+    }
+    if (zip64Offset)
+        Put64(zip64, localOffset);
+
+    Put32(directory, 0x02014b50);
+    // Made by Unix, spec 4.5: unzip then takes the names as UTF-8 rather than OEM code page text.
+    // DOS attributes still sit in the low byte of the external attributes, as Windows expects.
+    Put16(directory, (3 << 8) | 45);
+    Put16(directory, zip64Sizes || zip64Offset ? 45 : 20);
+    Put16(directory, 0x0800);
+    Put16(directory, deflate ? 8 : 0);
+    Put16(directory, time);
+    Put16(directory, date);
+    Put32(directory, crc);
+    Put32(directory, zip64Sizes ? kNoValue32 : static_cast<uint32_t>(compressed));
+    Put32(directory, zip64Sizes ? kNoValue32 : static_cast<uint32_t>(uncompressed));
+    Put16(directory, static_cast<uint32_t>(item.name.size()));
+    Put16(directory, static_cast<uint32_t>((zip64.empty() ? 0 : 4 + zip64.size()) + 36));
+    Put16(directory, 0);                // Comment
+    Put16(directory, 0);                // Disk
+    Put16(directory, 0);                // Internal attributes
+    Put32(directory, item.directory ? (040755u << 16) | 0x10 : (0100644u << 16) | 0x20);
+    Put32(directory, zip64Offset ? kNoValue32 : static_cast<uint32_t>(localOffset));
+    directory += item.name;
+    if (!zip64.empty())
+    {
+        Put16(directory, 0x0001);
+        Put16(directory, static_cast<uint32_t>(zip64.size()));
+        directory += zip64;
+    }
+    // NTFS extra field: the exact UTC modified time, which DOS time cannot carry
+    Put16(directory, 0x000A);
+    Put16(directory, 32);
+    Put32(directory, 0);
+    Put16(directory, 1);
+    Put16(directory, 24);
+    Put64(directory, item.lastWriteTime);
+    Put64(directory, item.lastWriteTime);
+    Put64(directory, item.lastWriteTime);
+}
+
+static void AppendEndRecords(std::string& out, uint64_t entries, uint64_t directoryOffset, uint64_t directorySize)
+{
+    bool zip64 = entries >= 0xFFFF || directoryOffset >= kNoValue32 || directorySize >= kNoValue32;
+    if (zip64)
+    {
+        uint64_t recordOffset = directoryOffset + directorySize;
+        Put32(out, 0x06064b50);
+        Put64(out, 44);
+        Put16(out, 45);
+        Put16(out, 45);
+        Put32(out, 0);
+        Put32(out, 0);
+        Put64(out, entries);
+        Put64(out, entries);
+        Put64(out, directorySize);
+        Put64(out, directoryOffset);
+
+        Put32(out, 0x07064b50);
+        Put32(out, 0);
+        Put64(out, recordOffset);
+        Put32(out, 1);
+    }
+    Put32(out, 0x06054b50);
+    Put16(out, 0);
+    Put16(out, 0);
+    Put16(out, static_cast<uint32_t>(std::min<uint64_t>(entries, 0xFFFF)));
+    Put16(out, static_cast<uint32_t>(std::min<uint64_t>(entries, 0xFFFF)));
+    Put32(out, static_cast<uint32_t>(std::min<uint64_t>(directorySize, kNoValue32)));
+    Put32(out, static_cast<uint32_t>(std::min<uint64_t>(directoryOffset, kNoValue32)));
+    Put16(out, 0);
+}
+
+bool CreateZipArchive(IFileSystem& fs, const std::wstring& archivePath, const std::vector<FileEntry>& entries,
+    ArchiveResult& result, const ArchiveOptions& options)
+{
+    std::vector<ArchiveItem> items;
+    for (const auto& selected : entries)
+    {
+        FileEntry entry = selected;
+        if (!entry.hasMetadata && fs.QueryMetadata(entry) != FsResult::Ok)
+        {
+            result.failed++;
+            continue;
+        }
+        CollectArchiveItems(fs, entry, WideToUtf8(PathFileName(entry.path)), items, result);
+    }
+
+    std::unique_ptr<IFileWriter> writer;
+    if (fs.CreateWriter(archivePath, writer) != FsResult::Ok)
+        return false;
+    ArchiveOutput out(*writer);
+
+    uint64_t totalJobs = 0;
+    for (const auto& item : items)
+        totalJobs += item.chunks;
+
+    unsigned threads = options.threads;
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::max<uint64_t>(1, std::min<uint64_t>(threads, totalJobs)));
+
+    // Chunks are handed out in archive order; at most window of them are in flight, which
+    // bounds memory to about window * 2 MB whatever the archive size
+    const size_t window = threads * 2 + 2;
+    std::vector<ChunkSlot> slots(window);
+    std::mutex mutex;
+    std::condition_variable chunkReady, slotFree;
+    uint64_t claimed = 0, written = 0;
+    size_t cursorItem = 0;
+    uint64_t cursorOffset = 0;
+    bool stop = false;
+
+    auto worker = [&]() {
+        std::vector<uint8_t> input;
+        for (;;)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            slotFree.wait(lock, [&]() { return stop || claimed == totalJobs || claimed - written < window; });
+            if (stop || claimed == totalJobs)
+                return;
+
+            ChunkSlot& slot = slots[claimed % window];
+            claimed++;
+            const ArchiveItem& item = items[cursorItem];
+            slot.job.item = cursorItem;
+            slot.job.offset = cursorOffset;
+            slot.job.length = static_cast<size_t>(std::min<uint64_t>(kChunkSize, item.size - std::min(item.size, cursorOffset)));
+            cursorOffset += kChunkSize;
+            slot.job.last = cursorOffset >= item.size;
+            if (slot.job.last)
+            {
+                cursorItem++;
+                cursorOffset = 0;
+            }
+            lock.unlock();
+
+            ProcessChunk(fs, item, slot, input);
+
+            lock.lock();
+            slot.done = true;
+            chunkReady.notify_all();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; t++)
+        pool.emplace_back(worker);
+
+    std::string directory;
+    uint64_t entryCount = 0;
+    uint64_t localOffset = 0, compressed = 0, uncompressed = 0;
+    uint32_t crc = 0;
+    bool deflate = false, zip64 = false, skipped = false, itemFailed = false;
+    std::string header;
+    for (uint64_t sequence = 0; sequence < totalJobs && !out.Failed(); sequence++)
+    {
+        ChunkSlot& slot = slots[sequence % window];
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            chunkReady.wait(lock, [&]() { return slot.done; });
+        }
+
+        const ArchiveItem& item = items[slot.job.item];
+        if (slot.job.offset == 0)
+        {
+            // A file that cannot be read at all is left out rather than archived empty
+            skipped = slot.failed && slot.read == 0 && slot.job.last;
+            if (!skipped)
+            {
+                deflate = !slot.stored;
+                zip64 = item.size >= kZip64EntrySize;
+                localOffset = out.Position();
+                header = LocalHeader(item, deflate, zip64);
+                out.Append(header);
+            }
+            compressed = uncompressed = 0;
+            crc = 0;
+            itemFailed = false;
+        }
+
+        if (!skipped)
+        {
+            out.Append(slot.data.data(), slot.data.size());
+            compressed += slot.data.size();
+            crc = Crc32Combine(crc, slot.crc, slot.read);
+            uncompressed += slot.read;
+        }
+        itemFailed |= slot.failed;
+
+        if (slot.job.last && skipped)
+        {
+            result.failed++;
+        }
+        else if (slot.job.last)
+        {
+            // Now the CRC and sizes are known
+            std::string fields;
+            Put32(fields, crc);
+            if (zip64)
+            {
+                out.Patch(localOffset + 14, fields);
+                fields.clear();
+                Put64(fields, uncompressed);
+                Put64(fields, compressed);
+                out.Patch(localOffset + 30 + item.name.size() + 4, fields);
+            }
+            else
+            {
+                Put32(fields, static_cast<uint32_t>(compressed));
+                Put32(fields, static_cast<uint32_t>(uncompressed));
+                out.Patch(localOffset + 14, fields);
+            }
+            AppendCentralRecord(directory, item, deflate, zip64, crc, compressed, uncompressed, localOffset);
+            entryCount++;
+            result.inputBytes += uncompressed;
+            if (item.directory)
+                result.folders++;
+            else
+                result.files++;
+            if (itemFailed)
+                result.failed++;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        slot.done = false;
+        written++;
+        slotFree.notify_all();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+        slotFree.notify_all();
+    }
+    for (auto& thread : pool)
+        thread.join();
+
+    uint64_t directoryOffset = out.Position();
+    out.Append(directory);
+    std::string end;
+    AppendEndRecords(end, entryCount, directoryOffset, directory.size());
+    out.Append(end);
+    out.Flush();
+    result.archiveBytes = out.Position();
+
+    bool ok = !out.Failed();
+    writer.reset();
+    if (!ok)
+        fs.DeleteEntry(archivePath);
+    return ok;
+}
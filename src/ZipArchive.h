@@ -0,0 +1,31 @@
+#pragma once
+#include "FileSystem.h"
+
+// ZIP archives of a selection ("New archive with selection"). Files are read and
+// deflated in 1 MB chunks on a worker pool and written strictly in order, so memory
+// stays at a few chunks per thread however large the selection. ZIP64 fields are
+// only added where a size, an offset or the entry count needs them.
+
+struct ArchiveOptions
+{
+    unsigned threads = 0;  // Compression threads; 0 picks a default
+};
+
+struct ArchiveResult
+{
+    size_t files = 0;
+    size_t folders = 0;
+    size_t failed = 0;            // Unreadable entries: left out, or cut short if they failed midway
+    uint64_t inputBytes = 0;
+    uint64_t archiveBytes = 0;
+};
+
+// Formats that are compressed already (most photo, video and audio types, archives and
+// Office documents); they are stored, since deflating them again costs time and saves nothing
+bool IsCompressedFormat(const std::wstring& path);
+
+// Creates archivePath (never replaces an existing file) with every entry under its own
+// name; selected folders are added with everything below them. Returns false, and removes
+// the partial archive, when the archive itself cannot be written.
+bool CreateZipArchive(IFileSystem& fs, const std::wstring& archivePath, const std::vector<FileEntry>& entries,
+    ArchiveResult& result, const ArchiveOptions& options = ArchiveOptions());
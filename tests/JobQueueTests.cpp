@@ -0,0 +1,367 @@
+// Tests for the background job queue the shell extension runs its commands on, and for
+// the portable plan/execute path such a job runs, against FakeFileSystem, and for the
+// planner cases a job hands it.
+//
+//   NewFolderFromFilesTests [name]   (no name: every test)
+
+#include "FakeFileSystem.h"
+#include "JobQueue.h"
+#include "OrganizeExecutor.h"
+#include "OrganizePlanner.h"
+#include "OrganizeStreaming.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+static int g_failures = 0;
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            g_failures++; \
+        } \
+    } while (0)
+
+using namespace std::chrono_literals;
+
+#ifdef _WIN32
+static const wchar_t* const kInbox = L"C:\\inbox";
+#else
+static const wchar_t* const kInbox = L"/inbox";
+#endif
+
+// Polls until condition holds or a generous deadline passes (loaded CI machines)
+template <typename Condition>
+static bool WaitFor(Condition condition)
+{
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (!condition())
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::sleep_for(1ms);
+    }
+    return true;
+}
+
+static void TestRunsJobsInOrder()
+{
+    JobQueue queue;
+    std::vector<int> order;  // Only the worker writes it; Drain orders the read after
+    for (int i = 0; i < 100; i++)
+        queue.Post([&order, i]() { order.push_back(i); });
+    queue.Drain();
+
+    CHECK(order.size() == 100);
+    for (int i = 0; i < static_cast<int>(order.size()); i++)
+        CHECK(order[i] == i);
+    CHECK(queue.Pending() == 0);
+}
+
+static void TestDrainWaitsForRunningJob()
+{
+    JobQueue queue;
+    std::atomic<bool> started(false), finished(false);
+    queue.Post([&]() {
+        started = true;
+        std::this_thread::sleep_for(50ms);
+        finished = true;
+    });
+    CHECK(WaitFor([&]() { return started.load(); }));
+    CHECK(queue.Pending() == 1);
+    queue.Drain();
+    CHECK(finished);
+    CHECK(queue.Pending() == 0);
+
+    // Nothing posted: returns at once
+    queue.Drain();
+}
+
+static void TestIdleExitAndRestart()
+{
+    std::atomic<int> starts(0), exits(0), runs(0);
+    JobQueue::ThreadHooks hooks;
+    hooks.start = [&]() { starts++; };
+    hooks.exit = [&]() { exits++; };
+    JobQueue queue(hooks, 20ms);
+
+    // No thread until there is work
+    std::this_thread::sleep_for(50ms);
+    CHECK(starts == 0);
+
+    queue.Post([&]() { runs++; });
+    queue.Drain();
+    CHECK(runs == 1);
+    CHECK(starts == 1);
+
+    // The idle worker leaves, running its exit hook
+    CHECK(WaitFor([&]() { return exits.load() == 1; }));
+
+    // The next job starts a fresh worker
+    queue.Post([&]() { runs++; });
+    queue.Drain();
+    CHECK(runs == 2);
+    CHECK(starts == 2);
+    CHECK(WaitFor([&]() { return exits.load() == 2; }));
+}
+
+static void TestThrowingJobKeepsQueueRunning()
+{
+    JobQueue queue;
+    std::atomic<bool> ranAfter(false);
+    queue.Post([]() { throw std::runtime_error("job failed"); });
+    queue.Post([]() { throw 42; });
+    queue.Post([&]() { ranAfter = true; });
+    queue.Drain();
+    CHECK(ranAfter);
+    CHECK(queue.Pending() == 0);
+}
+
+static void TestDestructionRunsPendingJobs()
+{
+    std::atomic<int> runs(0), exits(0);
+    {
+        JobQueue::ThreadHooks hooks;
+        hooks.exit = [&]() { exits++; };
+        JobQueue queue(hooks);
+        queue.Post([&]() {
+            std::this_thread::sleep_for(30ms);
+            runs++;
+        });
+        queue.Post([&]() { runs++; });
+    }
+    CHECK(runs == 2);
+    CHECK(exits == 1);
+}
+
+static void TestOrganizeJobOnFakeFileSystem()
+{
+    FakeFileSystemOptions options;
+    options.metadata = { 5, 20 };
+    options.change = { 5, 20 };
+    FakeFileSystem fs(options);
+    std::wstring folder = kInbox;
+    fs.AddFolder(folder);
+    const uint64_t kTicks2023 = 133170048000000000ULL;  // 2023-01-01, FILETIME ticks
+    for (const wchar_t* name : { L"a.jpg", L"b.JPG", L"c.mp4", L"notes.txt", L"song.mp3" })
+        fs.AddFile(JoinPath(folder, name), 1000, kTicks2023);
+    fs.AddFolder(JoinPath(folder, L"Photo"));  // Existing destinations are merged into
+
+    // What InvokeCommand posts: a snapshot of the selection, organized on the worker
+    JobQueue queue;
+    OrganizeResult result;
+    size_t groups = 0;
+    queue.Post([&]() {
+        std::vector<FileEntry> listing, entries;
+        if (fs.ListDirectory(folder, listing) != FsResult::Ok)
+            return;
+        for (auto& entry : listing)
+        {
+            if (!entry.isDirectory)
+                entries.push_back(std::move(entry));
+        }
+
+        OrganizePlan plan;
+        if (!BuildOrganizePlan(entries, OrganizeMode::ByTypePhoto, plan))
+            return;
+        groups = plan.groups.size();
+        std::vector<std::wstring> destinations = ResolveDestinations(fs, folder, plan);
+        ExecuteOrganizePlan(fs, folder, entries, plan, destinations, result);
+    });
+    queue.Drain();
+
+    CHECK(groups == 4);
+    CHECK(result.moved == 5);
+    CHECK(result.failed == 0);
+    CHECK(result.folders.size() == 4);
+    CHECK(fs.PathExists(JoinPath(JoinPath(folder, L"Photo"), L"a.jpg")));
+    CHECK(fs.PathExists(JoinPath(JoinPath(folder, L"Photo"), L"b.JPG")));
+    CHECK(fs.PathExists(JoinPath(JoinPath(folder, L"Video"), L"c.mp4")));
+    CHECK(fs.PathExists(JoinPath(JoinPath(folder, L"Document"), L"notes.txt")));
+    CHECK(fs.PathExists(JoinPath(JoinPath(folder, L"Audio"), L"song.mp3")));
+    CHECK(!fs.PathExists(JoinPath(folder, L"a.jpg")));
+    CHECK(fs.ElapsedMs() > 0);
+}
+
+static void TestOrganizeJobWithBlockedFolder()
+{
+    // A file where the Video folder should go: that group fails, the others still move
+    FakeFileSystem fs;
+    std::wstring folder = kInbox;
+    fs.AddFolder(folder);
+    fs.AddFile(JoinPath(folder, L"Video"), 10, 0);
+    std::vector<FileEntry> entries(3);
+    entries[0].path = JoinPath(folder, L"a.jpg");
+    entries[1].path = JoinPath(folder, L"b.jpg");
+    entries[2].path = JoinPath(folder, L"c.mp4");
+    for (const auto& entry : entries)
+        fs.AddFile(entry.path, 10, 0);
+
+    JobQueue queue;
+    OrganizeResult result;
+    queue.Post([&]() {
+        OrganizePlan plan;
+        BuildOrganizePlan(entries, OrganizeMode::ByTypePhoto, plan);
+        ExecuteOrganizePlan(fs, folder, entries, plan, ResolveDestinations(fs, folder, plan), result);
+    });
+    queue.Drain();
+
+    CHECK(result.moved == 2);
+    CHECK(result.failed == 1);
+    CHECK(fs.PathExists(entries[2].path));
+    CHECK(fs.PathExists(JoinPath(JoinPath(folder, L"Photo"), L"b.jpg")));
+}
+
+static void TestStreamingRerunKeepsFolders()
+{
+    FakeFileSystem fs;
+    std::wstring folder = kInbox;
+    fs.AddFolder(folder);
+    for (const wchar_t* name : { L"a.jpg", L"b.png", L"notes.txt" })
+        fs.AddFile(JoinPath(folder, name), 10, 0);
+
+    for (int run = 0; run < 2; run++)
+    {
+        if (run == 1)
+            fs.AddFile(JoinPath(folder, L"c.jpg"), 10, 0);  // Arrived since the first run
+        StreamingPlan plan;
+        OrganizeResult result;
+        CHECK(BuildStreamingPlan(fs, folder, OrganizeMode::ByTypePhoto, OrganizeOptions(), plan));
+        CHECK(ExecuteStreamingPlan(fs, folder, plan, result));
+        CHECK(result.failed == 0);
+        CHECK(result.moved == (run == 0 ? 3u : 1u));
+    }
+
+    std::wstring photo = JoinPath(folder, L"Photo");
+    CHECK(fs.PathExists(JoinPath(photo, L"a.jpg")));
+    CHECK(fs.PathExists(JoinPath(photo, L"b.png")));
+    CHECK(fs.PathExists(JoinPath(photo, L"c.jpg")));
+    CHECK(fs.PathExists(JoinPath(JoinPath(folder, L"Document"), L"notes.txt")));
+    CHECK(!fs.PathExists(JoinPath(folder, L"Other")));
+    CHECK(!fs.PathExists(JoinPath(JoinPath(folder, L"Other"), L"Photo")));
+}
+
+static void TestFakeClockOverlapsSlots()
+{
+    // Fixed 10 ms calls on a share serving 4 at once
+    FakeFileSystemOptions options;
+    options.metadata = { 10, 10 };
+    options.change = { 10, 10 };
+    options.slots = 4;
+    FakeFileSystem fs(options);
+    std::wstring folder = kInbox;
+    fs.AddFolder(JoinPath(folder, L"out"));
+    std::vector<MoveRequest> moves(8);
+    for (size_t i = 0; i < moves.size(); i++)
+    {
+        moves[i].from = JoinPath(folder, std::to_wstring(i) + L".txt");
+        moves[i].to = JoinPath(JoinPath(folder, L"out"), std::to_wstring(i) + L".txt");
+        fs.AddFile(moves[i].from, 10, 0);
+    }
+
+    // Calls on the creating thread are serial; a batch overlaps 4 requests at a time
+    FileEntry entry;
+    entry.path = moves[0].from;
+    fs.QueryMetadata(entry);
+    fs.QueryMetadata(entry);
+    CHECK(fs.ElapsedMs() == 20);
+    fs.MoveEntries(moves);
+    for (const auto& move : moves)
+        CHECK(move.result == FsResult::Ok);
+    CHECK(fs.ElapsedMs() == 40);
+
+    // Calls from other threads overlap too, however the threads were scheduled
+    std::vector<std::thread> pool;
+    for (int t = 0; t < 4; t++)
+    {
+        pool.emplace_back([&fs, &moves]() {
+            for (const auto& move : moves)
+                fs.PathExists(move.to);
+        });
+    }
+    for (auto& thread : pool)
+        thread.join();
+    CHECK(fs.ElapsedMs() == 120);
+}
+
+static void TestSimilarNamesOutsideAscii()
+{
+    // Distinct non-ASCII names and names without letters or digits stay apart; similar
+    // Cyrillic names still cluster
+    const wchar_t* const names[] =
+    {
+        L"\u041e\u0442\u0447\u0451\u0442 \u0437\u0430 \u043c\u0430\u0440\u0442.pdf",
+        L"\u5199\u771f.jpg",
+        L"\u0414\u043e\u0433\u043e\u0432\u043e\u0440.docx",
+        L".bashrc",
+        L".profile",
+        L"---.txt",
+        L"!!!.txt",
+        L"\u041e\u0442\u0447\u0451\u0442 \u0437\u0430 \u043c\u0430\u0440\u0442 v2.pdf",
+    };
+    std::vector<FileEntry> entries;
+    for (const wchar_t* name : names)
+    {
+        FileEntry entry;
+        entry.path = JoinPath(kInbox, name);
+        entries.push_back(entry);
+    }
+
+    OrganizePlan plan;
+    CHECK(BuildOrganizePlan(entries, OrganizeMode::BySimilarName, plan));
+    CHECK(plan.groups.size() == 1);
+    if (plan.groups.size() == 1)
+    {
+        CHECK(!plan.groups[0].folderName.empty());
+        CHECK(plan.groups[0].items.size() == 2);
+        for (size_t index : plan.groups[0].items)
+            CHECK(index == 0 || index == 7);
+    }
+}
+
+struct TestCase
+{
+    const char* name;
+    void (*run)();
+};
+
+static const TestCase kTests[] =
+{
+    { "order", TestRunsJobsInOrder },
+    { "drain", TestDrainWaitsForRunningJob },
+    { "idle-restart", TestIdleExitAndRestart },
+    { "throwing-job", TestThrowingJobKeepsQueueRunning },
+    { "destruction", TestDestructionRunsPendingJobs },
+    { "organize-fake", TestOrganizeJobOnFakeFileSystem },
+    { "organize-blocked-folder", TestOrganizeJobWithBlockedFolder },
+    { "stream-rerun", TestStreamingRerunKeepsFolders },
+    { "fake-clock-slots", TestFakeClockOverlapsSlots },
+    { "similar-names-non-ascii", TestSimilarNamesOutsideAscii },
+};
+
+int main(int argc, char** argv)
+{
+    int ran = 0;
+    for (const auto& test : kTests)
+    {
+        if (argc > 1 && strcmp(argv[1], test.name) != 0)
+            continue;
+        int before = g_failures;
+        test.run();
+        printf("%s %s\n", g_failures == before ? "PASS" : "FAIL", test.name);
+        ran++;
+    }
+    if (ran == 0)
+    {
+        fprintf(stderr, "No test named %s\n", argc > 1 ? argv[1] : "");
+        return 2;
+    }
+    return g_failures == 0 ? 0 : 1;
+}